@@ -36,12 +36,13 @@ using std::set;
 using std::cout;
 using std::endl;
 using std::string;
-using std::runtime_error;
 
 using namespace Tins;
  
 class BeaconSniffer {
 public:
+    BeaconSniffer();
+
     void run(const string& iface);
 private:
     typedef Dot11::address_type address_type;
@@ -50,7 +51,18 @@ private:
     bool callback(PDU& pdu);
      
     ssids_type ssids;
+    Dot11MgmtScanner scanner;
+    bool has_radiotap;
 };
+
+BeaconSniffer::BeaconSniffer() 
+: has_radiotap(false) {
+    // We only need these elements, so don't bother looking at the rest
+    scanner.clear_requests();
+    scanner.request(Dot11::SSID);
+    scanner.request(Dot11::DS_SET);
+    scanner.request(Dot11::HT_OPERATION);
+}
  
 void BeaconSniffer::run(const std::string& iface) {
     SnifferConfiguration config;
@@ -58,31 +70,60 @@ void BeaconSniffer::run(const std::string& iface) {
     config.set_filter("type mgt subtype beacon");
     config.set_rfmon(true);
     Sniffer sniffer(iface, config);
+    // Avoid parsing every beacon into a Dot11Beacon, the scanner
+    // only looks at what we need
+    sniffer.set_extract_raw_pdus(true);
+    has_radiotap = sniffer.link_type() == DLT_IEEE802_11_RADIO;
     sniffer.sniff_loop(make_sniffer_handler(this, &BeaconSniffer::callback));
 }
  
 bool BeaconSniffer::callback(PDU& pdu) {
-    // Get the Dot11 layer
-    const Dot11Beacon& beacon = pdu.rfind_pdu<Dot11Beacon>();
+    const RawPDU::payload_type& payload = pdu.rfind_pdu<RawPDU>().payload();
+    if (payload.empty()) {
+        return true;
+    }
+    const uint8_t* buffer = &payload[0];
+    uint32_t size = static_cast<uint32_t>(payload.size());
+    if (has_radiotap) {
+        // Skip the RadioTap header, its length is a little endian 
+        // field at offset 2
+        if (size < 4) {
+            return true;
+        }
+        const uint32_t radiotap_size = buffer[2] | (buffer[3] << 8);
+        if (radiotap_size > size) {
+            return true;
+        }
+        buffer += radiotap_size;
+        size -= radiotap_size;
+    }
+    if (!scanner.scan(buffer, size) || scanner.subtype() != Dot11::BEACON) {
+        return true;
+    }
     // All beacons must have from_ds == to_ds == 0
-    if (!beacon.from_ds() && !beacon.to_ds()) {
+    if (!scanner.from_ds() && !scanner.to_ds()) {
         // Get the AP address
-        address_type addr = beacon.addr2();
+        address_type addr = scanner.addr2();
         // Look it up in our set
         ssids_type::iterator it = ssids.find(addr);
         if (it == ssids.end()) {
             // First time we encounter this BSSID.
             try {
-                /* If no ssid option is set, then Dot11::ssid will throw 
-                 * a std::runtime_error.
+                /* If no ssid element is present, then Dot11MgmtScanner::ssid 
+                 * will throw an option_not_found.
                  */
-                string ssid = beacon.ssid();
+                string ssid = scanner.ssid();
                 // Save it so we don't show it again.
                 ssids.insert(addr);
                 // Display the tuple "address - ssid".
-                cout << addr << " - " << ssid << endl;
+                cout << addr << " - " << ssid;
+                if (scanner.search_element(Dot11::DS_SET) || 
+                    scanner.search_element(Dot11::HT_OPERATION)) {
+                    cout << " (channel " << (int)scanner.channel() << ")";
+                }
+                cout << endl;
             }
-            catch (runtime_error&) {
+            catch (option_not_found&) {
                 // No ssid, just ignore it.
             }
         }
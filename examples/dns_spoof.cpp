@@ -51,11 +51,15 @@ bool callback(const PDU& pdu) {
 
     // Is it a DNS query?
     if (dns.type() == DNS::QUERY) {
+        // Start a response which contains the same questions
+        DNSBuilder response(dns);
+        bool answered = false;
         // Let's see if there's any query for an "A" record.
         for (const auto& query : dns.queries()) {
             if (query.query_type() == DNS::A) {
-                // Here's one! Let's add an answer.
-                dns.add_answer(
+                // Here's one! Let's add an answer. Its name will point
+                // to the one in the question.
+                response.add_answer(
                     DNS::resource(
                         query.dname(), 
                         "127.0.0.1",
@@ -65,19 +69,18 @@ bool callback(const PDU& pdu) {
                         777
                     )
                 );
+                answered = true;
             }
         }
         // Have we added some answers?
-        if (dns.answers_count() > 0) {
-            // It's a response now
-            dns.type(DNS::RESPONSE);
+        if (answered) {
             // Recursion is available(just in case)
-            dns.recursion_available(1);
+            response.recursion_available(1);
             // Build our packet
             auto pkt = EthernetII(eth.src_addr(), eth.dst_addr()) /
                        IP(ip.src_addr(), ip.dst_addr()) /
                        UDP(udp.sport(), udp.dport()) /
-                       dns;
+                       response.build();
             // Send it!
             sender.send(pkt);
         }
@@ -37,149 +37,50 @@
 #include <iostream>
 #include <mutex>
 #include <chrono>
-#include <map>
 #include <thread>
-#include <algorithm>
 #include <tins/tins.h>
 
 using std::cout;
 using std::endl;
 using std::thread;
 using std::string;
-using std::bind;
-using std::map;
 using std::mutex;
-using std::max;
-using std::min;
 using std::exception;
 using std::lock_guard;
-using std::tuple;
-using std::make_tuple;
 using std::this_thread::sleep_for;
 using std::chrono::seconds;
-using std::chrono::milliseconds;
-using std::chrono::duration_cast;
-using std::chrono::system_clock;
 
 using namespace Tins;
 
-// Holds the DNS response time statistics. The response time is 
-// represented using the Duration template parameter.
-template<typename Duration>
-class statistics {
+// Sniffs DNS queries and responses and hands them to a 
+// DNSTransactionTracker, which matches them and keeps the response
+// time statistics. Queries that aren't answered are eventually discarded
+// and counted as unanswered.
+class dns_monitor {
 public:
-    typedef Duration duration_type;
     typedef lock_guard<mutex> locker_type;
-    
+
     struct information {
-        duration_type average, worst;
-        size_t count;
-    };
-    
-    statistics()
-    : m_duration(), m_worst(duration_type::min()), m_count() {
-        
-    }
-    
-    void add_response_time(const duration_type& duration) {
-        locker_type _(m_lock);
-        m_duration += duration;
-        m_count++;
-        m_worst = max(m_worst, duration);
-    }
-    
-    information get_information() const {
-        locker_type _(m_lock);
-        if(m_count == 0) {
-            return { };
-        }
-        else {
-            return { m_duration / m_count, m_worst, m_count };
-        }
+        LatencyHistogram latency;
+        uint64_t unanswered;
     };
-private:
-    duration_type m_duration, m_worst;
-    size_t m_count;
-    mutable mutex m_lock;
-};
 
-// Sniffs and tracks DNS queries. When a matching DNS response is found,
-// the response time is added to a statistics object.
-//
-// This class performs* no cleanup* on data associated with queries that
-// weren't answered.
-class dns_monitor {
-public:
-    // The response times are measured in milliseconds
-    typedef milliseconds duration_type;
-    // The statistics type used.
-    typedef statistics<duration_type> statistics_type;
-    
     void run(BaseSniffer& sniffer);
-    const statistics_type& stats() const {
-        return m_stats;
+    information get_information() const {
+        locker_type _(m_lock);
+        return { m_tracker.latency(), m_tracker.unanswered_count() };
     }
 private:
-    typedef tuple<IPv4Address, IPv4Address, uint16_t> packet_info;
-    typedef system_clock clock_type;
-    typedef clock_type::time_point time_point_type;
-
-    bool callback(const PDU& pdu);
-    static packet_info make_packet_info(const PDU& pdu, const DNS& dns);
-    
-    statistics_type m_stats;    
-    map<packet_info, time_point_type> m_packet_info;
+    DNSTransactionTracker m_tracker;
+    mutable mutex m_lock;
 };
 
 void dns_monitor::run(BaseSniffer& sniffer) {
-    sniffer.sniff_loop(
-        bind(
-            &dns_monitor::callback, 
-            this, 
-            std::placeholders::_1
-        )
-    );
-}
-
-bool dns_monitor::callback(const PDU& pdu) {
-    auto now = clock_type::now();
-    auto dns = pdu.rfind_pdu<RawPDU>().to<DNS>();
-    auto info = make_packet_info(pdu, dns);
-    // If it's a query, add the sniff time to our map.
-    if (dns.type() == DNS::QUERY) {
-        m_packet_info.insert(
-            std::make_pair(info, now)
-        );
-    }
-    else {
-        // It's a response, we need to find the query in our map.
-        auto iter = m_packet_info.find(info);
-        if (iter != m_packet_info.end()) {
-            // We found the query, let's add the response time to the
-            // statistics object.
-            m_stats.add_response_time(
-                duration_cast<duration_type>(now - iter->second)
-            );
-            // Forget about the query.
-            m_packet_info.erase(iter);
-        }
+    for (auto& packet : sniffer) {
+        locker_type _(m_lock);
+        // The packet's timestamp is used to measure the response time
+        m_tracker.process_packet(packet);
     }
-    return true;
-}
-
-// It is required that we can identify packets sent and received that
-// hold the same DNS id as belonging to the same query. 
-// 
-// This function retrieves a tuple (addr, addr, id) that will achieve it.
-auto dns_monitor::make_packet_info(const PDU& pdu, const DNS& dns) -> packet_info {
-    const auto& ip = pdu.rfind_pdu<IP>();
-    return make_tuple( 
-        // smallest address first
-        min(ip.src_addr(), ip.dst_addr()),
-        // largest address second
-        max(ip.src_addr(), ip.dst_addr()),
-        dns.id()
-    );
 }
 
 int main(int argc, char* argv[]) {
@@ -193,6 +94,8 @@ int main(int argc, char* argv[]) {
         iface = NetworkInterface::default_interface().name();
     }
     try {
+        // Decode DNS (among others) right away, rather than in a RawPDU
+        Allocators::register_application_allocators();
         SnifferConfiguration config;
         config.set_promisc_mode(true);
         config.set_filter("udp and port 53");
@@ -204,10 +107,12 @@ int main(int argc, char* argv[]) {
             }
         );
         while (true) {
-            auto info = monitor.stats().get_information();
-            cout << "\rAverage " << info.average.count() 
-                << "ms. Worst: " << info.worst.count() << "ms. Count: "
-                << info.count << "   ";
+            auto info = monitor.get_information();
+            cout << "\rAverage " << info.latency.mean().count() 
+                << "us. 99th percentile: " << info.latency.percentile(99).count()
+                << "us. Worst: " << info.latency.maximum().count() 
+                << "us. Count: " << info.latency.count() 
+                << ". Unanswered: " << info.unanswered << "   ";
             cout.flush();
             sleep_for(seconds(1));
         }
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <tins/radiotap.h>
+#include <tins/dot11/dot11_beacon.h>
+#include <tins/utils/radiotap_parser.h>
+#include <tins/sniffer.h>
+#include <tins/rawpdu.h>
+#include <tins/packet.h>
+
+using std::cout;
+using std::endl;
+using std::vector;
+using std::chrono::steady_clock;
+using std::chrono::duration;
+
+using namespace Tins;
+using Tins::Utils::RadioTapParser;
+
+// Measures how fast RadioTap headers can be parsed and have their fields
+// looked up. Frames are read from the pcap file given as the second argument
+// if any, otherwise a few frames using common present flags are built
+
+typedef vector<uint8_t> frame_type;
+
+const RadioTap::PresentFlags looked_up_fields[] = {
+    RadioTap::TSFT,
+    RadioTap::FLAGS,
+    RadioTap::RATE,
+    RadioTap::CHANNEL,
+    RadioTap::DBM_SIGNAL,
+    RadioTap::ANTENNA,
+    RadioTap::RX_FLAGS,
+    RadioTap::MCS
+};
+
+const size_t looked_up_fields_count = sizeof(looked_up_fields) / 
+                                      sizeof(looked_up_fields[0]);
+
+vector<frame_type> build_frames() {
+    vector<frame_type> frames;
+    Dot11Beacon beacon("ff:ff:ff:ff:ff:ff", "00:01:02:03:04:05");
+    beacon.addr3(beacon.addr2());
+    beacon.ssid("libtins");
+    beacon.ds_parameter_set(6);
+
+    // The default RadioTap flags
+    RadioTap radio;
+    frames.push_back((radio / beacon).serialize());
+
+    RadioTap::mcs_type mcs;
+    mcs.known = 0x07;
+    mcs.flags = 0;
+    mcs.mcs = 7;
+    radio.rate(12);
+    radio.dbm_noise(-95);
+    radio.mcs(mcs);
+    frames.push_back((radio / beacon).serialize());
+
+    radio.xchannel(RadioTap::xchannel_type());
+    radio.data_retries(1);
+    frames.push_back((radio / beacon).serialize());
+    return frames;
+}
+
+vector<frame_type> load_frames(const char* file_name) {
+    vector<frame_type> frames;
+    FileSniffer sniffer(file_name);
+    sniffer.set_extract_raw_pdus(true);
+    if (sniffer.link_type() != DLT_IEEE802_11_RADIO) {
+        cout << file_name << " doesn't contain RadioTap frames" << endl;
+        return frames;
+    }
+    while (Packet packet = sniffer.next_packet()) {
+        const RawPDU::payload_type& payload = packet.pdu()->rfind_pdu<RawPDU>().payload();
+        // Only keep frames that RadioTap can parse
+        try {
+            RadioTap radio(&payload[0], payload.size());
+            frames.push_back(payload);
+        }
+        catch (exception_base&) {
+        }
+    }
+    return frames;
+}
+
+void report(const char* name, size_t headers, steady_clock::time_point start) {
+    const duration<double> elapsed = steady_clock::now() - start;
+    cout << name << ": " << headers / elapsed.count() << " headers/s, "
+         << elapsed.count() * 1e9 / headers << " ns/header" << endl;
+}
+
+void run_parser_benchmark(const vector<frame_type>& frames, size_t iterations) {
+    size_t found = 0;
+    const steady_clock::time_point start = steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        for (size_t j = 0; j < frames.size(); ++j) {
+            const frame_type& frame = frames[j];
+            const uint32_t length = frame[2] | (frame[3] << 8);
+            // Use a fresh parser per field, just like the RadioTap getters do
+            for (size_t k = 0; k < looked_up_fields_count; ++k) {
+                RadioTapParser parser(&frame[4], length - 4);
+                if (parser.skip_to_field(looked_up_fields[k])) {
+                    found += *parser.current_option_ptr();
+                }
+            }
+        }
+    }
+    report("RadioTapParser lookups", iterations * frames.size(), start);
+    // Make sure the loop isn't optimized away
+    cout << "  (checksum " << found << ")" << endl;
+}
+
+void run_radiotap_benchmark(const vector<frame_type>& frames, size_t iterations) {
+    int64_t total = 0;
+    const steady_clock::time_point start = steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        for (size_t j = 0; j < frames.size(); ++j) {
+            const RadioTap radio(&frames[j][0], frames[j].size());
+            const RadioTap::PresentFlags present = radio.present();
+            if ((present & RadioTap::DBM_SIGNAL) != 0) {
+                total += radio.dbm_signal();
+            }
+            if ((present & RadioTap::CHANNEL) != 0) {
+                total += radio.channel_freq();
+            }
+            if ((present & RadioTap::ANTENNA) != 0) {
+                total += radio.antenna();
+            }
+        }
+    }
+    report("RadioTap parsing and getters", iterations * frames.size(), start);
+    cout << "  (checksum " << total << ")" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    size_t iterations = 100000;
+    if (argc > 1) {
+        iterations = std::strtoul(argv[1], 0, 10);
+    }
+    vector<frame_type> frames;
+    try {
+        frames = (argc > 2) ? load_frames(argv[2]) : build_frames();
+    }
+    catch (std::exception& ex) {
+        cout << "Error: " << ex.what() << endl;
+        return 1;
+    }
+    if (frames.empty()) {
+        cout << "No frames to parse" << endl;
+        return 1;
+    }
+    cout << "Parsing " << frames.size() << " RadioTap headers " 
+         << iterations << " times" << endl;
+    run_parser_benchmark(frames, iterations);
+    run_radiotap_benchmark(frames, iterations);
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <openssl/evp.h>
+#include <tins/dot11/dot11_data.h>
+#include <tins/crypto.h>
+#include <tins/rawpdu.h>
+#include <tins/snap.h>
+
+using std::cout;
+using std::endl;
+using std::vector;
+using std::chrono::steady_clock;
+using std::chrono::duration;
+
+using namespace Tins;
+using Crypto::WPA2::SessionKeys;
+
+// Measures how fast 1500 byte frames can be decrypted using each of the 
+// ciphers supported by WPA2Decrypter
+
+const size_t frame_size = 1500;
+
+// Builds a CCMP or GCMP protected payload for the given frame. The key 
+// starts at byte 32 of the PTK, just like SessionKeys expects
+RawPDU encrypt(const Dot11Data& dot11, SessionKeys::CipherType cipher,
+               const SessionKeys::ptk_type& ptk) {
+    const bool is_ccmp = (cipher == SessionKeys::CCMP);
+    const size_t mic_size = is_ccmp ? 8 : 16;
+    const PDU::serialization_type header = Dot11Data(dot11).serialize();
+    uint8_t aad[22];
+    aad[0] = header[0] & 0x8f;
+    aad[1] = (header[1] & 0xc7) | 0x40;
+    std::copy(header.begin() + 4, header.begin() + 22, aad + 2);
+    aad[20] = header[22] & 0x0f;
+    aad[21] = 0;
+    // Packet number 1 using the extended IV
+    const uint8_t pn_header[8] = { 1, 0, 0, 0x20, 0, 0, 0, 0 };
+    uint8_t nonce[13] = { 0 };
+    uint8_t* nonce_start = is_ccmp ? nonce + 1 : nonce;
+    dot11.addr2().copy(nonce_start);
+    nonce_start[11] = 1;
+
+    vector<uint8_t> plaintext(frame_size, 0xaa);
+    vector<uint8_t> payload(pn_header, pn_header + 8);
+    payload.resize(8 + frame_size + mic_size);
+    uint8_t* output = &payload[8];
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    int length;
+    if (is_ccmp) {
+        EVP_EncryptInit_ex(ctx, EVP_aes_128_ccm(), 0, 0, 0);
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_IVLEN, 13, 0);
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_TAG, (int)mic_size, 0);
+        EVP_EncryptInit_ex(ctx, 0, 0, &ptk[32], nonce);
+        EVP_EncryptUpdate(ctx, 0, &length, 0, (int)frame_size);
+    }
+    else {
+        const EVP_CIPHER* evp_cipher = (cipher == SessionKeys::GCMP_256) ? EVP_aes_256_gcm()
+                                                                          : EVP_aes_128_gcm();
+        EVP_EncryptInit_ex(ctx, evp_cipher, 0, 0, 0);
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, 12, 0);
+        EVP_EncryptInit_ex(ctx, 0, 0, &ptk[32], nonce);
+    }
+    EVP_EncryptUpdate(ctx, 0, &length, aad, sizeof(aad));
+    EVP_EncryptUpdate(ctx, output, &length, &plaintext[0], (int)frame_size);
+    EVP_EncryptFinal_ex(ctx, output + length, &length);
+    EVP_CIPHER_CTX_ctrl(ctx, is_ccmp ? EVP_CTRL_CCM_GET_TAG : EVP_CTRL_GCM_GET_TAG,
+                        (int)mic_size, output + frame_size);
+    EVP_CIPHER_CTX_free(ctx);
+    return RawPDU(payload);
+}
+
+void run_benchmark(const char* name, SessionKeys::CipherType cipher, size_t iterations) {
+    SessionKeys::ptk_type ptk(SessionKeys::PTK_SIZE);
+    for (size_t i = 0; i < ptk.size(); ++i) {
+        ptk[i] = static_cast<uint8_t>(i);
+    }
+    SessionKeys keys(ptk, cipher);
+    Dot11Data dot11("00:01:02:03:04:05", "06:07:08:09:0a:0b");
+    dot11.addr3("06:07:08:09:0a:0b");
+    dot11.from_ds(1);
+    dot11.wep(1);
+    const RawPDU encrypted = encrypt(dot11, cipher, ptk);
+
+    size_t decrypted = 0;
+    const steady_clock::time_point start = steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        // Decryption is done in place so use a fresh copy every time
+        RawPDU raw = encrypted;
+        SNAP* snap = keys.decrypt_unicast(dot11, raw);
+        if (snap) {
+            ++decrypted;
+            delete snap;
+        }
+    }
+    const duration<double> elapsed = steady_clock::now() - start;
+    const double megabytes = static_cast<double>(iterations * frame_size) / (1024 * 1024);
+    cout << name << ": " << megabytes / elapsed.count() << " MB/s";
+    if (decrypted != iterations) {
+        cout << " (" << iterations - decrypted << " frames failed to decrypt)";
+    }
+    cout << endl;
+}
+
+int main(int argc, char* argv[]) {
+    size_t iterations = 100000;
+    if (argc > 1) {
+        iterations = std::strtoul(argv[1], 0, 10);
+    }
+    cout << "Decrypting " << iterations << " frames of " << frame_size 
+         << " bytes" << endl;
+    run_benchmark("CCMP", SessionKeys::CCMP, iterations);
+    run_benchmark("GCMP-128", SessionKeys::GCMP_128, iterations);
+    run_benchmark("GCMP-256", SessionKeys::GCMP_256, iterations);
+}
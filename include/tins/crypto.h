@@ -41,6 +41,11 @@
 #include <tins/macros.h>
 #include <tins/handshake_capturer.h>
 
+#ifdef TINS_HAVE_WPA2_DECRYPTION
+// OpenSSL's EVP_CIPHER_CTX
+struct evp_cipher_ctx_st;
+#endif // TINS_HAVE_WPA2_DECRYPTION
+
 namespace Tins {
 
 class PDU;
@@ -78,6 +83,16 @@ public:
      * The type used to hold the PMK (this has to be PMK_SIZE bytes long).
      */
     typedef std::vector<uint8_t> pmk_type;
+
+    /**
+     * The ciphers that can be used to protect unicast traffic.
+     */
+    enum CipherType {
+        TKIP,
+        CCMP,
+        GCMP_128,
+        GCMP_256
+    };
     
     /**
      * Default constructs a SessionKeys object.
@@ -93,6 +108,18 @@ public:
      */
     SessionKeys(const ptk_type& ptk, bool is_ccmp);
 
+    /**
+     * \brief Constructs an instance using the provided PTK and cipher.
+     *
+     * The temporal key is read from the PTK starting at byte 32, as in 
+     * keys derived from a 4-way handshake. GCMP_256 uses a 32 byte temporal
+     * key while every other cipher uses a 16 byte one.
+     *
+     * \param ptk The PTK to use.
+     * \param cipher The cipher used to protect this traffic.
+     */
+    SessionKeys(const ptk_type& ptk, CipherType cipher);
+
     /**
      * \brief Constructs an instance using a handshake and a PMK.
      *
@@ -106,6 +133,13 @@ public:
     /**
      * \brief Decrypts a unicast packet.
      *
+     * The payload is decrypted in place, so the RawPDU's contents are
+     * modified even if decryption fails.
+     *
+     * TKIP phase 1 keys and the CCMP/GCMP cipher context are cached within
+     * this object, so the same instance must not be used to decrypt from
+     * several threads at once. Copies don't share this state.
+     *
      * \param dot11 The encrypted packet to decrypt.
      * \param raw The raw layer on the packet to decrypt.
      * \return A SNAP layer containing the decrypted traffic or a null pointer
@@ -124,12 +158,53 @@ public:
      * /return true iff CCMP is used.
      */
     bool uses_ccmp() const;
+
+    /**
+     * \brief Gets the cipher used to decrypt packets
+     */
+    CipherType cipher() const;
 private:
     SNAP* ccmp_decrypt_unicast(const Dot11Data& dot11, RawPDU& raw) const;
+    SNAP* gcmp_decrypt_unicast(const Dot11Data& dot11, RawPDU& raw) const;
     SNAP* tkip_decrypt_unicast(const Dot11Data& dot11, RawPDU& raw) const;
+    void tkip_phase1_key(const HWAddress<6>& transmitter, const uint8_t* iv32,
+                         uint16_t* ttak) const;
+
+    // TKIP phase 1 output only changes every 65536 packets, so keep the last 
+    // one computed for each direction of the link.
+    struct TKIPPhase1Key {
+        TKIPPhase1Key() : valid(false) { }
+
+        HWAddress<6> transmitter;
+        uint8_t iv32[4];
+        uint16_t ttak[5];
+        bool valid;
+    };
+
+    // Owns the cipher context used by CCMP and GCMP. It's created and keyed
+    // on first use and then only re-initialized with each packet's nonce.
+    // Copies start without a context of their own.
+    class CipherContext {
+    public:
+        CipherContext();
+        CipherContext(const CipherContext&);
+        CipherContext& operator=(const CipherContext&);
+        ~CipherContext();
+
+        void reset();
+
+        evp_cipher_ctx_st* context;
+        bool keyed;
+    };
+
+    static const size_t TKIP_PHASE1_CACHE_SIZE = 2;
+
+    evp_cipher_ctx_st* keyed_cipher_context() const;
 
     ptk_type ptk_;
-    bool is_ccmp_;
+    CipherType cipher_;
+    mutable TKIPPhase1Key tkip_phase1_cache_[TKIP_PHASE1_CACHE_SIZE];
+    mutable CipherContext cipher_context_;
 };
 
 /**
@@ -152,6 +227,15 @@ public:
      * \param ssid The access point's SSID.
      */
     SupplicantData(const std::string& psk, const std::string& ssid);
+
+    /**
+     * \brief Constructs a SupplicantData from an already derived PMK.
+     *
+     * \param pmk The PMK.
+     * \param ssid The access point's SSID.
+     * \sa derive_pmks
+     */
+    SupplicantData(const pmk_type& pmk, const std::string& ssid);
     
     /**
      * \brief Getter for the PMK.
@@ -322,6 +406,17 @@ public:
     void add_ap_data(const std::string& psk,
                      const std::string& ssid,
                      const address_type& addr);
+
+    /**
+     * \brief Adds an access point's information using an already derived PMK.
+     *
+     * This behaves like the add_ap_data overload that takes a PSK and an SSID,
+     * but avoids deriving the PMK. This is useful when adding many networks, 
+     * as their PMKs can be derived at once using WPA2::derive_pmks.
+     *
+     * \param data The supplicant data, containing the PMK and SSID.
+     */
+    void add_ap_data(const WPA2::SupplicantData& data);
     
     /**
      * \brief Explicitly add decryption keys.
@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_HASH_TABLE_HELPERS_H
+#define TINS_HASH_TABLE_HELPERS_H
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * \cond
+ */
+namespace Tins {
+namespace Internals {
+
+// 64 bit FNV-1a
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+// 32 bit FNV-1a, for hashers that return size_t
+const uint32_t FNV32_OFFSET_BASIS = 2166136261U;
+const uint32_t FNV32_PRIME = 16777619U;
+
+inline uint64_t fnv_hash_byte(uint64_t hash, uint8_t value) {
+    return (hash ^ value) * FNV_PRIME;
+}
+
+inline uint64_t fnv_hash(const void* data, size_t size, 
+                         uint64_t hash = FNV_OFFSET_BASIS) {
+    const uint8_t* ptr = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = fnv_hash_byte(hash, ptr[i]);
+    }
+    return hash;
+}
+
+inline uint32_t fnv32_hash(const void* data, size_t size, 
+                           uint32_t hash = FNV32_OFFSET_BASIS) {
+    const uint8_t* ptr = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ ptr[i]) * FNV32_PRIME;
+    }
+    return hash;
+}
+
+// Domain names are hashed and compared case insensitively
+inline uint8_t ascii_to_lower(uint8_t value) {
+    return (value >= 'A' && value <= 'Z') ? value + ('a' - 'A') : value;
+}
+
+// Open addressing hash table using linear probing. Values are stored
+// along with a hash computed by the caller, several values can share
+// the same hash and callers compare the values found themselves.
+//
+// Values are addressed by slot index. Indexes are invalidated by
+// insertions and erasures.
+template <typename T>
+class hash_table {
+public:
+    static const size_t npos = static_cast<size_t>(-1);
+
+    hash_table() : size_(0) { }
+
+    size_t size() const {
+        return size_;
+    }
+
+    size_t slot_count() const {
+        return slots_.size();
+    }
+
+    bool used(size_t index) const {
+        return slots_[index].used;
+    }
+
+    T& value(size_t index) {
+        return slots_[index].value;
+    }
+
+    const T& value(size_t index) const {
+        return slots_[index].value;
+    }
+
+    // Index of the first value with the given hash, or npos
+    size_t find(uint64_t hash) const {
+        if (slots_.empty()) {
+            return npos;
+        }
+        return probe(hash, static_cast<size_t>(hash) & mask());
+    }
+
+    // Index of the next value with the same hash as the given one, or npos
+    size_t find_next(size_t index) const {
+        return probe(slots_[index].hash, (index + 1) & mask());
+    }
+
+    size_t insert(uint64_t hash, const T& value) {
+        if (!fits(size_ + 1, slots_.size())) {
+            rehash(slots_.empty() ? MIN_SLOT_COUNT : slots_.size() * 2);
+        }
+        size_t index = static_cast<size_t>(hash) & mask();
+        while (slots_[index].used) {
+            index = (index + 1) & mask();
+        }
+        slots_[index].hash = hash;
+        slots_[index].value = value;
+        slots_[index].used = true;
+        size_++;
+        return index;
+    }
+
+    // Shifts back the values that follow the erased one, so lookups never
+    // need tombstones
+    void erase(size_t index) {
+        size_t next = (index + 1) & mask();
+        while (slots_[next].used) {
+            const size_t ideal = static_cast<size_t>(slots_[next].hash) & mask();
+            if (((next - ideal) & mask()) >= ((next - index) & mask())) {
+                slots_[index] = slots_[next];
+                index = next;
+            }
+            next = (next + 1) & mask();
+        }
+        slots_[index].used = false;
+        size_--;
+    }
+
+    // Makes room for the given number of values, so inserting them 
+    // doesn't grow the table
+    void reserve(size_t count) {
+        size_t slot_count = MIN_SLOT_COUNT;
+        while (!fits(count, slot_count)) {
+            slot_count *= 2;
+        }
+        if (slot_count > slots_.size()) {
+            rehash(slot_count);
+        }
+    }
+
+    // Keeps the allocated slots around
+    void clear() {
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            slots_[i].used = false;
+        }
+        size_ = 0;
+    }
+private:
+    static const size_t MIN_SLOT_COUNT = 16;
+
+    struct slot {
+        slot() : hash(0), value(), used(false) { }
+
+        uint64_t hash;
+        T value;
+        bool used;
+    };
+
+    size_t mask() const {
+        return slots_.size() - 1;
+    }
+
+    size_t probe(uint64_t hash, size_t index) const {
+        while (slots_[index].used) {
+            if (slots_[index].hash == hash) {
+                return index;
+            }
+            index = (index + 1) & mask();
+        }
+        return npos;
+    }
+
+    // Keep the load factor below 3/4
+    static bool fits(size_t count, size_t slot_count) {
+        return count * 4 <= slot_count * 3;
+    }
+
+    void rehash(size_t slot_count) {
+        std::vector<slot> old_slots(slot_count);
+        old_slots.swap(slots_);
+        size_ = 0;
+        for (size_t i = 0; i < old_slots.size(); ++i) {
+            if (old_slots[i].used) {
+                insert(old_slots[i].hash, old_slots[i].value);
+            }
+        }
+    }
+
+    std::vector<slot> slots_;
+    size_t size_;
+};
+
+template <typename T>
+const size_t hash_table<T>::npos;
+
+template <typename T>
+const size_t hash_table<T>::MIN_SLOT_COUNT;
+
+// Least recently used list over values stored in a random access container.
+// Values are linked through their "previous" and "next" members, which 
+// hold the indexes of their neighbours.
+template <typename Index>
+class lru_list {
+public:
+    static const Index npos = static_cast<Index>(-1);
+
+    lru_list() : front_(npos), back_(npos) { }
+
+    // The least recently used value, or npos
+    Index back() const {
+        return back_;
+    }
+
+    template <typename Container>
+    void push_front(Container& values, Index index) {
+        values[index].previous = npos;
+        values[index].next = front_;
+        if (front_ != npos) {
+            values[front_].previous = index;
+        }
+        else {
+            back_ = index;
+        }
+        front_ = index;
+    }
+
+    template <typename Container>
+    void erase(Container& values, Index index) {
+        const Index previous = values[index].previous;
+        const Index next = values[index].next;
+        if (previous != npos) {
+            values[previous].next = next;
+        }
+        else {
+            front_ = next;
+        }
+        if (next != npos) {
+            values[next].previous = previous;
+        }
+        else {
+            back_ = previous;
+        }
+    }
+
+    template <typename Container>
+    void move_to_front(Container& values, Index index) {
+        if (index != front_) {
+            erase(values, index);
+            push_front(values, index);
+        }
+    }
+
+    void clear() {
+        front_ = back_ = npos;
+    }
+private:
+    Index front_;
+    Index back_;
+};
+
+template <typename Index>
+const Index lru_list<Index>::npos;
+
+} // Internals
+} // Tins
+/**
+ * \endcond
+ */
+
+#endif // TINS_HASH_TABLE_HELPERS_H
@@ -50,6 +50,10 @@ PDU* pdu_from_dlt_flag(int flag, const uint8_t* buffer,
                        uint32_t size, bool rawpdu_on_no_match = true);
 #endif // TINS_HAVE_PCAP
 PDU* pdu_from_flag(PDU::PDUType type, const uint8_t* buffer, uint32_t size);
+PDU* pdu_from_udp_ports(uint16_t sport, uint16_t dport, const uint8_t* buffer,
+                        uint32_t size);
+PDU* pdu_from_tcp_ports(uint16_t sport, uint16_t dport, const uint8_t* buffer,
+                        uint32_t size);
 
 Constants::Ethernet::e pdu_flag_to_ether_type(PDU::PDUType flag);
 PDU::PDUType ether_type_to_pdu_flag(Constants::Ethernet::e flag);
@@ -32,6 +32,8 @@
 
 #include <vector>
 #include <string>
+#include <iterator>
+#include <cstring>
 #include <tins/bootp.h>
 #include <tins/macros.h>
 #include <tins/pdu_option.h>
@@ -170,6 +172,88 @@ public:
      * The type used to store the DHCP options.
      */
     typedef std::vector<option> options_type;
+
+    /**
+     * \brief Forward iterator over the addresses stored in a list option.
+     *
+     * Addresses are read straight from the option's data, nothing is
+     * allocated.
+     */
+    class address_iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef ipaddress_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const ipaddress_type* pointer;
+        typedef ipaddress_type reference;
+
+        /**
+         * \brief Constructs an iterator pointing to the given address.
+         */
+        explicit address_iterator(const uint8_t* ptr = 0) : ptr_(ptr) { }
+
+        reference operator*() const {
+            uint32_t address;
+            std::memcpy(&address, ptr_, sizeof(address));
+            return ipaddress_type(address);
+        }
+
+        address_iterator& operator++() {
+            ptr_ += sizeof(uint32_t);
+            return *this;
+        }
+
+        address_iterator operator++(int) {
+            address_iterator output(*this);
+            ptr_ += sizeof(uint32_t);
+            return output;
+        }
+
+        bool operator==(const address_iterator& rhs) const {
+            return ptr_ == rhs.ptr_;
+        }
+
+        bool operator!=(const address_iterator& rhs) const {
+            return !(*this == rhs);
+        }
+    private:
+        const uint8_t* ptr_;
+    };
+
+    /**
+     * \brief A range of addresses, usable in range based for loops.
+     *
+     * The range points to the option's data, so it's only valid as long 
+     * as the DHCP object it was taken from is not modified or destroyed.
+     */
+    class address_range {
+    public:
+        typedef address_iterator iterator;
+        typedef address_iterator const_iterator;
+
+        address_range(const address_iterator& first, const address_iterator& last,
+                      size_t count)
+        : first_(first), last_(last), size_(count) { }
+
+        iterator begin() const {
+            return first_;
+        }
+
+        iterator end() const {
+            return last_;
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+        bool empty() const {
+            return size_ == 0;
+        }
+    private:
+        iterator first_, last_;
+        size_t size_;
+    };
     
     /**
      * \brief Extracts metadata for this protocol based on the buffer provided
@@ -232,10 +316,29 @@ public:
 
     /**
      * \brief Searchs for an option that matchs the given flag.
+     *
+     * Options are indexed by type as they're added, so this takes
+     * constant time.
+     *
      * \param opt_flag The flag to be searched.
      * \return A pointer to the option, or 0 if it was not found.
      */
     const option* search_option(OptionTypes opt) const;
+
+    /**
+     * \brief Searchs for an option holding a list of addresses.
+     *
+     * This can be used on options such as ROUTERS or DOMAIN_NAME_SERVERS
+     * to iterate their addresses without copying them into a container.
+     *
+     * If the option is not found, an option_not_found exception is
+     * thrown. If its size is not a multiple of 4, a malformed_option
+     * exception is thrown.
+     *
+     * \param opt The option to be searched.
+     * \return The range of addresses in the option.
+     */
+    address_range addresses(OptionTypes opt) const;
     
     /** 
      * \brief Adds a type option to the option list.
@@ -483,7 +586,7 @@ public:
      * \brief Getter for the options list.
      * \return The option list.
      */
-    const options_type options() const { return options_; }
+    const options_type& options() const { return options_; }
     
     /**
      * \brief Getter for the PDU's type.
@@ -519,11 +622,14 @@ private:
     }
     
     void internal_add_option(const option& opt);
+    void rebuild_option_index();
     serialization_type serialize_list(const std::vector<ipaddress_type>& ip_list);
     options_type::const_iterator search_option_iterator(OptionTypes opt) const;
     options_type::iterator search_option_iterator(OptionTypes opt);
     
     options_type options_;
+    // The position + 1 of the first option of each type, 0 if there's none
+    uint16_t option_index_[256];
     uint32_t size_;
 };
 
@@ -0,0 +1,373 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_DHCP_LEASE_TRACKER_H
+#define TINS_DHCP_LEASE_TRACKER_H
+
+#include <tins/cxxstd.h>
+
+#if TINS_IS_CXX11
+
+#include <vector>
+#include <chrono>
+#include <iterator>
+#include <functional>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/hw_address.h>
+#include <tins/ip_address.h>
+#include <tins/ipv6_address.h>
+#include <tins/dhcpv6.h>
+#include <tins/detail/hash_table_helpers.h>
+
+namespace Tins {
+
+class PDU;
+class Packet;
+class DHCP;
+
+/**
+ * \class DHCPLeaseTracker
+ * \brief Keeps track of DHCP and DHCPv6 leases and the servers handing them.
+ *
+ * Leases are learnt from DHCP ACKs and DHCPv6 Replies and removed when 
+ * they expire or when the client releases or declines them, or the server
+ * NAKs them. Each client, identified by its hardware address, holds at 
+ * most one IPv4 and one IPv6 lease. For DHCPv6, the hardware address is 
+ * taken from the client's DUID when it contains one, or from the Ethernet
+ * layer otherwise. Relayed DHCPv6 messages are ignored.
+ *
+ * DHCP and DHCPv6 layers are used when present. Otherwise, UDP payloads 
+ * sent from or to the DHCP and DHCPv6 ports are parsed.
+ *
+ * Every server that sends offers, acknowledgements or replies is recorded.
+ * Servers are identified by their server identifier option (or source 
+ * address, if it's missing) for DHCP and by their DUID for DHCPv6. The 
+ * first time a server that was not trusted using 
+ * DHCPLeaseTracker::trust_server is seen, the handler set through 
+ * DHCPLeaseTracker::unexpected_server_handler is called.
+ *
+ * Leases are stored in an open addressing hash table and their expiry 
+ * times in a binary heap, so processing a packet doesn't allocate memory,
+ * other than what's needed to decode it and the occasional table growth. 
+ * When using a Packet, timestamps come from the packet itself, so this 
+ * works on captures as well as on live traffic.
+ *
+ * This class is not thread safe. It's only available when using C++11.
+ *
+ * \code
+ * DHCPLeaseTracker tracker;
+ * tracker.trust_server(IPv4Address("192.168.0.1"));
+ * tracker.unexpected_server_handler([](const DHCPLeaseTracker::server& srv) {
+ *     std::cout << "Rogue DHCP server at " << srv.hw_address << std::endl;
+ * });
+ * 
+ * // For every packet
+ * tracker.process_packet(packet);
+ * 
+ * for (const auto& lease : tracker) {
+ *     std::cout << lease.client << " -> " << lease.address << std::endl;
+ * }
+ * \endcode
+ */
+class TINS_API DHCPLeaseTracker {
+public:
+    /**
+     * The type used to store timestamps
+     */
+    typedef std::chrono::microseconds timestamp_type;
+
+    /**
+     * The type used to store clients' hardware addresses
+     */
+    typedef HWAddress<6> hwaddress_type;
+
+    /**
+     * \brief A lease.
+     */
+    struct lease {
+        /**
+         * The client's hardware address
+         */
+        hwaddress_type client;
+
+        /**
+         * The leased address, if this is a DHCP lease
+         */
+        IPv4Address address;
+
+        /**
+         * The leased address, if this is a DHCPv6 lease
+         */
+        IPv6Address ipv6_address;
+
+        /**
+         * The time at which the lease expires, or timestamp_type::max() 
+         * if it never does
+         */
+        timestamp_type expiry;
+
+        /**
+         * The index of the server that granted the lease within 
+         * DHCPLeaseTracker::servers
+         */
+        size_t server_index;
+
+        /**
+         * Whether this is a DHCPv6 lease
+         */
+        bool ipv6;
+    };
+
+    /**
+     * \brief A DHCP or DHCPv6 server.
+     */
+    struct server {
+        /**
+         * The server identifier option's data for DHCP servers, or 
+         * their DUID for DHCPv6 servers
+         */
+        std::vector<uint8_t> identifier;
+
+        /**
+         * The source hardware address of the last packet sent by this 
+         * server, if it had an Ethernet layer
+         */
+        hwaddress_type hw_address;
+
+        /**
+         * The number of offers, acknowledgements or replies sent
+         */
+        uint64_t packets;
+
+        /**
+         * Whether this is a DHCPv6 server
+         */
+        bool ipv6;
+
+        /**
+         * Whether this server was trusted
+         */
+        bool trusted;
+    };
+
+    /**
+     * The type returned by DHCPLeaseTracker::servers
+     */
+    typedef std::vector<server> servers_type;
+
+    /**
+     * The type returned by DHCPLeaseTracker::snapshot
+     */
+    typedef std::vector<lease> leases_type;
+
+    /**
+     * The type of the unexpected server handler
+     */
+    typedef std::function<void(const server&)> server_handler_type;
+
+    /**
+     * \brief Iterates over the current leases.
+     *
+     * Iterators are invalidated when the tracker is modified.
+     */
+    class const_iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef lease value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const lease* pointer;
+        typedef const lease& reference;
+
+        /**
+         * \brief Constructs an iterator pointing to the first of a 
+         * tracker's leases stored at or after the given slot.
+         */
+        const_iterator(const DHCPLeaseTracker* tracker = 0, size_t index = 0);
+
+        reference operator*() const;
+
+        pointer operator->() const;
+
+        const_iterator& operator++();
+
+        const_iterator operator++(int);
+
+        bool operator==(const const_iterator& rhs) const {
+            return index_ == rhs.index_;
+        }
+
+        bool operator!=(const const_iterator& rhs) const {
+            return !(*this == rhs);
+        }
+    private:
+        void skip_unused();
+
+        const DHCPLeaseTracker* tracker_;
+        size_t index_;
+    };
+
+    /**
+     * \brief Default constructor.
+     */
+    DHCPLeaseTracker();
+
+    /**
+     * \brief Processes a packet.
+     *
+     * The current time is used as the packet's timestamp. 
+     *
+     * \return true iff this packet added, renewed or removed a lease
+     */
+    bool process_packet(const PDU& pdu);
+
+    /**
+     * \brief Processes a packet.
+     *
+     * The packet's timestamp is used as the time it was seen.
+     *
+     * \return true iff this packet added, renewed or removed a lease
+     */
+    bool process_packet(const Packet& packet);
+
+    /**
+     * \brief Removes the leases that expire at or before the given time.
+     *
+     * This is done automatically when processing packets, so it's only
+     * needed when no packets are seen for a while.
+     *
+     * \param now The current time
+     */
+    void expire(const timestamp_type& now);
+
+    /**
+     * \brief Marks a DHCP server as trusted.
+     *
+     * \param identifier The server's identifier option
+     */
+    void trust_server(IPv4Address identifier);
+
+    /**
+     * \brief Marks a DHCPv6 server as trusted.
+     *
+     * \param duid The server's DUID
+     */
+    void trust_server(const DHCPv6::duid_type& duid);
+
+    /**
+     * \brief Sets the handler called the first time an untrusted server 
+     * is seen.
+     *
+     * \param handler The handler to be used
+     */
+    void unexpected_server_handler(const server_handler_type& handler);
+
+    /**
+     * \brief Retrieves every server seen or trusted.
+     */
+    const servers_type& servers() const;
+
+    /**
+     * \brief Searches for a client's DHCP lease.
+     *
+     * \param client The client's hardware address
+     * \return A pointer to the lease, or 0 if there is none. The pointer
+     * is invalidated when the tracker is modified.
+     */
+    const lease* find_lease(const hwaddress_type& client) const;
+
+    /**
+     * \brief Searches for a client's DHCPv6 lease.
+     *
+     * \sa DHCPLeaseTracker::find_lease
+     */
+    const lease* find_ipv6_lease(const hwaddress_type& client) const;
+
+    /**
+     * \brief Retrieves the number of leases.
+     */
+    size_t lease_count() const;
+
+    /**
+     * \brief Makes room for the given number of leases.
+     *
+     * This avoids growing the lease table while processing packets.
+     */
+    void reserve(size_t count);
+
+    /**
+     * \brief Retrieves an iterator to the first lease.
+     */
+    const_iterator begin() const;
+
+    /**
+     * \brief Retrieves an iterator past the last lease.
+     */
+    const_iterator end() const;
+
+    /**
+     * \brief Copies every lease into a new container.
+     */
+    leases_type snapshot() const;
+private:
+    struct expiry_entry {
+        timestamp_type expiry;
+        hwaddress_type client;
+        bool ipv6;
+
+        bool operator>(const expiry_entry& rhs) const;
+    };
+
+    typedef Internals::hash_table<lease> leases_table_type;
+    typedef Internals::hash_table<size_t> servers_index_type;
+
+    bool process_packet(const PDU& pdu, const timestamp_type& ts);
+    bool process_dhcp(const PDU& pdu, const DHCP& dhcp, const timestamp_type& ts);
+    bool process_dhcpv6(const PDU& pdu, const DHCPv6& dhcp, const timestamp_type& ts);
+    size_t find_server(const uint8_t* identifier, size_t size, bool ipv6,
+                       const PDU& pdu);
+    size_t add_server(const uint8_t* identifier, size_t size, bool ipv6);
+    void update_lease(const lease& value);
+    bool erase_lease(const hwaddress_type& client, bool ipv6);
+    size_t find_slot(const hwaddress_type& client, bool ipv6) const;
+    size_t find_server_index(const uint8_t* identifier, size_t size, bool ipv6) const;
+    void rebuild_expiry_heap();
+
+    leases_table_type leases_;
+    std::vector<expiry_entry> expiry_heap_;
+    servers_type servers_;
+    servers_index_type servers_index_;
+    server_handler_type server_handler_;
+};
+
+} // Tins
+
+#endif // TINS_IS_CXX11
+
+#endif // TINS_DHCP_LEASE_TRACKER_H
@@ -848,6 +848,9 @@ public:
     /**
      * \brief Searchs for an option that matchs the given type.
      * 
+     * Options whose type is below 256 are indexed as they're added, so
+     * looking them up takes constant time.
+     *
      * If the option is not found, a null pointer is returned. 
      * Deleting the returned pointer will result in <b>undefined 
      * behaviour</b>.
@@ -893,6 +896,7 @@ private:
     void write_option(const option& option, Memory::OutputMemoryStream& stream) const;
     options_type::const_iterator search_option_iterator(OptionTypes type) const;
     options_type::iterator search_option_iterator(OptionTypes type);
+    void rebuild_option_index();
     
     template <template <typename> class Functor>
     const option* safe_search_option(OptionTypes opt, uint32_t size) const {
@@ -916,6 +920,9 @@ private:
     uint32_t options_size_;
     ipaddress_type link_addr_, peer_addr_;
     options_type options_;
+    // The position + 1 of the first option of each type below 256, 
+    // 0 if there's none
+    uint16_t option_index_[256];
 };
 
 } // Tins
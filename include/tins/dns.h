@@ -35,6 +35,8 @@
 #include <cstring>
 #include <string>
 #include <map>
+#include <iterator>
+#include <cstddef>
 #include <tins/macros.h>
 #include <tins/pdu.h>
 #include <tins/endianness.h>
@@ -56,6 +58,7 @@ class InputMemoryStream;
 
 class IPv4Address;
 class IPv6Address;
+class DNSNameTable;
 
 /**
  * \class DNS
@@ -622,6 +625,218 @@ public:
     typedef IPv4Address address_type;
     typedef IPv6Address address_v6_type;
     
+    /**
+     * \brief A read-only view of a resource record.
+     *
+     * Views point into the DNS PDU's buffer, so constructing them doesn't
+     * allocate nor copy anything. Domain names are only decompressed when 
+     * explicitly requested and can be compared against a string without 
+     * decompressing them.
+     *
+     * A view is only valid while the DNS PDU it was taken from is alive
+     * and unmodified.
+     *
+     * \sa DNS::answer_records
+     */
+    class TINS_API record_view {
+    public:
+        /**
+         * \brief Default constructor. 
+         */
+        record_view() : dns_(0), name_(0), fields_(0) { }
+
+        /**
+         * \brief Decompresses and returns this record's domain name.
+         */
+        std::string dname() const;
+
+        /**
+         * \brief Compares this record's domain name against the one provided.
+         *
+         * The comparison is case insensitive and doesn't decompress the name.
+         *
+         * \param name The domain name to compare against (e.g. "www.example.com")
+         */
+        bool dname_equals(const std::string& name) const;
+
+        /**
+         * \brief Getter for the record type field.
+         */
+        uint16_t query_type() const {
+            return read_field(0);
+        }
+
+        /**
+         * \brief Getter for the record class field.
+         */
+        uint16_t query_class() const {
+            return read_field(2);
+        }
+
+        /**
+         * \brief Getter for the time-to-live field.
+         */
+        uint32_t ttl() const {
+            return (static_cast<uint32_t>(read_field(4)) << 16) | read_field(6);
+        }
+
+        /**
+         * \brief Getter for the size of the record data.
+         */
+        uint16_t data_size() const {
+            return read_field(8);
+        }
+
+        /**
+         * \brief Getter for the raw, undecoded, record data.
+         *
+         * For MX records, this includes the preference field.
+         */
+        const uint8_t* data_ptr() const {
+            return fields_ + 10;
+        }
+
+        /**
+         * \brief Getter for the address on an A record.
+         *
+         * If the record data is not 4 bytes long, malformed_packet is thrown.
+         */
+        address_type address() const;
+
+        /**
+         * \brief Getter for the address on an AAAA record.
+         *
+         * If the record data is not 16 bytes long, malformed_packet is thrown.
+         */
+        address_v6_type address_v6() const;
+
+        /**
+         * \brief Getter for the preference field on an MX record.
+         */
+        uint16_t preference() const;
+
+        /**
+         * \brief Decompresses and returns the domain name in the record data.
+         *
+         * This can be used on NS, CNAME, DNAME, PTR and MX records.
+         */
+        std::string target_dname() const;
+
+        /**
+         * \brief Compares the domain name in the record data against the 
+         * one provided.
+         *
+         * This can be used on NS, CNAME, DNAME, PTR and MX records. The 
+         * comparison is case insensitive and doesn't decompress the name.
+         *
+         * \param name The domain name to compare against
+         */
+        bool target_dname_equals(const std::string& name) const;
+    private:
+        friend class DNS;
+        friend class DNSNameTable;
+
+        record_view(const DNS* dns, const uint8_t* name, const uint8_t* fields) 
+        : dns_(dns), name_(name), fields_(fields) { }
+
+        uint16_t read_field(size_t offset) const {
+            uint16_t value;
+            std::memcpy(&value, fields_ + offset, sizeof(value));
+            return Endian::be_to_host(value);
+        }
+
+        const uint8_t* target_dname_ptr() const;
+
+        const DNS* dns_;
+        const uint8_t* name_;
+        const uint8_t* fields_;
+    };
+
+    /**
+     * \brief Forward iterator over the resource records in a section.
+     *
+     * Advancing the iterator only skips over the current record, nothing is 
+     * decoded nor allocated.
+     */
+    class TINS_API record_iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef record_view value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const record_view* pointer;
+        typedef const record_view& reference;
+
+        /**
+         * \brief Constructs an end iterator.
+         */
+        record_iterator() : end_(0), remaining_(0) { }
+
+        reference operator*() const {
+            return view_;
+        }
+
+        pointer operator->() const {
+            return &view_;
+        }
+
+        record_iterator& operator++() {
+            advance();
+            return *this;
+        }
+
+        record_iterator operator++(int) {
+            record_iterator output(*this);
+            advance();
+            return output;
+        }
+
+        bool operator==(const record_iterator& rhs) const {
+            return view_.name_ == rhs.view_.name_;
+        }
+
+        bool operator!=(const record_iterator& rhs) const {
+            return !(*this == rhs);
+        }
+    private:
+        friend class DNS;
+
+        record_iterator(const DNS* dns, const uint8_t* start, const uint8_t* end,
+                        uint16_t count);
+
+        void load(const uint8_t* ptr);
+        void advance();
+
+        record_view view_;
+        const uint8_t* end_;
+        uint16_t remaining_;
+    };
+
+    /**
+     * \brief A range of resource records, usable in range based for loops.
+     */
+    class record_range {
+    public:
+        typedef record_iterator iterator;
+        typedef record_iterator const_iterator;
+
+        record_range(const record_iterator& first, const record_iterator& last)
+        : first_(first), last_(last) { }
+
+        iterator begin() const {
+            return first_;
+        }
+
+        iterator end() const {
+            return last_;
+        }
+
+        bool empty() const {
+            return first_ == last_;
+        }
+    private:
+        iterator first_, last_;
+    };
+    
     /**
      * \brief Extracts metadata for this protocol based on the buffer provided
      *
@@ -947,6 +1162,39 @@ public:
      * \return The additional records in this PDU.
      */
     resources_type additional() const;
+
+    /**
+     * \brief Iterates over the answer records without copying them.
+     *
+     * Unlike DNS::answers, this doesn't build a container nor decompress
+     * any domain names. 
+     *
+     * \code
+     * for (const DNS::record_view& record : dns.answer_records()) {
+     *     if (record.query_type() == DNS::A) {
+     *         IPv4Address address = record.address();
+     *         // ...
+     *     }
+     * }
+     * \endcode
+     *
+     * The returned range is invalidated when this PDU is modified.
+     */
+    record_range answer_records() const;
+
+    /**
+     * \brief Iterates over the authority records without copying them.
+     *
+     * \sa DNS::answer_records
+     */
+    record_range authority_records() const;
+
+    /**
+     * \brief Iterates over the additional records without copying them.
+     *
+     * \sa DNS::answer_records
+     */
+    record_range additional_records() const;
     
     /**
      * \brief Encodes a domain name.
@@ -996,6 +1244,9 @@ public:
     }
 private:
     friend class soa_record;
+    friend class DNSNameTable;
+    friend class DNSBuilder;
+    friend class DNSTransactionTracker;
 
     TINS_BEGIN_PACK
     struct dns_header {
@@ -1031,7 +1282,12 @@ private:
     
     typedef std::vector<std::pair<uint32_t*, uint32_t> > sections_type;
     
-    uint32_t compose_name(const uint8_t* ptr, char* out_ptr) const;
+    struct name_memo;
+
+    uint32_t compose_name(const uint8_t* ptr, char* out_ptr, name_memo* memo = 0) const;
+    const uint8_t* follow_pointers(const uint8_t* ptr, uint8_t& pointer_counter) const;
+    bool dname_equals(const uint8_t* ptr, const std::string& name) const;
+    record_range make_record_range(uint32_t start, uint32_t end, uint16_t count) const;
     void convert_records(const uint8_t* ptr, 
                          const uint8_t* end,
                          resources_type& res,
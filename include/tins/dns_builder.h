@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_DNS_BUILDER_H
+#define TINS_DNS_BUILDER_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/dns.h>
+#include <tins/detail/hash_table_helpers.h>
+
+namespace Tins {
+
+/**
+ * \class DNSBuilder
+ * \brief Builds DNS messages by appending records to a single buffer.
+ *
+ * Adding records through DNS::add_answer and friends inserts them in the 
+ * middle of the PDU's buffer and then fixes every compression pointer 
+ * after them, which gets expensive when building large messages. Names
+ * are also never compressed.
+ *
+ * DNSBuilder instead requires records to be added in section order 
+ * (questions, answers, authority and then additional records), so each
+ * of them is just appended to the buffer. Domain names are compressed
+ * against every name previously written, using a table of suffixes.
+ *
+ * A builder can also be constructed from a query, in which case the 
+ * query's header and questions are copied as they are and the message is 
+ * turned into a response, ready for answers to be appended.
+ *
+ * \code
+ * DNS query = udp.rfind_pdu<RawPDU>().to<DNS>();
+ * DNSBuilder builder(query);
+ * builder.add_answer(
+ *     DNS::resource("www.example.com", "127.0.0.1", DNS::A, DNS::INTERNET, 777)
+ * );
+ * sender.send(EthernetII() / IP() / UDP() / builder.build());
+ * \endcode
+ */
+class TINS_API DNSBuilder {
+public:
+    /**
+     * The type used to store the built message
+     */
+    typedef std::vector<uint8_t> buffer_type;
+
+    /**
+     * \brief Constructs an empty message.
+     *
+     * Every header field is initialized to 0.
+     */
+    DNSBuilder();
+
+    /**
+     * \brief Constructs a response to the given query.
+     *
+     * The query's header and questions are kept, the message type is set
+     * to DNS::RESPONSE and any records in the query are dropped.
+     *
+     * \param query The query to respond to
+     */
+    explicit DNSBuilder(const DNS& query);
+
+    /**
+     * \brief Setter for the id field.
+     */
+    DNSBuilder& id(uint16_t value);
+
+    /**
+     * \brief Setter for the query/response field.
+     */
+    DNSBuilder& type(DNS::QRType value);
+
+    /**
+     * \brief Setter for the authoritative answer field.
+     */
+    DNSBuilder& authoritative_answer(uint8_t value);
+
+    /**
+     * \brief Setter for the recursion desired field.
+     */
+    DNSBuilder& recursion_desired(uint8_t value);
+
+    /**
+     * \brief Setter for the recursion available field.
+     */
+    DNSBuilder& recursion_available(uint8_t value);
+
+    /**
+     * \brief Setter for the rcode field.
+     */
+    DNSBuilder& rcode(uint8_t value);
+
+    /**
+     * \brief Appends a question.
+     *
+     * If any resource record was already added, invalid_section_order
+     * is thrown.
+     *
+     * \param query The question to be added
+     */
+    DNSBuilder& add_query(const DNS::query& query);
+
+    /**
+     * \brief Appends an answer record.
+     *
+     * If any authority or additional record was already added, 
+     * invalid_section_order is thrown.
+     *
+     * \param resource The record to be added
+     */
+    DNSBuilder& add_answer(const DNS::resource& resource);
+
+    /**
+     * \brief Appends an authority record.
+     *
+     * If any additional record was already added, invalid_section_order
+     * is thrown.
+     *
+     * \param resource The record to be added
+     */
+    DNSBuilder& add_authority(const DNS::resource& resource);
+
+    /**
+     * \brief Appends an additional record.
+     *
+     * \param resource The record to be added
+     */
+    DNSBuilder& add_additional(const DNS::resource& resource);
+
+    /**
+     * \brief Retrieves the message built so far, header included.
+     */
+    const buffer_type& buffer() const;
+
+    /**
+     * \brief Constructs a DNS PDU out of the message built so far.
+     */
+    DNS build() const;
+
+    /**
+     * \brief Discards every record and resets the header.
+     */
+    void clear();
+private:
+    enum Section {
+        QUESTIONS,
+        ANSWERS,
+        AUTHORITY,
+        ADDITIONAL
+    };
+
+    typedef Internals::hash_table<uint16_t> suffixes_type;
+
+    void start_section(Section section);
+    void increment_count(Section section);
+    void add_record(Section section, const DNS::resource& resource);
+    void write_name(const std::string& name);
+    void add_suffixes(const std::string& name, size_t name_offset);
+    bool suffix_matches(uint16_t name_offset, const std::string& name, 
+                        size_t start, size_t size) const;
+
+    buffer_type buffer_;
+    suffixes_type suffixes_;
+    Section section_;
+};
+
+} // Tins
+
+#endif // TINS_DNS_BUILDER_H
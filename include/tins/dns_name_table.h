@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_DNS_NAME_TABLE_H
+#define TINS_DNS_NAME_TABLE_H
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/dns.h>
+#include <tins/detail/hash_table_helpers.h>
+
+namespace Tins {
+
+/**
+ * \class DNSNameTable
+ * \brief Interns domain names found in DNS packets.
+ *
+ * Each distinct domain name is assigned a numeric identifier the first 
+ * time it's seen. Looking up a name found on a packet hashes its labels
+ * directly from the packet's buffer, following compression pointers, so
+ * names that were already interned are never decompressed again.
+ *
+ * Names are compared case insensitively and the spelling of the first 
+ * occurrence is the one that is kept. Identifiers are assigned 
+ * sequentially starting from 0, and the identifiers of names that were 
+ * erased are reused.
+ *
+ * By default names are kept until they're erased. When a maximum size is 
+ * set, interning a new name on a full table evicts the least recently
+ * interned one, so the table can be used on untrusted traffic without 
+ * growing indefinitely.
+ *
+ * \code
+ * DNSNameTable table;
+ * for (const DNS::record_view& record : dns.answer_records()) {
+ *     DNSNameTable::id_type id = table.intern(record);
+ *     // Use the id as a key for statistics, etc.
+ *     std::cout << table.name(id) << std::endl;
+ * }
+ * \endcode
+ *
+ * This class is not thread safe.
+ */
+class TINS_API DNSNameTable {
+public:
+    /**
+     * The type used to identify interned names
+     */
+    typedef uint32_t id_type;
+
+    /**
+     * \brief Default constructor.
+     *
+     * The table has no maximum size.
+     */
+    DNSNameTable();
+
+    /**
+     * \brief Sets the maximum number of names kept.
+     *
+     * If the table holds more names than this, the least recently 
+     * interned ones are evicted right away.
+     *
+     * \param value The maximum number of names, or 0 for no limit
+     */
+    void max_size(size_t value);
+
+    /**
+     * \brief Retrieves the maximum number of names kept, or 0 if there's
+     * no limit.
+     */
+    size_t max_size() const;
+
+    /**
+     * \brief Interns the given domain name.
+     *
+     * \param name The domain name, e.g. "www.example.com"
+     * \return The identifier assigned to this name
+     */
+    id_type intern(const std::string& name);
+
+    /**
+     * \brief Interns a record's domain name.
+     *
+     * \param record The record whose domain name will be interned
+     * \return The identifier assigned to this name
+     */
+    id_type intern(const DNS::record_view& record);
+
+    /**
+     * \brief Interns the domain name found in a record's data.
+     *
+     * This can be used on NS, CNAME, DNAME, PTR and MX records.
+     *
+     * \param record The record whose data will be interned
+     * \return The identifier assigned to this name
+     */
+    id_type intern_target(const DNS::record_view& record);
+
+    /**
+     * \brief Interns the domain name of a packet's first question.
+     *
+     * If the packet contains no questions, malformed_packet is thrown.
+     *
+     * \param dns The packet whose first question will be interned
+     * \return The identifier assigned to this name
+     */
+    id_type intern_query(const DNS& dns);
+
+    /**
+     * \brief Retrieves an interned domain name.
+     *
+     * The returned reference remains valid until this name is erased or
+     * evicted, or the table is cleared or destroyed. If no name has 
+     * this identifier, std::out_of_range is thrown.
+     *
+     * \param id The identifier of the name to be retrieved
+     */
+    const std::string& name(id_type id) const;
+
+    /**
+     * \brief Erases an interned domain name.
+     *
+     * Its identifier may be assigned to another name afterwards. If no
+     * name has this identifier, this does nothing.
+     *
+     * \param id The identifier of the name to be erased
+     */
+    void erase(id_type id);
+
+    /**
+     * \brief Retrieves the number of names interned.
+     */
+    size_t size() const;
+
+    /**
+     * \brief Removes all interned names.
+     */
+    void clear();
+private:
+    struct entry {
+        entry() : hash(0), previous(0), next(0), used(false) { }
+
+        std::string name;
+        uint64_t hash;
+        id_type previous;
+        id_type next;
+        bool used;
+    };
+
+    typedef Internals::hash_table<id_type> index_type;
+    typedef Internals::lru_list<id_type> lru_type;
+
+    static uint64_t hash_name(const std::string& name);
+    static uint64_t hash_name(const DNS& dns, const uint8_t* ptr);
+    id_type intern(const DNS& dns, const uint8_t* ptr);
+    id_type add_name(uint64_t hash, const std::string& name);
+    id_type touch(id_type id);
+
+    index_type index_;
+    // Deque so that references to the names stay valid as it grows
+    std::deque<entry> entries_;
+    std::vector<id_type> free_ids_;
+    lru_type lru_;
+    size_t max_size_;
+};
+
+} // Tins
+
+#endif // TINS_DNS_NAME_TABLE_H
@@ -0,0 +1,411 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_DNS_TRANSACTION_TRACKER_H
+#define TINS_DNS_TRANSACTION_TRACKER_H
+
+#include <tins/cxxstd.h>
+
+#if TINS_IS_CXX11
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/dns.h>
+#include <tins/dns_name_table.h>
+#include <tins/detail/hash_table_helpers.h>
+
+namespace Tins {
+
+class PDU;
+class Packet;
+
+/**
+ * \class LatencyHistogram
+ * \brief Histogram of latencies with bounded relative error.
+ *
+ * Latencies are stored in microseconds. Values below 32us are counted 
+ * exactly, while larger ones are counted in buckets whose width is 1/16th 
+ * of the power of two they fall in, so any value reported back is within 
+ * 6.25% of the one that was added. The buckets only take a few KB and 
+ * adding a value takes constant time, regardless of how many were added.
+ *
+ * Latencies above ~19 hours are counted in the last bucket.
+ *
+ * This class is only available when using C++11.
+ */
+class TINS_API LatencyHistogram {
+public:
+    /**
+     * The type used to store latencies
+     */
+    typedef std::chrono::microseconds duration_type;
+
+    /**
+     * \brief Default constructor.
+     */
+    LatencyHistogram();
+
+    /**
+     * \brief Adds a latency to this histogram.
+     *
+     * Negative latencies are counted as 0.
+     */
+    void add(const duration_type& latency);
+
+    /**
+     * \brief Adds every latency in another histogram to this one.
+     */
+    void merge(const LatencyHistogram& other);
+
+    /**
+     * \brief Retrieves the number of latencies added.
+     */
+    uint64_t count() const;
+
+    /**
+     * \brief Retrieves the smallest latency added, or 0 if there is none.
+     */
+    duration_type minimum() const;
+
+    /**
+     * \brief Retrieves the largest latency added, or 0 if there is none.
+     */
+    duration_type maximum() const;
+
+    /**
+     * \brief Retrieves the average latency, or 0 if there is none.
+     */
+    duration_type mean() const;
+
+    /**
+     * \brief Retrieves the latency at the given percentile.
+     *
+     * The returned value is the largest one that falls in the same bucket 
+     * as the latency at that percentile. 
+     *
+     * \param value The percentile, between 0 and 100
+     */
+    duration_type percentile(double value) const;
+
+    /**
+     * \brief Removes every latency added.
+     */
+    void clear();
+private:
+    static size_t bucket_index(uint64_t value);
+    static uint64_t bucket_upper_bound(size_t index);
+
+    std::vector<uint64_t> buckets_;
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t min_;
+    uint64_t max_;
+};
+
+/**
+ * \class DNSTransactionTracker
+ * \brief Matches DNS queries and responses and measures their latency.
+ *
+ * Queries are tracked by client address, server address, client port and 
+ * DNS id, both for IPv4 and IPv6 over UDP. When the matching response is 
+ * seen, the time elapsed since the query is added to a latency histogram 
+ * kept for the name and type of the query's first question, as well as 
+ * to an overall one. Queries that are not answered within the configured 
+ * timeout are discarded and counted as unanswered.
+ *
+ * DNS layers are used when present. Otherwise, UDP payloads sent from 
+ * or to port 53 are parsed as DNS.
+ *
+ * Pending queries are kept in an open addressing hash table and expired
+ * using a timer wheel, so processing a packet takes constant time. When 
+ * using a Packet, timestamps come from the packet itself, so this works
+ * on captures as well as on live traffic.
+ *
+ * Statistics are kept for at most DEFAULT_MAX_STATISTICS query names and
+ * types by default. Once that many are kept, the ones that were updated 
+ * least recently are discarded to make room for new ones. Their latencies
+ * are still part of the overall histogram.
+ *
+ * This class is not thread safe. In order to process traffic on several 
+ * threads, use one tracker per thread, pick each packet's tracker using
+ * DNSTransactionTracker::shard and then merge their statistics:
+ *
+ * \code
+ * std::vector<DNSTransactionTracker> trackers(4);
+ * // On each thread
+ * const size_t index = DNSTransactionTracker::shard(packet, trackers.size());
+ * // ...hand the packet to the thread owning trackers[index]
+ * 
+ * // Once done
+ * DNSTransactionTracker total;
+ * for (const auto& tracker : trackers) {
+ *     total.merge(tracker);
+ * }
+ * for (const auto& stats : total.statistics()) {
+ *     std::cout << stats.name << ": " << stats.latency.percentile(99).count()
+ *               << "us" << std::endl;
+ * }
+ * \endcode
+ *
+ * This class is only available when using C++11.
+ */
+class TINS_API DNSTransactionTracker {
+public:
+    /**
+     * The type used to store timestamps
+     */
+    typedef std::chrono::microseconds timestamp_type;
+
+    /**
+     * The type of the latency histograms
+     */
+    typedef LatencyHistogram histogram_type;
+
+    /**
+     * \brief The statistics for a query name and type.
+     */
+    struct query_statistics {
+        std::string name;
+        DNS::QueryType type;
+        histogram_type latency;
+        uint64_t unanswered;
+    };
+
+    /**
+     * The type returned by DNSTransactionTracker::statistics
+     */
+    typedef std::vector<query_statistics> statistics_type;
+
+    /**
+     * The default time after which a query is counted as unanswered
+     */
+    static const timestamp_type DEFAULT_TIMEOUT;
+
+    /**
+     * The default maximum number of query names and types whose 
+     * statistics are kept
+     */
+    static const size_t DEFAULT_MAX_STATISTICS;
+
+    /**
+     * \brief Default constructor.
+     */
+    DNSTransactionTracker();
+
+    /**
+     * \brief Processes a packet.
+     *
+     * The current time is used as the packet's timestamp. 
+     *
+     * \return true iff this packet was a response that matched a query
+     */
+    bool process_packet(const PDU& pdu);
+
+    /**
+     * \brief Processes a packet.
+     *
+     * The packet's timestamp is used as the time it was seen.
+     *
+     * \return true iff this packet was a response that matched a query
+     */
+    bool process_packet(const Packet& packet);
+
+    /**
+     * \brief Sets the time after which queries are counted as unanswered.
+     *
+     * Queries that are already pending keep the timeout that was in
+     * effect when they were seen.
+     *
+     * \param value The timeout
+     */
+    template <typename Rep, typename Period>
+    void timeout(const std::chrono::duration<Rep, Period>& value) {
+        set_timeout(std::chrono::duration_cast<timestamp_type>(value));
+    }
+
+    /**
+     * \brief Sets the maximum number of query names and types whose
+     * statistics are kept.
+     *
+     * If more than this are already kept, the ones that were updated least
+     * recently are discarded right away.
+     *
+     * \param value The maximum number of statistics, or 0 for no limit
+     */
+    void max_statistics(size_t value);
+
+    /**
+     * \brief Retrieves the maximum number of query names and types whose
+     * statistics are kept, or 0 if there's no limit.
+     */
+    size_t max_statistics() const;
+
+    /**
+     * \brief Retrieves the statistics for every query name and type kept.
+     *
+     * This builds a new container every time it's called.
+     */
+    statistics_type statistics() const;
+
+    /**
+     * \brief Retrieves the latency histogram of every answered query.
+     */
+    const histogram_type& latency() const;
+
+    /**
+     * \brief Retrieves the number of queries answered.
+     */
+    uint64_t answered_count() const;
+
+    /**
+     * \brief Retrieves the number of queries that timed out.
+     */
+    uint64_t unanswered_count() const;
+
+    /**
+     * \brief Retrieves the number of queries waiting for a response.
+     */
+    size_t pending_transactions() const;
+
+    /**
+     * \brief Adds the statistics of another tracker to this one.
+     *
+     * Pending queries are not merged.
+     *
+     * \param other The tracker whose statistics will be added
+     */
+    void merge(const DNSTransactionTracker& other);
+
+    /**
+     * \brief Discards the statistics gathered so far.
+     *
+     * Pending queries are kept.
+     */
+    void clear_statistics();
+
+    /**
+     * \brief Picks the shard that should process a packet.
+     *
+     * Both a query and its response are assigned the same shard. Packets
+     * that aren't DNS over UDP are assigned shard 0.
+     *
+     * \param pdu The packet to be assigned a shard
+     * \param shard_count The number of shards
+     * \return A value between 0 and shard_count - 1
+     */
+    static size_t shard(const PDU& pdu, size_t shard_count);
+
+    /**
+     * \brief Picks the shard that should process a packet.
+     *
+     * \sa DNSTransactionTracker::shard(const PDU&, size_t)
+     */
+    static size_t shard(const Packet& packet, size_t shard_count);
+private:
+    struct transaction_key {
+        uint8_t client[16];
+        uint8_t server[16];
+        uint16_t client_port;
+        uint16_t id;
+
+        bool operator==(const transaction_key& rhs) const;
+    };
+
+    struct transaction {
+        transaction_key key;
+        timestamp_type timestamp;
+        uint64_t statistics_key;
+    };
+
+    struct wheel_entry {
+        transaction_key key;
+        timestamp_type timestamp;
+        timestamp_type deadline;
+    };
+
+    struct name_statistics {
+        name_statistics() : key(0), unanswered(0), previous(0), next(0) { }
+
+        uint64_t key;
+        histogram_type latency;
+        uint64_t unanswered;
+        uint32_t previous;
+        uint32_t next;
+    };
+
+    typedef Internals::hash_table<transaction> transactions_type;
+    typedef std::vector<std::vector<wheel_entry> > wheel_type;
+    typedef std::deque<name_statistics> name_statistics_type;
+    typedef Internals::hash_table<uint32_t> statistics_index_type;
+    typedef Internals::lru_list<uint32_t> statistics_lru_type;
+
+    static bool make_key(const PDU& pdu, transaction_key& key, 
+                         const DNS*& dns, DNS& parsed_dns);
+    static uint64_t hash_key(const transaction_key& key);
+    static uint64_t hash_statistics_key(uint64_t key);
+    bool process_packet(const PDU& pdu, const timestamp_type& ts);
+    uint64_t statistics_key(const DNS& dns);
+    size_t find_transaction(const transaction_key& key) const;
+    void erase_transaction(size_t index);
+    name_statistics& find_statistics(uint64_t key);
+    void erase_statistics(uint32_t index);
+    void acquire_name(DNSNameTable::id_type id);
+    void release_name(DNSNameTable::id_type id);
+    void set_timeout(const timestamp_type& value);
+    void schedule(const wheel_entry& entry);
+    void advance_wheel(const timestamp_type& now);
+    void expire_bucket(size_t index, const timestamp_type& now);
+
+    transactions_type transactions_;
+    wheel_type wheel_;
+    uint64_t current_tick_;
+    bool wheel_started_;
+    timestamp_type timeout_;
+    timestamp_type tick_duration_;
+    // Names are referenced by statistics and pending queries
+    DNSNameTable names_;
+    std::vector<uint32_t> name_references_;
+    name_statistics_type name_statistics_;
+    statistics_index_type statistics_index_;
+    statistics_lru_type statistics_lru_;
+    std::vector<uint32_t> free_statistics_;
+    size_t max_statistics_;
+    histogram_type latency_;
+    uint64_t unanswered_count_;
+};
+
+} // Tins
+
+#endif // TINS_IS_CXX11
+
+#endif // TINS_DNS_TRANSACTION_TRACKER_H
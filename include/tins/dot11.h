@@ -40,5 +40,6 @@
 #include <tins/dot11/dot11_auth.h>
 #include <tins/dot11/dot11_probe.h>
 #include <tins/dot11/dot11_control.h>
+#include <tins/dot11/dot11_mgmt_scanner.h>
 
 #endif // TINS_DOT_11
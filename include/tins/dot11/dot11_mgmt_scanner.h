@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/config.h>
+
+#if !defined(TINS_DOT11_DOT11_MGMT_SCANNER_H) && defined(TINS_HAVE_DOT11)
+#define TINS_DOT11_DOT11_MGMT_SCANNER_H
+
+#include <string>
+#include <stdint.h>
+#include <tins/cxxstd.h>
+#if TINS_IS_CXX11
+    #include <functional>
+#endif // TINS_IS_CXX11
+#include <tins/dot11/dot11_base.h>
+#include <tins/macros.h>
+
+namespace Tins {
+
+/**
+ * \class Dot11MgmtScanner
+ * \brief Extracts fields from raw IEEE 802.11 management frames.
+ *
+ * Constructing a Dot11ManagementFrame decodes every tagged parameter
+ * into an option. When only a few of them are needed, e.g. the SSID and 
+ * channel of beacons, this class can be used instead. Each call to
+ * Dot11MgmtScanner::scan walks the frame's tagged parameters once and 
+ * records where the first occurrence of each requested element is, 
+ * without allocating any memory or copying the frame.
+ *
+ * Every element is requested by default. On C++11, a handler can be set
+ * which is called for every occurrence of a requested element, so 
+ * repeated elements such as vendor specific ones can be processed as well.
+ * Otherwise, elements can still be read through their data pointers and 
+ * offsets.
+ *
+ * Elements and addresses point into the scanned buffer, so they're only 
+ * valid until it's modified or freed, or until the next frame is 
+ * scanned. If the frame ends in a truncated element, e.g. because the 
+ * FCS was not removed, the elements before it are still reported.
+ *
+ * \code
+ * Dot11MgmtScanner scanner;
+ * scanner.clear_requests();
+ * scanner.request(Dot11::SSID);
+ * scanner.request(Dot11::DS_SET);
+ * scanner.request(Dot11::HT_OPERATION);
+ * 
+ * if (scanner.scan(buffer, size) && scanner.subtype() == Dot11::BEACON) {
+ *     std::cout << scanner.addr3() << " - " << scanner.ssid() << std::endl;
+ * }
+ * \endcode
+ */
+class TINS_API Dot11MgmtScanner {
+public:
+    /**
+     * The type used to store hardware addresses
+     */
+    typedef Dot11::address_type address_type;
+
+    /**
+     * \brief A tagged element found in a frame.
+     */
+    struct element {
+        /**
+         * The element's data
+         */
+        const uint8_t* data;
+
+        /**
+         * The offset of the element's data within the frame
+         */
+        uint32_t offset;
+
+        /**
+         * The element's id
+         */
+        uint8_t id;
+
+        /**
+         * The element's data length
+         */
+        uint8_t length;
+    };
+
+    #if TINS_IS_CXX11
+        /**
+         * The type of the element handler
+         */
+        typedef std::function<void(const element&)> handler_type;
+    #endif // TINS_IS_CXX11
+
+    /**
+     * \brief Default constructor.
+     *
+     * Every element is requested.
+     */
+    Dot11MgmtScanner();
+
+    /**
+     * Copy constructor
+     */
+    Dot11MgmtScanner(const Dot11MgmtScanner& other);
+
+    /**
+     * Copy assignment operator
+     */
+    Dot11MgmtScanner& operator=(const Dot11MgmtScanner& other);
+
+    /**
+     * Destructor
+     */
+    ~Dot11MgmtScanner();
+
+    /**
+     * \brief Requests an element.
+     *
+     * \param id The id of the element to be requested
+     */
+    void request(uint8_t id);
+
+    /**
+     * \brief Requests every element.
+     */
+    void request_all();
+
+    /**
+     * \brief Removes every requested element.
+     */
+    void clear_requests();
+
+    #if TINS_IS_CXX11
+        /**
+         * \brief Sets the handler called for every requested element found.
+         *
+         * \param value The handler to be used
+         */
+        void handler(const handler_type& value);
+    #endif // TINS_IS_CXX11
+
+    /**
+     * \brief Scans a frame.
+     *
+     * The buffer must start at the IEEE 802.11 header. Elements are only 
+     * looked for in association, reassociation, probe, beacon and 
+     * authentication frames that aren't protected.
+     *
+     * \param buffer The frame
+     * \param total_sz The frame's size
+     * \return true iff this is a management frame
+     */
+    bool scan(const uint8_t* buffer, uint32_t total_sz);
+
+    /**
+     * \brief Retrieves the subtype of the last frame scanned.
+     */
+    uint8_t subtype() const;
+
+    /**
+     * \brief Retrieves the to DS flag of the last frame scanned.
+     */
+    bool to_ds() const;
+
+    /**
+     * \brief Retrieves the from DS flag of the last frame scanned.
+     */
+    bool from_ds() const;
+
+    /**
+     * \brief Retrieves the first address of the last frame scanned.
+     */
+    address_type addr1() const;
+
+    /**
+     * \brief Retrieves the second address of the last frame scanned.
+     */
+    address_type addr2() const;
+
+    /**
+     * \brief Retrieves the third address of the last frame scanned.
+     *
+     * For management frames, this is the BSSID.
+     */
+    address_type addr3() const;
+
+    /**
+     * \brief Searches for an element in the last frame scanned.
+     *
+     * \param id The id of the element to be searched
+     * \return A pointer to its first occurrence, or 0 if it was not found 
+     * or it was not requested.
+     */
+    const element* search_element(uint8_t id) const;
+
+    /**
+     * \brief Retrieves the SSID of the last frame scanned.
+     *
+     * An option_not_found exception is thrown if there is no SSID element.
+     */
+    std::string ssid() const;
+
+    /**
+     * \brief Retrieves the channel of the last frame scanned.
+     *
+     * This is taken from the DS parameter set or, if there's none, from
+     * the HT operation element's primary channel. An option_not_found 
+     * exception is thrown if neither of them is present.
+     */
+    uint8_t channel() const;
+private:
+    static const uint32_t MAX_ELEMENTS = 256;
+
+    // Holds the element handler. This is only defined when building with
+    // C++11, but the member is always there so the layout doesn't depend
+    // on the standard used by the application
+    struct handler_holder;
+
+    const uint8_t* frame_;
+    handler_holder* handler_;
+    uint64_t requested_[MAX_ELEMENTS / 64];
+    element elements_[MAX_ELEMENTS];
+    uint32_t generations_[MAX_ELEMENTS];
+    uint32_t generation_;
+};
+
+} // Tins
+
+#endif // TINS_DOT11_DOT11_MGMT_SCANNER_H
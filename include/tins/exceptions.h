@@ -289,6 +289,14 @@ public:
     invalid_domain_name() : exception_base("Invalid domain name") { }
 };
 
+/**
+ * \brief Exception thrown when a stream's payload can't be spilled to disk
+ */
+class spill_error : public exception_base {
+public:
+    spill_error() : exception_base("Failed to spill stream payload") { }
+};
+
 /**
  * \brief Exception thrown when a stream is not found
  */
@@ -305,6 +313,22 @@ public:
     callback_not_set() : exception_base("Callback not set") { }
 };
 
+/**
+ * \brief Exception thrown when restoring state from an invalid checkpoint
+ */
+class invalid_checkpoint : public exception_base {
+public:
+    invalid_checkpoint() : exception_base("Invalid checkpoint") { }
+};
+
+/**
+ * \brief Exception thrown when serializing a stream that has spilled payloads
+ */
+class unserializable_stream : public exception_base {
+public:
+    unserializable_stream() : exception_base("Stream has spilled payloads") { }
+};
+
 /**
  * \brief Exception thrown when an invalid packet is provided to some function
  */
@@ -313,6 +337,15 @@ public:
     invalid_packet() : exception_base("Invalid packet") { }
 };
 
+/**
+ * \brief Exception thrown when DNS records are added out of section order
+ */
+class invalid_section_order : public exception_base {
+public:
+    invalid_section_order() 
+    : exception_base("DNS records must be added in section order") { }
+};
+
 namespace Crypto {
 namespace WPA2 {
     /**
@@ -322,6 +355,14 @@ namespace WPA2 {
     public:
         invalid_handshake() : exception_base("Invalid WPA2 handshake") { }
     };
+
+    /**
+     * \brief Exception thrown when an SSID is longer than 32 bytes.
+     */
+    class invalid_ssid : public exception_base {
+    public:
+        invalid_ssid() : exception_base("Invalid SSID") { }
+    };
 } // WPA2
 } // Crypto
 
@@ -33,14 +33,21 @@
 #define TINS_HANDSHAKE_CAPTURER_H
 
 #include <vector>
-#include <map>
 #include <utility>
+#include <tins/cxxstd.h>
+#if TINS_IS_CXX11
+    #include <chrono>
+    #include <functional>
+#endif // TINS_IS_CXX11
 #include <tins/hw_address.h>
 #include <tins/macros.h>
 #include <tins/eapol.h>
+#include <tins/detail/hash_table_helpers.h>
 
 namespace Tins {
 
+class Packet;
+
 /**
  * \brief Generic EAPOL handshake.
  *
@@ -104,7 +111,21 @@ private:
 typedef EAPOLHandshake<RSNEAPOL> RSNHandshake;
 
 /**
- * Captures 802.1X RSN handshakes.
+ * \brief Captures 802.1X RSN handshakes.
+ *
+ * Handshakes that are still in progress are kept in a hash table indexed by
+ * the pair of addresses involved, which holds the EAPOL frames seen so far.
+ * Once the fourth frame arrives, the handshake is completed using the 
+ * original frames.
+ *
+ * Handshakes that don't make progress within the configured timeout are
+ * discarded, so memory usage stays bounded on long running captures. Use
+ * RSNHandshakeCapturer::process_packet(const Packet&) so that timeouts are
+ * driven by the packets' timestamps.
+ *
+ * Completed handshakes are stored and retrieved through
+ * RSNHandshakeCapturer::handshakes. On C++11, they can instead be handed to
+ * a callback as soon as they're completed.
  */
 class TINS_API RSNHandshakeCapturer {
 public:
@@ -118,18 +139,67 @@ public:
      * will be stored.
      */
     typedef std::vector<handshake_type> handshakes_type;
+
+    #if TINS_IS_CXX11
+        /**
+         * \brief The type used for the completed handshake callback
+         *
+         * The callback will be called with every completed handshake. 
+         */
+        typedef std::function<void(const handshake_type&)> handshake_callback_type;
+    #endif // TINS_IS_CXX11
+
+    /**
+     * The default time after which incomplete handshakes are discarded, in
+     * seconds
+     */
+    static const uint32_t DEFAULT_TIMEOUT;
+
+    /**
+     * Default constructor
+     */
+    RSNHandshakeCapturer();
+
+    /**
+     * Copy constructor
+     */
+    RSNHandshakeCapturer(const RSNHandshakeCapturer& other);
+
+    /**
+     * Copy assignment operator
+     */
+    RSNHandshakeCapturer& operator=(const RSNHandshakeCapturer& other);
+
+    /**
+     * Destructor
+     */
+    ~RSNHandshakeCapturer();
     
     /**
      * \brief Processes a packet.
      * 
      * This will fetch the RSNEAPOL layer, if any, and store
      * it in an intermediate storage. When a handshake is 
-     * completed, it will be stored separately. 
+     * completed, it will be stored separately or handed to the 
+     * completed handshake callback, if any. 
+     *
+     * The current time is used when checking for timeouts.
      *
+     * \return true iff this packet completed a handshake.
      * \sa RSNHandshakeCapturer::handshakes
      */
     bool process_packet(const PDU& pdu);
 
+    /**
+     * \brief Processes a packet.
+     *
+     * This behaves like RSNHandshakeCapturer::process_packet(const PDU&)
+     * but uses the packet's timestamp when checking for timeouts.
+     *
+     * \return true iff this packet completed a handshake.
+     */
+    bool process_packet(const Packet& packet);
+
     /**
      * \brief Retrieves the completed handshakes.
      *
@@ -137,6 +207,9 @@ public:
      * so far. A handshake is completed when the 4-way handshake
      * is captured.
      *
+     * Handshakes will not be stored here if a completed handshake 
+     * callback is set.
+     *
      * \sa RSNHandshakeCapturer::clear_handshakes
      */
     const handshakes_type& handshakes() const {
@@ -153,16 +226,91 @@ public:
     void clear_handshakes() {
         completed_handshakes_.clear();
     }
+
+    #if TINS_IS_CXX11
+        /**
+         * \brief Sets the completed handshake callback
+         *
+         * Once set, completed handshakes are handed to this callback instead
+         * of being stored.
+         *
+         * \param callback The callback to be set
+         */
+        void handshake_callback(const handshake_callback_type& callback);
+    #endif // TINS_IS_CXX11
+
+    /**
+     * \brief Sets the time after which incomplete handshakes are discarded
+     *
+     * The timeout is measured since the last frame that belonged to the 
+     * handshake was seen.
+     *
+     * \param value The timeout to be set, in seconds
+     */
+    void timeout(uint32_t value);
+
+    #if TINS_IS_CXX11
+        /**
+         * \brief Sets the time after which incomplete handshakes are discarded
+         *
+         * \param value The timeout to be set
+         * \sa RSNHandshakeCapturer::timeout(uint32_t)
+         */
+        template <typename Rep, typename Period>
+        void timeout(const std::chrono::duration<Rep, Period>& value) {
+            timeout_ = std::chrono::duration_cast<std::chrono::microseconds>(value).count();
+        }
+    #endif // TINS_IS_CXX11
+
+    /**
+     * \brief Retrieves the number of handshakes currently in progress
+     */
+    size_t pending_handshakes() const;
 private:
     typedef handshake_type::address_type address_type;
     typedef handshake_type::container_type eapol_list;
-    typedef std::map<std::pair<address_type, address_type>, eapol_list> handshake_map;
+    // Microseconds
+    typedef uint64_t timestamp_type;
+
+    // Both addresses, smallest one first, packed together
+    struct address_pair_key {
+        static const size_t data_size = 2 * address_type::address_size;
+
+        address_pair_key() { }
+        address_pair_key(const address_type& addr1, const address_type& addr2);
+
+        bool operator==(const address_pair_key& rhs) const;
+        uint64_t hash() const;
+
+        uint8_t data[data_size];
+    };
+
+    struct pending_handshake {
+        address_pair_key key;
+        timestamp_type last_seen;
+        // The frames seen so far, in order
+        eapol_list frames;
+    };
+
+    // Holds the completed handshake callback. This is only defined when
+    // building with C++11, but the member is always there so the layout 
+    // doesn't depend on the standard used by the application
+    struct callback_holder;
+
+    typedef Internals::hash_table<pending_handshake> handshake_map;
 
-    bool do_insert(const handshake_map::key_type& key, const RSNEAPOL* eapol, 
-      size_t expected);
+    bool process_packet(const PDU& pdu, timestamp_type ts);
+    size_t find_index(const address_pair_key& key) const;
+    pending_handshake* find_handshake(const address_pair_key& key,
+                                      timestamp_type ts, size_t expected);
+    void complete_handshake(const handshake_type& handshake);
+    void expire_handshakes(timestamp_type now);
 
     handshake_map handshakes_;
     handshakes_type completed_handshakes_;
+    callback_holder* handshake_callback_;
+    timestamp_type timeout_;
+    timestamp_type last_expiration_;
 };
 
 } // Tins
@@ -59,6 +59,13 @@ class OutputMemoryStream;
  * is retrieved (by using the routing table and the destination address)
  * and set as the source address. If you don't want this behaviour, simply
  * set the source address to 0.0.0.0.
+ *
+ * Options read from a buffer are decoded the first time IP::options or
+ * IP::search_option is called. Although both are const, they modify the 
+ * object when they do so, so concurrent calls to them on the same IP 
+ * object must be synchronized by the caller, or the options decoded 
+ * beforehand. Other const member functions, including the option getters
+ * such as IP::security, never modify the object.
  */
 class TINS_API IP : public PDU {
 public:
@@ -410,9 +417,15 @@ public:
 
     /** 
      * \brief Getter for the IP options.
+     *
+     * The first call to this method decodes the options read from a 
+     * buffer. Since that modifies this PDU, concurrent calls on the same
+     * IP object must be synchronized by the caller.
+     *
      * \return The stored options.
      */
     const options_type& options() const {
+        parse_options();
         return options_;
     }
 
@@ -527,6 +540,7 @@ public:
          * \param opt The option to be added.
          */
         void add_option(option &&opt) {
+            parse_options();
             options_.push_back(std::move(opt));
         }
 
@@ -540,6 +554,7 @@ public:
          */
         template<typename... Args>
         void add_option(Args&&... args) {
+            parse_options();
             options_.emplace_back(std::forward<Args>(args)...);
         }
     #endif
@@ -561,6 +576,10 @@ public:
      * If the option is not found, a null pointer is returned. 
      * Deleting the returned pointer will result in <b>undefined 
      * behaviour</b>.
+     *
+     * This decodes the options read from a buffer if they weren't yet. 
+     * Since that modifies this PDU, concurrent calls on the same IP 
+     * object must be synchronized by the caller.
      * 
      * \param id The option identifier to be searched.
      */
@@ -760,17 +779,25 @@ private:
     void prepare_for_serialize();
     uint32_t calculate_options_size() const;
     uint32_t pad_options_size(uint32_t size) const;
+    void parse_options() const;
     void init_ip_fields();
     void write_serialization(uint8_t* buffer, uint32_t total_sz);
     void write_option(const option& opt, Memory::OutputMemoryStream& stream);
     void add_route_option(option_identifier id, const generic_route_option_type& data);
     generic_route_option_type search_route_option(option_identifier id) const;
+    option find_option(option_identifier id) const;
     void checksum(uint16_t new_check);
     options_type::const_iterator search_option_iterator(option_identifier id) const;
     options_type::iterator search_option_iterator(option_identifier id);
 
-    options_type options_;
+    static const uint32_t MAX_OPTIONS_SIZE = 40;
+
+    // Options are decoded from raw_options_ on first use
+    mutable options_type options_;
     ip_header header_;
+    uint8_t raw_options_[MAX_OPTIONS_SIZE];
+    uint8_t raw_options_size_;
+    mutable bool options_parsed_;
 };
 
 } // Tins
@@ -32,59 +32,90 @@
 
 #include <vector>
 #include <map>
+#include <list>
+#include <tins/cxxstd.h>
 #include <tins/pdu.h>
 #include <tins/macros.h>
 #include <tins/ip_address.h>
+#include <tins/ipv6_address.h>
 #include <tins/ip.h>
+#include <tins/ipv6.h>
+#if TINS_IS_CXX11
+    #include <chrono>
+#endif // TINS_IS_CXX11
 
 namespace Tins {
 
+class Packet;
+
+namespace Memory {
+
+class InputMemoryStream;
+class OutputMemoryStream;
+
+} // Memory
+
 /** 
  * \cond
  */
 namespace Internals {
-class IPv4Fragment {
-public:
-    typedef PDU::serialization_type payload_type;
-
-    IPv4Fragment() : offset_() { }
-
-    template<typename T>
-    IPv4Fragment(T* pdu, uint16_t offset)
-    : payload_(pdu->serialize()), offset_(offset) {
-        
-    }
-    
-    const payload_type& payload() const {
-        return payload_;
-    }
-    
-    uint16_t offset() const {
-        return offset_;
-    }
-private:
-    payload_type payload_;
-    uint16_t offset_;
-};
-
 class TINS_API IPv4Stream {
 public:
     IPv4Stream();
+    IPv4Stream(Memory::InputMemoryStream& input);
     
     void add_fragment(IP* ip);
     bool is_complete() const;
     PDU* allocate_pdu() const;
     const IP& first_fragment() const;
+    size_t serialized_size() const;
+    void serialize(Memory::OutputMemoryStream& output) const;
 private:
-    typedef std::vector<IPv4Fragment> fragments_type;
+    // Holes are represented as [first, last) ranges
+    typedef std::pair<uint32_t, uint32_t> hole_type;
+    typedef std::vector<hole_type> holes_type;
     
     uint16_t extract_offset(const IP* ip);
-    bool extract_more_frag(const IP* ip);
+    void fill_holes(const uint8_t* data, uint32_t offset, uint32_t end);
+    void set_total_size(uint32_t total_size);
 
-    fragments_type fragments_;
-    size_t received_size_;
-    size_t total_size_;
+    PDU::serialization_type buffer_;
+    holes_type holes_;
+    uint32_t total_size_;
     IP first_fragment_;
+    bool received_first_;
+    bool received_end_;
+};
+
+class TINS_API IPv6Stream {
+public:
+    IPv6Stream(const IPv6& ipv6, size_t fragment_index);
+
+    static bool is_valid_fragment(const IPv6& ipv6, size_t fragment_index);
+    bool add_fragment(const IPv6& ipv6, size_t fragment_index);
+    bool is_complete() const;
+    bool build_packet(IPv6& ipv6);
+    size_t buffer_size() const;
+private:
+    // Holes are represented as [first, last) ranges
+    typedef std::pair<uint32_t, uint32_t> hole_type;
+    typedef std::vector<hole_type> holes_type;
+
+    static uint8_t fragment_next_header(const IPv6& ipv6, size_t fragment_index);
+    static uint32_t unfragmentable_size(const IPv6& ipv6, size_t fragment_index);
+    static uint32_t fragmentable_size(const IPv6& ipv6, size_t fragment_index);
+    static void write_ext_header(Memory::OutputMemoryStream& output, uint8_t next_header,
+                                 const IPv6::ext_header& header);
+    void write_unfragmentable_part(const IPv6& ipv6, size_t fragment_index);
+    void write_fragmentable_part(const IPv6& ipv6, size_t fragment_index,
+                                 uint8_t* buffer, uint32_t size);
+    void set_total_size(uint32_t total_size);
+    void fill_hole(size_t index, uint32_t offset, uint32_t end);
+
+    std::vector<uint8_t> buffer_;
+    holes_type holes_;
+    uint32_t header_size_;
+    uint32_t total_size_;
     bool received_end_;
 };
 } // namespace Internals
@@ -103,6 +134,18 @@ private:
  * packet wasn't fragmented) or IPv4Reassembler::REASSEMBLED (meaning the packet was
  * fragmented but it's now reassembled), then you can process the packet normally.
  *
+ * Each fragment is written straight into a single buffer that ends up holding
+ * the whole reassembled payload, keeping track of the missing ranges as in 
+ * RFC 815. If fragments overlap, the data that was received first is kept.
+ *
+ * By default there's no limit on the amount of state kept. Limits can be
+ * enabled so that packets that aren't reassembled within a timeout are 
+ * discarded, the oldest packet is evicted when the maximum amount of packets
+ * being reassembled is reached and fragments starting a new packet are 
+ * dropped when their source address already has too many packets being 
+ * reassembled. Use IPv4Reassembler::process(Packet&) so that timeouts are 
+ * driven by the packets' timestamps.
+ *
  * Simple example:
  *
  * \code
@@ -138,6 +181,15 @@ public:
         NONE 
     };
 
+    /**
+     * The reasons why a packet being reassembled can be discarded
+     */
+    enum EvictionReason {
+        TIMEOUT, ///< The packet wasn't reassembled within the timeout
+        MAX_STREAMS, ///< The packet was evicted to make room for a new one
+        SOURCE_QUOTA ///< A fragment was dropped as its source reached its quota
+    };
+
     /**
      * Default constructor
      */
@@ -158,6 +210,9 @@ public:
      * the packet is successfully reassembled using previously
      * processed packets, its contents will be modified so that
      * it contains the whole payload and not just a fragment.
+     *
+     * If a timeout is set, the current time is used as the packet's 
+     * timestamp. Otherwise, the clock isn't read at all.
      * 
      * \param pdu The PDU to process.
      * \return NOT_FRAGMENTED if the PDU does not contain an IP
@@ -167,6 +222,77 @@ public:
      */
     PacketStatus process(PDU& pdu);
 
+    /**
+     * \brief Processes a packet and tries to reassemble it.
+     *
+     * The packet's timestamp is used to expire incomplete packets.
+     *
+     * \param packet The packet to process.
+     * \sa IPv4Reassembler::process(PDU&)
+     */
+    PacketStatus process(Packet& packet);
+
+    /**
+     * \brief Sets the reassembly timeout
+     *
+     * Packets which aren't reassembled within this time since their first
+     * fragment was seen are discarded. A value of 0, which is the default,
+     * disables timeouts.
+     *
+     * \param value The timeout to be set, in seconds
+     */
+    void timeout(uint32_t value);
+
+    #if TINS_IS_CXX11
+        /**
+         * \brief Sets the reassembly timeout
+         *
+         * \param value The timeout to be set
+         * \sa IPv4Reassembler::timeout(uint32_t)
+         */
+        template <typename Rep, typename Period>
+        void timeout(const std::chrono::duration<Rep, Period>& value) {
+            timeout_ = std::chrono::duration_cast<std::chrono::microseconds>(value).count();
+        }
+    #endif // TINS_IS_CXX11
+
+    /**
+     * \brief Sets the maximum amount of packets being reassembled
+     *
+     * Once this limit is reached, the oldest packet is discarded whenever a
+     * fragment for a new one is received. A value of 0, which is the default,
+     * means there's no limit.
+     *
+     * \param value The value to be set
+     */
+    void max_streams(size_t value);
+
+    /**
+     * \brief Sets the maximum amount of packets being reassembled per source
+     *
+     * Fragments that would start a new packet for a source address that 
+     * already reached this limit are dropped. A value of 0, which is the 
+     * default, means there's no limit.
+     *
+     * \param value The value to be set
+     */
+    void max_streams_per_source(size_t value);
+
+    /**
+     * Retrieves the amount of packets currently being reassembled
+     */
+    size_t stream_count() const;
+
+    /**
+     * \brief Retrieves the amount of evictions for the given reason
+     *
+     * For TIMEOUT and MAX_STREAMS, this is the amount of packets discarded.
+     * For SOURCE_QUOTA, this is the amount of fragments dropped.
+     *
+     * \param reason The reason to look up
+     */
+    uint64_t eviction_count(EvictionReason reason) const;
+
     /**
      * Removes all of the packets and data stored.
      */
@@ -183,18 +309,255 @@ public:
      * \sa IP::id
      */
     void remove_stream(uint16_t id, IPv4Address addr1, IPv4Address addr2);
+
+    /**
+     * \brief Serializes the state of every packet being reassembled
+     *
+     * The returned buffer contains every fragment received so far. It can
+     * later be given to IPv4Reassembler::restore, potentially on a different
+     * process, to keep reassembling these packets.
+     */
+    std::vector<uint8_t> checkpoint() const;
+
+    /**
+     * \brief Restores the packets being reassembled from a checkpoint
+     *
+     * Restored packets are added to the ones being reassembled, replacing any
+     * packet having the same identifier and addresses.
+     *
+     * If the checkpoint is invalid, an invalid_checkpoint exception is thrown
+     * and nothing is restored.
+     *
+     * \param buffer The buffer containing the checkpoint
+     * \param total_sz The size of the buffer
+     * \sa IPv4Reassembler::checkpoint
+     */
+    void restore(const uint8_t* buffer, size_t total_sz);
 private:
+    static const uint32_t CHECKPOINT_MAGIC;
+    static const uint8_t CHECKPOINT_VERSION;
+
+    // Timestamps are kept as microseconds since the epoch
+    typedef uint64_t timestamp_type;
     typedef std::pair<IPv4Address, IPv4Address> address_pair;
     typedef std::pair<uint16_t, address_pair> key_type;
-    typedef std::map<key_type, Internals::IPv4Stream> streams_type;
+    typedef std::list<key_type> key_list_type;
+
+    struct stream_data {
+        stream_data(const Internals::IPv4Stream& stream, IPv4Address source,
+                    timestamp_type ts, key_list_type::iterator position)
+        : stream(stream), source(source), first_seen(ts), position(position) {
+
+        }
 
+        Internals::IPv4Stream stream;
+        IPv4Address source;
+        timestamp_type first_seen;
+        key_list_type::iterator position;
+    };
+
+    typedef std::map<key_type, stream_data> streams_type;
+    typedef std::map<IPv4Address, size_t> source_counts_type;
+
+    PacketStatus process(PDU& pdu, timestamp_type ts);
     key_type make_key(const IP* ip) const;
     address_pair make_address_pair(IPv4Address addr1, IPv4Address addr2) const;
+    streams_type::iterator add_stream(const key_type& key, stream_data& data);
+    void remove_stream(streams_type::iterator iter);
+    void expire_streams(timestamp_type now);
+    void enforce_stream_limit(size_t limit);
     
     streams_type streams_;
+    key_list_type streams_by_age_;
+    source_counts_type source_counts_;
+    timestamp_type timeout_;
+    size_t max_streams_;
+    size_t max_streams_per_source_;
+    uint64_t eviction_counts_[3];
     OverlappingTechnique technique_;
 };
 
+/**
+ * \brief Reassembles fragmented IPv6 packets.
+ *
+ * This works just like IPv4Reassembler: feed packets into it using 
+ * IPv6Reassembler::process and process them normally unless the return 
+ * value is IPv6Reassembler::FRAGMENTED.
+ *
+ * Fragments are identified by their Fragment extension header's 
+ * identification field and their source and destination addresses. Each 
+ * fragment is copied straight into a single buffer, which grows up to the 
+ * end of the furthest fragment seen until the last fragment tells us the 
+ * packet's size. At that point, it's sized to fit the whole packet.
+ *
+ * The following rules apply:
+ *
+ * - If a fragment overlaps some other fragment of the same packet, the whole
+ * packet is discarded (RFC 5722). Fragments whose data was already received
+ * are ignored.
+ * - Atomic fragments (offset 0 and no more fragments) are reassembled on their
+ * own without affecting any other packet (RFC 6946).
+ * - Fragments other than the last one whose size is not a multiple of 8 and
+ * fragments that would make the packet larger than 65535 bytes are discarded.
+ * - Packets that aren't reassembled before the timeout expires, measured
+ * from their first fragment, are discarded.
+ * - If the buffered fragments take more than the configured maximum amount of
+ * memory, the oldest packets are discarded.
+ *
+ * \code
+ * IPv6Reassembler reassembler;
+ * Sniffer sniffer = ...;
+ * sniffer.sniff_loop([&](Packet& packet) {
+ *     if (reassembler.process(packet) != IPv6Reassembler::FRAGMENTED) {
+ *         process_packet(*packet.pdu());
+ *     }
+ *     return true;
+ * });
+ * \endcode
+ */
+class TINS_API IPv6Reassembler {
+public:
+    /**
+     * The status of each processed packet.
+     */
+    enum PacketStatus {
+        NOT_FRAGMENTED, ///< The given packet is not fragmented
+        FRAGMENTED, ///< The given packet is fragmented and can't be reassembled yet
+        REASSEMBLED ///< The given packet was fragmented but is now reassembled
+    };
+
+    /**
+     * The default reassembly timeout, in seconds
+     */
+    static const uint32_t DEFAULT_TIMEOUT;
+
+    /**
+     * The default maximum amount of bytes to be buffered
+     */
+    static const size_t DEFAULT_MAX_BUFFERED_BYTES;
+
+    /**
+     * Default constructor
+     */
+    IPv6Reassembler();
+
+    /**
+     * \brief Processes a PDU and tries to reassemble it.
+     *
+     * If the packet is successfully reassembled using previously processed 
+     * fragments, its IPv6 layer is replaced by the reassembled packet. 
+     *
+     * If a timeout is set, the current time is used as the packet's 
+     * timestamp. Otherwise, the clock isn't read at all.
+     *
+     * \param pdu The PDU to process.
+     * \return NOT_FRAGMENTED if the PDU does not contain an IPv6 layer or is not
+     * fragmented, FRAGMENTED if the packet is fragmented or was discarded or
+     * REASSEMBLED if the packet was fragmented but has now been reassembled.
+     */
+    PacketStatus process(PDU& pdu);
+
+    /**
+     * \brief Processes a packet and tries to reassemble it.
+     *
+     * The packet's timestamp is used to expire incomplete packets.
+     *
+     * \param packet The packet to process.
+     * \sa IPv6Reassembler::process(PDU&)
+     */
+    PacketStatus process(Packet& packet);
+
+    /**
+     * \brief Sets the reassembly timeout
+     *
+     * Packets which aren't reassembled within this time since their first
+     * fragment was seen are discarded. This defaults to 60 seconds. A value
+     * of 0 disables timeouts.
+     *
+     * \param value The timeout to be set, in seconds
+     */
+    void timeout(uint32_t value);
+
+    #if TINS_IS_CXX11
+        /**
+         * \brief Sets the reassembly timeout
+         *
+         * \param value The timeout to be set
+         * \sa IPv6Reassembler::timeout(uint32_t)
+         */
+        template <typename Rep, typename Period>
+        void timeout(const std::chrono::duration<Rep, Period>& value) {
+            timeout_ = std::chrono::duration_cast<std::chrono::microseconds>(value).count();
+        }
+    #endif // TINS_IS_CXX11
+
+    /**
+     * \brief Sets the maximum amount of bytes to be buffered
+     *
+     * This defaults to 4MB.
+     *
+     * \param value The value to be set
+     */
+    void max_buffered_bytes(size_t value);
+
+    /**
+     * Retrieves the amount of bytes currently buffered
+     */
+    size_t buffered_bytes() const;
+
+    /**
+     * Retrieves the amount of packets currently being reassembled
+     */
+    size_t stream_count() const;
+
+    /**
+     * Removes all of the packets and data stored.
+     */
+    void clear_streams();
+
+    /**
+     * \brief Removes all of the data stored that belongs to the packet 
+     * identified by the given parameters.
+     * 
+     * \param id The Fragment extension header's identification field
+     * \param src_addr The source address
+     * \param dst_addr The destination address
+     */
+    void remove_stream(uint32_t id, const IPv6Address& src_addr,
+                       const IPv6Address& dst_addr);
+private:
+    // Timestamps are kept as microseconds since the epoch
+    typedef uint64_t timestamp_type;
+    typedef std::pair<IPv6Address, IPv6Address> address_pair;
+    typedef std::pair<uint32_t, address_pair> key_type;
+    typedef std::list<key_type> key_list_type;
+
+    struct stream_data {
+        stream_data(const Internals::IPv6Stream& stream, timestamp_type ts,
+                    key_list_type::iterator position)
+        : stream(stream), first_seen(ts), position(position) {
+
+        }
+
+        Internals::IPv6Stream stream;
+        timestamp_type first_seen;
+        key_list_type::iterator position;
+    };
+
+    typedef std::map<key_type, stream_data> streams_type;
+
+    PacketStatus process(PDU& pdu, timestamp_type ts);
+    void remove_stream(streams_type::iterator iter);
+    void expire_streams(timestamp_type now);
+    void enforce_memory_limit();
+
+    streams_type streams_;
+    key_list_type streams_by_age_;
+    timestamp_type timeout_;
+    size_t max_buffered_bytes_;
+    size_t buffered_bytes_;
+};
+
 /**
  * Proxy functor class that reassembles PDUs.
  */
@@ -244,6 +607,55 @@ IPv4ReassemblerProxy<Functor> make_ipv4_reassembler_proxy(Functor func) {
     return IPv4ReassemblerProxy<Functor>(func);
 }
 
+/**
+ * Proxy functor class that reassembles IPv6 PDUs.
+ */
+template<typename Functor>
+class IPv6ReassemblerProxy {
+public:
+    /**
+     * Constructs the proxy from a functor object.
+     *
+     * \param func The functor object.
+     */
+    IPv6ReassemblerProxy(Functor func)
+    : functor_(func) {
+
+    }
+
+    /**
+     * \brief Tries to reassemble the packet and forwards it to 
+     * the functor.
+     * 
+     * \param pdu The packet to process
+     * \return true if the packet wasn't forwarded, otherwise
+     * the value returned by the functor.
+     */
+    bool operator()(PDU& pdu) {
+        // Forward it unless it's fragmented.
+        if (reassembler_.process(pdu) != IPv6Reassembler::FRAGMENTED) {
+            return functor_(pdu);
+        }
+        else {
+            return true;
+        }
+    }
+private:
+    IPv6Reassembler reassembler_;
+    Functor functor_;
+};
+
+/**
+ * Helper function that creates an IPv6ReassemblerProxy.
+ *
+ * \param func The functor object to use in the IPv6ReassemblerProxy.
+ * \return An IPv6ReassemblerProxy.
+ */
+template<typename Functor>
+IPv6ReassemblerProxy<Functor> make_ipv6_reassembler_proxy(Functor func) {
+    return IPv6ReassemblerProxy<Functor>(func);
+}
+
 } // Tins
 
 #endif // TINS_IP_REASSEMBLER_H
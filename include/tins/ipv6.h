@@ -227,6 +227,18 @@ public:
         return header_.next_header;
     }
 
+    /**
+     * \brief Getter for the next header field of the last extension header.
+     *
+     * This is the protocol identifier of the payload that follows every
+     * extension header in this packet.
+     *
+     *  \return The stored next header value.
+     */
+    uint8_t last_next_header() const {
+        return next_header_;
+    }
+
     /**
      * \brief Getter for the hop_limit field.
      *  \return The stored hop_limit field value.
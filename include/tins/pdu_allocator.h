@@ -43,6 +43,8 @@ class Dot1Q;
 class SLL;
 class IP;
 class IPv6;
+class UDP;
+class TCP;
 
 namespace Internals {
 
@@ -57,15 +59,33 @@ public:
     typedef typename Tag::identifier_type id_type;
     typedef PDU *(*allocator_type)(const uint8_t *, uint32_t);
 
+    // One entry per identifier, so finding an allocator is a single load
+    static const size_t table_size = static_cast<size_t>(1) << (sizeof(id_type) * 8);
+
     template<typename PDUType>
     static void register_allocator(id_type identifier) {
-        allocators[identifier] = &default_allocator<PDUType>;
-        pdu_types[PDUType::pdu_flag] = identifier;
+        // Copy the flag so it's not odr-used, as most PDUs don't define it
+        const PDU::PDUType type = PDUType::pdu_flag;
+        table()[identifier] = &default_allocator<PDUType>;
+        pdu_types[type] = identifier;
+    }
+
+    // Used for the protocols the library knows about. These never replace
+    // an allocator registered by the user.
+    static void register_builtin_allocator(id_type identifier, allocator_type allocator) {
+        allocator_type* entries = table();
+        if (!entries[identifier]) {
+            entries[identifier] = allocator;
+        }
+    }
+
+    static allocator_type find(id_type identifier) {
+        return allocators ? allocators[identifier] : 0;
     }
 
     static PDU* allocate(id_type identifier, const uint8_t* buffer, uint32_t size) {
-        typename allocators_type::const_iterator it = allocators.find(identifier);
-        return (it == allocators.end()) ? 0 : (*it->second)(buffer, size);
+        const allocator_type allocator = find(identifier);
+        return allocator ? (*allocator)(buffer, size) : 0;
     }
 
     static bool pdu_type_registered(PDU::PDUType type) {
@@ -77,15 +97,24 @@ public:
         return it->second;
     }
 private:
-    typedef std::map<id_type, allocator_type> allocators_type;
     typedef std::map<PDU::PDUType, id_type> pdu_map_types;
 
-    static allocators_type allocators;
+    // The table is only allocated once something is registered, as the port
+    // tables are rarely used and take 512KB each
+    static allocator_type* table() {
+        if (!allocators) {
+            allocators = new allocator_type[table_size]();
+        }
+        return allocators;
+    }
+
+    // Zero initialized before any dynamic initialization takes place
+    static allocator_type* allocators;
     static pdu_map_types pdu_types;
 };
 
 template<typename Tag>
-typename PDUAllocator<Tag>::allocators_type PDUAllocator<Tag>::allocators;
+typename PDUAllocator<Tag>::allocator_type* PDUAllocator<Tag>::allocators;
 
 template<typename Tag>
 typename PDUAllocator<Tag>::pdu_map_types PDUAllocator<Tag>::pdu_types;
@@ -113,6 +142,23 @@ TINS_GENERATE_TAG_MAPPER(IPv6, uint8_t)
 
 #undef TINS_GENERATE_TAG_MAPPER
 
+// Ports get their own tag per transport protocol, so UDP and TCP 
+// don't share their tables with each other nor with ethertypes
+template<typename PDUType>
+struct port_tag {
+    typedef uint16_t identifier_type;
+};
+
+template<>
+struct pdu_tag_mapper<UDP> {
+    typedef port_tag<UDP> type;
+};
+
+template<>
+struct pdu_tag_mapper<TCP> {
+    typedef port_tag<TCP> type;
+};
+
 template<typename PDUType>
 PDU* allocate(typename pdu_tag_mapper<PDUType>::type::identifier_type id, 
               const uint8_t* buffer, 
@@ -161,6 +207,22 @@ namespace Allocators {
  * registering an allocator for EthernetII will make it work for 
  * the rest of the link layer protocols, sine they should all work 
  * the same way.
+ *
+ * Registering an identifier that the library already knows about
+ * (e.g. the IPv4 ethertype) replaces the built in protocol.
+ *
+ * Allocators can also be registered for UDP and TCP ports. In this 
+ * case, the payload of a segment or datagram is decoded using the
+ * allocator registered for its lowest port or, if there's none, for
+ * its highest one. If decoding fails, a RawPDU is used instead. TCP
+ * stream following serializes decoded payloads back into bytes, so these
+ * are only reproduced exactly for protocols that serialize the way they
+ * were parsed.
+ *
+ * \code
+ * // Decode UDP datagrams to/from port 5353 as DNS
+ * Allocators::register_allocator<UDP, DNS>(5353);
+ * \endcode
  */
 template<typename PDUType, typename AllocatedType>
 void register_allocator(typename Internals::pdu_tag_mapper<PDUType>::type::identifier_type id) {
@@ -169,6 +231,25 @@ void register_allocator(typename Internals::pdu_tag_mapper<PDUType>::type::ident
     >::template register_allocator<AllocatedType>(id);
 }
 
+/**
+ * \brief Registers allocators for well known application layer protocols.
+ *
+ * By default, UDP and TCP payloads are stored in a RawPDU which then has
+ * to be converted (e.g. using RawPDU::to) into the actual protocol. After
+ * calling this function, the following protocols will be decoded directly
+ * while parsing the packet:
+ *
+ * - UDP port 53 as DNS
+ * - UDP ports 67 and 68 as DHCP
+ * - UDP ports 546 and 547 as DHCPv6
+ * - UDP port 4789 as VXLAN
+ *
+ * Note that this affects every packet parsed afterwards, so code that 
+ * looks for a RawPDU on top of these ports should look for the decoded
+ * protocol instead.
+ */
+TINS_API void register_application_allocators();
+
 } // Allocators
 } // Tins
 
@@ -34,6 +34,7 @@
 #include <string>
 #include <cstring>
 #include <stdint.h>
+#include <tins/macros.h>
 #include <tins/exceptions.h>
 #include <tins/detail/type_traits.h>
 
@@ -51,6 +52,45 @@ template <typename OptionType, typename PDUType>
 class PDUOption;
 
 namespace Internals {
+    /**
+     * \brief Reference counted copy of a PDU's options area.
+     *
+     * Its definition is private to the library, which makes the reference
+     * count atomic when it's built using C++11.
+     */
+    class option_buffer;
+
+    TINS_API void acquire_option_buffer(option_buffer* buffer);
+    TINS_API void release_option_buffer(option_buffer* buffer);
+
+    /**
+     * \brief Shares a single copy of a PDU's options area among its options.
+     *
+     * Parsing code creates one of these over the part of the buffer that
+     * holds the options. That part is copied once, the first time an 
+     * option that doesn't fit in PDUOption's small buffer is created out 
+     * of it. Every such option then points into that copy rather than 
+     * allocating its own buffer, and keeps a reference to it.
+     */
+    class TINS_API option_block {
+    public:
+        option_block(const uint8_t* start, const uint8_t* end);
+        ~option_block();
+
+        /**
+         * Returns the address of ptr's copy and sets buffer to the copy
+         * it lives in, adding a reference to it.
+         */
+        const uint8_t* share(const uint8_t* ptr, option_buffer*& buffer);
+    private:
+        option_block(const option_block&);
+        option_block& operator=(const option_block&);
+
+        const uint8_t* start_;
+        const uint8_t* end_;
+        option_buffer* buffer_;
+    };
+
     namespace Converters {
         uint8_t convert(const uint8_t* ptr, uint32_t data_size, PDU::endian_type endian,
                         type_to_type<uint8_t>);
@@ -214,18 +254,50 @@ public:
     PDUOption(option_type opt = option_type(), 
               size_t length = 0,
               const data_type* data = 0) 
-    : option_(opt), size_(static_cast<uint16_t>(length)), real_size_(0) {
+    : option_(opt), size_(static_cast<uint16_t>(length)), real_size_(0),
+      shared_payload_(0) {
         if (data != 0) {
             set_payload_contents(data, data + length);
         }
     }
+
+    /**
+     * \brief Constructs a PDUOption whose data belongs to an option block.
+     *
+     * If the data doesn't fit in the option's small buffer, the option
+     * points into the block's copy of the data rather than allocating 
+     * its own buffer. Copies of this option share that data as well.
+     *
+     * \param opt The option type.
+     * \param length The length field value.
+     * \param data The option's data, within the block's area.
+     * \param data_size The size of the option's data.
+     * \param block The block the data belongs to.
+     */
+    PDUOption(option_type opt, size_t length, const data_type* data, 
+              size_t data_size, Internals::option_block& block) 
+    : option_(opt), size_(static_cast<uint16_t>(length)), real_size_(0),
+      shared_payload_(0) {
+        if (data_size <= small_buffer_size) {
+            set_payload_contents(data, data + data_size);
+        }
+        else {
+            if (data_size > 65535) {
+                throw option_payload_too_large();
+            }
+            payload_.big_buffer_ptr = const_cast<data_type*>(
+                block.share(data, shared_payload_)
+            );
+            real_size_ = static_cast<uint16_t>(data_size);
+        }
+    }
     
     /**
      * \brief Copy constructor.
      * \param rhs The PDUOption to be copied.
      */
-    PDUOption(const PDUOption& rhs) {
-        real_size_ = 0;
+    PDUOption(const PDUOption& rhs) 
+    : real_size_(0), shared_payload_(0) {
         *this = rhs;
     }
     
@@ -234,8 +306,8 @@ public:
      * \brief Move constructor.
      * \param rhs The PDUOption to be moved.
      */
-    PDUOption(PDUOption&& rhs) TINS_NOEXCEPT {
-        real_size_ = 0;
+    PDUOption(PDUOption&& rhs) TINS_NOEXCEPT 
+    : real_size_(0), shared_payload_(0) {
         *this = std::move(rhs);
     }
     
@@ -246,10 +318,10 @@ public:
     PDUOption& operator=(PDUOption&& rhs) TINS_NOEXCEPT {
         option_ = rhs.option_;
         size_ = rhs.size_;
-        if (real_size_ > small_buffer_size) {
-            delete[] payload_.big_buffer_ptr;
-        }
+        release_payload();
         real_size_ = rhs.real_size_;
+        shared_payload_ = rhs.shared_payload_;
+        rhs.shared_payload_ = 0;
         if (real_size_ > small_buffer_size) {
             payload_.big_buffer_ptr = 0;
             std::swap(payload_.big_buffer_ptr, rhs.payload_.big_buffer_ptr);
@@ -268,13 +340,23 @@ public:
      * \param rhs The PDUOption to be copied.
      */
     PDUOption& operator=(const PDUOption& rhs) {
+        if (this == &rhs) {
+            return *this;
+        }
         option_ = rhs.option_;
         size_ = rhs.size_;
-        if (real_size_ > small_buffer_size) {
-            delete[] payload_.big_buffer_ptr;
+        release_payload();
+        shared_payload_ = rhs.shared_payload_;
+        if (shared_payload_) {
+            // Shared data is never modified, so there's no need to copy it
+            Internals::acquire_option_buffer(shared_payload_);
+            real_size_ = rhs.real_size_;
+            payload_.big_buffer_ptr = rhs.payload_.big_buffer_ptr;
+        }
+        else {
+            real_size_ = rhs.real_size_;
+            set_payload_contents(rhs.data_ptr(), rhs.data_ptr() + rhs.data_size());
         }
-        real_size_ = rhs.real_size_;
-        set_payload_contents(rhs.data_ptr(), rhs.data_ptr() + rhs.data_size());
         return* this;
     }
     
@@ -282,9 +364,7 @@ public:
      * \brief Destructor.
      */
     ~PDUOption() {
-        if (real_size_ > small_buffer_size) {
-            delete[] payload_.big_buffer_ptr;
-        }
+        release_payload();
     }
     
     /**
@@ -297,7 +377,8 @@ public:
      */
     template<typename ForwardIterator>
     PDUOption(option_type opt, ForwardIterator start, ForwardIterator end) 
-    : option_(opt), size_(static_cast<uint16_t>(std::distance(start, end))) {
+    : option_(opt), size_(static_cast<uint16_t>(std::distance(start, end))),
+      shared_payload_(0) {
         set_payload_contents(start, end);
     }
     
@@ -318,7 +399,7 @@ public:
      */
     template<typename ForwardIterator>
     PDUOption(option_type opt, uint16_t length, ForwardIterator start, ForwardIterator end) 
-    : option_(opt), size_(length) {
+    : option_(opt), size_(length), shared_payload_(0) {
         set_payload_contents(start, end);
     }
     
@@ -390,6 +471,16 @@ public:
         return Internals::converter::convert<T>(*this);
     }
 private:
+    void release_payload() {
+        if (shared_payload_) {
+            Internals::release_option_buffer(shared_payload_);
+            shared_payload_ = 0;
+        }
+        else if (real_size_ > small_buffer_size) {
+            delete[] payload_.big_buffer_ptr;
+        }
+    }
+
     template<typename ForwardIterator>
     void set_payload_contents(ForwardIterator start, ForwardIterator end) {
         size_t total_size = std::distance(start, end);
@@ -419,6 +510,8 @@ private:
         data_type small_buffer[small_buffer_size];
         data_type* big_buffer_ptr;
     } payload_;
+    // The option block's copy big_buffer_ptr points into, if any
+    Internals::option_buffer* shared_payload_;
 };
 
 namespace Internals {
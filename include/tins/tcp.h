@@ -70,6 +70,13 @@ class OutputMemoryStream;
  * const RawPDU::payload_type& payload = raw.payload();
  * \endcode
  *
+ * Options read from a buffer are decoded the first time TCP::options or
+ * TCP::search_option is called. Although both are const, they modify the 
+ * object when they do so, so concurrent calls to them on the same TCP 
+ * object must be synchronized by the caller, or the options decoded 
+ * beforehand. Other const member functions, including the option getters
+ * such as TCP::mss, never modify the object.
+ *
  * \sa RawPDU
  */
 
@@ -245,10 +252,15 @@ public:
 
     /**
      * \brief Getter for the option list.
+     *
+     * The first call to this method decodes the options read from a 
+     * buffer. Since that modifies this PDU, concurrent calls on the same
+     * TCP object must be synchronized by the caller.
      * 
      * \return The options list.
      */
     const options_type& options() const {
+        parse_options();
         return options_;
     }
 
@@ -493,6 +505,7 @@ public:
          * \param option The option to be added.
          */
         void add_option(option &&opt) {
+            parse_options();
             options_.push_back(std::move(opt));
         }
 
@@ -506,6 +519,7 @@ public:
          */
         template <typename... Args>
         void add_option(Args&&... args) {
+            parse_options();
             options_.emplace_back(std::forward<Args>(args)...);
         }
     #endif
@@ -551,6 +565,11 @@ public:
 
     /**
      * \brief Searchs for an option that matchs the given type.
+     *
+     * This decodes the options read from a buffer if they weren't yet. 
+     * Since that modifies this PDU, concurrent calls on the same TCP 
+     * object must be synchronized by the caller.
+     *
      * \param type The option type to be searched.
      * \return A pointer to the option, or 0 if it was not found.
      */
@@ -612,9 +631,20 @@ private:
     } TINS_END_PACK;
 
     static const uint16_t DEFAULT_WINDOW;
+    static const uint32_t MAX_OPTIONS_SIZE = 40;
     
     template <typename T> 
     T generic_search(OptionTypes opt_type) const {
+        // Avoid decoding every option if they haven't been parsed yet
+        if (!options_parsed_) {
+            const uint8_t* data = 0;
+            uint32_t data_size = 0;
+            if (!find_raw_option(opt_type, data, data_size)) {
+                throw option_not_found();
+            }
+            return Internals::Converters::convert(data, data_size, endianness,
+                                                  Internals::type_to_type<T>());
+        }
         const option* opt = search_option(opt_type);
         if (!opt) {
             throw option_not_found();
@@ -626,13 +656,19 @@ private:
     void checksum(uint16_t new_check);
     uint32_t calculate_options_size() const;
     uint32_t pad_options_size(uint32_t size) const;
+    void parse_options() const;
+    bool find_raw_option(OptionTypes type, const uint8_t*& data, uint32_t& data_size) const;
     options_type::const_iterator search_option_iterator(OptionTypes type) const;
     options_type::iterator search_option_iterator(OptionTypes type);
     
     void write_option(const option& opt, Memory::OutputMemoryStream& stream);
 
-    options_type options_;
+    // Options are decoded from raw_options_ on first use
+    mutable options_type options_;
     tcp_header header_;
+    uint8_t raw_options_[MAX_OPTIONS_SIZE];
+    uint8_t raw_options_size_;
+    mutable bool options_parsed_;
 };
 
 } // Tins
@@ -42,8 +42,17 @@ namespace Tins {
 
 class PDU;
 
+namespace Memory {
+
+class InputMemoryStream;
+class OutputMemoryStream;
+
+} // Memory
+
 namespace TCPIP {
 
+struct SegmentInfo;
+
 /**
  * \brief Represents an acknowledged segment range
  *
@@ -111,11 +120,24 @@ public:
      */
     AckTracker(uint32_t initial_ack, bool use_sack = true);
 
+    /**
+     * \brief Constructs an instance from a previously serialized state
+     *
+     * \param input The stream to read the state from
+     * \sa AckTracker::serialize
+     */
+    AckTracker(Memory::InputMemoryStream& input);
+
     /**
      * \brief Process a packet
      */
     void process_packet(const PDU& packet);
 
+    /**
+     * \brief Process a segment scanned from a raw buffer
+     */
+    void process_segment(const SegmentInfo& segment);
+
     /**
      * \brief Indicates whether Selective ACKs should be processed
      */
@@ -138,6 +160,18 @@ public:
      * \param length The segment's length
      */
     bool is_segment_acked(uint32_t sequence_number, uint32_t length) const;
+
+    /**
+     * Retrieves the size this tracker's state takes once serialized
+     */
+    size_t serialized_size() const;
+
+    /**
+     * \brief Serializes this tracker's state
+     *
+     * \param output The stream to write the state to
+     */
+    void serialize(Memory::OutputMemoryStream& output) const;
 private:
     void process_sack(const std::vector<uint32_t>& sack);
     void cleanup_sacked_intervals(uint32_t old_ack, uint32_t new_ack);
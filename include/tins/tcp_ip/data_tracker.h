@@ -39,6 +39,13 @@
 #ifdef TINS_HAVE_TCPIP
 
 namespace Tins {
+namespace Memory {
+
+class InputMemoryStream;
+class OutputMemoryStream;
+
+} // Memory
+
 namespace TCPIP {
 
 /**
@@ -71,6 +78,14 @@ public:
      */
     DataTracker(uint32_t seq_number);
 
+    /**
+     * \brief Constructs an instance from a previously serialized state
+     *
+     * \param input The stream to read the state from
+     * \sa DataTracker::serialize
+     */
+    DataTracker(Memory::InputMemoryStream& input);
+
     /**
      * \brief Processes the given payload
      *
@@ -144,6 +159,18 @@ public:
      * Retrieves the total amount of buffered bytes
      */
     uint32_t total_buffered_bytes() const;
+
+    /**
+     * Retrieves the size this tracker's state takes once serialized
+     */
+    size_t serialized_size() const;
+
+    /**
+     * \brief Serializes this tracker's state, including all of its payload
+     *
+     * \param output The stream to write the state to
+     */
+    void serialize(Memory::OutputMemoryStream& output) const;
 private:
     void store_payload(uint32_t seq, payload_type payload);
     buffered_payload_type::iterator erase_iterator(buffered_payload_type::iterator iter);
@@ -50,6 +50,8 @@ class IPv6Address;
 
 namespace TCPIP {
 
+struct SegmentInfo;
+
 /**
  * \brief Represents an unidirectional TCP flow between 2 endpoints
  *
@@ -126,6 +128,16 @@ public:
     Flow(const IPv6Address& dst_address, uint16_t dst_port,
          uint32_t sequence_number);
 
+    /**
+     * \brief Constructs a Flow from a previously serialized state
+     *
+     * The constructed flow will have no callbacks set.
+     *
+     * \param input The stream to read the state from
+     * \sa Flow::serialize
+     */
+    Flow(Memory::InputMemoryStream& input);
+
     /**
      * \brief Sets the callback that will be executed when data is readable
      *
@@ -162,6 +174,17 @@ public:
      */
     void process_packet(PDU& pdu);
 
+    /**
+     * \brief Processes a segment scanned from a raw buffer.
+     *
+     * This behaves exactly like Flow::process_packet but doesn't require
+     * constructing a PDU chain.
+     *
+     * \param segment The segment to be processed
+     * \sa Flow::process_packet
+     */
+    void process_segment(const SegmentInfo& segment);
+
     /**
      * \brief Skip forward to a sequence number
      *
@@ -203,6 +226,14 @@ public:
      */
     bool packet_belongs(const PDU& packet) const;
 
+    /**
+     * \brief Indicates whether a segment belongs to this flow
+     *
+     * \param segment The segment to be checked
+     * \sa Flow::packet_belongs
+     */
+    bool segment_belongs(const SegmentInfo& segment) const;
+
     /**
      * \brief Retrieves the IPv4 destination address
      *
@@ -309,6 +340,21 @@ public:
      */
     AckTracker& ack_tracker();
     #endif // TINS_HAVE_ACK_TRACKER
+
+    /**
+     * Retrieves the size this flow's state takes once serialized
+     */
+    size_t serialized_size() const;
+
+    /**
+     * \brief Serializes this flow's state
+     *
+     * This includes the flow's addressing, its state, sequence numbers
+     * and all of its payload, but not its callbacks.
+     *
+     * \param output The stream to write the state to
+     */
+    void serialize(Memory::OutputMemoryStream& output) const;
 private:
     // Compress all flags into just one struct using bitfields 
     struct flags {
@@ -323,6 +369,9 @@ private:
     };
 
     void update_state(const TCP& tcp);
+    void update_state(uint8_t tcp_flags, uint32_t seq, uint32_t ack_seq, int mss,
+                      bool sack_permitted);
+    void process_payload(uint32_t seq, payload_type payload);
     void initialize();
 
     DataTracker data_tracker_;
@@ -0,0 +1,435 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_TCP_IP_FLOW_TABLE_H
+#define TINS_TCP_IP_FLOW_TABLE_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <iterator>
+#include <cstring>
+#include <stdint.h>
+#include <tins/tcp_ip/stream_identifier.h>
+
+namespace Tins {
+namespace TCPIP {
+
+/**
+ * \brief Hashes a StreamIdentifier
+ *
+ * Since StreamIdentifier already sorts both endpoints, packets flowing in
+ * either direction hash to the same value.
+ */
+struct StreamIdentifierHash {
+    size_t operator()(const StreamIdentifier& id) const {
+        uint64_t words[4];
+        std::memcpy(words, id.min_address.data(), 16);
+        std::memcpy(words + 2, id.max_address.data(), 16);
+        uint64_t output = (static_cast<uint64_t>(id.min_address_port) << 16) |
+                          id.max_address_port;
+        for (size_t i = 0; i < 4; ++i) {
+            output = mix(output ^ words[i]);
+        }
+        return static_cast<size_t>(output);
+    }
+
+    static uint64_t mix(uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdULL;
+        value ^= value >> 33;
+        value *= 0xc4ceb9fe1a85ec53ULL;
+        value ^= value >> 33;
+        return value;
+    }
+};
+
+/**
+ * \brief Bidirectional flow table keyed by StreamIdentifier
+ *
+ * This is an open addressing hash table that uses linear probing and
+ * backward shift deletion, so it doesn't need tombstones and lookups stay
+ * fast even after lots of flows have been removed. Entries are stored in a
+ * single contiguous array, meaning there's no per-flow allocation.
+ *
+ * Note that inserting or removing flows invalidates every iterator, pointer
+ * and reference to the entries in the table.
+ *
+ * \code
+ * FlowTable<uint64_t> packet_count;
+ * // For each packet
+ * packet_count[StreamIdentifier::make_identifier(pdu)]++;
+ * \endcode
+ */
+template <typename T>
+class FlowTable {
+public:
+    /**
+     * The type used as key
+     */
+    typedef StreamIdentifier key_type;
+
+    /**
+     * The type stored for each flow
+     */
+    typedef T mapped_type;
+
+    /**
+     * The type of each entry in the table
+     */
+    typedef std::pair<key_type, mapped_type> value_type;
+
+    /**
+     * The hash function used
+     */
+    typedef StreamIdentifierHash hasher;
+
+    /**
+     * \brief Forward iterator over the flows in a table
+     */
+    template <typename Entry>
+    class basic_iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Entry value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef Entry* pointer;
+        typedef Entry& reference;
+
+        basic_iterator(Entry* entry, const uint8_t* used, const uint8_t* used_end)
+        : entry_(entry), used_(used), used_end_(used_end) {
+            skip_unused();
+        }
+
+        template <typename OtherEntry>
+        basic_iterator(const basic_iterator<OtherEntry>& other)
+        : entry_(other.entry_), used_(other.used_), used_end_(other.used_end_) {
+
+        }
+
+        reference operator*() const {
+            return *entry_;
+        }
+
+        pointer operator->() const {
+            return entry_;
+        }
+
+        basic_iterator& operator++() {
+            ++entry_;
+            ++used_;
+            skip_unused();
+            return *this;
+        }
+
+        basic_iterator operator++(int) {
+            basic_iterator output = *this;
+            ++*this;
+            return output;
+        }
+
+        bool operator==(const basic_iterator& rhs) const {
+            return entry_ == rhs.entry_;
+        }
+
+        bool operator!=(const basic_iterator& rhs) const {
+            return entry_ != rhs.entry_;
+        }
+    private:
+        template <typename OtherEntry>
+        friend class basic_iterator;
+
+        void skip_unused() {
+            while (used_ != used_end_ && !*used_) {
+                ++entry_;
+                ++used_;
+            }
+        }
+
+        Entry* entry_;
+        const uint8_t* used_;
+        const uint8_t* used_end_;
+    };
+
+    /**
+     * The iterator type
+     */
+    typedef basic_iterator<value_type> iterator;
+
+    /**
+     * The const iterator type
+     */
+    typedef basic_iterator<const value_type> const_iterator;
+
+    /**
+     * \brief Constructs a flow table
+     *
+     * \param initial_capacity The amount of flows to reserve space for
+     */
+    FlowTable(size_t initial_capacity = 0)
+    : size_(0) {
+        allocate(capacity_for(initial_capacity));
+    }
+
+    /**
+     * \brief Finds the flow identified by the given key
+     *
+     * \return A pointer to the flow's value or 0 if it's not present
+     */
+    mapped_type* find(const key_type& key) {
+        const size_t index = find_index(key);
+        return index == npos ? 0 : &entries_[index].second;
+    }
+
+    /**
+     * \brief Finds the flow identified by the given key (const)
+     *
+     * \return A pointer to the flow's value or 0 if it's not present
+     */
+    const mapped_type* find(const key_type& key) const {
+        const size_t index = find_index(key);
+        return index == npos ? 0 : &entries_[index].second;
+    }
+
+    /**
+     * \brief Retrieves a flow, inserting a default constructed one if needed
+     */
+    mapped_type& operator[](const key_type& key) {
+        return insert(key).first;
+    }
+
+    /**
+     * \brief Retrieves a flow, inserting a default constructed one if needed
+     *
+     * \return A pair containing a reference to the flow's value and a bool
+     * indicating whether the flow was inserted.
+     */
+    std::pair<mapped_type&, bool> insert(const key_type& key) {
+        size_t index = find_index(key);
+        if (index != npos) {
+            return std::pair<mapped_type&, bool>(entries_[index].second, false);
+        }
+        if ((size_ + 1) * 4 > entries_.size() * 3) {
+            rehash(entries_.size() * 2);
+        }
+        index = bucket_for(key);
+        while (used_[index]) {
+            index = (index + 1) & mask_;
+        }
+        entries_[index] = value_type(key, mapped_type());
+        used_[index] = 1;
+        size_++;
+        return std::pair<mapped_type&, bool>(entries_[index].second, true);
+    }
+
+    /**
+     * \brief Removes the flow identified by the given key
+     *
+     * \return true iff the flow was present
+     */
+    bool erase(const key_type& key) {
+        const size_t index = find_index(key);
+        if (index == npos) {
+            return false;
+        }
+        erase_index(index);
+        return true;
+    }
+
+    /**
+     * \brief Removes every flow for which the given predicate returns true
+     *
+     * The predicate is called using the flow's key and value. It's allowed
+     * to be called more than once for the same flow as entries are moved 
+     * around, so it should not have side effects unless it returns true.
+     *
+     * \return The number of flows removed
+     */
+    template <typename Predicate>
+    size_t remove_if(Predicate predicate) {
+        size_t removed = 0;
+        size_t index = 0;
+        while (index < entries_.size()) {
+            // Backward shift deletion moves a later entry into this slot,
+            // so it has to be checked again
+            if (used_[index] && predicate(entries_[index].first, entries_[index].second)) {
+                erase_index(index);
+                removed++;
+            }
+            else {
+                index++;
+            }
+        }
+        return removed;
+    }
+
+    /**
+     * \brief Reserves space for the given amount of flows
+     */
+    void reserve(size_t count) {
+        const size_t capacity = capacity_for(count);
+        if (capacity > entries_.size()) {
+            rehash(capacity);
+        }
+    }
+
+    /**
+     * Removes all flows
+     */
+    void clear() {
+        std::fill(used_.begin(), used_.end(), 0);
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            entries_[i] = value_type();
+        }
+        size_ = 0;
+    }
+
+    /**
+     * Retrieves the amount of flows stored
+     */
+    size_t size() const {
+        return size_;
+    }
+
+    /**
+     * Indicates whether the table is empty
+     */
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    /**
+     * Retrieves the amount of slots allocated
+     */
+    size_t capacity() const {
+        return entries_.size();
+    }
+
+    iterator begin() {
+        return iterator(&entries_[0], &used_[0], &used_[0] + used_.size());
+    }
+
+    iterator end() {
+        return iterator(&entries_[0] + entries_.size(), 0, 0);
+    }
+
+    const_iterator begin() const {
+        return const_iterator(&entries_[0], &used_[0], &used_[0] + used_.size());
+    }
+
+    const_iterator end() const {
+        return const_iterator(&entries_[0] + entries_.size(), 0, 0);
+    }
+private:
+    static const size_t npos = static_cast<size_t>(-1);
+    static const size_t min_capacity = 16;
+
+    static size_t capacity_for(size_t count) {
+        size_t capacity = min_capacity;
+        while (capacity * 3 < count * 4) {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    void allocate(size_t capacity) {
+        entries_.assign(capacity, value_type());
+        used_.assign(capacity, 0);
+        mask_ = capacity - 1;
+    }
+
+    size_t bucket_for(const key_type& key) const {
+        return hasher()(key) & mask_;
+    }
+
+    size_t find_index(const key_type& key) const {
+        size_t index = bucket_for(key);
+        while (used_[index]) {
+            if (entries_[index].first == key) {
+                return index;
+            }
+            index = (index + 1) & mask_;
+        }
+        return npos;
+    }
+
+    void erase_index(size_t hole) {
+        size_t index = hole;
+        while (true) {
+            index = (index + 1) & mask_;
+            if (!used_[index]) {
+                break;
+            }
+            // Move this entry back unless its ideal bucket lies cyclically
+            // within (hole, index]
+            const size_t ideal = bucket_for(entries_[index].first);
+            if (((index - ideal) & mask_) >= ((index - hole) & mask_)) {
+                entries_[hole] = std::move(entries_[index]);
+                hole = index;
+            }
+        }
+        entries_[hole] = value_type();
+        used_[hole] = 0;
+        size_--;
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<value_type> old_entries;
+        std::vector<uint8_t> old_used;
+        old_entries.swap(entries_);
+        old_used.swap(used_);
+        allocate(capacity);
+        for (size_t i = 0; i < old_entries.size(); ++i) {
+            if (old_used[i]) {
+                size_t index = bucket_for(old_entries[i].first);
+                while (used_[index]) {
+                    index = (index + 1) & mask_;
+                }
+                entries_[index] = std::move(old_entries[i]);
+                used_[index] = 1;
+            }
+        }
+    }
+
+    std::vector<value_type> entries_;
+    std::vector<uint8_t> used_;
+    size_t size_;
+    size_t mask_;
+};
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
+
+#endif // TINS_TCP_IP_FLOW_TABLE_H
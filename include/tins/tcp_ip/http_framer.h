@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_TCP_IP_HTTP_FRAMER_H
+#define TINS_TCP_IP_HTTP_FRAMER_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <functional>
+#include <stdint.h>
+#include <tins/macros.h>
+
+namespace Tins {
+namespace TCPIP {
+
+/**
+ * \brief Incrementally splits an HTTP/1.x flow into messages
+ *
+ * This is meant to be used as a Stream payload consumer. Every time new data
+ * is available on the flow, it is handed to this framer which consumes as
+ * much as possible and keeps enough state so that nothing it has already 
+ * seen has to be scanned again. This means parsing a whole flow takes linear
+ * time regardless of how data was segmented.
+ *
+ * For each message, the headers callback is executed once using the
+ * start line and headers (including the empty line that ends them). Then the 
+ * body callback is executed zero or more times using consecutive pieces of the
+ * body, which is de-chunked if the chunked transfer encoding is used. Finally
+ * the message end callback is executed.
+ *
+ * Responses which don't specify a body length are considered to last until
+ * the connection is closed. Note that since the framer has no knowledge of the
+ * request that caused a response, responses to HEAD requests are not handled.
+ * A Content-Length too large to be represented puts the framer in an error
+ * state, as the body couldn't be framed correctly.
+ *
+ * \code
+ * HTTPFramer framer(HTTPFramer::REQUEST);
+ * framer.headers_callback([](const uint8_t* data, size_t size) {
+ *     // Process the request's headers
+ * });
+ * stream.client_payload_consumer(framer);
+ * \endcode
+ *
+ * \sa Stream::client_payload_consumer
+ */
+class TINS_API HTTPFramer {
+public:
+    /**
+     * The type of messages being framed
+     */
+    enum MessageType {
+        REQUEST,
+        RESPONSE
+    };
+
+    /**
+     * The type used for the headers and body callbacks
+     */
+    typedef std::function<void(const uint8_t*, size_t)> data_callback_type;
+
+    /**
+     * The type used for the message end callback
+     */
+    typedef std::function<void()> message_end_callback_type;
+
+    /**
+     * The maximum size of a message's headers, by default
+     */
+    static const size_t DEFAULT_MAX_HEADERS_SIZE;
+
+    /**
+     * \brief Constructs a framer
+     *
+     * \param type The type of messages this framer will process
+     */
+    HTTPFramer(MessageType type);
+
+    /**
+     * \brief Sets the callback executed when a message's headers are parsed
+     *
+     * \param callback The callback to be set
+     */
+    void headers_callback(const data_callback_type& callback);
+
+    /**
+     * \brief Sets the callback executed when a piece of a body is available
+     *
+     * \param callback The callback to be set
+     */
+    void body_callback(const data_callback_type& callback);
+
+    /**
+     * \brief Sets the callback executed when a message ends
+     *
+     * \param callback The callback to be set
+     */
+    void message_end_callback(const message_end_callback_type& callback);
+
+    /**
+     * \brief Sets the maximum size of a message's headers
+     *
+     * If a message's headers are larger than this, the framer enters an error
+     * state and discards all further data.
+     *
+     * \param value The value to be set
+     */
+    void max_headers_size(size_t value);
+
+    /**
+     * \brief Consumes data
+     *
+     * \param data The available data
+     * \param size The size of the available data
+     * \return The amount of bytes consumed. Bytes that weren't consumed must be
+     * provided again on the next call, followed by any new data
+     */
+    size_t operator()(const uint8_t* data, size_t size);
+
+    /**
+     * Indicates whether invalid data was found
+     */
+    bool has_error() const;
+private:
+    enum State {
+        HEADERS,
+        BODY,
+        BODY_UNTIL_CLOSE,
+        CHUNK_SIZE,
+        CHUNK_DATA,
+        CHUNK_DATA_END,
+        CHUNK_TRAILERS,
+        FRAMING_ERROR
+    };
+
+    size_t find_sequence(const uint8_t* data, size_t size, const char* sequence,
+                         size_t sequence_size);
+    void process_headers(const uint8_t* data, size_t size);
+    void notify_body(const uint8_t* data, size_t size);
+    void finish_message();
+
+    data_callback_type on_headers_;
+    data_callback_type on_body_;
+    message_end_callback_type on_message_end_;
+    size_t max_headers_size_;
+    uint64_t remaining_;
+    size_t scanned_;
+    MessageType type_;
+    State state_;
+};
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
+
+#endif // TINS_TCP_IP_HTTP_FRAMER_H
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_TCP_IP_PAYLOAD_SPILL_H
+#define TINS_TCP_IP_PAYLOAD_SPILL_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <vector>
+#include <memory>
+#include <cstdio>
+#include <stdint.h>
+#include <tins/macros.h>
+
+namespace Tins {
+namespace TCPIP {
+
+/**
+ * \brief Stores reassembled payload on a temporary file
+ *
+ * This is used by Stream to keep the resident memory of a flow bounded when
+ * its payloads are not automatically cleaned up. Bytes are only ever appended
+ * and they can later be read back at any offset.
+ *
+ * The backing file is created lazily on the first append and is removed
+ * automatically once the last instance referencing it is destroyed. Note that
+ * copies of a PayloadSpill share the same backing file along with its size,
+ * so data appended through any of them is visible to all of them.
+ *
+ * \sa Stream::spill_payloads
+ */
+class TINS_API PayloadSpill {
+public:
+    /**
+     * Default constructs an empty spill
+     */
+    PayloadSpill();
+
+    /**
+     * \brief Appends data at the end of this spill
+     *
+     * \param data The data to be appended
+     * \param size The amount of bytes to be appended
+     */
+    void append(const uint8_t* data, size_t size);
+
+    /**
+     * \brief Reads data stored on this spill
+     *
+     * \param offset The offset from which to start reading
+     * \param buffer The buffer in which to store the read data
+     * \param size The maximum amount of bytes to read
+     * \return The amount of bytes actually read
+     */
+    size_t read(uint64_t offset, uint8_t* buffer, size_t size) const;
+
+    /**
+     * Retrieves the amount of bytes stored on this spill
+     */
+    uint64_t size() const;
+
+    /**
+     * Indicates whether this spill is empty
+     */
+    bool empty() const;
+
+    /**
+     * \brief Discards all of the data stored on this spill
+     *
+     * This releases the backing file.
+     */
+    void clear();
+private:
+    struct Storage;
+
+    std::shared_ptr<Storage> storage_;
+};
+
+/**
+ * \brief Sequentially reads a flow's spilled and resident payload
+ *
+ * The spilled bytes are always older than the ones still kept in memory, so
+ * this reader first yields the contents of the PayloadSpill and then the
+ * contents of the in-memory payload.
+ *
+ * The reader keeps references to both objects, so it must not outlive them.
+ *
+ * \sa Stream::client_payload_reader
+ * \sa Stream::server_payload_reader
+ */
+class TINS_API PayloadReader {
+public:
+    /**
+     * The type used to store in-memory payloads
+     */
+    typedef std::vector<uint8_t> payload_type;
+
+    /**
+     * \brief Constructs a reader
+     *
+     * \param spill The spilled payload
+     * \param payload The in-memory payload
+     */
+    PayloadReader(const PayloadSpill& spill, const payload_type& payload);
+
+    /**
+     * \brief Reads the next chunk of data
+     *
+     * \param buffer The buffer in which to store the read data
+     * \param size The maximum amount of bytes to read
+     * \return The amount of bytes read. This will only be 0 if there's no
+     * data left to read
+     */
+    size_t read(uint8_t* buffer, size_t size);
+
+    /**
+     * Retrieves the total amount of bytes this reader can provide
+     */
+    uint64_t size() const;
+
+    /**
+     * Retrieves the amount of bytes read so far
+     */
+    uint64_t position() const;
+
+    /**
+     * Indicates whether all of the data has been read
+     */
+    bool eof() const;
+private:
+    const PayloadSpill* spill_;
+    const payload_type* payload_;
+    uint64_t position_;
+};
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
+
+#endif // TINS_TCP_IP_PAYLOAD_SPILL_H
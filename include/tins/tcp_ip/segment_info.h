@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_TCP_IP_SEGMENT_INFO_H
+#define TINS_TCP_IP_SEGMENT_INFO_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <array>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/hw_address.h>
+
+namespace Tins {
+namespace TCPIP {
+
+/**
+ * \brief Describes a TCP segment without constructing a PDU chain
+ *
+ * This contains every field needed to follow a TCP stream. Instances are
+ * filled in by scanning raw packet buffers using SegmentInfo::scan_ip or
+ * SegmentInfo::scan_ethernet, and can then be fed into
+ * StreamFollower::process_segment.
+ *
+ * Note that the payload and SACK pointers point into the scanned buffer, so
+ * a SegmentInfo must not outlive it.
+ *
+ * \code
+ * SegmentInfo segment;
+ * if (segment.scan_ethernet(buffer, buffer_size)) {
+ *     follower.process_segment(segment, timestamp);
+ * }
+ * \endcode
+ */
+struct TINS_API SegmentInfo {
+    /**
+     * The type used to store addresses. This matches StreamIdentifier's
+     */
+    typedef std::array<uint8_t, 16> address_type;
+
+    /**
+     * The type used to store hardware addresses
+     */
+    typedef HWAddress<6> hwaddress_type;
+
+    /**
+     * Default constructor
+     */
+    SegmentInfo();
+
+    /**
+     * \brief Scans a buffer starting at an IPv4 or IPv6 header
+     *
+     * Fragmented packets and packets that don't carry TCP are rejected.
+     *
+     * \param buffer The buffer to be scanned
+     * \param total_sz The size of the buffer
+     * \return true iff the buffer contains a TCP segment
+     */
+    bool scan_ip(const uint8_t* buffer, uint32_t total_sz);
+
+    /**
+     * \brief Scans a buffer starting at an Ethernet II header
+     *
+     * 802.1Q/802.1ad tags are skipped. The hardware addresses are filled in
+     * and then the rest of the buffer is scanned using SegmentInfo::scan_ip.
+     *
+     * \param buffer The buffer to be scanned
+     * \param total_sz The size of the buffer
+     * \return true iff the buffer contains a TCP segment
+     */
+    bool scan_ethernet(const uint8_t* buffer, uint32_t total_sz);
+
+    /**
+     * \brief Checks whether the given flags are set
+     *
+     * \param check_flags The TCP::Flags to check
+     */
+    bool has_flags(uint8_t check_flags) const {
+        return (flags & check_flags) == check_flags;
+    }
+
+    address_type src_addr;
+    address_type dst_addr;
+    hwaddress_type src_hw_addr;
+    hwaddress_type dst_hw_addr;
+    bool is_v6;
+    uint16_t sport;
+    uint16_t dport;
+    uint32_t seq;
+    uint32_t ack_seq;
+    uint8_t flags;
+    // The MSS option's value, or -1 if not present
+    int mss;
+    bool sack_permitted;
+    // The SACK option's edges, as found on the wire
+    const uint8_t* sack;
+    uint32_t sack_size;
+    const uint8_t* payload;
+    uint32_t payload_size;
+private:
+    bool scan_tcp(const uint8_t* buffer, uint32_t total_sz);
+};
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
+
+#endif // TINS_TCP_IP_SEGMENT_INFO_H
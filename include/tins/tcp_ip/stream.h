@@ -44,6 +44,7 @@
 #include <tins/hw_address.h>
 #include <tins/config.h>
 #include <tins/tcp_ip/flow.h>
+#include <tins/tcp_ip/payload_spill.h>
 #ifdef TINS_HAVE_TCP_STREAM_CUSTOM_DATA
     #include <boost/any.hpp>
 #endif
@@ -57,6 +58,8 @@ class IPv6Address;
 
 namespace TCPIP {
 
+struct SegmentInfo;
+
 /** 
  * \brief Represents a TCP stream
  *
@@ -99,6 +102,16 @@ public:
                                uint32_t,
                                const payload_type&)> stream_packet_callback_type;
 
+    /**
+     * \brief The type used for payload consumers
+     *
+     * The arguments are the flow's unconsumed payload and its size. The return
+     * value is the amount of bytes consumed.
+     *
+     * \sa Stream::client_payload_consumer
+     */
+    typedef std::function<size_t(const uint8_t*, size_t)> payload_consumer_type;
+
     /**
      * The type used to store hardware addresses
      */
@@ -113,6 +126,26 @@ public:
      */
     Stream(PDU& initial_packet, const timestamp_type& ts = timestamp_type());
 
+    /**
+     * \brief Constructs a TCP stream using the provided segment.
+     * 
+     * \param initial_segment The first segment of the stream
+     * \param ts The first segment's timestamp
+     */
+    Stream(const SegmentInfo& initial_segment, const timestamp_type& ts = timestamp_type());
+
+    /**
+     * \brief Constructs a TCP stream from a previously serialized state.
+     *
+     * The constructed stream will have no callbacks set and will use the
+     * default settings. Stream::setup_flows_callbacks has to be called once
+     * the stream is stored in its final location.
+     *
+     * \param input The stream to read the state from
+     * \sa Stream::serialize
+     */
+    Stream(Memory::InputMemoryStream& input);
+
     /**
      * \brief Processes this packet.
      *
@@ -134,6 +167,27 @@ public:
      */
     void process_packet(PDU& packet);
 
+    /**
+     * \brief Processes a segment scanned from a raw buffer.
+     *
+     * This will forward the segment appropriately to the client
+     * or server flow.
+     *
+     * \param segment The segment to be processed
+     * \param ts The segment's timestamp
+     */
+    void process_segment(const SegmentInfo& segment, const timestamp_type& ts);
+
+    /**
+     * \brief Processes a segment scanned from a raw buffer.
+     *
+     * This will forward the segment appropriately to the client
+     * or server flow.
+     *
+     * \param segment The segment to be processed
+     */
+    void process_segment(const SegmentInfo& segment);
+
     /**
      * Getter for the client flow
      */
@@ -296,6 +350,34 @@ public:
      */
     void server_out_of_order_callback(const stream_packet_callback_type& callback);
 
+    /**
+     * \brief Sets the consumer of the client's payload
+     *
+     * Whenever there's new client data, the consumer is executed using all of
+     * the client's payload that hasn't been consumed yet and returns how many
+     * bytes it consumed. Those bytes are then removed from the payload, so the
+     * next time the consumer is executed it will only see the bytes it didn't
+     * consume followed by the new ones. This allows parsing application layer
+     * protocols incrementally without ever scanning the same data twice.
+     *
+     * The consumer is executed before the client data callback. While a
+     * consumer is set, unconsumed bytes are always kept on the payload, 
+     * regardless of Stream::auto_cleanup_client_data.
+     *
+     * \param consumer The consumer to be set
+     * \sa HTTPFramer
+     * \sa TLSRecordFramer
+     */
+    void client_payload_consumer(const payload_consumer_type& consumer);
+
+    /**
+     * \brief Sets the consumer of the server's payload
+     *
+     * \param consumer The consumer to be set
+     * \sa Stream::client_payload_consumer
+     */
+    void server_payload_consumer(const payload_consumer_type& consumer);
+
     /**
      * \brief Indicates that the data packets sent by the client should be 
      * ignored
@@ -357,6 +439,73 @@ public:
      */
     void auto_cleanup_server_data(bool value);
 
+    /**
+     * \brief Sets the threshold above which each flow's payload is spilled to disk
+     *
+     * This is only meaningful when payloads are not automatically erased. Whenever
+     * a flow's in-memory payload reaches this amount of bytes, after the data
+     * callback is executed, its contents are appended to a temporary file and the
+     * in-memory payload is cleared. This keeps the memory used by long lived, high
+     * volume streams bounded while still preserving all of their data.
+     *
+     * Use Stream::client_payload_reader/Stream::server_payload_reader to read the
+     * whole reassembled payload, including the spilled part.
+     *
+     * A threshold of 0 disables spilling, which is the default.
+     *
+     * \param threshold The amount of bytes above which payloads are spilled
+     * \sa auto_cleanup_payloads
+     */
+    void spill_payloads(uint32_t threshold);
+
+    /**
+     * \brief Sets the threshold above which the client's payload is spilled to disk
+     *
+     * \sa spill_payloads
+     */
+    void spill_client_data(uint32_t threshold);
+
+    /**
+     * \brief Sets the threshold above which the server's payload is spilled to disk
+     *
+     * \sa spill_payloads
+     */
+    void spill_server_data(uint32_t threshold);
+
+    /**
+     * Getter for the client's spilled payload (const)
+     */
+    const PayloadSpill& client_spilled_payload() const;
+
+    /**
+     * Getter for the client's spilled payload
+     */
+    PayloadSpill& client_spilled_payload();
+
+    /**
+     * Getter for the server's spilled payload (const)
+     */
+    const PayloadSpill& server_spilled_payload() const;
+
+    /**
+     * Getter for the server's spilled payload
+     */
+    PayloadSpill& server_spilled_payload();
+
+    /**
+     * \brief Creates a reader for all of the client's payload
+     *
+     * The reader yields the spilled payload followed by the in-memory one.
+     */
+    PayloadReader client_payload_reader() const;
+
+    /**
+     * \brief Creates a reader for all of the server's payload
+     *
+     * The reader yields the spilled payload followed by the in-memory one.
+     */
+    PayloadReader server_payload_reader() const;
+
     /**
      * Enables tracking of acknowledged segments
      *
@@ -423,9 +572,31 @@ public:
      * packet that is outside of the recovery window.
      */
     bool is_recovery_mode_enabled() const;
+
+    /**
+     * Retrieves the size this stream's state takes once serialized
+     */
+    size_t serialized_size() const;
+
+    /**
+     * \brief Serializes this stream's state
+     *
+     * This includes both flows, the endpoints' hardware addresses and the 
+     * stream's timestamps. Callbacks, payload consumers, recovery mode and 
+     * any user data are not serialized.
+     *
+     * Streams that have spilled payloads to disk can't be serialized, as 
+     * their spilled data would be lost. An unserializable_stream exception 
+     * is thrown in that case.
+     *
+     * \param output The stream to write the state to
+     */
+    void serialize(Memory::OutputMemoryStream& output) const;
 private:
     static Flow extract_client_flow(const PDU& packet);
     static Flow extract_server_flow(const PDU& packet);
+    static Flow extract_client_flow(const SegmentInfo& segment);
+    static Flow extract_server_flow(const SegmentInfo& segment);
 
     void on_client_flow_data(const Flow& flow);
     void on_server_flow_data(const Flow& flow);
@@ -445,6 +616,10 @@ private:
                                              const stream_packet_callback_type& original_callback);
     static bool recovery_mode_handler(Flow& flow, uint32_t sequence_number,
                                       uint32_t recovery_sequence_number_end);
+    static void spill_payload(payload_type& payload, PayloadSpill& spill,
+                              uint32_t threshold);
+    static void consume_payload(payload_type& payload,
+                                const payload_consumer_type& consumer);
 
     Flow client_flow_;
     Flow server_flow_;
@@ -453,6 +628,8 @@ private:
     stream_callback_type on_server_data_callback_;
     stream_packet_callback_type on_client_out_of_order_callback_;
     stream_packet_callback_type on_server_out_of_order_callback_;
+    payload_consumer_type client_payload_consumer_;
+    payload_consumer_type server_payload_consumer_;
     hwaddress_type client_hw_addr_;
     hwaddress_type server_hw_addr_;
     timestamp_type create_time_;
@@ -460,6 +637,10 @@ private:
     bool auto_cleanup_client_;
     bool auto_cleanup_server_;
     bool is_partial_stream_;
+    uint32_t client_spill_threshold_;
+    uint32_t server_spill_threshold_;
+    PayloadSpill client_spill_;
+    PayloadSpill server_spill_;
     unsigned directions_recovery_mode_enabled_;
 
     #ifdef TINS_HAVE_TCP_STREAM_CUSTOM_DATA
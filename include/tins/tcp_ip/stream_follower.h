@@ -35,6 +35,7 @@
 #ifdef TINS_HAVE_TCPIP
 
 #include <map>
+#include <vector>
 #include <tins/tcp_ip/stream.h>
 #include <tins/tcp_ip/stream_identifier.h>
 
@@ -48,6 +49,8 @@ class Packet;
 
 namespace TCPIP {
 
+struct SegmentInfo;
+
 /**
  * \brief Represents a class that follows TCP and reassembles streams
  *
@@ -130,6 +133,29 @@ public:
      */
     void process_packet(Packet& packet);
 
+    /** 
+     * \brief Processes a segment scanned from a raw buffer
+     *
+     * This behaves like StreamFollower::process_packet, but works on a
+     * SegmentInfo so no PDU needs to be constructed. This is useful when 
+     * packets are only captured to reassemble streams.
+     *
+     * The current time is used as the segment's timestamp.
+     *
+     * \param segment The segment to be processed
+     * \sa SegmentInfo::scan_ethernet
+     */
+    void process_segment(const SegmentInfo& segment);
+
+    /** 
+     * \brief Processes a segment scanned from a raw buffer
+     *
+     * \param segment The segment to be processed
+     * \param ts The segment's timestamp
+     * \sa StreamFollower::process_segment
+     */
+    void process_segment(const SegmentInfo& segment, const Stream::timestamp_type& ts);
+
     /**
      * \brief Sets the callback to be executed when a new stream is captured.
      *
@@ -205,9 +231,44 @@ public:
      * \sa Stream::enable_recovery_mode
      */
     void follow_partial_streams(bool value);
+
+    /**
+     * \brief Serializes the state of every stream being followed
+     *
+     * The returned buffer contains the flows' states, sequence numbers and 
+     * buffered payloads of every stream. It can later be given to 
+     * StreamFollower::restore, potentially on a different process, to keep
+     * following these streams.
+     *
+     * Streams that have spilled payloads to disk can't be checkpointed. If
+     * any of them did, an unserializable_stream exception is thrown.
+     *
+     * \sa Stream::serialize
+     */
+    std::vector<uint8_t> checkpoint() const;
+
+    /**
+     * \brief Restores streams from a checkpoint
+     *
+     * Restored streams are added to the ones being followed, replacing any
+     * stream having the same identifier. Since callbacks can't be serialized,
+     * the new stream callback is executed for every restored stream so they 
+     * can be configured again.
+     *
+     * If the checkpoint is invalid, an invalid_checkpoint exception is thrown
+     * and no streams are restored.
+     *
+     * \param buffer The buffer containing the checkpoint
+     * \param total_sz The size of the buffer
+     * \sa StreamFollower::checkpoint
+     */
+    void restore(const uint8_t* buffer, size_t total_sz);
 private:
     typedef Stream::timestamp_type timestamp_type;
 
+    static const uint32_t CHECKPOINT_MAGIC;
+    static const uint8_t CHECKPOINT_VERSION;
+
     static const size_t DEFAULT_MAX_BUFFERED_CHUNKS;
     static const size_t DEFAULT_MAX_SACKED_INTERVALS;
     static const uint32_t DEFAULT_MAX_BUFFERED_BYTES;
@@ -217,6 +278,9 @@ private:
 
     Stream& find_stream(const stream_id& id);
     void process_packet(PDU& packet, const timestamp_type& ts);
+    streams_type::iterator track_stream(const stream_id& identifier, Stream stream,
+                                        bool assume_established);
+    void check_stream_termination(streams_type::iterator iter, const timestamp_type& ts);
     void cleanup_streams(const timestamp_type& now);
 
     streams_type streams_;
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_TCP_IP_TLS_RECORD_FRAMER_H
+#define TINS_TCP_IP_TLS_RECORD_FRAMER_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <functional>
+#include <stdint.h>
+#include <tins/macros.h>
+
+namespace Tins {
+namespace TCPIP {
+
+/**
+ * \brief Incrementally splits a TLS flow into records
+ *
+ * This is meant to be used as a Stream payload consumer. Records are only
+ * consumed once they're complete, at which point the record callback is
+ * executed using the record's content type, protocol version and fragment.
+ *
+ * If something that doesn't look like a TLS record is found, the framer enters
+ * an error state and discards all further data.
+ *
+ * \code
+ * TLSRecordFramer framer;
+ * framer.record_callback([](uint8_t type, uint16_t version, 
+ *                           const uint8_t* fragment, size_t size) {
+ *     if (type == TLSRecordFramer::HANDSHAKE) {
+ *         // Process handshake message(s)
+ *     }
+ * });
+ * stream.client_payload_consumer(framer);
+ * \endcode
+ *
+ * \sa Stream::client_payload_consumer
+ */
+class TINS_API TLSRecordFramer {
+public:
+    /**
+     * The record content types
+     */
+    enum ContentType {
+        CHANGE_CIPHER_SPEC = 20,
+        ALERT = 21,
+        HANDSHAKE = 22,
+        APPLICATION_DATA = 23,
+        HEARTBEAT = 24
+    };
+
+    /**
+     * \brief The type used for the record callback
+     *
+     * The arguments are the content type, the protocol version and the record's
+     * fragment.
+     */
+    typedef std::function<void(uint8_t, uint16_t, const uint8_t*, size_t)> record_callback_type;
+
+    /**
+     * The size of a record header
+     */
+    static const size_t RECORD_HEADER_SIZE;
+
+    /**
+     * The maximum size of a record's fragment (2^14 + 2048)
+     */
+    static const size_t MAX_FRAGMENT_SIZE;
+
+    /**
+     * Default constructor
+     */
+    TLSRecordFramer();
+
+    /**
+     * \brief Sets the callback executed for every record
+     *
+     * \param callback The callback to be set
+     */
+    void record_callback(const record_callback_type& callback);
+
+    /**
+     * \brief Consumes data
+     *
+     * \param data The available data
+     * \param size The size of the available data
+     * \return The amount of bytes consumed. Bytes that weren't consumed must be
+     * provided again on the next call, followed by any new data
+     */
+    size_t operator()(const uint8_t* data, size_t size);
+
+    /**
+     * Indicates whether invalid data was found
+     */
+    bool has_error() const;
+private:
+    record_callback_type on_record_;
+    bool has_error_;
+};
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
+
+#endif // TINS_TCP_IP_TLS_RECORD_FRAMER_H
@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_TCP_IP_UDP_FLOW_TRACKER_H
+#define TINS_TCP_IP_UDP_FLOW_TRACKER_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <chrono>
+#include <functional>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/tcp_ip/flow_table.h>
+#include <tins/tcp_ip/stream_identifier.h>
+
+namespace Tins {
+
+class PDU;
+class IPv4Address;
+class IPv6Address;
+class Packet;
+
+namespace TCPIP {
+
+/**
+ * \brief Summary of a UDP flow, similar to a bidirectional NetFlow/IPFIX record
+ *
+ * The client is the endpoint that sent the first packet seen on the flow.
+ * Byte counters include the network layer header.
+ */
+struct TINS_API UDPFlowRecord {
+    /**
+     * The type used to represent timestamps
+     */
+    typedef std::chrono::microseconds timestamp_type;
+
+    /**
+     * The type used to store addresses
+     */
+    typedef StreamIdentifier::address_type address_type;
+
+    /**
+     * The reason why a flow record was exported
+     */
+    enum EndReason {
+        IDLE_TIMEOUT, ///< No packets were seen during the idle timeout
+        FORCED_END    ///< The flow was flushed by the user
+    };
+
+    UDPFlowRecord();
+
+    /**
+     * Retrieves the client's IPv4 address. Only valid if is_v6 == false
+     */
+    IPv4Address client_addr_v4() const;
+
+    /**
+     * Retrieves the client's IPv6 address. Only valid if is_v6 == true
+     */
+    IPv6Address client_addr_v6() const;
+
+    /**
+     * Retrieves the server's IPv4 address. Only valid if is_v6 == false
+     */
+    IPv4Address server_addr_v4() const;
+
+    /**
+     * Retrieves the server's IPv6 address. Only valid if is_v6 == true
+     */
+    IPv6Address server_addr_v6() const;
+
+    address_type client_addr;
+    address_type server_addr;
+    uint16_t client_port;
+    uint16_t server_port;
+    bool is_v6;
+    timestamp_type first_seen;
+    timestamp_type last_seen;
+    uint64_t client_packets;
+    uint64_t client_bytes;
+    uint64_t server_packets;
+    uint64_t server_bytes;
+    EndReason end_reason;
+};
+
+/**
+ * \brief Tracks UDP flows and keeps per flow counters
+ *
+ * Each packet processed is matched to a bidirectional flow identified by a
+ * StreamIdentifier. Flows for which no packets are seen during the idle 
+ * timeout are removed and, if an export callback is set, exported as a
+ * UDPFlowRecord.
+ *
+ * Flows are kept on a FlowTable and store just their counters, timestamps
+ * and a couple of flags on top of their identifier, so this scales to
+ * millions of concurrent flows.
+ *
+ * \code
+ * UDPFlowTracker tracker;
+ * tracker.flow_export_callback([](const UDPFlowRecord& record) {
+ *     // Store the record somewhere
+ * });
+ * // For each packet
+ * tracker.process_packet(packet);
+ * \endcode
+ */
+class TINS_API UDPFlowTracker {
+public:
+    /**
+     * The type used to represent timestamps
+     */
+    typedef UDPFlowRecord::timestamp_type timestamp_type;
+
+    /**
+     * The type used to identify flows
+     */
+    typedef StreamIdentifier flow_id;
+
+    /**
+     * The type used for flow export callbacks
+     */
+    typedef std::function<void(const UDPFlowRecord&)> export_callback_type;
+
+    /**
+     * \brief The per flow state
+     */
+    struct flow_state {
+        flow_state()
+        : first_seen(0), last_seen(0), packets(), bytes(), client_is_min(0),
+          is_v6(0) {
+
+        }
+
+        timestamp_type first_seen;
+        timestamp_type last_seen;
+        // Indexed by direction: 0 means sent by the endpoint stored as 
+        // StreamIdentifier::min_address
+        uint64_t packets[2];
+        uint64_t bytes[2];
+        uint8_t client_is_min:1,
+                is_v6:1;
+    };
+
+    /**
+     * The type of the table used to store flows
+     */
+    typedef FlowTable<flow_state> table_type;
+
+    /**
+     * Default constructor
+     */
+    UDPFlowTracker();
+
+    /**
+     * \brief Processes a packet using the current time as its timestamp
+     *
+     * Packets that don't contain UDP are ignored.
+     *
+     * \param packet The packet to be processed
+     */
+    void process_packet(PDU& packet);
+
+    /**
+     * \brief Processes a packet
+     *
+     * Packets that don't contain UDP are ignored.
+     *
+     * \param packet The packet to be processed
+     */
+    void process_packet(Packet& packet);
+
+    /**
+     * \brief Sets the callback to be executed when a flow is exported
+     *
+     * \param callback The callback to be set
+     */
+    void flow_export_callback(const export_callback_type& callback);
+
+    /**
+     * \brief Sets the maximum time a flow will be kept without seeing packets
+     * that belong to it.
+     *
+     * \param timeout The idle timeout
+     */
+    template <typename Rep, typename Period>
+    void idle_timeout(const std::chrono::duration<Rep, Period>& timeout) {
+        idle_timeout_ = timeout;
+    }
+
+    /**
+     * \brief Reserves space for the given amount of flows
+     */
+    void reserve(size_t flow_count);
+
+    /**
+     * \brief Builds the record for the flow identified by the given arguments.
+     *
+     * The flow is looked up regardless of which endpoint is the client.
+     *
+     * \param client_addr The client's address
+     * \param client_port The client's port
+     * \param server_addr The server's address
+     * \param server_addr The server's port
+     */
+    UDPFlowRecord find_flow(const IPv4Address& client_addr, uint16_t client_port,
+                            const IPv4Address& server_addr, uint16_t server_port) const;
+
+    /**
+     * \brief Builds the record for the flow identified by the given arguments.
+     *
+     * The flow is looked up regardless of which endpoint is the client.
+     *
+     * \param client_addr The client's address
+     * \param client_port The client's port
+     * \param server_addr The server's address
+     * \param server_addr The server's port
+     */
+    UDPFlowRecord find_flow(const IPv6Address& client_addr, uint16_t client_port,
+                            const IPv6Address& server_addr, uint16_t server_port) const;
+
+    /**
+     * \brief Exports and removes every flow being tracked
+     */
+    void flush();
+
+    /**
+     * Retrieves the number of flows being tracked
+     */
+    size_t flow_count() const;
+
+    /**
+     * Retrieves the table in which flows are stored
+     */
+    const table_type& flows() const;
+
+    /**
+     * \brief Builds the record for a flow in the table
+     *
+     * \param id The flow's identifier
+     * \param state The flow's state
+     * \param reason The reason to be set on the record
+     */
+    static UDPFlowRecord make_record(const flow_id& id, const flow_state& state,
+                                     UDPFlowRecord::EndReason reason);
+private:
+    static const timestamp_type DEFAULT_IDLE_TIMEOUT;
+
+    void process_packet(PDU& packet, const timestamp_type& ts);
+    UDPFlowRecord find_flow(const flow_id& id) const;
+    void cleanup_flows(const timestamp_type& now);
+
+    table_type flows_;
+    export_callback_type on_flow_export_;
+    timestamp_type idle_timeout_;
+    timestamp_type last_cleanup_;
+};
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
+
+#endif // TINS_TCP_IP_UDP_FLOW_TRACKER_H
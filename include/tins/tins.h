@@ -31,9 +31,13 @@
 #define TINS_TINS_H
 
 #include <tins/dns.h>
+#include <tins/dns_builder.h>
+#include <tins/dns_name_table.h>
+#include <tins/dns_transaction_tracker.h>
 #include <tins/arp.h>
 #include <tins/bootp.h>
 #include <tins/dhcp.h>
+#include <tins/dhcp_lease_tracker.h>
 #include <tins/eapol.h>
 #include <tins/ethernetII.h>
 #include <tins/ieee802_3.h>
@@ -63,6 +67,8 @@
 #include <tins/tcp_stream.h>
 #endif
 #include <tins/crypto.h>
+#include <tins/wpa2_parallel_decrypter.h>
+#include <tins/wpa2_pmk.h>
 #include <tins/pdu_cacher.h>
 #include <tins/rsn_information.h>
 #include <tins/ipv6_address.h>
@@ -91,6 +91,17 @@ public:
      */
     RadioTapParser(const std::vector<uint8_t>& buffer);
 
+    /**
+     * \brief Constructs a RadioTap parser around a raw buffer
+     *
+     * The buffer must start at the first present flags word, just like
+     * the vector based constructor. It is not copied either.
+     *
+     * \param buffer The buffer to be parsed
+     * \param total_sz The size of the buffer
+     */
+    RadioTapParser(const uint8_t* buffer, uint32_t total_sz);
+
     /**
      * Gets the current namespace being parsed
      */
@@ -167,6 +178,24 @@ public:
      */
     bool has_field(RadioTap::PresentFlags flag) const;
 private:
+    /**
+     * Offsets of every field in the first namespace, relative to the start
+     * of the present flags. These only depend on the present flags, so
+     * they're computed once per flags value and cached.
+     */
+    struct FieldLayout {
+        uint32_t present;
+        uint32_t present_count;
+        uint16_t offsets[32];
+    };
+
+    static const uint16_t FIELD_NOT_PRESENT;
+
+    static void build_layout(FieldLayout& layout, uint32_t present,
+                             uint32_t present_count);
+
+    void initialize(const uint8_t* buffer, uint32_t total_sz);
+    void load_layout();
     const uint8_t* find_options_start() const;
     bool advance_to_first_field();
     bool advance_to_next_field();
@@ -183,6 +212,7 @@ private:
     uint32_t current_flags_;
     uint32_t namespace_index_;
     NamespaceType current_namespace_;
+    FieldLayout layout_;
 };
 
 } // Utils
@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/config.h>
+
+#if !defined(TINS_WPA2_PARALLEL_DECRYPTER_H) && defined(TINS_HAVE_WPA2_CALLBACKS)
+#define TINS_WPA2_PARALLEL_DECRYPTER_H
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <exception>
+#include <tins/macros.h>
+#include <tins/crypto.h>
+#include <tins/detail/smart_ptr.h>
+
+namespace Tins {
+
+class PDU;
+class Packet;
+
+namespace Crypto {
+
+/**
+ * \brief Decrypts WPA2-encrypted traffic using a pool of worker threads.
+ *
+ * Packets are given to WPA2ParallelDecrypter::process on the capture thread. 
+ * Beacons and EAPOL handshakes are handled right away on that thread, the 
+ * same way WPA2Decrypter does. Every packet is then queued on one of the 
+ * worker threads, which decrypts it (if possible) and hands it to the 
+ * packet callback.
+ *
+ * Packets are sharded by the pair of addresses they're sent between, so
+ * every packet exchanged between an access point and a client is handled
+ * by the same worker and delivered to the callback in the order in which 
+ * it was processed. There's no ordering guarantee between packets that 
+ * belong to different pairs.
+ *
+ * Each worker keeps its own copy of the session keys in a hash table. New
+ * keys are pushed through the workers' queues, so they're applied right 
+ * before the packets that follow the handshake and looking them up doesn't
+ * require any locking.
+ *
+ * If decrypting a packet or executing the packet callback throws an 
+ * exception on a worker thread, the worker skips that packet and keeps 
+ * going. The exception is then rethrown on the calling thread by the next 
+ * call to WPA2ParallelDecrypter::process or WPA2ParallelDecrypter::flush.
+ * Only the first exception is kept until it's rethrown.
+ *
+ * \code
+ * WPA2ParallelDecrypter decrypter(4, [&](Packet& packet, bool decrypted) {
+ *     // This is executed on one of the worker threads
+ *     if (decrypted) {
+ *         handle_packet(packet);
+ *     }
+ * });
+ * decrypter.add_ap_data("some password", "some SSID");
+ * Sniffer sniffer = ...;
+ * while (Packet packet = sniffer.next_packet()) {
+ *     decrypter.process(std::move(packet));
+ * }
+ * decrypter.flush();
+ * \endcode
+ */
+class TINS_API WPA2ParallelDecrypter {
+public:
+    /**
+     * The type used to store Dot11 addresses.
+     */
+    typedef WPA2Decrypter::address_type address_type;
+
+    /**
+     * The type used to represent a pair of addresses.
+     */
+    typedef WPA2Decrypter::addr_pair addr_pair;
+
+    /**
+     * The type used to store the callback executed when a new access point
+     * is found.
+     */
+    typedef WPA2Decrypter::ap_found_callback_type ap_found_callback_type;
+
+    /**
+     * The type used to store the callback executed when a new handshake
+     * is captured.
+     */
+    typedef WPA2Decrypter::handshake_captured_callback_type handshake_captured_callback_type;
+
+    /**
+     * \brief The type used to store the callback executed for every packet
+     *
+     * The first argument is the processed packet and the second one indicates
+     * whether it was decrypted.
+     */
+    typedef std::function<void(Packet&, bool)> packet_callback_type;
+
+    /**
+     * The default maximum amount of packets queued on each worker.
+     */
+    static const size_t DEFAULT_MAX_QUEUE_SIZE;
+
+    /**
+     * \brief Constructs a WPA2ParallelDecrypter and starts its workers.
+     *
+     * \param thread_count The amount of worker threads to use. If this is 0, 
+     * then one worker per hardware thread is used.
+     * \param callback The callback to be executed for every packet. This
+     * is executed on the worker threads, potentially concurrently.
+     */
+    WPA2ParallelDecrypter(size_t thread_count, const packet_callback_type& callback);
+
+    /**
+     * \brief Destructor
+     *
+     * Every packet still queued is processed before the workers are stopped.
+     */
+    ~WPA2ParallelDecrypter();
+
+    /**
+     * \brief Adds an access points's information.
+     *
+     * \param psk The PSK associated with the SSID.
+     * \param ssid The network's SSID.
+     * \sa WPA2Decrypter::add_ap_data
+     */
+    void add_ap_data(const std::string& psk, const std::string& ssid);
+
+    /**
+     * \brief Adds a access points's information, including its BSSID.
+     *
+     * \param psk The PSK associated with this SSID.
+     * \param ssid The network's SSID.
+     * \param addr The access point's BSSID.
+     * \sa WPA2Decrypter::add_ap_data
+     */
+    void add_ap_data(const std::string& psk,
+                     const std::string& ssid,
+                     const address_type& addr);
+
+    /**
+     * \brief Adds an access point's information using an already derived PMK.
+     *
+     * \param data The supplicant data, containing the PMK and SSID.
+     * \sa WPA2Decrypter::add_ap_data
+     */
+    void add_ap_data(const WPA2::SupplicantData& data);
+
+    /**
+     * \brief Explicitly add decryption keys.
+     *
+     * These are used for every packet processed after this call.
+     *
+     * \param addresses The address pair (host, access point) to associate.
+     * \param session_keys The keys to use when decrypting messages sent between the 
+     * given addresses.
+     * \sa WPA2Decrypter::add_decryption_keys
+     */
+    void add_decryption_keys(const addr_pair& addresses, 
+                             const WPA2::SessionKeys& session_keys);
+
+    /**
+     * \brief Processes a packet.
+     *
+     * The packet is queued on the worker that handles its addresses. If that
+     * worker's queue is full, this blocks until there's room for it.
+     *
+     * If a worker thread failed processing a previous packet, the exception
+     * it threw is rethrown here and this packet isn't processed.
+     *
+     * \param packet The packet to be processed
+     */
+    void process(Packet packet);
+
+    /**
+     * \brief Waits until every queued packet has been processed
+     *
+     * If a worker thread failed processing a packet, the exception it threw
+     * is rethrown once every queued packet has been processed.
+     */
+    void flush();
+
+    /**
+     * \brief Sets the maximum amount of packets queued on each worker
+     *
+     * This defaults to 1024.
+     *
+     * \param value The value to be set
+     */
+    void max_queue_size(size_t value);
+
+    /**
+     * Retrieves the amount of worker threads
+     */
+    size_t thread_count() const;
+
+    /**
+     * \brief Sets the handshake captured callback
+     *
+     * This is executed on the thread that calls WPA2ParallelDecrypter::process.
+     *
+     * \param callback The new callback to be set
+     */
+    void handshake_captured_callback(const handshake_captured_callback_type& callback);
+
+    /**
+     * \brief Sets the access point found callback
+     *
+     * This is executed on the thread that calls WPA2ParallelDecrypter::process.
+     *
+     * \param callback The new callback to be set
+     */
+    void ap_found_callback(const ap_found_callback_type& callback);
+
+    /**
+     * \brief Getter for the keys captured so far
+     */
+    const WPA2Decrypter::keys_map& get_keys() const;
+private:
+    struct task;
+    struct worker;
+
+    WPA2ParallelDecrypter(const WPA2ParallelDecrypter&);
+    WPA2ParallelDecrypter& operator=(const WPA2ParallelDecrypter&);
+
+    void on_handshake_captured(const std::string& ssid, const address_type& bssid,
+                               const address_type& client);
+    void push_keys(const addr_pair& addresses, const WPA2::SessionKeys& session_keys);
+    void push_task(worker& target, task& item, bool wait_for_room);
+    worker& find_worker(const PDU& pdu);
+    void run_worker(worker& target);
+    void store_worker_error(std::exception_ptr error);
+    void rethrow_worker_error();
+
+    WPA2Decrypter decrypter_;
+    packet_callback_type packet_callback_;
+    handshake_captured_callback_type handshake_captured_callback_;
+    size_t max_queue_size_;
+    std::vector<Internals::smart_ptr<worker>::type> workers_;
+    std::mutex error_mutex_;
+    std::exception_ptr worker_error_;
+    std::atomic<bool> has_worker_error_;
+};
+
+} // Crypto
+} // Tins
+
+#endif // TINS_WPA2_PARALLEL_DECRYPTER_H
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/config.h>
+
+#if !defined(TINS_WPA2_PMK_H) && defined(TINS_HAVE_WPA2_DECRYPTION)
+#define TINS_WPA2_PMK_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+#include <tins/macros.h>
+#include <tins/crypto.h>
+
+namespace Tins {
+namespace Crypto {
+namespace WPA2 {
+
+/**
+ * \brief Stores PMKs so they don't have to be derived again.
+ *
+ * PMKs are indexed by SSID and a SHA-256 hash of the PSK, so the PSKs 
+ * themselves are never stored. Note that a PMK is enough to decrypt the
+ * traffic of its network, so the cache file should be protected accordingly.
+ *
+ * \code
+ * PMKCache cache("/var/cache/pmks");
+ * vector<pair<string, string> > credentials = ...;
+ * vector<SessionKeys::pmk_type> pmks = derive_pmks(credentials, 0, &cache);
+ * cache.save();
+ * \endcode
+ */
+class TINS_API PMKCache {
+public:
+    /**
+     * The type used to store PMKs.
+     */
+    typedef SessionKeys::pmk_type pmk_type;
+
+    /**
+     * \brief Constructs an in-memory cache.
+     */
+    PMKCache();
+
+    /**
+     * \brief Constructs a cache backed by the given file.
+     *
+     * The PMKs stored in the file are loaded. If the file doesn't exist or 
+     * isn't a valid cache, the cache starts empty and the file will be
+     * overwritten on PMKCache::save.
+     *
+     * \param file_path The path to the cache file
+     */
+    explicit PMKCache(const std::string& file_path);
+
+    /**
+     * \brief Looks up the PMK for a PSK and SSID.
+     *
+     * \param psk The pre-shared key
+     * \param ssid The SSID
+     * \return A pointer to the PMK or a null pointer if it's not cached
+     */
+    const pmk_type* find(const std::string& psk, const std::string& ssid) const;
+
+    /**
+     * \brief Stores the PMK for a PSK and SSID.
+     *
+     * SSIDs can't be longer than 32 bytes. An invalid_ssid exception is
+     * thrown for longer ones.
+     *
+     * \param psk The pre-shared key
+     * \param ssid The SSID
+     * \param pmk The PMK
+     */
+    void insert(const std::string& psk, const std::string& ssid, const pmk_type& pmk);
+
+    /**
+     * Retrieves the amount of cached PMKs
+     */
+    size_t size() const;
+
+    /**
+     * \brief Writes the cache to its file.
+     *
+     * The cache is written to a new file that only the current user can
+     * access, which then atomically replaces the existing one. This does
+     * nothing on in-memory caches.
+     * A std::runtime_error is thrown if the file can't be written.
+     */
+    void save() const;
+private:
+    static const uint32_t FILE_MAGIC;
+    static const uint8_t FILE_VERSION;
+
+    typedef std::vector<uint8_t> hash_type;
+    typedef std::pair<std::string, hash_type> key_type;
+    typedef std::map<key_type, pmk_type> pmks_type;
+
+    static key_type make_key(const std::string& psk, const std::string& ssid);
+    void load();
+
+    pmks_type pmks_;
+    std::string file_path_;
+};
+
+/**
+ * \brief Derives the PMK for a PSK and SSID.
+ *
+ * \param psk The pre-shared key
+ * \param ssid The SSID
+ */
+TINS_API SessionKeys::pmk_type derive_pmk(const std::string& psk, const std::string& ssid);
+
+/**
+ * \brief Derives the PMKs for several PSK and SSID pairs at once.
+ *
+ * Several PMKs are computed on each pass over the PBKDF2 iterations and
+ * the work is split among the given amount of threads. If a cache is
+ * provided, cached PMKs are not derived again and the derived ones are
+ * inserted into it.
+ *
+ * \param credentials The (PSK, SSID) pairs
+ * \param thread_count The amount of threads to use. If this is 0, then
+ * one thread per hardware thread is used.
+ * \param cache The cache to use, if any
+ * \return The PMKs, in the same order as the credentials
+ */
+TINS_API std::vector<SessionKeys::pmk_type> derive_pmks(
+    const std::vector<std::pair<std::string, std::string> >& credentials,
+    size_t thread_count = 1, PMKCache* cache = 0);
+
+} // WPA2
+} // Crypto
+} // Tins
+
+#endif // TINS_WPA2_PMK_H
@@ -28,6 +28,7 @@
  */
 
 #include <tins/crypto.h>
+#include <tins/wpa2_pmk.h>
 
 #ifdef TINS_HAVE_DOT11
 
@@ -35,7 +36,6 @@
 #ifdef TINS_HAVE_WPA2_DECRYPTION
     #include <openssl/evp.h>
     #include <openssl/hmac.h>
-    #include <openssl/aes.h>
 #endif // TINS_HAVE_WPA2_DECRYPTION
 #include <tins/snap.h>
 #include <tins/rawpdu.h>
@@ -57,62 +57,10 @@ using std::fill;
 using std::runtime_error;
 
 namespace Tins {
-namespace Internals {
-
-template<size_t n>
-class byte_array {
-public:
-    typedef uint8_t* iterator;
-    typedef const uint8_t* const_iterator;
-
-    byte_array() {
-        std::memset(data, 0, size());
-    }
-
-    uint8_t& operator[](size_t i) {
-        return data[i];
-    }
-
-    uint8_t operator[](size_t i) const{
-        return data[i];
-    }
-
-    iterator begin() {
-        return data;
-    }
-
-    iterator end() {
-        return data + n;
-    }
-
-    const_iterator begin() const {
-        return data;
-    }
-
-    const_iterator end() const {
-        return data + n;
-    }
-
-    size_t size() const {
-        return n;
-    }
-private:
-    uint8_t data[n];
-};
-
-} // Internals
-
 namespace Crypto {
 
 // Helper stuff
 
-template<typename InputIterator1, typename InputIterator2, typename OutputIterator>
-void xor_range(InputIterator1 src1, InputIterator2 src2, OutputIterator dst, size_t sz) {
-    for (size_t i = 0; i < sz; ++i) {
-        *dst++ = *src1++ ^ *src2++;
-    }
-}
-
 const uint16_t sbox_table[2][256]= {
     {
         0xC6A5, 0xF884, 0xEE99, 0xF68D, 0xFF0D, 0xD6BD, 0xDEB1, 0x9154,
@@ -209,98 +157,95 @@ uint16_t lower_byte(uint16_t value) {
 struct RC4Key {
     static const size_t data_size = 256;
 
-    template<typename ForwardIterator>
-    RC4Key(ForwardIterator start, ForwardIterator end) {
+    RC4Key(const uint8_t* key, size_t key_size) {
         for (size_t i = 0; i < data_size; ++i) {
             data[i] = static_cast<uint8_t>(i);
         }
-        size_t j = 0;
-        ForwardIterator iter = start;
-        for (size_t i = 0; i < data_size; ++i) {
-            j = (j + data[i] + *iter++) % 256;
-            if(iter == end) {
-                iter = start;
+        // uint8_t arithmetic wraps around, no need to use modulo 256
+        uint8_t j = 0;
+        for (size_t i = 0, k = 0; i < data_size; ++i) {
+            j += data[i] + key[k];
+            if (++k == key_size) {
+                k = 0;
             }
             std::swap(data[i], data[j]);
         }
     }
 
-    static RC4Key from_packet(const Dot11Data& dot11, const RawPDU& raw,
-                              const vector<uint8_t>& ptk) { 
-        const RawPDU::payload_type& pload = raw.payload();
-        const uint8_t* tk = &ptk[0] + 32;
-        Internals::byte_array<16> rc4_key;
-        uint16_t ppk[6];
-        const Dot11::address_type addr = dot11.addr2();
-        // Phase 1
-        ppk[0] = join_bytes(pload[4], pload[5]);
-        ppk[1] = join_bytes(pload[6], pload[7]);
-        ppk[2] = join_bytes(addr[1], addr[0]);
-        ppk[3] = join_bytes(addr[3], addr[2]);
-        ppk[4] = join_bytes(addr[5], addr[4]);
-
-        for (size_t i = 0; i < 4; ++i) {
-            ppk[0] += sbox(ppk[4] ^ join_bytes(tk[1], tk[0]));
-            ppk[1] += sbox(ppk[0] ^ join_bytes(tk[5], tk[4]));
-            ppk[2] += sbox(ppk[1] ^ join_bytes(tk[9], tk[8]));
-            ppk[3] += sbox(ppk[2] ^ join_bytes(tk[13], tk[12]));
-            ppk[4] += sbox(ppk[3] ^ join_bytes(tk[1], tk[0])) + 2*i;
-            ppk[0] += sbox(ppk[4] ^ join_bytes(tk[3], tk[2]));
-            ppk[1] += sbox(ppk[0] ^ join_bytes(tk[7], tk[6]));
-            ppk[2] += sbox(ppk[1] ^ join_bytes(tk[11], tk[10]));
-            ppk[3] += sbox(ppk[2] ^ join_bytes(tk[15], tk[14]));
-            ppk[4] += sbox(ppk[3] ^ join_bytes(tk[3], tk[2])) + 2*i + 1;
-        }
-
-        // Phase 2, step 1
-        ppk[5] = ppk[4] + join_bytes(pload[0], pload[2]);
-
-        // Phase 2, step 2
-        ppk[0] += sbox(ppk[5] ^ join_bytes(tk[1], tk[0]));
-        ppk[1] += sbox(ppk[0] ^ join_bytes(tk[3], tk[2]));
-        ppk[2] += sbox(ppk[1] ^ join_bytes(tk[5], tk[4]));
-        ppk[3] += sbox(ppk[2] ^ join_bytes(tk[7], tk[6]));
-        ppk[4] += sbox(ppk[3] ^ join_bytes(tk[9], tk[8]));
-        ppk[5] += sbox(ppk[4] ^ join_bytes(tk[11], tk[10]));
-
-        ppk[0] += rotate(ppk[5] ^ join_bytes(tk[13], tk[12]));
-        ppk[1] += rotate(ppk[0] ^ join_bytes(tk[15], tk[14]));
-        ppk[2] += rotate(ppk[1]);
-        ppk[3] += rotate(ppk[2]);
-        ppk[4] += rotate(ppk[3]);
-        ppk[5] += rotate(ppk[4]);
-
-        // Phase 2, step 3
-        rc4_key[0] = upper_byte(join_bytes(pload[0], pload[2]));
-        rc4_key[1] = (rc4_key[0] | 0x20) & 0x7f;
-        rc4_key[2] = lower_byte(join_bytes(pload[0], pload[2]));
-        rc4_key[3] = lower_byte((ppk[5] ^ join_bytes(tk[1], tk[0])) >> 1);
-        rc4_key[4] = lower_byte(ppk[0]);
-        rc4_key[5] = upper_byte(ppk[0]);
-        rc4_key[6] = lower_byte(ppk[1]);
-        rc4_key[7] = upper_byte(ppk[1]);
-        rc4_key[8] = lower_byte(ppk[2]);
-        rc4_key[9] = upper_byte(ppk[2]);
-        rc4_key[10] = lower_byte(ppk[3]);
-        rc4_key[11] = upper_byte(ppk[3]);
-        rc4_key[12] = lower_byte(ppk[4]);
-        rc4_key[13] = upper_byte(ppk[4]);
-        rc4_key[14] = lower_byte(ppk[5]);
-        rc4_key[15] = upper_byte(ppk[5]);
-        return RC4Key(rc4_key.begin(), rc4_key.end());
-    }
-
     uint8_t data[data_size];
 };
 
-template<typename ForwardIterator, typename OutputIterator>
-void rc4(ForwardIterator start, ForwardIterator end, RC4Key& key, OutputIterator output) {
-    size_t i = 0, j = 0;
-    while (start != end) {
-        i = (i + 1) % RC4Key::data_size;
-        j = (j + key.data[i]) % RC4Key::data_size;
-        std::swap(key.data[i], key.data[j]);
-        *output++ = *start++ ^ key.data[(key.data[i] + key.data[j]) % RC4Key::data_size];
+// Input and output can point to the same buffer
+void rc4(const uint8_t* input, size_t size, RC4Key& key, uint8_t* output) {
+    uint8_t* state = key.data;
+    uint8_t i = 0, j = 0;
+    for (size_t n = 0; n < size; ++n) {
+        const uint8_t state_i = state[++i];
+        j += state_i;
+        const uint8_t state_j = state[j];
+        state[i] = state_j;
+        state[j] = state_i;
+        output[n] = input[n] ^ state[static_cast<uint8_t>(state_i + state_j)];
+    }
+}
+
+// TKIP key mixing
+
+// Phase 1 only depends on the TK, the transmitter address and the IV32, 
+// so its output can be reused until the IV32 changes.
+void tkip_phase1(const uint8_t* tk, const HWAddress<6>& addr, const uint8_t* iv32,
+                 uint16_t* ttak) {
+    ttak[0] = join_bytes(iv32[0], iv32[1]);
+    ttak[1] = join_bytes(iv32[2], iv32[3]);
+    ttak[2] = join_bytes(addr[1], addr[0]);
+    ttak[3] = join_bytes(addr[3], addr[2]);
+    ttak[4] = join_bytes(addr[5], addr[4]);
+
+    for (uint16_t i = 0; i < 4; ++i) {
+        ttak[0] += sbox(ttak[4] ^ join_bytes(tk[1], tk[0]));
+        ttak[1] += sbox(ttak[0] ^ join_bytes(tk[5], tk[4]));
+        ttak[2] += sbox(ttak[1] ^ join_bytes(tk[9], tk[8]));
+        ttak[3] += sbox(ttak[2] ^ join_bytes(tk[13], tk[12]));
+        ttak[4] += sbox(ttak[3] ^ join_bytes(tk[1], tk[0])) + 2*i;
+        ttak[0] += sbox(ttak[4] ^ join_bytes(tk[3], tk[2]));
+        ttak[1] += sbox(ttak[0] ^ join_bytes(tk[7], tk[6]));
+        ttak[2] += sbox(ttak[1] ^ join_bytes(tk[11], tk[10]));
+        ttak[3] += sbox(ttak[2] ^ join_bytes(tk[15], tk[14]));
+        ttak[4] += sbox(ttak[3] ^ join_bytes(tk[3], tk[2])) + 2*i + 1;
+    }
+}
+
+void tkip_phase2(const uint8_t* tk, const uint16_t* ttak, uint16_t iv16,
+                 uint8_t* rc4_key) {
+    uint16_t ppk[6];
+    copy(ttak, ttak + 5, ppk);
+
+    // Step 1
+    ppk[5] = ppk[4] + iv16;
+
+    // Step 2
+    ppk[0] += sbox(ppk[5] ^ join_bytes(tk[1], tk[0]));
+    ppk[1] += sbox(ppk[0] ^ join_bytes(tk[3], tk[2]));
+    ppk[2] += sbox(ppk[1] ^ join_bytes(tk[5], tk[4]));
+    ppk[3] += sbox(ppk[2] ^ join_bytes(tk[7], tk[6]));
+    ppk[4] += sbox(ppk[3] ^ join_bytes(tk[9], tk[8]));
+    ppk[5] += sbox(ppk[4] ^ join_bytes(tk[11], tk[10]));
+
+    ppk[0] += rotate(ppk[5] ^ join_bytes(tk[13], tk[12]));
+    ppk[1] += rotate(ppk[0] ^ join_bytes(tk[15], tk[14]));
+    ppk[2] += rotate(ppk[1]);
+    ppk[3] += rotate(ppk[2]);
+    ppk[4] += rotate(ppk[3]);
+    ppk[5] += rotate(ppk[4]);
+
+    // Step 3
+    rc4_key[0] = upper_byte(iv16);
+    rc4_key[1] = (rc4_key[0] | 0x20) & 0x7f;
+    rc4_key[2] = lower_byte(iv16);
+    rc4_key[3] = lower_byte((ppk[5] ^ join_bytes(tk[1], tk[0])) >> 1);
+    for (size_t i = 0; i < 6; ++i) {
+        rc4_key[4 + i * 2] = lower_byte(ppk[i]);
+        rc4_key[5 + i * 2] = upper_byte(ppk[i]);
     }
 }
 
@@ -363,20 +308,22 @@ PDU* WEPDecrypter::decrypt(RawPDU& raw, const string& password) {
     copy(pload.begin(), pload.begin() + 3, key_buffer_.begin());
     copy(password.begin(), password.end(), key_buffer_.begin() + 3);
 
-    // Generate the key
-    RC4Key key(key_buffer_.begin(), key_buffer_.begin() + password.size() + 3);
-    rc4(pload.begin() + 4, pload.end(), key, pload.begin());
-    uint32_t payload_size = static_cast<uint32_t>(pload.size() - 8);
-    uint32_t crc = Utils::crc32(&pload[0], payload_size);
-    if (pload[pload.size() - 8] != (crc & 0xff) ||
-        pload[pload.size() - 7] != ((crc >> 8) & 0xff) ||
-        pload[pload.size() - 6] != ((crc >> 16) & 0xff) ||
-        pload[pload.size() - 5] != ((crc >> 24) & 0xff)) {
+    // Generate the key and decrypt everything after the IV in place
+    RC4Key key(&key_buffer_[0], password.size() + 3);
+    uint8_t* data = &pload[4];
+    const uint32_t data_size = static_cast<uint32_t>(pload.size() - 4);
+    rc4(data, data_size, key, data);
+    const uint32_t payload_size = data_size - 4;
+    uint32_t crc = Utils::crc32(data, payload_size);
+    if (data[payload_size] != (crc & 0xff) ||
+        data[payload_size + 1] != ((crc >> 8) & 0xff) ||
+        data[payload_size + 2] != ((crc >> 16) & 0xff) ||
+        data[payload_size + 3] != ((crc >> 24) & 0xff)) {
         return 0;
     }
 
     try {
-        return new SNAP(&pload[0], payload_size);
+        return new SNAP(data, payload_size);
     }
     catch (exception_base&) {
         return 0;
@@ -408,31 +355,111 @@ HWAddress<6> get_bssid(const Dot11Data& dot11) {
     }
 }
 
+uint8_t frame_priority(const Dot11Data& dot11) {
+    if (dot11.subtype() == Dot11::QOS_DATA_DATA) {
+        return static_cast<const Dot11QoSData&>(dot11).qos_control() & 0x0f;
+    }
+    return 0;
+}
+
+// Builds the additional authentication data used by CCMP and GCMP and returns its size
+size_t build_aad(const Dot11Data& dot11, uint8_t* AAD) {
+    const bool has_addr4 = dot11.from_ds() && dot11.to_ds();
+    size_t size = 22;
+    AAD[0] = dot11.protocol() | (dot11.type() << 2) | ((dot11.subtype() << 4) & 0x80);
+    AAD[1] = 0x40 | dot11.to_ds() | (dot11.from_ds() << 1) |
+             (dot11.more_frag() << 2) | (dot11.order() << 7);
+    dot11.addr1().copy(AAD + 2);
+    dot11.addr2().copy(AAD + 8);
+    dot11.addr3().copy(AAD + 14);
+    AAD[20] = dot11.frag_num();
+    AAD[21] = 0;
+    if (has_addr4) {
+        dot11.addr4().copy(AAD + size);
+        size += 6;
+    }
+    if (dot11.subtype() == Dot11::QOS_DATA_DATA) {
+        AAD[size] = frame_priority(dot11);
+        AAD[size + 1] = 0;
+        size += 2;
+    }
+    return size;
+}
+
+// Writes the packet number in the CCMP/GCMP header as a big endian value
+void extract_packet_number(const RawPDU::payload_type& pload, uint8_t* output) {
+    output[0] = pload[7];
+    output[1] = pload[6];
+    output[2] = pload[5];
+    output[3] = pload[4];
+    output[4] = pload[1];
+    output[5] = pload[0];
+}
+
 namespace WPA2 {
 
+// SessionKeys::CipherContext
+
+SessionKeys::CipherContext::CipherContext()
+: context(0), keyed(false) {
+
+}
+
+SessionKeys::CipherContext::CipherContext(const CipherContext&)
+: context(0), keyed(false) {
+
+}
+
+SessionKeys::CipherContext& SessionKeys::CipherContext::operator=(const CipherContext&) {
+    // The keys are being replaced, so this context has to be keyed again
+    reset();
+    return *this;
+}
+
+SessionKeys::CipherContext::~CipherContext() {
+    reset();
+}
+
+void SessionKeys::CipherContext::reset() {
+    EVP_CIPHER_CTX_free(context);
+    context = 0;
+    keyed = false;
+}
+
+// SessionKeys
+
 const size_t SessionKeys::PTK_SIZE = 80;
 const size_t SessionKeys::PMK_SIZE = 32;
 
-SessionKeys::SessionKeys() {
+SessionKeys::SessionKeys() 
+: cipher_(TKIP) {
 
 }
 
 SessionKeys::SessionKeys(const ptk_type& ptk, bool is_ccmp) 
-: ptk_(ptk), is_ccmp_(is_ccmp) {
+: ptk_(ptk), cipher_(is_ccmp ? CCMP : TKIP) {
+    if (ptk_.size() != PTK_SIZE) {
+        throw invalid_handshake();
+    }
+}
+
+SessionKeys::SessionKeys(const ptk_type& ptk, CipherType cipher) 
+: ptk_(ptk), cipher_(cipher) {
     if (ptk_.size() != PTK_SIZE) {
         throw invalid_handshake();
     }
 }
 
 SessionKeys::SessionKeys(const RSNHandshake& hs, const pmk_type& pmk) 
-: ptk_(PTK_SIZE), is_ccmp_(false) {
+: ptk_(PTK_SIZE), cipher_(TKIP) {
     if (pmk.size() != PMK_SIZE) {
         throw invalid_handshake();
     }
 
     uint8_t PKE[100] = "Pairwise key expansion";
     uint8_t MIC[20];
-    is_ccmp_ = (hs.handshake()[3].key_descriptor() == 2);
+    const bool is_ccmp = (hs.handshake()[3].key_descriptor() == 2);
+    cipher_ = is_ccmp ? CCMP : TKIP;
     
     min(hs.client_address(), hs.supplicant_address()).copy(PKE + 23);
     max(hs.client_address(), hs.supplicant_address()).copy(PKE + 29);
@@ -453,7 +480,7 @@ SessionKeys::SessionKeys(const RSNHandshake& hs, const pmk_type& pmk)
     RSNEAPOL& last_hs = const_cast<RSNEAPOL&>(hs.handshake()[3]);
     PDU::serialization_type buffer = last_hs.serialize();
     fill(buffer.begin() + 81, buffer.begin() + 81 + 16, 0);
-    if (is_ccmp_) {
+    if (is_ccmp) {
         HMAC(EVP_sha1(), &ptk_[0], 16, &buffer[0], buffer.size(), MIC, 0);
     }
     else {
@@ -465,90 +492,102 @@ SessionKeys::SessionKeys(const RSNHandshake& hs, const pmk_type& pmk)
     }
 }
 
+EVP_CIPHER_CTX* SessionKeys::keyed_cipher_context() const {
+    if (cipher_context_.keyed) {
+        return cipher_context_.context;
+    }
+    if (!cipher_context_.context) {
+        cipher_context_.context = EVP_CIPHER_CTX_new();
+        if (!cipher_context_.context) {
+            return 0;
+        }
+    }
+    // Set the cipher, the nonce size and the key once. Each packet then only
+    // provides its nonce (and its MIC, for CCMP)
+    EVP_CIPHER_CTX* ctx = cipher_context_.context;
+    bool keyed;
+    if (cipher_ == CCMP) {
+        // The MIC size has to be known before the key is set. Some OpenSSL
+        // versions won't take it without a tag, so use a placeholder one
+        uint8_t mic[8] = { 0 };
+        keyed = EVP_DecryptInit_ex(ctx, EVP_aes_128_ccm(), 0, 0, 0) &&
+                EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_IVLEN, 13, 0) &&
+                EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_TAG, sizeof(mic), mic) &&
+                EVP_DecryptInit_ex(ctx, 0, 0, &ptk_[0] + 32, 0);
+    }
+    else {
+        const EVP_CIPHER* cipher = (cipher_ == GCMP_256) ? EVP_aes_256_gcm() : EVP_aes_128_gcm();
+        keyed = EVP_DecryptInit_ex(ctx, cipher, 0, 0, 0) &&
+                EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, 12, 0) &&
+                EVP_DecryptInit_ex(ctx, 0, 0, &ptk_[0] + 32, 0);
+    }
+    if (!keyed) {
+        cipher_context_.reset();
+        return 0;
+    }
+    cipher_context_.keyed = true;
+    return ctx;
+}
+
 SNAP* SessionKeys::ccmp_decrypt_unicast(const Dot11Data& dot11, RawPDU& raw) const {
+    static const size_t header_size = 8, mic_size = 8;
     RawPDU::payload_type& pload = raw.payload();
-    uint8_t MIC[16] = {0};
-    uint8_t PN[6] = {
-        pload[7],
-        pload[6],
-        pload[5],
-        pload[4],
-        pload[1],
-        pload[0]
-    };
-    
-    uint8_t AAD[32] = {0};
-    AAD[0] = 0;
-    AAD[1] = 22 + 6 * int(dot11.from_ds() && dot11.to_ds());
-    if (dot11.subtype() == Dot11::QOS_DATA_DATA)  {
-        AAD[1] += 2;
-    }
-    AAD[2] = dot11.protocol() | (dot11.type() << 2) | ((dot11.subtype() << 4) & 0x80);
-    AAD[3] = 0x40 | dot11.to_ds() | (dot11.from_ds() << 1) |
-            (dot11.more_frag() << 2) | (dot11.order() << 7);
-    dot11.addr1().copy(AAD + 4);
-    dot11.addr2().copy(AAD + 10);
-    dot11.addr3().copy(AAD + 16);
-    
-    AAD[22] = dot11.frag_num();
-    AAD[23] = 0;
-    
-    if (dot11.from_ds() && dot11.to_ds()) {
-        dot11.addr4().copy(AAD + 24);
+    if (pload.size() <= header_size + mic_size) {
+        return 0;
     }
-    
-    AES_KEY ctx;
-    AES_set_encrypt_key(&ptk_[0] + 32, 128, &ctx);
-    uint8_t crypted_block[16];
-    size_t total_sz = raw.payload_size() - 16, offset = 8, blocks = (total_sz + 15) / 16;
-    
-    uint8_t counter[16];
-    counter[0] = 0x59;
-    counter[1] = 0;
-    dot11.addr2().copy(counter + 2);
-    copy(PN, PN + 6, counter + 8);
-    counter[14] = (total_sz >> 8) & 0xff;
-    counter[15] = total_sz & 0xff;
-    
-    if (dot11.subtype() == Dot11::QOS_DATA_DATA) {
-        const uint32_t offset = (dot11.from_ds() && dot11.to_ds()) ? 30 : 24;
-        AAD[offset] = static_cast<const Dot11QoSData&>(dot11).qos_control() & 0x0f;
-        counter[1] = AAD[offset];
+    const int total_sz = static_cast<int>(pload.size() - header_size - mic_size);
+    uint8_t AAD[30];
+    const int aad_size = static_cast<int>(build_aad(dot11, AAD));
+    // The nonce is made of the priority, the transmitter address and the PN
+    uint8_t nonce[13];
+    nonce[0] = frame_priority(dot11);
+    dot11.addr2().copy(nonce + 1);
+    extract_packet_number(pload, nonce + 7);
+
+    // Decrypt in place. This fails if the MIC doesn't match
+    uint8_t* data = &pload[header_size];
+    EVP_CIPHER_CTX* ctx = keyed_cipher_context();
+    int length;
+    if (!ctx ||
+        !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_TAG, mic_size, data + total_sz) ||
+        !EVP_DecryptInit_ex(ctx, 0, 0, 0, nonce) ||
+        !EVP_DecryptUpdate(ctx, 0, &length, 0, total_sz) ||
+        !EVP_DecryptUpdate(ctx, 0, &length, AAD, aad_size) ||
+        EVP_DecryptUpdate(ctx, data, &length, data, total_sz) <= 0) {
+        cipher_context_.reset();
+        return 0;
     }
+    return new SNAP(data, total_sz);
+}
 
-    AES_encrypt(counter, MIC, &ctx);
-    xor_range(MIC, AAD, MIC, 16);
-    AES_encrypt(MIC, MIC, &ctx);
-    xor_range(MIC, AAD + 16, MIC, 16);
-    AES_encrypt(MIC, MIC, &ctx);
-    
-    counter[0] = 1;
-    counter[14] = counter[15] = 0;
-    AES_encrypt(counter, crypted_block, &ctx);
-    uint8_t nice_MIC[8];
-    copy(pload.begin() + pload.size() - 8, pload.end(), nice_MIC);
-    xor_range(crypted_block, nice_MIC, nice_MIC, 8);
-    for (size_t i = 1; i <= blocks; ++i) {
-        size_t block_sz = (i == blocks) ? (total_sz % 16) : 16;
-        if (block_sz == 0) {
-            block_sz = 16;
-        }
-        counter[14] = (i >> 8) & 0xff;
-        counter[15] = i & 0xff;
-        AES_encrypt(counter, crypted_block, &ctx );
-
-        xor_range(crypted_block, &pload[offset], &pload[(i - 1) * 16], block_sz);
-        
-        xor_range(MIC, &pload[(i - 1) * 16], MIC, block_sz);
-        AES_encrypt(MIC, MIC, &ctx);   
-        offset += block_sz;
-    }
-    if (equal(nice_MIC, nice_MIC + sizeof(nice_MIC), MIC)) {
-        return new SNAP(&pload[0], total_sz);
+SNAP* SessionKeys::gcmp_decrypt_unicast(const Dot11Data& dot11, RawPDU& raw) const {
+    static const size_t header_size = 8, mic_size = 16;
+    RawPDU::payload_type& pload = raw.payload();
+    if (pload.size() <= header_size + mic_size) {
+        return 0;
     }
-    else {
+    const int total_sz = static_cast<int>(pload.size() - header_size - mic_size);
+    uint8_t AAD[30];
+    const int aad_size = static_cast<int>(build_aad(dot11, AAD));
+    // The nonce is made of the transmitter address and the PN
+    uint8_t nonce[12];
+    dot11.addr2().copy(nonce);
+    extract_packet_number(pload, nonce + 6);
+
+    // Decrypt in place. This fails if the MIC doesn't match
+    uint8_t* data = &pload[header_size];
+    EVP_CIPHER_CTX* ctx = keyed_cipher_context();
+    int length;
+    if (!ctx ||
+        !EVP_DecryptInit_ex(ctx, 0, 0, 0, nonce) ||
+        !EVP_DecryptUpdate(ctx, 0, &length, AAD, aad_size) ||
+        !EVP_DecryptUpdate(ctx, data, &length, data, total_sz) ||
+        !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, mic_size, data + total_sz) ||
+        EVP_DecryptFinal_ex(ctx, data + length, &length) <= 0) {
+        cipher_context_.reset();
         return 0;
     }
+    return new SNAP(data, total_sz);
 }
 
 SNAP* SessionKeys::tkip_decrypt_unicast(const Dot11Data& dot11, RawPDU& raw) const {
@@ -556,25 +595,68 @@ SNAP* SessionKeys::tkip_decrypt_unicast(const Dot11Data& dot11, RawPDU& raw) con
     if (raw.payload_size() <= 20) {
         return 0;
     }
-    Crypto::RC4Key key = RC4Key::from_packet(dot11, raw, ptk_);
     RawPDU::payload_type& pload = raw.payload();
-    rc4(pload.begin() + 8, pload.end(), key, pload.begin());
-
-    uint32_t crc = Utils::crc32(&pload[0], pload.size() - 12);
-    if (pload[pload.size() - 12] != (crc & 0xff) ||
-        pload[pload.size() - 11] != ((crc >> 8) & 0xff) ||
-        pload[pload.size() - 10] != ((crc >> 16) & 0xff) ||
-        pload[pload.size() - 9] != ((crc >> 24) & 0xff)) {
+    const uint8_t* tk = &ptk_[0] + 32;
+    uint16_t ttak[5];
+    tkip_phase1_key(dot11.addr2(), &pload[4], ttak);
+    uint8_t rc4_key[16];
+    tkip_phase2(tk, ttak, join_bytes(pload[0], pload[2]), rc4_key);
+
+    // Decrypt everything after the IV/extended IV in place
+    RC4Key key(rc4_key, sizeof(rc4_key));
+    uint8_t* data = &pload[8];
+    const uint32_t data_size = static_cast<uint32_t>(pload.size() - 8);
+    rc4(data, data_size, key, data);
+
+    // The ICV covers the payload and the MIC
+    const uint32_t icv_offset = data_size - 4;
+    uint32_t crc = Utils::crc32(data, icv_offset);
+    if (data[icv_offset] != (crc & 0xff) ||
+        data[icv_offset + 1] != ((crc >> 8) & 0xff) ||
+        data[icv_offset + 2] != ((crc >> 16) & 0xff) ||
+        data[icv_offset + 3] != ((crc >> 24) & 0xff)) {
         return 0;
     }
 
-    return new SNAP(&pload[0], pload.size() - 20);
+    return new SNAP(data, data_size - 12);
+}
+
+void SessionKeys::tkip_phase1_key(const HWAddress<6>& transmitter, const uint8_t* iv32,
+                                  uint16_t* ttak) const {
+    // Most recently used entry is kept first
+    size_t index = 0;
+    while (index < TKIP_PHASE1_CACHE_SIZE && 
+           !(tkip_phase1_cache_[index].valid &&
+             tkip_phase1_cache_[index].transmitter == transmitter)) {
+        ++index;
+    }
+    if (index == TKIP_PHASE1_CACHE_SIZE) {
+        index = TKIP_PHASE1_CACHE_SIZE - 1;
+        tkip_phase1_cache_[index].valid = false;
+    }
+    if (index != 0) {
+        std::swap(tkip_phase1_cache_[0], tkip_phase1_cache_[index]);
+    }
+    TKIPPhase1Key& entry = tkip_phase1_cache_[0];
+    if (!entry.valid || !equal(iv32, iv32 + 4, entry.iv32)) {
+        tkip_phase1(&ptk_[0] + 32, transmitter, iv32, entry.ttak);
+        copy(iv32, iv32 + 4, entry.iv32);
+        entry.transmitter = transmitter;
+        entry.valid = true;
+    }
+    copy(entry.ttak, entry.ttak + 5, ttak);
 }
 
 SNAP* SessionKeys::decrypt_unicast(const Dot11Data& dot11, RawPDU& raw) const {
-    return is_ccmp_ ? 
-           ccmp_decrypt_unicast(dot11, raw) :
-           tkip_decrypt_unicast(dot11, raw);
+    switch (cipher_) {
+        case CCMP:
+            return ccmp_decrypt_unicast(dot11, raw);
+        case GCMP_128:
+        case GCMP_256:
+            return gcmp_decrypt_unicast(dot11, raw);
+        default:
+            return tkip_decrypt_unicast(dot11, raw);
+    }
 }
 
 const SessionKeys::ptk_type& SessionKeys::get_ptk() const {
@@ -582,22 +664,23 @@ const SessionKeys::ptk_type& SessionKeys::get_ptk() const {
 }
 
 bool SessionKeys::uses_ccmp() const {
-    return is_ccmp_;
+    return cipher_ == CCMP;
+}
+
+SessionKeys::CipherType SessionKeys::cipher() const {
+    return cipher_;
 }
 
 // supplicant_data
 
 SupplicantData::SupplicantData(const string& psk, const string& ssid)
-: pmk_(SessionKeys::PMK_SIZE), ssid_(ssid) {
-    PKCS5_PBKDF2_HMAC_SHA1(
-        psk.c_str(), 
-        psk.size(), 
-        (unsigned char *)ssid.c_str(), 
-        ssid.size(), 
-        4096, 
-        pmk_.size(), 
-        &pmk_[0]
-    );
+: pmk_(derive_pmk(psk, ssid)), ssid_(ssid) {
+
+}
+
+SupplicantData::SupplicantData(const pmk_type& pmk, const string& ssid)
+: pmk_(pmk), ssid_(ssid) {
+
 }
 
 const SupplicantData::pmk_type& SupplicantData::pmk() const {
@@ -621,6 +704,10 @@ void WPA2Decrypter::add_ap_data(const string& psk,
     add_access_point(ssid, addr);
 }
 
+void WPA2Decrypter::add_ap_data(const WPA2::SupplicantData& data) {
+    pmks_.insert(make_pair(data.ssid(), data));
+}
+
 void WPA2Decrypter::add_access_point(const string& ssid, const address_type& addr) {
     pmks_map::const_iterator it = pmks_.find(ssid);
     if (it == pmks_.end()) {
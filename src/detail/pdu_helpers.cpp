@@ -51,76 +51,160 @@
 #include <tins/rawpdu.h>
 #include <tins/dot1q.h>
 #include <tins/pppoe.h>
+#include <tins/dns.h>
+#include <tins/dhcp.h>
+#include <tins/dhcpv6.h>
+#include <tins/vxlan.h>
 #include <tins/pdu_allocator.h>
+#include <tins/exceptions.h>
 
 namespace Tins {
 namespace Internals {
 
+typedef PDUAllocator<pdu_tag_mapper<EthernetII>::type> ethertype_allocators;
+typedef PDUAllocator<pdu_tag_mapper<IP>::type> ip_protocol_allocators;
+typedef PDUAllocator<pdu_tag_mapper<UDP>::type> udp_port_allocators;
+typedef PDUAllocator<pdu_tag_mapper<TCP>::type> tcp_port_allocators;
+typedef PDU* (*allocator_type)(const uint8_t*, uint32_t);
+
+PDU* allocate_eapol(const uint8_t* buffer, uint32_t size) {
+    return EAPOL::from_bytes(buffer, size);
+}
+
+#ifdef TINS_HAVE_PCAP
+
+// Large enough for every DLT value libpcap defines
+const size_t DLT_TABLE_SIZE = 512;
+
+allocator_type dlt_allocators[DLT_TABLE_SIZE];
+
+#ifdef TINS_HAVE_DOT11
+PDU* allocate_dot11(const uint8_t* buffer, uint32_t size) {
+    return Dot11::from_bytes(buffer, size);
+}
+#else // TINS_HAVE_DOT11
+PDU* allocate_dot11(const uint8_t*, uint32_t) {
+    throw protocol_disabled();
+}
+#endif // TINS_HAVE_DOT11
+
+#endif // TINS_HAVE_PCAP
+
+// Fills the dispatch tables with the protocols the library knows about
+void register_builtin_allocators() {
+    ethertype_allocators::register_builtin_allocator(
+        Constants::Ethernet::IP, &default_allocator<IP>);
+    ethertype_allocators::register_builtin_allocator(
+        Constants::Ethernet::IPV6, &default_allocator<IPv6>);
+    ethertype_allocators::register_builtin_allocator(
+        Constants::Ethernet::ARP, &default_allocator<ARP>);
+    ethertype_allocators::register_builtin_allocator(
+        Constants::Ethernet::PPPOED, &default_allocator<PPPoE>);
+    ethertype_allocators::register_builtin_allocator(
+        Constants::Ethernet::PPPOES, &default_allocator<PPPoE>);
+    ethertype_allocators::register_builtin_allocator(
+        Constants::Ethernet::EAPOL, &allocate_eapol);
+    ethertype_allocators::register_builtin_allocator(
+        Constants::Ethernet::VLAN, &default_allocator<Dot1Q>);
+    ethertype_allocators::register_builtin_allocator(
+        Constants::Ethernet::QINQ, &default_allocator<Dot1Q>);
+    ethertype_allocators::register_builtin_allocator(
+        Constants::Ethernet::OLD_QINQ, &default_allocator<Dot1Q>);
+    ethertype_allocators::register_builtin_allocator(
+        Constants::Ethernet::MPLS, &default_allocator<MPLS>);
+
+    ip_protocol_allocators::register_builtin_allocator(
+        Constants::IP::PROTO_IPIP, &default_allocator<IP>);
+    ip_protocol_allocators::register_builtin_allocator(
+        Constants::IP::PROTO_TCP, &default_allocator<TCP>);
+    ip_protocol_allocators::register_builtin_allocator(
+        Constants::IP::PROTO_UDP, &default_allocator<UDP>);
+    ip_protocol_allocators::register_builtin_allocator(
+        Constants::IP::PROTO_ICMP, &default_allocator<ICMP>);
+    ip_protocol_allocators::register_builtin_allocator(
+        Constants::IP::PROTO_ICMPV6, &default_allocator<ICMPv6>);
+    ip_protocol_allocators::register_builtin_allocator(
+        Constants::IP::PROTO_IPV6, &default_allocator<IPv6>);
+    ip_protocol_allocators::register_builtin_allocator(
+        Constants::IP::PROTO_AH, &default_allocator<IPSecAH>);
+    ip_protocol_allocators::register_builtin_allocator(
+        Constants::IP::PROTO_ESP, &default_allocator<IPSecESP>);
+
+    #ifdef TINS_HAVE_PCAP
+        dlt_allocators[DLT_EN10MB] = &default_allocator<EthernetII>;
+        #ifdef TINS_HAVE_DOT11
+            dlt_allocators[DLT_IEEE802_11_RADIO] = &default_allocator<RadioTap>;
+        #else // TINS_HAVE_DOT11
+            dlt_allocators[DLT_IEEE802_11_RADIO] = &allocate_dot11;
+        #endif // TINS_HAVE_DOT11
+        dlt_allocators[DLT_IEEE802_11] = &allocate_dot11;
+        dlt_allocators[DLT_NULL] = &default_allocator<Loopback>;
+        dlt_allocators[DLT_LINUX_SLL] = &default_allocator<SLL>;
+        dlt_allocators[DLT_PPI] = &default_allocator<PPI>;
+    #endif // TINS_HAVE_PCAP
+}
+
+// Built in protocols are registered on first use instead of by a static
+// initializer, so packets can be parsed during static initialization too
+void ensure_builtin_allocators() {
+    static const bool registered = (register_builtin_allocators(), true);
+    (void)registered;
+}
+
 Tins::PDU* pdu_from_flag(Constants::Ethernet::e flag,
                          const uint8_t* buffer,
                          uint32_t size,
                          bool rawpdu_on_no_match) {
-    switch (flag) {
-        case Tins::Constants::Ethernet::IP:
-            return new IP(buffer, size);
-        case Constants::Ethernet::IPV6:
-            return new IPv6(buffer, size);
-        case Tins::Constants::Ethernet::ARP:
-            return new ARP(buffer, size);
-        case Tins::Constants::Ethernet::PPPOED:
-        case Tins::Constants::Ethernet::PPPOES:
-            return new PPPoE(buffer, size);
-        case Tins::Constants::Ethernet::EAPOL:
-            return EAPOL::from_bytes(buffer, size);
-        case Tins::Constants::Ethernet::VLAN:
-        case Tins::Constants::Ethernet::QINQ:
-        case Tins::Constants::Ethernet::OLD_QINQ:
-            return new Dot1Q(buffer, size);
-        case Tins::Constants::Ethernet::MPLS:
-            return new MPLS(buffer, size);
-        default:
-            {
-                PDU* pdu = Internals::allocate<EthernetII>(
-                    static_cast<uint16_t>(flag),
-                    buffer,
-                    size
-                );
-                if (pdu) {
-                    return pdu;
-                }
-            }
-            return rawpdu_on_no_match ? new RawPDU(buffer, size) : 0;
-    };
+    ensure_builtin_allocators();
+    const allocator_type allocator = ethertype_allocators::find(
+        static_cast<uint16_t>(flag)
+    );
+    if (allocator) {
+        return (*allocator)(buffer, size);
+    }
+    return rawpdu_on_no_match ? new RawPDU(buffer, size) : 0;
 }
 
 Tins::PDU* pdu_from_flag(Constants::IP::e flag,
                          const uint8_t* buffer,
                          uint32_t size,
                          bool rawpdu_on_no_match) {
-    switch (flag) {
-        case Constants::IP::PROTO_IPIP:
-            return new Tins::IP(buffer, size);
-        case Constants::IP::PROTO_TCP:
-            return new Tins::TCP(buffer, size);
-        case Constants::IP::PROTO_UDP:
-            return new Tins::UDP(buffer, size);
-        case Constants::IP::PROTO_ICMP:
-            return new Tins::ICMP(buffer, size);
-        case Constants::IP::PROTO_ICMPV6:
-            return new Tins::ICMPv6(buffer, size);
-        case Constants::IP::PROTO_IPV6:
-            return new Tins::IPv6(buffer, size);
-        case Constants::IP::PROTO_AH:
-            return new Tins::IPSecAH(buffer, size);
-        case Constants::IP::PROTO_ESP:
-            return new Tins::IPSecESP(buffer, size);
-        default:
-            break;
+    ensure_builtin_allocators();
+    const allocator_type allocator = ip_protocol_allocators::find(
+        static_cast<uint8_t>(flag)
+    );
+    if (allocator) {
+        return (*allocator)(buffer, size);
     }
-    if (rawpdu_on_no_match) {
-        return new Tins::RawPDU(buffer, size);
+    return rawpdu_on_no_match ? new RawPDU(buffer, size) : 0;
+}
+
+template<typename Allocators>
+PDU* pdu_from_ports(uint16_t sport, uint16_t dport, const uint8_t* buffer, uint32_t size) {
+    // Well known ports are usually the lowest ones
+    allocator_type allocator = Allocators::find(std::min(sport, dport));
+    if (!allocator) {
+        allocator = Allocators::find(std::max(sport, dport));
     }
-    return 0;
+    if (allocator) {
+        try {
+            return (*allocator)(buffer, size);
+        }
+        catch (exception_base&) {
+            // Not really this protocol, keep the raw payload
+        }
+    }
+    return new RawPDU(buffer, size);
+}
+
+PDU* pdu_from_udp_ports(uint16_t sport, uint16_t dport, const uint8_t* buffer,
+                        uint32_t size) {
+    return pdu_from_ports<udp_port_allocators>(sport, dport, buffer, size);
+}
+
+PDU* pdu_from_tcp_ports(uint16_t sport, uint16_t dport, const uint8_t* buffer,
+                        uint32_t size) {
+    return pdu_from_ports<tcp_port_allocators>(sport, dport, buffer, size);
 }
 
 #ifdef TINS_HAVE_PCAP
@@ -128,30 +212,11 @@ PDU* pdu_from_dlt_flag(int flag,
                        const uint8_t* buffer,
                        uint32_t size,
                        bool rawpdu_on_no_match) {
-    switch (flag) {
-        case DLT_EN10MB:
-            return new EthernetII(buffer, size);
-
-        #ifdef TINS_HAVE_DOT11
-        case DLT_IEEE802_11_RADIO:
-            return new RadioTap(buffer, size);
-        case DLT_IEEE802_11:
-            return Dot11::from_bytes(buffer, size);
-        #else // TINS_HAVE_DOT11
-        case DLT_IEEE802_11_RADIO:
-        case DLT_IEEE802_11:
-            throw protocol_disabled();
-        #endif // TINS_HAVE_DOT11
-
-        case DLT_NULL:
-            return new Loopback(buffer, size);
-        case DLT_LINUX_SLL:
-            return new SLL(buffer, size);
-        case DLT_PPI:
-            return new PPI(buffer, size);
-        default:
-            return rawpdu_on_no_match ? new RawPDU(buffer, size) : 0;
-    };
+    ensure_builtin_allocators();
+    if (flag >= 0 && static_cast<size_t>(flag) < DLT_TABLE_SIZE && dlt_allocators[flag]) {
+        return (*dlt_allocators[flag])(buffer, size);
+    }
+    return rawpdu_on_no_match ? new RawPDU(buffer, size) : 0;
 }
 #endif // TINS_HAVE_PCAP
 
@@ -300,4 +365,17 @@ PDU::PDUType ip_type_to_pdu_flag(Constants::IP::e flag) {
 }
 
 } // Internals
+
+namespace Allocators {
+
+void register_application_allocators() {
+    register_allocator<UDP, DNS>(53);
+    register_allocator<UDP, DHCP>(67);
+    register_allocator<UDP, DHCP>(68);
+    register_allocator<UDP, DHCPv6>(546);
+    register_allocator<UDP, DHCPv6>(547);
+    register_allocator<UDP, VXLAN>(4789);
+}
+
+} // Allocators
 } // Tins
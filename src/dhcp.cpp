@@ -28,6 +28,7 @@
  */
 
 #include <cstring>
+#include <algorithm>
 #include <tins/endianness.h>
 #include <tins/dhcp.h>
 #include <tins/exceptions.h>
@@ -36,12 +37,16 @@
 using std::string;
 using std::vector;
 using std::runtime_error;
+using std::memset;
 
 using Tins::Memory::InputMemoryStream;
 using Tins::Memory::OutputMemoryStream;
 
 namespace Tins {
 
+// Positions are stored as uint16_t in the option index
+const size_t MAX_INDEXED_OPTIONS = 0xffff;
+
 PDU::metadata DHCP::extract_metadata(const uint8_t* /*buffer*/, uint32_t total_sz) {
     if (TINS_UNLIKELY(total_sz < sizeof(bootp_header))) {
         throw malformed_packet();
@@ -51,20 +56,21 @@ PDU::metadata DHCP::extract_metadata(const uint8_t* /*buffer*/, uint32_t total_s
 
 // Magic cookie: uint32_t. 
 DHCP::DHCP() 
-: size_(sizeof(uint32_t)) {
+: option_index_(), size_(sizeof(uint32_t)) {
     opcode(BOOTREQUEST);
     htype(1); // ethernet
     hlen(6); // MAC address length
 }
 
 DHCP::DHCP(const uint8_t* buffer, uint32_t total_sz) 
-: BootP(buffer, total_sz, 0), size_(sizeof(uint32_t)) {
+: BootP(buffer, total_sz, 0), option_index_(), size_(sizeof(uint32_t)) {
     InputMemoryStream stream(buffer, total_sz);
     stream.skip(BootP::header_size() - vend().size());
     const uint32_t magic_number = stream.read<uint32_t>();
     if (magic_number != Endian::host_to_be<uint32_t>(0x63825363)) {
         throw malformed_packet();
     }
+    Internals::option_block block(stream.pointer(), stream.pointer() + stream.size());
     // While there's data left
     while (stream) {
         OptionTypes option_type;
@@ -78,7 +84,9 @@ DHCP::DHCP(const uint8_t* buffer, uint32_t total_sz)
         if (!stream.can_read(option_length)) {
             throw malformed_packet();
         }
-        add_option(option(option_type, option_length, stream.pointer()));
+        add_option(
+            option(option_type, option_length, stream.pointer(), option_length, block)
+        );
         stream.skip(option_length);
     }
 }
@@ -88,8 +96,24 @@ void DHCP::add_option(const option& opt) {
     options_.push_back(opt);
 }
 
+// Called right before the option is appended to options_
 void DHCP::internal_add_option(const option& opt) {
     size_ += static_cast<uint32_t>(opt.data_size() + (sizeof(uint8_t) << 1));
+    uint16_t& position = option_index_[opt.option()];
+    if (position == 0 && options_.size() < MAX_INDEXED_OPTIONS) {
+        position = static_cast<uint16_t>(options_.size() + 1);
+    }
+}
+
+void DHCP::rebuild_option_index() {
+    memset(option_index_, 0, sizeof(option_index_));
+    const size_t count = std::min(options_.size(), MAX_INDEXED_OPTIONS);
+    for (size_t i = 0; i < count; ++i) {
+        uint16_t& position = option_index_[options_[i].option()];
+        if (position == 0) {
+            position = static_cast<uint16_t>(i + 1);
+        }
+    }
 }
 
 bool DHCP::remove_option(OptionTypes type) {
@@ -99,20 +123,48 @@ bool DHCP::remove_option(OptionTypes type) {
     }
     size_ -= static_cast<uint32_t>(iter->data_size() + (sizeof(uint8_t) << 1));
     options_.erase(iter);
+    rebuild_option_index();
     return true;
 }
 
 const DHCP::option* DHCP::search_option(OptionTypes opt) const {
-    // Search for the iterator. If we found something, return it, otherwise return nullptr.
+    const uint16_t position = option_index_[static_cast<uint8_t>(opt)];
+    if (position != 0) {
+        return &options_[position - 1];
+    }
+    // Only a huge amount of PAD options can leave options out of the index
+    if (TINS_LIKELY(options_.size() <= MAX_INDEXED_OPTIONS)) {
+        return 0;
+    }
     options_type::const_iterator iter = search_option_iterator(opt);
     return (iter != options_.end()) ? &*iter : 0;
 }
 
+DHCP::address_range DHCP::addresses(OptionTypes opt) const {
+    const option* option = search_option(opt);
+    if (!option) {
+        throw option_not_found();
+    }
+    if (option->data_size() % sizeof(uint32_t) != 0) {
+        throw malformed_option();
+    }
+    const uint8_t* ptr = option->data_ptr();
+    return address_range(
+        address_iterator(ptr),
+        address_iterator(ptr + option->data_size()),
+        option->data_size() / sizeof(uint32_t)
+    );
+}
+
 DHCP::options_type::const_iterator DHCP::search_option_iterator(OptionTypes opt) const {
     return Internals::find_option_const<option>(options_, opt);
 }
 
 DHCP::options_type::iterator DHCP::search_option_iterator(OptionTypes opt) {
+    const uint16_t position = option_index_[static_cast<uint8_t>(opt)];
+    if (position != 0) {
+        return options_.begin() + (position - 1);
+    }
     return Internals::find_option<option>(options_, opt);
 }
 
@@ -0,0 +1,486 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/dhcp_lease_tracker.h>
+
+#if TINS_IS_CXX11
+
+#include <cstring>
+#include <algorithm>
+#include <tins/pdu.h>
+#include <tins/packet.h>
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/udp.h>
+#include <tins/dhcp.h>
+#include <tins/dhcpv6.h>
+#include <tins/rawpdu.h>
+#include <tins/exceptions.h>
+#include <tins/memory_helpers.h>
+
+using std::vector;
+using std::memcmp;
+using std::memcpy;
+using std::greater;
+using std::push_heap;
+using std::pop_heap;
+using std::make_heap;
+using std::chrono::system_clock;
+using std::chrono::duration_cast;
+using std::chrono::seconds;
+
+using Tins::Memory::InputMemoryStream;
+using Tins::Internals::fnv_hash;
+using Tins::Internals::fnv_hash_byte;
+
+namespace Tins {
+
+// Stale expiry entries are dropped once the heap grows past this
+const size_t MIN_EXPIRY_HEAP_SIZE = 64;
+const uint16_t DHCP_SERVER_PORT = 67;
+const uint16_t DHCP_CLIENT_PORT = 68;
+const uint16_t DHCPV6_CLIENT_PORT = 546;
+const uint16_t DHCPV6_SERVER_PORT = 547;
+const uint32_t INFINITE_LIFETIME = 0xffffffff;
+const uint16_t DUID_LLT = 1;
+const uint16_t DUID_LL = 3;
+const uint16_t ETHERNET_HW_TYPE = 1;
+// The address, preferred and valid lifetimes in an IA address option
+const uint16_t IA_ADDRESS_SIZE = 24;
+
+static uint64_t lease_tracker_hash(const uint8_t* ptr, size_t size, bool ipv6) {
+    return fnv_hash_byte(fnv_hash(ptr, size), ipv6 ? 1 : 0);
+}
+
+static uint64_t lease_tracker_hash(const HWAddress<6>& client, bool ipv6) {
+    return lease_tracker_hash(client.begin(), client.size(), ipv6);
+}
+
+static DHCPLeaseTracker::timestamp_type lease_expiry(const DHCPLeaseTracker::timestamp_type& now,
+                                                     uint32_t lifetime) {
+    if (lifetime == INFINITE_LIFETIME) {
+        return DHCPLeaseTracker::timestamp_type::max();
+    }
+    return now + duration_cast<DHCPLeaseTracker::timestamp_type>(seconds(lifetime));
+}
+
+// DHCPLeaseTracker::const_iterator
+
+DHCPLeaseTracker::const_iterator::const_iterator(const DHCPLeaseTracker* tracker, 
+                                                 size_t index)
+: tracker_(tracker), index_(index) {
+    skip_unused();
+}
+
+DHCPLeaseTracker::const_iterator::reference DHCPLeaseTracker::const_iterator::operator*() const {
+    return tracker_->leases_.value(index_);
+}
+
+DHCPLeaseTracker::const_iterator::pointer DHCPLeaseTracker::const_iterator::operator->() const {
+    return &tracker_->leases_.value(index_);
+}
+
+DHCPLeaseTracker::const_iterator& DHCPLeaseTracker::const_iterator::operator++() {
+    ++index_;
+    skip_unused();
+    return *this;
+}
+
+DHCPLeaseTracker::const_iterator DHCPLeaseTracker::const_iterator::operator++(int) {
+    const_iterator output(*this);
+    ++*this;
+    return output;
+}
+
+void DHCPLeaseTracker::const_iterator::skip_unused() {
+    if (!tracker_) {
+        return;
+    }
+    const leases_table_type& leases = tracker_->leases_;
+    while (index_ < leases.slot_count() && !leases.used(index_)) {
+        ++index_;
+    }
+}
+
+// DHCPLeaseTracker
+
+bool DHCPLeaseTracker::expiry_entry::operator>(const expiry_entry& rhs) const {
+    return expiry > rhs.expiry;
+}
+
+DHCPLeaseTracker::DHCPLeaseTracker() {
+}
+
+bool DHCPLeaseTracker::process_packet(const PDU& pdu) {
+    const system_clock::duration ts = system_clock::now().time_since_epoch();
+    return process_packet(pdu, duration_cast<timestamp_type>(ts));
+}
+
+bool DHCPLeaseTracker::process_packet(const Packet& packet) {
+    if (!packet.pdu()) {
+        return false;
+    }
+    return process_packet(*packet.pdu(), packet.timestamp());
+}
+
+void DHCPLeaseTracker::expire(const timestamp_type& now) {
+    while (!expiry_heap_.empty() && expiry_heap_.front().expiry <= now) {
+        const expiry_entry entry = expiry_heap_.front();
+        pop_heap(expiry_heap_.begin(), expiry_heap_.end(), greater<expiry_entry>());
+        expiry_heap_.pop_back();
+        // Renewed leases leave their previous expiry time behind
+        const size_t index = find_slot(entry.client, entry.ipv6);
+        if (index != leases_table_type::npos && leases_.value(index).expiry == entry.expiry) {
+            leases_.erase(index);
+        }
+    }
+}
+
+void DHCPLeaseTracker::trust_server(IPv4Address identifier) {
+    const uint32_t address = identifier;
+    const uint8_t* ptr = reinterpret_cast<const uint8_t*>(&address);
+    size_t index = find_server_index(ptr, sizeof(address), false);
+    if (index == servers_.size()) {
+        index = add_server(ptr, sizeof(address), false);
+    }
+    servers_[index].trusted = true;
+}
+
+void DHCPLeaseTracker::trust_server(const DHCPv6::duid_type& duid) {
+    // The DUID type followed by its data, as found in the server id option
+    vector<uint8_t> identifier(sizeof(uint16_t) + duid.data.size());
+    identifier[0] = duid.id >> 8;
+    identifier[1] = duid.id & 0xff;
+    std::copy(duid.data.begin(), duid.data.end(), identifier.begin() + sizeof(uint16_t));
+    size_t index = find_server_index(&identifier[0], identifier.size(), true);
+    if (index == servers_.size()) {
+        index = add_server(&identifier[0], identifier.size(), true);
+    }
+    servers_[index].trusted = true;
+}
+
+void DHCPLeaseTracker::unexpected_server_handler(const server_handler_type& handler) {
+    server_handler_ = handler;
+}
+
+const DHCPLeaseTracker::servers_type& DHCPLeaseTracker::servers() const {
+    return servers_;
+}
+
+const DHCPLeaseTracker::lease* DHCPLeaseTracker::find_lease(const hwaddress_type& client) const {
+    const size_t index = find_slot(client, false);
+    return index != leases_table_type::npos ? &leases_.value(index) : 0;
+}
+
+const DHCPLeaseTracker::lease* DHCPLeaseTracker::find_ipv6_lease(const hwaddress_type& client) const {
+    const size_t index = find_slot(client, true);
+    return index != leases_table_type::npos ? &leases_.value(index) : 0;
+}
+
+size_t DHCPLeaseTracker::lease_count() const {
+    return leases_.size();
+}
+
+void DHCPLeaseTracker::reserve(size_t count) {
+    leases_.reserve(count);
+}
+
+DHCPLeaseTracker::const_iterator DHCPLeaseTracker::begin() const {
+    return const_iterator(this, 0);
+}
+
+DHCPLeaseTracker::const_iterator DHCPLeaseTracker::end() const {
+    return const_iterator(this, leases_.slot_count());
+}
+
+DHCPLeaseTracker::leases_type DHCPLeaseTracker::snapshot() const {
+    return leases_type(begin(), end());
+}
+
+bool DHCPLeaseTracker::process_packet(const PDU& pdu, const timestamp_type& ts) {
+    expire(ts);
+    const UDP* udp = pdu.find_pdu<UDP>();
+    if (!udp) {
+        return false;
+    }
+    try {
+        if (const DHCP* dhcp = udp->find_pdu<DHCP>()) {
+            return process_dhcp(pdu, *dhcp, ts);
+        }
+        if (const DHCPv6* dhcpv6 = udp->find_pdu<DHCPv6>()) {
+            return process_dhcpv6(pdu, *dhcpv6, ts);
+        }
+        const RawPDU* raw = udp->find_pdu<RawPDU>();
+        if (!raw) {
+            return false;
+        }
+        const uint16_t sport = udp->sport(), dport = udp->dport();
+        if (sport == DHCP_SERVER_PORT || sport == DHCP_CLIENT_PORT ||
+            dport == DHCP_SERVER_PORT || dport == DHCP_CLIENT_PORT) {
+            return process_dhcp(pdu, raw->to<DHCP>(), ts);
+        }
+        if (sport == DHCPV6_SERVER_PORT || sport == DHCPV6_CLIENT_PORT ||
+            dport == DHCPV6_SERVER_PORT || dport == DHCPV6_CLIENT_PORT) {
+            return process_dhcpv6(pdu, raw->to<DHCPv6>(), ts);
+        }
+    }
+    catch (exception_base&) {
+        return false;
+    }
+    return false;
+}
+
+bool DHCPLeaseTracker::process_dhcp(const PDU& pdu, const DHCP& dhcp, 
+                                    const timestamp_type& ts) {
+    const DHCP::option* type_option = dhcp.search_option(DHCP::DHCP_MESSAGE_TYPE);
+    if (!type_option || dhcp.hlen() != hwaddress_type::address_size) {
+        return false;
+    }
+    const uint8_t type = type_option->to<uint8_t>();
+    const hwaddress_type client(dhcp.chaddr().begin());
+    if (type == DHCP::RELEASE || type == DHCP::DECLINE) {
+        return erase_lease(client, false);
+    }
+    if (type != DHCP::OFFER && type != DHCP::ACK && type != DHCP::NAK) {
+        return false;
+    }
+    size_t server_index;
+    const DHCP::option* server_option = dhcp.search_option(DHCP::DHCP_SERVER_IDENTIFIER);
+    if (server_option && server_option->data_size() == sizeof(uint32_t)) {
+        server_index = find_server(server_option->data_ptr(), sizeof(uint32_t), false, pdu);
+    }
+    else {
+        const IP* ip = pdu.find_pdu<IP>();
+        const uint32_t address = ip ? static_cast<uint32_t>(ip->src_addr()) : 0;
+        server_index = find_server(reinterpret_cast<const uint8_t*>(&address),
+                                   sizeof(address), false, pdu);
+    }
+    if (type == DHCP::NAK) {
+        return erase_lease(client, false);
+    }
+    // Acknowledgements to DHCP informs don't assign an address
+    if (type == DHCP::OFFER || dhcp.yiaddr() == IPv4Address()) {
+        return false;
+    }
+    const DHCP::option* time_option = dhcp.search_option(DHCP::DHCP_LEASE_TIME);
+    lease value;
+    value.client = client;
+    value.address = dhcp.yiaddr();
+    value.expiry = lease_expiry(ts, time_option ? time_option->to<uint32_t>() : 
+                                                  INFINITE_LIFETIME);
+    value.server_index = server_index;
+    value.ipv6 = false;
+    update_lease(value);
+    return true;
+}
+
+bool DHCPLeaseTracker::process_dhcpv6(const PDU& pdu, const DHCPv6& dhcp, 
+                                      const timestamp_type& ts) {
+    const DHCPv6::MessageType type = dhcp.msg_type();
+    if (type != DHCPv6::ADVERTISE && type != DHCPv6::REPLY && 
+        type != DHCPv6::RELEASE && type != DHCPv6::DECLINE) {
+        return false;
+    }
+    const bool from_client = type == DHCPv6::RELEASE || type == DHCPv6::DECLINE;
+    // Use the DUID's link layer address if there's one. Otherwise, use the
+    // client's side of the Ethernet frame
+    hwaddress_type client;
+    const DHCPv6::option* client_option = dhcp.search_option(DHCPv6::CLIENTID);
+    const EthernetII* eth = pdu.find_pdu<EthernetII>();
+    const uint8_t* duid = client_option ? client_option->data_ptr() : 0;
+    const size_t duid_size = client_option ? client_option->data_size() : 0;
+    const uint16_t duid_type = duid_size >= 4 ? (duid[0] << 8) | duid[1] : 0;
+    const uint16_t hw_type = duid_size >= 4 ? (duid[2] << 8) | duid[3] : 0;
+    if (duid_type == DUID_LLT && hw_type == ETHERNET_HW_TYPE && 
+        duid_size == 8 + hwaddress_type::address_size) {
+        client = hwaddress_type(duid + 8);
+    }
+    else if (duid_type == DUID_LL && hw_type == ETHERNET_HW_TYPE && 
+             duid_size == 4 + hwaddress_type::address_size) {
+        client = hwaddress_type(duid + 4);
+    }
+    else if (eth) {
+        client = from_client ? eth->src_addr() : eth->dst_addr();
+    }
+    else {
+        return false;
+    }
+    if (from_client) {
+        return erase_lease(client, true);
+    }
+    const DHCPv6::option* server_option = dhcp.search_option(DHCPv6::SERVERID);
+    if (!server_option) {
+        return false;
+    }
+    const size_t server_index = find_server(server_option->data_ptr(), 
+                                            server_option->data_size(), true, pdu);
+    const DHCPv6::option* ia_option = dhcp.search_option(DHCPv6::IA_NA);
+    if (type == DHCPv6::ADVERTISE || !ia_option) {
+        return false;
+    }
+    // Skip the IAID, T1 and T2 fields and look for the first address
+    InputMemoryStream stream(ia_option->data_ptr(), ia_option->data_size());
+    stream.skip(sizeof(uint32_t) * 3);
+    while (stream) {
+        const uint16_t option_type = stream.read_be<uint16_t>();
+        const uint16_t option_size = stream.read_be<uint16_t>();
+        if (!stream.can_read(option_size)) {
+            break;
+        }
+        if (option_type != DHCPv6::IA_ADDR || option_size < IA_ADDRESS_SIZE) {
+            stream.skip(option_size);
+            continue;
+        }
+        const IPv6Address address(stream.pointer());
+        stream.skip(IPv6Address::address_size + sizeof(uint32_t));
+        const uint32_t valid_lifetime = stream.read_be<uint32_t>();
+        if (valid_lifetime == 0) {
+            return erase_lease(client, true);
+        }
+        lease value;
+        value.client = client;
+        value.ipv6_address = address;
+        value.expiry = lease_expiry(ts, valid_lifetime);
+        value.server_index = server_index;
+        value.ipv6 = true;
+        update_lease(value);
+        return true;
+    }
+    return false;
+}
+
+size_t DHCPLeaseTracker::find_server(const uint8_t* identifier, size_t size, bool ipv6,
+                                     const PDU& pdu) {
+    size_t index = find_server_index(identifier, size, ipv6);
+    const bool is_new = index == servers_.size();
+    if (is_new) {
+        index = add_server(identifier, size, ipv6);
+    }
+    server& current = servers_[index];
+    if (const EthernetII* eth = pdu.find_pdu<EthernetII>()) {
+        current.hw_address = eth->src_addr();
+    }
+    current.packets++;
+    if (is_new && server_handler_) {
+        // The handler could add servers, so give it a copy
+        const server value = current;
+        server_handler_(value);
+    }
+    return index;
+}
+
+size_t DHCPLeaseTracker::add_server(const uint8_t* identifier, size_t size, bool ipv6) {
+    server value;
+    value.identifier.assign(identifier, identifier + size);
+    value.packets = 0;
+    value.ipv6 = ipv6;
+    value.trusted = false;
+    servers_.push_back(value);
+    servers_index_.insert(lease_tracker_hash(identifier, size, ipv6), servers_.size() - 1);
+    return servers_.size() - 1;
+}
+
+// Returns servers_.size() if there's no such server
+size_t DHCPLeaseTracker::find_server_index(const uint8_t* identifier, size_t size, 
+                                           bool ipv6) const {
+    size_t index = servers_index_.find(lease_tracker_hash(identifier, size, ipv6));
+    for (; index != servers_index_type::npos; index = servers_index_.find_next(index)) {
+        const server& current = servers_[servers_index_.value(index)];
+        if (current.ipv6 == ipv6 && current.identifier.size() == size && 
+            (size == 0 || memcmp(&current.identifier[0], identifier, size) == 0)) {
+            return servers_index_.value(index);
+        }
+    }
+    return servers_.size();
+}
+
+void DHCPLeaseTracker::update_lease(const lease& value) {
+    const size_t index = find_slot(value.client, value.ipv6);
+    if (index != leases_table_type::npos) {
+        lease& current = leases_.value(index);
+        const bool expiry_changed = current.expiry != value.expiry;
+        current = value;
+        if (!expiry_changed) {
+            return;
+        }
+    }
+    else {
+        leases_.insert(lease_tracker_hash(value.client, value.ipv6), value);
+    }
+    if (value.expiry == timestamp_type::max()) {
+        return;
+    }
+    expiry_entry entry;
+    entry.expiry = value.expiry;
+    entry.client = value.client;
+    entry.ipv6 = value.ipv6;
+    expiry_heap_.push_back(entry);
+    push_heap(expiry_heap_.begin(), expiry_heap_.end(), greater<expiry_entry>());
+    if (expiry_heap_.size() > leases_.size() * 2 + MIN_EXPIRY_HEAP_SIZE) {
+        rebuild_expiry_heap();
+    }
+}
+
+bool DHCPLeaseTracker::erase_lease(const hwaddress_type& client, bool ipv6) {
+    const size_t index = find_slot(client, ipv6);
+    if (index == leases_table_type::npos) {
+        return false;
+    }
+    leases_.erase(index);
+    return true;
+}
+
+size_t DHCPLeaseTracker::find_slot(const hwaddress_type& client, bool ipv6) const {
+    size_t index = leases_.find(lease_tracker_hash(client, ipv6));
+    for (; index != leases_table_type::npos; index = leases_.find_next(index)) {
+        const lease& current = leases_.value(index);
+        if (current.ipv6 == ipv6 && current.client == client) {
+            return index;
+        }
+    }
+    return index;
+}
+
+void DHCPLeaseTracker::rebuild_expiry_heap() {
+    expiry_heap_.clear();
+    for (const_iterator it = begin(); it != end(); ++it) {
+        if (it->expiry != timestamp_type::max()) {
+            expiry_entry entry;
+            entry.expiry = it->expiry;
+            entry.client = it->client;
+            entry.ipv6 = it->ipv6;
+            expiry_heap_.push_back(entry);
+        }
+    }
+    make_heap(expiry_heap_.begin(), expiry_heap_.end(), greater<expiry_entry>());
+}
+
+} // Tins
+
+#endif // TINS_IS_CXX11
@@ -28,12 +28,14 @@
  */
 
 #include <vector>
+#include <cstring>
 #include <tins/dhcpv6.h>
 #include <tins/exceptions.h>
 #include <tins/memory_helpers.h>
 
 using std::vector;
 using std::memcpy;
+using std::memset;
 using std::equal;
 
 using Tins::Memory::InputMemoryStream;
@@ -41,6 +43,9 @@ using Tins::Memory::OutputMemoryStream;
 
 namespace Tins {
 
+// Options whose type is below this are indexed
+const uint16_t OPTION_INDEX_SIZE = 256;
+
 namespace Internals {
 
 template<typename InputIterator>
@@ -98,12 +103,12 @@ PDU::metadata DHCPv6::extract_metadata(const uint8_t* /*buffer*/, uint32_t total
 }
 
 DHCPv6::DHCPv6() 
-: header_data_(), options_size_() {
+: header_data_(), options_size_(), option_index_() {
 
 }
 
 DHCPv6::DHCPv6(const uint8_t* buffer, uint32_t total_sz) 
-: options_size_() {
+: options_size_(), option_index_() {
     InputMemoryStream stream(buffer, total_sz);
     if (!stream) {
         throw malformed_packet();
@@ -117,18 +122,22 @@ DHCPv6::DHCPv6(const uint8_t* buffer, uint32_t total_sz)
         stream.read(link_addr_);
         stream.read(peer_addr_);
     }
+    Internals::option_block block(stream.pointer(), stream.pointer() + stream.size());
     while (stream) {
         uint16_t opt = stream.read_be<uint16_t>();
         uint16_t data_size = stream.read_be<uint16_t>();
         if (!stream.can_read(data_size)) {
             throw malformed_packet();
         }
-        add_option(option(opt, stream.pointer(), stream.pointer() + data_size));
+        add_option(option(opt, data_size, stream.pointer(), data_size, block));
         stream.skip(data_size);
     }
 }
     
 void DHCPv6::add_option(const option& opt) {
+    if (opt.option() < OPTION_INDEX_SIZE && option_index_[opt.option()] == 0) {
+        option_index_[opt.option()] = static_cast<uint16_t>(options_.size() + 1);
+    }
     options_.push_back(opt);
     options_size_ += opt.data_size() + sizeof(uint16_t) * 2;
 }
@@ -140,11 +149,15 @@ bool DHCPv6::remove_option(OptionTypes type) {
     }
     options_size_ -= iter->data_size() + sizeof(uint16_t) * 2;
     options_.erase(iter);
+    rebuild_option_index();
     return true;
 }
 
 const DHCPv6::option* DHCPv6::search_option(OptionTypes type) const {
-    // Search for the iterator. If we found something, return it, otherwise return nullptr.
+    if (static_cast<uint16_t>(type) < OPTION_INDEX_SIZE) {
+        const uint16_t position = option_index_[type];
+        return (position != 0) ? &options_[position - 1] : 0;
+    }
     options_type::const_iterator iter = search_option_iterator(type);
     return (iter != options_.end()) ? &*iter : 0;
 }
@@ -154,9 +167,23 @@ DHCPv6::options_type::const_iterator DHCPv6::search_option_iterator(OptionTypes
 }
 
 DHCPv6::options_type::iterator DHCPv6::search_option_iterator(OptionTypes type) {
+    if (static_cast<uint16_t>(type) < OPTION_INDEX_SIZE) {
+        const uint16_t position = option_index_[type];
+        return (position != 0) ? options_.begin() + (position - 1) : options_.end();
+    }
     return Internals::find_option<option>(options_, type);
 }
 
+void DHCPv6::rebuild_option_index() {
+    memset(option_index_, 0, sizeof(option_index_));
+    for (size_t i = 0; i < options_.size(); ++i) {
+        const uint16_t type = options_[i].option();
+        if (type < OPTION_INDEX_SIZE && option_index_[type] == 0) {
+            option_index_[type] = static_cast<uint16_t>(i + 1);
+        }
+    }
+}
+
 void DHCPv6::write_option(const option& opt, OutputMemoryStream& stream) const {
     stream.write_be<uint16_t>(opt.option());
     stream.write_be<uint16_t>(opt.length_field());
@@ -35,6 +35,7 @@
 #include <tins/exceptions.h>
 #include <tins/endianness.h>
 #include <tins/memory_helpers.h>
+#include <tins/detail/hash_table_helpers.h>
 
 using std::string;
 using std::memcpy;
@@ -42,6 +43,7 @@ using std::make_pair;
 
 using Tins::Memory::InputMemoryStream;
 using Tins::Memory::OutputMemoryStream;
+using Tins::Internals::ascii_to_lower;
 
 namespace Tins {
 
@@ -332,15 +334,64 @@ string DNS::decode_domain_name(const string& domain_name) {
     return output;
 }
 
+// Remembers the names found at compression pointer targets. Within a 
+// message, records tend to point to the same few suffixes (e.g. the 
+// question's name), so these are only decoded once.
+struct DNS::name_memo {
+    static const size_t MAX_ENTRIES = 16;
+    static const size_t TEXT_SIZE = 2048;
+
+    name_memo() : size(0), text_size(0) {
+
+    }
+
+    bool find(uint16_t target, const char*& suffix, size_t& suffix_size) const {
+        for (size_t i = 0; i < size; ++i) {
+            if (targets[i] == target) {
+                suffix = text + starts[i];
+                suffix_size = lengths[i];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void add(uint16_t target, const char* suffix, size_t suffix_size) {
+        const char* dummy;
+        size_t dummy_size;
+        if (size == MAX_ENTRIES || text_size + suffix_size > TEXT_SIZE ||
+            find(target, dummy, dummy_size)) {
+            return;
+        }
+        memcpy(text + text_size, suffix, suffix_size);
+        targets[size] = target;
+        starts[size] = static_cast<uint16_t>(text_size);
+        lengths[size] = static_cast<uint8_t>(suffix_size);
+        text_size += suffix_size;
+        ++size;
+    }
+
+    uint16_t targets[MAX_ENTRIES];
+    uint16_t starts[MAX_ENTRIES];
+    uint8_t lengths[MAX_ENTRIES];
+    size_t size;
+    size_t text_size;
+    char text[TEXT_SIZE];
+};
+
 // The output buffer should be at least 256 bytes long. This used to use
 // a std::string but it worked about 50% slower, so this is somehow 
 // unsafe but a lot faster.
-uint32_t DNS::compose_name(const uint8_t* ptr, char* out_ptr) const {
+uint32_t DNS::compose_name(const uint8_t* ptr, char* out_ptr, name_memo* memo) const {
     const uint8_t* start_ptr = ptr;
     const uint8_t* end = &records_data_[0] + records_data_.size();
     const uint8_t* end_ptr = 0;
     char* current_out_ptr = out_ptr;
     uint8_t pointer_counter = 0;
+    // The pointers followed and where their suffix starts in the output
+    uint16_t jump_targets[32];
+    size_t jump_starts[32];
+    size_t jumps = 0;
     while (*ptr) {
         if (pointer_counter++ > 30){
             throw dns_decompression_pointer_loops();
@@ -361,6 +412,28 @@ uint32_t DNS::compose_name(const uint8_t* ptr, char* out_ptr) const {
             if (end_ptr == 0) {
                 end_ptr = ptr + sizeof(uint16_t);
             }
+            if (memo) {
+                const char* suffix;
+                size_t suffix_size;
+                if (memo->find(index, suffix, suffix_size)) {
+                    if (TINS_UNLIKELY(current_out_ptr - out_ptr + suffix_size + 1 > 255)) {
+                        throw malformed_packet();
+                    }
+                    if (suffix_size > 0 && current_out_ptr != out_ptr) {
+                        *current_out_ptr++ = '.';
+                    }
+                    memcpy(current_out_ptr, suffix, suffix_size);
+                    current_out_ptr += suffix_size;
+                    break;
+                }
+                jump_targets[jumps] = index;
+                jump_starts[jumps] = current_out_ptr - out_ptr;
+                // Skip the dot that will be added before the next label
+                if (current_out_ptr != out_ptr) {
+                    ++jump_starts[jumps];
+                }
+                ++jumps;
+            }
             // Now this is our pointer
             ptr = &records_data_[index - 0x0c];
         }
@@ -385,6 +458,11 @@ uint32_t DNS::compose_name(const uint8_t* ptr, char* out_ptr) const {
     if (!end_ptr) {
         end_ptr = ptr + 1;
     }
+    const size_t name_size = current_out_ptr - out_ptr;
+    for (size_t i = 0; i < jumps; ++i) {
+        const size_t start = (jump_starts[i] > name_size) ? name_size : jump_starts[i];
+        memo->add(jump_targets[i], out_ptr + start, name_size - start);
+    }
     return end_ptr - start_ptr;
 }
 
@@ -422,11 +500,12 @@ void DNS::convert_records(const uint8_t* ptr,
                           const uint16_t rr_count) const {
     InputMemoryStream stream(ptr, end - ptr);
     char dname[256], small_addr_buf[256];
+    name_memo memo;
     while (stream && (res.size() < rr_count)) {
         string data;
         bool used_small_buffer = false;
         // Retrieve the record's domain name.
-        stream.skip(compose_name(stream.pointer(), dname));
+        stream.skip(compose_name(stream.pointer(), dname, &memo));
         // Retrieve the following fields.
         uint16_t type, qclass, data_size, preference = 0;
         uint32_t ttl;
@@ -456,15 +535,15 @@ void DNS::convert_records(const uint8_t* ptr,
             case DNAM:
             case PTR:
             case MX:
-                compose_name(stream.pointer(), small_addr_buf);
+                compose_name(stream.pointer(), small_addr_buf, &memo);
                 stream.skip(data_size);
                 used_small_buffer = true;
                 break;
             case SOA:
                 {
-                    stream.skip(compose_name(stream.pointer(), small_addr_buf));
+                    stream.skip(compose_name(stream.pointer(), small_addr_buf, &memo));
                     data = encode_domain_name(small_addr_buf);
-                    stream.skip(compose_name(stream.pointer(), small_addr_buf));
+                    stream.skip(compose_name(stream.pointer(), small_addr_buf, &memo));
                     data += encode_domain_name(small_addr_buf);
                     const uint32_t size_left = sizeof(uint32_t) * 5;
                     if (!stream.can_read(size_left)) {
@@ -560,8 +639,9 @@ DNS::queries_type DNS::queries() const {
     if (!records_data_.empty()) {
         InputMemoryStream stream(&records_data_[0], answers_idx_);
         char buffer[256];
+        name_memo memo;
         while (stream) {
-            stream.skip(compose_name(stream.pointer(), buffer));
+            stream.skip(compose_name(stream.pointer(), buffer, &memo));
             uint16_t query_type = stream.read_be<uint16_t>();
             uint16_t query_class = stream.read_be<uint16_t>();
             #if TINS_IS_CXX11
@@ -615,6 +695,187 @@ DNS::resources_type DNS::additional() const {
     return res;
 }
 
+DNS::record_range DNS::answer_records() const {
+    return make_record_range(answers_idx_, authority_idx_, answers_count());
+}
+
+DNS::record_range DNS::authority_records() const {
+    return make_record_range(authority_idx_, additional_idx_, authority_count());
+}
+
+DNS::record_range DNS::additional_records() const {
+    return make_record_range(
+        additional_idx_,
+        static_cast<uint32_t>(records_data_.size()),
+        additional_count()
+    );
+}
+
+DNS::record_range DNS::make_record_range(uint32_t start, uint32_t end, 
+                                         uint16_t count) const {
+    if (start >= records_data_.size()) {
+        return record_range(record_iterator(), record_iterator());
+    }
+    const uint8_t* base = &records_data_[0];
+    return record_range(
+        record_iterator(this, base + start, base + end, count),
+        record_iterator()
+    );
+}
+
+// Follows any compression pointers starting at ptr and returns a pointer
+// to the next label's size, making sure the label is within bounds.
+const uint8_t* DNS::follow_pointers(const uint8_t* ptr, uint8_t& pointer_counter) const {
+    const uint8_t* base = &records_data_[0];
+    const uint8_t* end = base + records_data_.size();
+    while (true) {
+        if (TINS_UNLIKELY(ptr >= end)) {
+            throw malformed_packet();
+        }
+        if ((*ptr & 0xc0) != 0xc0) {
+            if (TINS_UNLIKELY(ptr + *ptr + 1 > end)) {
+                throw malformed_packet();
+            }
+            return ptr;
+        }
+        if (pointer_counter++ > 30) {
+            throw dns_decompression_pointer_loops();
+        }
+        if (TINS_UNLIKELY(ptr + sizeof(uint16_t) > end)) {
+            throw malformed_packet();
+        }
+        const uint16_t offset = ((*ptr & 0x3f) << 8) | ptr[1];
+        if (offset < 0x0c || base + (offset - 0x0c) >= end) {
+            throw dns_decompression_pointer_out_of_bounds();
+        }
+        ptr = base + (offset - 0x0c);
+    }
+}
+
+// Compares the (possibly compressed) domain name at ptr against a dotted 
+// one, without decompressing it first.
+bool DNS::dname_equals(const uint8_t* ptr, const string& name) const {
+    size_t name_size = name.size();
+    // "example.com." and "example.com" are the same name
+    if (name_size > 0 && name[name_size - 1] == '.') {
+        --name_size;
+    }
+    size_t index = 0;
+    uint8_t pointer_counter = 0;
+    while (true) {
+        ptr = follow_pointers(ptr, pointer_counter);
+        const uint8_t size = *ptr++;
+        if (size == 0) {
+            return index == name_size;
+        }
+        // Every label but the first one is preceded by a dot
+        if (index != 0) {
+            if (index >= name_size || name[index] != '.') {
+                return false;
+            }
+            ++index;
+        }
+        if (name_size - index < size) {
+            return false;
+        }
+        for (uint8_t i = 0; i < size; ++i) {
+            if (ascii_to_lower(ptr[i]) != ascii_to_lower(name[index + i])) {
+                return false;
+            }
+        }
+        index += size;
+        ptr += size;
+    }
+}
+
+// DNS::record_view
+
+string DNS::record_view::dname() const {
+    char buffer[256];
+    dns_->compose_name(name_, buffer);
+    return buffer;
+}
+
+bool DNS::record_view::dname_equals(const string& name) const {
+    return dns_->dname_equals(name_, name);
+}
+
+DNS::address_type DNS::record_view::address() const {
+    if (TINS_UNLIKELY(data_size() != sizeof(uint32_t))) {
+        throw malformed_packet();
+    }
+    uint32_t value;
+    memcpy(&value, data_ptr(), sizeof(value));
+    return address_type(value);
+}
+
+DNS::address_v6_type DNS::record_view::address_v6() const {
+    if (TINS_UNLIKELY(data_size() != address_v6_type::address_size)) {
+        throw malformed_packet();
+    }
+    return address_v6_type(data_ptr());
+}
+
+uint16_t DNS::record_view::preference() const {
+    if (TINS_UNLIKELY(data_size() < sizeof(uint16_t))) {
+        throw malformed_packet();
+    }
+    return read_field(10);
+}
+
+const uint8_t* DNS::record_view::target_dname_ptr() const {
+    if (query_type() == MX) {
+        if (TINS_UNLIKELY(data_size() < sizeof(uint16_t))) {
+            throw malformed_packet();
+        }
+        return data_ptr() + sizeof(uint16_t);
+    }
+    return data_ptr();
+}
+
+string DNS::record_view::target_dname() const {
+    char buffer[256];
+    dns_->compose_name(target_dname_ptr(), buffer);
+    return buffer;
+}
+
+bool DNS::record_view::target_dname_equals(const string& name) const {
+    return dns_->dname_equals(target_dname_ptr(), name);
+}
+
+// DNS::record_iterator
+
+DNS::record_iterator::record_iterator(const DNS* dns, const uint8_t* start,
+                                      const uint8_t* end, uint16_t count)
+: end_(end), remaining_(count) {
+    view_.dns_ = dns;
+    load(start);
+}
+
+void DNS::record_iterator::load(const uint8_t* ptr) {
+    static const size_t fields_size = sizeof(uint16_t) * 3 + sizeof(uint32_t);
+    if (remaining_ == 0 || ptr >= end_) {
+        // Become an end iterator
+        *this = record_iterator();
+        return;
+    }
+    InputMemoryStream stream(ptr, end_ - ptr);
+    view_.dns_->skip_to_dname_end(stream);
+    if (TINS_UNLIKELY(!stream.can_read(fields_size))) {
+        throw malformed_packet();
+    }
+    view_.name_ = ptr;
+    view_.fields_ = stream.pointer();
+    if (TINS_UNLIKELY(!stream.can_read(fields_size + view_.data_size()))) {
+        throw malformed_packet();
+    }
+}
+
+void DNS::record_iterator::advance() {
+    --remaining_;
+    load(view_.data_ptr() + view_.data_size());
+}
+
 bool DNS::matches_response(const uint8_t* ptr, uint32_t total_sz) const {
     if (total_sz < sizeof(header_)) {
         return false;
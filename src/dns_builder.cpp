@@ -0,0 +1,366 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <cstring>
+#include <algorithm>
+#include <tins/dns_builder.h>
+#include <tins/ip_address.h>
+#include <tins/ipv6_address.h>
+#include <tins/endianness.h>
+#include <tins/exceptions.h>
+#include <tins/memory_helpers.h>
+
+using std::string;
+using std::vector;
+using std::memcpy;
+
+using Tins::Memory::OutputMemoryStream;
+using Tins::Internals::fnv_hash_byte;
+using Tins::Internals::ascii_to_lower;
+using Tins::Internals::FNV_OFFSET_BASIS;
+
+namespace Tins {
+
+const size_t DNS_HEADER_SIZE = 12;
+const size_t MAX_LABEL_SIZE = 63;
+const size_t MAX_ENCODED_NAME_SIZE = 255;
+// Compression pointers only have 14 bits for the offset
+const size_t MAX_POINTER_OFFSET = 0x4000;
+const uint8_t MAX_POINTERS_FOLLOWED = 10;
+
+// Hashes the label lengths and lowercase contents of name[start, size)
+uint64_t hash_suffix(const string& name, size_t start, size_t size) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    while (start < size) {
+        size_t end = name.find('.', start);
+        if (end == string::npos || end > size) {
+            end = size;
+        }
+        hash = fnv_hash_byte(hash, static_cast<uint8_t>(end - start));
+        for (size_t i = start; i < end; ++i) {
+            hash = fnv_hash_byte(hash, ascii_to_lower(name[i]));
+        }
+        start = end + 1;
+    }
+    return hash;
+}
+
+// Same as above, but over an encoded name. Returns false if it's malformed
+bool hash_suffix(const DNSBuilder::buffer_type& buffer, size_t offset, uint64_t& hash) {
+    uint8_t pointers_followed = 0;
+    hash = FNV_OFFSET_BASIS;
+    while (offset < buffer.size() && buffer[offset] != 0) {
+        const uint8_t size = buffer[offset];
+        if ((size & 0xc0) == 0xc0) {
+            if (offset + 1 >= buffer.size() || 
+                ++pointers_followed > MAX_POINTERS_FOLLOWED) {
+                return false;
+            }
+            offset = ((size & 0x3f) << 8) | buffer[offset + 1];
+            continue;
+        }
+        if ((size & 0xc0) != 0 || offset + 1 + size > buffer.size()) {
+            return false;
+        }
+        hash = fnv_hash_byte(hash, size);
+        for (size_t i = 0; i < size; ++i) {
+            hash = fnv_hash_byte(hash, ascii_to_lower(buffer[offset + 1 + i]));
+        }
+        offset += size + 1;
+    }
+    return offset < buffer.size();
+}
+
+DNSBuilder::DNSBuilder() {
+    clear();
+}
+
+DNSBuilder::DNSBuilder(const DNS& query) 
+: section_(QUESTIONS) {
+    const uint8_t* header = reinterpret_cast<const uint8_t*>(&query.header_);
+    buffer_.assign(header, header + sizeof(query.header_));
+    if (query.answers_idx_ > 0) {
+        buffer_.insert(
+            buffer_.end(),
+            query.records_data_.begin(),
+            query.records_data_.begin() + query.answers_idx_
+        );
+    }
+    type(DNS::RESPONSE);
+    // Only the questions are kept
+    std::fill(buffer_.begin() + 6, buffer_.begin() + DNS_HEADER_SIZE, 0);
+
+    // Let the answers point to the names in the questions
+    size_t offset = DNS_HEADER_SIZE;
+    const uint16_t questions = query.questions_count();
+    for (uint16_t i = 0; i < questions && offset < buffer_.size(); ++i) {
+        while (offset < buffer_.size() && buffer_[offset] != 0 && 
+               (buffer_[offset] & 0xc0) == 0) {
+            uint64_t hash;
+            if (offset < MAX_POINTER_OFFSET && hash_suffix(buffer_, offset, hash)) {
+                suffixes_.insert(hash, static_cast<uint16_t>(offset));
+            }
+            offset += buffer_[offset] + 1;
+        }
+        if (offset < buffer_.size() && buffer_[offset] != 0) {
+            // Skip the pointer's second byte
+            ++offset;
+        }
+        // Skip the null byte/pointer, type and class
+        offset += 1 + sizeof(uint16_t) * 2;
+    }
+}
+
+DNSBuilder& DNSBuilder::id(uint16_t value) {
+    buffer_[0] = static_cast<uint8_t>(value >> 8);
+    buffer_[1] = static_cast<uint8_t>(value);
+    return *this;
+}
+
+DNSBuilder& DNSBuilder::type(DNS::QRType value) {
+    buffer_[2] = (buffer_[2] & 0x7f) | ((value & 1) << 7);
+    return *this;
+}
+
+DNSBuilder& DNSBuilder::authoritative_answer(uint8_t value) {
+    buffer_[2] = (buffer_[2] & 0xfb) | ((value & 1) << 2);
+    return *this;
+}
+
+DNSBuilder& DNSBuilder::recursion_desired(uint8_t value) {
+    buffer_[2] = (buffer_[2] & 0xfe) | (value & 1);
+    return *this;
+}
+
+DNSBuilder& DNSBuilder::recursion_available(uint8_t value) {
+    buffer_[3] = (buffer_[3] & 0x7f) | ((value & 1) << 7);
+    return *this;
+}
+
+DNSBuilder& DNSBuilder::rcode(uint8_t value) {
+    buffer_[3] = (buffer_[3] & 0xf0) | (value & 0x0f);
+    return *this;
+}
+
+DNSBuilder& DNSBuilder::add_query(const DNS::query& query) {
+    start_section(QUESTIONS);
+    write_name(query.dname());
+    const size_t offset = buffer_.size();
+    buffer_.resize(offset + sizeof(uint16_t) * 2);
+    OutputMemoryStream stream(&buffer_[offset], buffer_.size() - offset);
+    stream.write_be<uint16_t>(query.query_type());
+    stream.write_be<uint16_t>(query.query_class());
+    increment_count(QUESTIONS);
+    return *this;
+}
+
+DNSBuilder& DNSBuilder::add_answer(const DNS::resource& resource) {
+    add_record(ANSWERS, resource);
+    return *this;
+}
+
+DNSBuilder& DNSBuilder::add_authority(const DNS::resource& resource) {
+    add_record(AUTHORITY, resource);
+    return *this;
+}
+
+DNSBuilder& DNSBuilder::add_additional(const DNS::resource& resource) {
+    add_record(ADDITIONAL, resource);
+    return *this;
+}
+
+const DNSBuilder::buffer_type& DNSBuilder::buffer() const {
+    return buffer_;
+}
+
+DNS DNSBuilder::build() const {
+    return DNS(&buffer_[0], static_cast<uint32_t>(buffer_.size()));
+}
+
+void DNSBuilder::clear() {
+    buffer_.assign(DNS_HEADER_SIZE, 0);
+    suffixes_.clear();
+    section_ = QUESTIONS;
+}
+
+void DNSBuilder::start_section(Section section) {
+    if (section < section_) {
+        throw invalid_section_order();
+    }
+    section_ = section;
+}
+
+void DNSBuilder::increment_count(Section section) {
+    uint8_t* ptr = &buffer_[4 + section * sizeof(uint16_t)];
+    const uint16_t count = ((ptr[0] << 8) | ptr[1]) + 1;
+    ptr[0] = static_cast<uint8_t>(count >> 8);
+    ptr[1] = static_cast<uint8_t>(count);
+}
+
+void DNSBuilder::add_record(Section section, const DNS::resource& resource) {
+    // Parse addresses before touching the buffer, so an invalid one 
+    // doesn't leave a half written record behind
+    IPv4Address v4_addr;
+    IPv6Address v6_addr;
+    if (resource.query_type() == DNS::A) {
+        v4_addr = resource.data();
+    }
+    else if (resource.query_type() == DNS::AAAA) {
+        v6_addr = resource.data();
+    }
+    start_section(section);
+    write_name(resource.dname());
+    const size_t fields_offset = buffer_.size();
+    const size_t data_offset = fields_offset + sizeof(uint16_t) * 3 + sizeof(uint32_t);
+    buffer_.resize(data_offset);
+    OutputMemoryStream stream(&buffer_[fields_offset], data_offset - fields_offset);
+    stream.write_be<uint16_t>(resource.query_type());
+    stream.write_be<uint16_t>(resource.query_class());
+    stream.write_be(resource.ttl());
+    if (resource.query_type() == DNS::A) {
+        buffer_.resize(data_offset + 4);
+        OutputMemoryStream(&buffer_[data_offset], 4).write(v4_addr);
+    }
+    else if (resource.query_type() == DNS::AAAA) {
+        buffer_.resize(data_offset + IPv6Address::address_size);
+        OutputMemoryStream(
+            &buffer_[data_offset],
+            IPv6Address::address_size
+        ).write(v6_addr);
+    }
+    else if (DNS::contains_dname(resource.query_type())) {
+        if (resource.query_type() == DNS::MX) {
+            buffer_.push_back(static_cast<uint8_t>(resource.preference() >> 8));
+            buffer_.push_back(static_cast<uint8_t>(resource.preference()));
+        }
+        write_name(resource.data());
+    }
+    else {
+        buffer_.insert(buffer_.end(), resource.data().begin(), resource.data().end());
+    }
+    const uint16_t data_size = Endian::host_to_be(
+        static_cast<uint16_t>(buffer_.size() - data_offset)
+    );
+    memcpy(&buffer_[data_offset - sizeof(uint16_t)], &data_size, sizeof(data_size));
+    increment_count(section);
+}
+
+void DNSBuilder::write_name(const string& name) {
+    // "example.com." and "example.com" are the same name
+    const size_t size = (!name.empty() && name[name.size() - 1] == '.') ? 
+                        name.size() - 1 : name.size();
+    vector<size_t> labels;
+    for (size_t start = 0; start < size;) {
+        size_t end = name.find('.', start);
+        if (end == string::npos || end > size) {
+            end = size;
+        }
+        if (end == start || end - start > MAX_LABEL_SIZE) {
+            throw invalid_domain_name();
+        }
+        labels.push_back(start);
+        start = end + 1;
+    }
+    if (size + 2 > MAX_ENCODED_NAME_SIZE) {
+        throw invalid_domain_name();
+    }
+
+    // Find the longest suffix that's already in the buffer
+    vector<uint64_t> hashes;
+    size_t matched = labels.size();
+    uint16_t pointer = 0;
+    for (size_t i = 0; i < labels.size() && matched == labels.size(); ++i) {
+        hashes.push_back(hash_suffix(name, labels[i], size));
+        size_t index = suffixes_.find(hashes.back());
+        for (; index != suffixes_type::npos; index = suffixes_.find_next(index)) {
+            if (suffix_matches(suffixes_.value(index), name, labels[i], size)) {
+                matched = i;
+                pointer = suffixes_.value(index);
+                break;
+            }
+        }
+    }
+    for (size_t i = 0; i < matched; ++i) {
+        const size_t offset = buffer_.size();
+        if (offset < MAX_POINTER_OFFSET) {
+            suffixes_.insert(hashes[i], static_cast<uint16_t>(offset));
+        }
+        const size_t end = (i + 1 < labels.size()) ? labels[i + 1] - 1 : size;
+        buffer_.push_back(static_cast<uint8_t>(end - labels[i]));
+        buffer_.insert(buffer_.end(), name.begin() + labels[i], name.begin() + end);
+    }
+    if (matched < labels.size()) {
+        buffer_.push_back(static_cast<uint8_t>(0xc0 | (pointer >> 8)));
+        buffer_.push_back(static_cast<uint8_t>(pointer));
+    }
+    else {
+        buffer_.push_back(0);
+    }
+}
+
+bool DNSBuilder::suffix_matches(uint16_t name_offset, const string& name, 
+                                size_t start, size_t size) const {
+    size_t offset = name_offset;
+    uint8_t pointers_followed = 0;
+    while (offset < buffer_.size()) {
+        const uint8_t label_size = buffer_[offset];
+        if ((label_size & 0xc0) == 0xc0) {
+            if (offset + 1 >= buffer_.size() || 
+                ++pointers_followed > MAX_POINTERS_FOLLOWED) {
+                return false;
+            }
+            offset = ((label_size & 0x3f) << 8) | buffer_[offset + 1];
+            continue;
+        }
+        if (label_size == 0) {
+            return start >= size;
+        }
+        if (start >= size || offset + 1 + label_size > buffer_.size()) {
+            return false;
+        }
+        size_t end = name.find('.', start);
+        if (end == string::npos || end > size) {
+            end = size;
+        }
+        if (end - start != label_size) {
+            return false;
+        }
+        for (size_t i = 0; i < label_size; ++i) {
+            if (ascii_to_lower(buffer_[offset + 1 + i]) != 
+                ascii_to_lower(name[start + i])) {
+                return false;
+            }
+        }
+        offset += label_size + 1;
+        start = end + 1;
+    }
+    return false;
+}
+
+} // Tins
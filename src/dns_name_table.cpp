@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdexcept>
+#include <tins/dns_name_table.h>
+#include <tins/exceptions.h>
+
+using std::string;
+using std::out_of_range;
+
+using Tins::Internals::fnv_hash_byte;
+using Tins::Internals::ascii_to_lower;
+using Tins::Internals::FNV_OFFSET_BASIS;
+
+namespace Tins {
+
+// "example.com." and "example.com" are the same name
+size_t name_size(const string& name) {
+    if (!name.empty() && name[name.size() - 1] == '.') {
+        return name.size() - 1;
+    }
+    return name.size();
+}
+
+bool names_equal(const string& lhs, const string& rhs) {
+    const size_t size = name_size(lhs);
+    if (size != name_size(rhs)) {
+        return false;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        if (ascii_to_lower(lhs[i]) != ascii_to_lower(rhs[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+DNSNameTable::DNSNameTable()
+: max_size_(0) {
+
+}
+
+void DNSNameTable::max_size(size_t value) {
+    max_size_ = value;
+    while (max_size_ != 0 && size() > max_size_) {
+        erase(lru_.back());
+    }
+}
+
+size_t DNSNameTable::max_size() const {
+    return max_size_;
+}
+
+DNSNameTable::id_type DNSNameTable::intern(const string& name) {
+    const uint64_t hash = hash_name(name);
+    size_t index = index_.find(hash);
+    for (; index != index_type::npos; index = index_.find_next(index)) {
+        if (names_equal(entries_[index_.value(index)].name, name)) {
+            return touch(index_.value(index));
+        }
+    }
+    return add_name(hash, name.substr(0, name_size(name)));
+}
+
+DNSNameTable::id_type DNSNameTable::intern(const DNS::record_view& record) {
+    return intern(*record.dns_, record.name_);
+}
+
+DNSNameTable::id_type DNSNameTable::intern_target(const DNS::record_view& record) {
+    return intern(*record.dns_, record.target_dname_ptr());
+}
+
+DNSNameTable::id_type DNSNameTable::intern_query(const DNS& dns) {
+    if (dns.questions_count() == 0 || dns.records_data_.empty()) {
+        throw malformed_packet();
+    }
+    return intern(dns, &dns.records_data_[0]);
+}
+
+const string& DNSNameTable::name(id_type id) const {
+    if (id >= entries_.size() || !entries_[id].used) {
+        throw out_of_range("No name has this identifier");
+    }
+    return entries_[id].name;
+}
+
+void DNSNameTable::erase(id_type id) {
+    if (id >= entries_.size() || !entries_[id].used) {
+        return;
+    }
+    entry& value = entries_[id];
+    size_t index = index_.find(value.hash);
+    while (index_.value(index) != id) {
+        index = index_.find_next(index);
+    }
+    index_.erase(index);
+    lru_.erase(entries_, id);
+    string().swap(value.name);
+    value.used = false;
+    free_ids_.push_back(id);
+}
+
+size_t DNSNameTable::size() const {
+    return index_.size();
+}
+
+void DNSNameTable::clear() {
+    index_.clear();
+    entries_.clear();
+    free_ids_.clear();
+    lru_.clear();
+}
+
+DNSNameTable::id_type DNSNameTable::intern(const DNS& dns, const uint8_t* ptr) {
+    const uint64_t hash = hash_name(dns, ptr);
+    size_t index = index_.find(hash);
+    for (; index != index_type::npos; index = index_.find_next(index)) {
+        if (dns.dname_equals(ptr, entries_[index_.value(index)].name)) {
+            return touch(index_.value(index));
+        }
+    }
+    // Only decompress names we haven't seen before
+    char buffer[256];
+    dns.compose_name(ptr, buffer);
+    return add_name(hash, buffer);
+}
+
+DNSNameTable::id_type DNSNameTable::add_name(uint64_t hash, const string& name) {
+    if (max_size_ != 0 && size() >= max_size_) {
+        erase(lru_.back());
+    }
+    id_type id;
+    if (free_ids_.empty()) {
+        id = static_cast<id_type>(entries_.size());
+        entries_.push_back(entry());
+    }
+    else {
+        id = free_ids_.back();
+        free_ids_.pop_back();
+    }
+    entry& value = entries_[id];
+    value.name = name;
+    value.hash = hash;
+    value.used = true;
+    index_.insert(hash, id);
+    lru_.push_front(entries_, id);
+    return id;
+}
+
+DNSNameTable::id_type DNSNameTable::touch(id_type id) {
+    lru_.move_to_front(entries_, id);
+    return id;
+}
+
+// Both hash functions hash the label sizes and the lowercased labels,
+// so they yield the same value for the same name
+
+uint64_t DNSNameTable::hash_name(const string& name) {
+    const size_t size = name_size(name);
+    uint64_t hash = FNV_OFFSET_BASIS;
+    size_t label_start = 0;
+    while (label_start < size) {
+        size_t label_end = name.find('.', label_start);
+        if (label_end == string::npos || label_end > size) {
+            label_end = size;
+        }
+        hash = fnv_hash_byte(hash, static_cast<uint8_t>(label_end - label_start));
+        for (size_t i = label_start; i < label_end; ++i) {
+            hash = fnv_hash_byte(hash, ascii_to_lower(name[i]));
+        }
+        label_start = label_end + 1;
+    }
+    return fnv_hash_byte(hash, 0);
+}
+
+uint64_t DNSNameTable::hash_name(const DNS& dns, const uint8_t* ptr) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    uint8_t pointer_counter = 0;
+    while (true) {
+        ptr = dns.follow_pointers(ptr, pointer_counter);
+        const uint8_t size = *ptr++;
+        if (size == 0) {
+            break;
+        }
+        hash = fnv_hash_byte(hash, size);
+        for (uint8_t i = 0; i < size; ++i) {
+            hash = fnv_hash_byte(hash, ascii_to_lower(ptr[i]));
+        }
+        ptr += size;
+    }
+    return fnv_hash_byte(hash, 0);
+}
+
+} // Tins
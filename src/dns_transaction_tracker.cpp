@@ -0,0 +1,561 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/dns_transaction_tracker.h>
+
+#if TINS_IS_CXX11
+
+#include <cstring>
+#include <cmath>
+#include <tins/pdu.h>
+#include <tins/packet.h>
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/udp.h>
+#include <tins/rawpdu.h>
+#include <tins/exceptions.h>
+#include <tins/memory_helpers.h>
+
+using std::vector;
+using std::memcmp;
+using std::memcpy;
+using std::memset;
+using std::chrono::system_clock;
+using std::chrono::duration_cast;
+using std::chrono::seconds;
+
+using Tins::Memory::InputMemoryStream;
+using Tins::Internals::fnv_hash;
+
+namespace Tins {
+
+// Values below this are counted exactly
+const uint64_t LATENCY_LINEAR_BUCKETS = 32;
+// Every power of two above that is split in this many buckets
+const uint64_t LATENCY_SUB_BUCKETS = 16;
+const size_t LATENCY_SUB_BUCKET_BITS = 4;
+// The largest power of two tracked is 2^35us
+const size_t LATENCY_MAX_EXPONENT = 35;
+const size_t LATENCY_BUCKET_COUNT = LATENCY_LINEAR_BUCKETS + 
+    (LATENCY_MAX_EXPONENT - LATENCY_SUB_BUCKET_BITS) * LATENCY_SUB_BUCKETS;
+
+// LatencyHistogram
+
+LatencyHistogram::LatencyHistogram() 
+: count_(0), sum_(0), min_(0), max_(0) {
+
+}
+
+void LatencyHistogram::add(const duration_type& latency) {
+    const uint64_t value = latency.count() > 0 ? latency.count() : 0;
+    if (buckets_.empty()) {
+        buckets_.resize(LATENCY_BUCKET_COUNT);
+    }
+    buckets_[bucket_index(value)]++;
+    if (count_ == 0 || value < min_) {
+        min_ = value;
+    }
+    if (value > max_) {
+        max_ = value;
+    }
+    count_++;
+    sum_ += value;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    if (other.count_ == 0) {
+        return;
+    }
+    if (buckets_.empty()) {
+        buckets_.resize(LATENCY_BUCKET_COUNT);
+    }
+    for (size_t i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+        buckets_[i] += other.buckets_[i];
+    }
+    if (count_ == 0 || other.min_ < min_) {
+        min_ = other.min_;
+    }
+    if (other.max_ > max_) {
+        max_ = other.max_;
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+}
+
+uint64_t LatencyHistogram::count() const {
+    return count_;
+}
+
+LatencyHistogram::duration_type LatencyHistogram::minimum() const {
+    return duration_type(min_);
+}
+
+LatencyHistogram::duration_type LatencyHistogram::maximum() const {
+    return duration_type(max_);
+}
+
+LatencyHistogram::duration_type LatencyHistogram::mean() const {
+    return duration_type(count_ == 0 ? 0 : sum_ / count_);
+}
+
+LatencyHistogram::duration_type LatencyHistogram::percentile(double value) const {
+    if (count_ == 0) {
+        return duration_type(0);
+    }
+    value = value < 0 ? 0 : (value > 100 ? 100 : value);
+    uint64_t target = static_cast<uint64_t>(std::ceil(value / 100 * count_));
+    if (target == 0) {
+        target = 1;
+    }
+    uint64_t accumulated = 0;
+    for (size_t i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+        accumulated += buckets_[i];
+        if (accumulated >= target) {
+            const uint64_t bound = bucket_upper_bound(i);
+            if (i == LATENCY_BUCKET_COUNT - 1 || bound > max_) {
+                return duration_type(max_);
+            }
+            return duration_type(bound < min_ ? min_ : bound);
+        }
+    }
+    return duration_type(max_);
+}
+
+void LatencyHistogram::clear() {
+    buckets_.clear();
+    count_ = sum_ = min_ = max_ = 0;
+}
+
+size_t LatencyHistogram::bucket_index(uint64_t value) {
+    if (value < LATENCY_LINEAR_BUCKETS) {
+        return static_cast<size_t>(value);
+    }
+    size_t exponent = LATENCY_SUB_BUCKET_BITS + 1;
+    while (exponent <= LATENCY_MAX_EXPONENT && (value >> (exponent + 1)) != 0) {
+        ++exponent;
+    }
+    if (exponent > LATENCY_MAX_EXPONENT) {
+        return LATENCY_BUCKET_COUNT - 1;
+    }
+    const size_t shift = exponent - LATENCY_SUB_BUCKET_BITS;
+    return static_cast<size_t>(
+        LATENCY_LINEAR_BUCKETS + 
+        (exponent - LATENCY_SUB_BUCKET_BITS - 1) * LATENCY_SUB_BUCKETS + 
+        ((value >> shift) - LATENCY_SUB_BUCKETS)
+    );
+}
+
+uint64_t LatencyHistogram::bucket_upper_bound(size_t index) {
+    if (index < LATENCY_LINEAR_BUCKETS) {
+        return index;
+    }
+    index -= LATENCY_LINEAR_BUCKETS;
+    const size_t shift = index / LATENCY_SUB_BUCKETS + 1;
+    const uint64_t sub_bucket = LATENCY_SUB_BUCKETS + index % LATENCY_SUB_BUCKETS;
+    return ((sub_bucket + 1) << shift) - 1;
+}
+
+// DNSTransactionTracker
+
+const DNSTransactionTracker::timestamp_type DNSTransactionTracker::DEFAULT_TIMEOUT = seconds(5);
+const size_t DNSTransactionTracker::DEFAULT_MAX_STATISTICS = 4096;
+
+const size_t TRANSACTION_WHEEL_SIZE = 64;
+const uint16_t DNS_PORT = 53;
+
+bool DNSTransactionTracker::transaction_key::operator==(const transaction_key& rhs) const {
+    return memcmp(this, &rhs, sizeof(rhs)) == 0;
+}
+
+DNSTransactionTracker::DNSTransactionTracker() 
+: wheel_(TRANSACTION_WHEEL_SIZE), current_tick_(0), wheel_started_(false),
+  max_statistics_(DEFAULT_MAX_STATISTICS), unanswered_count_(0) {
+    set_timeout(DEFAULT_TIMEOUT);
+}
+
+bool DNSTransactionTracker::process_packet(const PDU& pdu) {
+    const system_clock::duration ts = system_clock::now().time_since_epoch();
+    return process_packet(pdu, duration_cast<timestamp_type>(ts));
+}
+
+bool DNSTransactionTracker::process_packet(const Packet& packet) {
+    if (!packet.pdu()) {
+        return false;
+    }
+    return process_packet(*packet.pdu(), packet.timestamp());
+}
+
+void DNSTransactionTracker::max_statistics(size_t value) {
+    max_statistics_ = value;
+    while (max_statistics_ != 0 && statistics_index_.size() > max_statistics_) {
+        erase_statistics(statistics_lru_.back());
+    }
+}
+
+size_t DNSTransactionTracker::max_statistics() const {
+    return max_statistics_;
+}
+
+DNSTransactionTracker::statistics_type DNSTransactionTracker::statistics() const {
+    statistics_type output;
+    output.reserve(statistics_index_.size());
+    for (size_t i = 0; i < statistics_index_.slot_count(); ++i) {
+        if (!statistics_index_.used(i)) {
+            continue;
+        }
+        const name_statistics& value = name_statistics_[statistics_index_.value(i)];
+        query_statistics stats;
+        stats.name = names_.name(static_cast<DNSNameTable::id_type>(value.key >> 16));
+        stats.type = static_cast<DNS::QueryType>(value.key & 0xffff);
+        stats.latency = value.latency;
+        stats.unanswered = value.unanswered;
+        output.push_back(stats);
+    }
+    return output;
+}
+
+const DNSTransactionTracker::histogram_type& DNSTransactionTracker::latency() const {
+    return latency_;
+}
+
+uint64_t DNSTransactionTracker::answered_count() const {
+    return latency_.count();
+}
+
+uint64_t DNSTransactionTracker::unanswered_count() const {
+    return unanswered_count_;
+}
+
+size_t DNSTransactionTracker::pending_transactions() const {
+    return transactions_.size();
+}
+
+void DNSTransactionTracker::merge(const DNSTransactionTracker& other) {
+    const statistics_index_type& other_index = other.statistics_index_;
+    for (size_t i = 0; i < other_index.slot_count(); ++i) {
+        if (!other_index.used(i)) {
+            continue;
+        }
+        const name_statistics& value = other.name_statistics_[other_index.value(i)];
+        const DNSNameTable::id_type other_id = 
+            static_cast<DNSNameTable::id_type>(value.key >> 16);
+        const uint64_t id = names_.intern(other.names_.name(other_id));
+        name_statistics& stats = find_statistics((id << 16) | (value.key & 0xffff));
+        stats.latency.merge(value.latency);
+        stats.unanswered += value.unanswered;
+    }
+    latency_.merge(other.latency_);
+    unanswered_count_ += other.unanswered_count_;
+}
+
+void DNSTransactionTracker::clear_statistics() {
+    for (size_t i = 0; i < statistics_index_.slot_count(); ++i) {
+        if (statistics_index_.used(i)) {
+            const uint64_t key = name_statistics_[statistics_index_.value(i)].key;
+            release_name(static_cast<DNSNameTable::id_type>(key >> 16));
+        }
+    }
+    name_statistics_.clear();
+    statistics_index_.clear();
+    statistics_lru_.clear();
+    free_statistics_.clear();
+    latency_.clear();
+    unanswered_count_ = 0;
+}
+
+size_t DNSTransactionTracker::shard(const PDU& pdu, size_t shard_count) {
+    transaction_key key;
+    const DNS* dns;
+    DNS parsed_dns;
+    if (shard_count == 0 || !make_key(pdu, key, dns, parsed_dns)) {
+        return 0;
+    }
+    return static_cast<size_t>(hash_key(key) % shard_count);
+}
+
+size_t DNSTransactionTracker::shard(const Packet& packet, size_t shard_count) {
+    return packet.pdu() ? shard(*packet.pdu(), shard_count) : 0;
+}
+
+bool DNSTransactionTracker::make_key(const PDU& pdu, transaction_key& key, 
+                                     const DNS*& dns, DNS& parsed_dns) {
+    const UDP* udp = pdu.find_pdu<UDP>();
+    if (!udp) {
+        return false;
+    }
+    dns = udp->find_pdu<DNS>();
+    if (!dns) {
+        const RawPDU* raw = udp->find_pdu<RawPDU>();
+        if (!raw || (udp->sport() != DNS_PORT && udp->dport() != DNS_PORT)) {
+            return false;
+        }
+        try {
+            parsed_dns = raw->to<DNS>();
+        }
+        catch (exception_base&) {
+            return false;
+        }
+        dns = &parsed_dns;
+    }
+    // Clients' addresses and ports are the source ones on queries
+    const bool is_query = dns->type() == DNS::QUERY;
+    memset(&key, 0, sizeof(key));
+    if (const IP* ip = pdu.find_pdu<IP>()) {
+        // Use IPv4 mapped addresses, e.g. ::ffff:192.168.0.1
+        const uint32_t src = ip->src_addr(), dst = ip->dst_addr();
+        key.client[10] = key.client[11] = key.server[10] = key.server[11] = 0xff;
+        memcpy(key.client + 12, is_query ? &src : &dst, sizeof(uint32_t));
+        memcpy(key.server + 12, is_query ? &dst : &src, sizeof(uint32_t));
+    }
+    else if (const IPv6* ipv6 = pdu.find_pdu<IPv6>()) {
+        const IPv6::address_type& src = ipv6->src_addr(), &dst = ipv6->dst_addr();
+        (is_query ? src : dst).copy(key.client);
+        (is_query ? dst : src).copy(key.server);
+    }
+    else {
+        return false;
+    }
+    key.client_port = is_query ? udp->sport() : udp->dport();
+    key.id = dns->id();
+    return true;
+}
+
+uint64_t DNSTransactionTracker::hash_key(const transaction_key& key) {
+    return fnv_hash(&key, sizeof(key));
+}
+
+// The type lives in the lower bits, so mix the whole key
+uint64_t DNSTransactionTracker::hash_statistics_key(uint64_t key) {
+    return fnv_hash(&key, sizeof(key));
+}
+
+bool DNSTransactionTracker::process_packet(const PDU& pdu, const timestamp_type& ts) {
+    advance_wheel(ts);
+    transaction_key key;
+    const DNS* dns;
+    DNS parsed_dns;
+    if (!make_key(pdu, key, dns, parsed_dns)) {
+        return false;
+    }
+    const size_t index = find_transaction(key);
+    if (dns->type() == DNS::QUERY) {
+        // Retransmissions are measured from the first query
+        if (index != transactions_type::npos) {
+            return false;
+        }
+        transaction value;
+        value.key = key;
+        value.timestamp = ts;
+        try {
+            value.statistics_key = statistics_key(*dns);
+        }
+        catch (exception_base&) {
+            return false;
+        }
+        acquire_name(static_cast<DNSNameTable::id_type>(value.statistics_key >> 16));
+        transactions_.insert(hash_key(key), value);
+        wheel_entry entry;
+        entry.key = key;
+        entry.timestamp = ts;
+        entry.deadline = ts + timeout_;
+        schedule(entry);
+        return false;
+    }
+    if (index == transactions_type::npos) {
+        return false;
+    }
+    const transaction& current = transactions_.value(index);
+    const timestamp_type latency = ts - current.timestamp;
+    find_statistics(current.statistics_key).latency.add(latency);
+    latency_.add(latency);
+    erase_transaction(index);
+    return true;
+}
+
+// The first question's interned name in the upper bits and its type 
+// in the lower 16 bits
+uint64_t DNSTransactionTracker::statistics_key(const DNS& dns) {
+    // Read the type first so malformed questions don't intern anything
+    if (dns.questions_count() == 0 || dns.records_data_.empty()) {
+        throw malformed_packet();
+    }
+    InputMemoryStream stream(dns.records_data_);
+    dns.skip_to_dname_end(stream);
+    const uint16_t type = stream.read_be<uint16_t>();
+    const uint64_t id = names_.intern_query(dns);
+    return (id << 16) | type;
+}
+
+size_t DNSTransactionTracker::find_transaction(const transaction_key& key) const {
+    size_t index = transactions_.find(hash_key(key));
+    while (index != transactions_type::npos && !(transactions_.value(index).key == key)) {
+        index = transactions_.find_next(index);
+    }
+    return index;
+}
+
+void DNSTransactionTracker::erase_transaction(size_t index) {
+    const uint64_t key = transactions_.value(index).statistics_key;
+    transactions_.erase(index);
+    release_name(static_cast<DNSNameTable::id_type>(key >> 16));
+}
+
+// Finds the statistics for a key, adding them if they're not there. 
+// The least recently updated ones are discarded if there are too many
+DNSTransactionTracker::name_statistics& DNSTransactionTracker::find_statistics(uint64_t key) {
+    const uint64_t hash = hash_statistics_key(key);
+    size_t index = statistics_index_.find(hash);
+    while (index != statistics_index_type::npos) {
+        const uint32_t position = statistics_index_.value(index);
+        if (name_statistics_[position].key == key) {
+            statistics_lru_.move_to_front(name_statistics_, position);
+            return name_statistics_[position];
+        }
+        index = statistics_index_.find_next(index);
+    }
+    uint32_t position;
+    if (free_statistics_.empty()) {
+        position = static_cast<uint32_t>(name_statistics_.size());
+        name_statistics_.push_back(name_statistics());
+    }
+    else {
+        position = free_statistics_.back();
+        free_statistics_.pop_back();
+    }
+    name_statistics& value = name_statistics_[position];
+    value.key = key;
+    acquire_name(static_cast<DNSNameTable::id_type>(key >> 16));
+    statistics_index_.insert(hash, position);
+    statistics_lru_.push_front(name_statistics_, position);
+    // The new entry is the most recent one, so it's never the one evicted
+    while (max_statistics_ != 0 && statistics_index_.size() > max_statistics_) {
+        erase_statistics(statistics_lru_.back());
+    }
+    return value;
+}
+
+void DNSTransactionTracker::erase_statistics(uint32_t position) {
+    name_statistics& value = name_statistics_[position];
+    size_t index = statistics_index_.find(hash_statistics_key(value.key));
+    while (statistics_index_.value(index) != position) {
+        index = statistics_index_.find_next(index);
+    }
+    statistics_index_.erase(index);
+    statistics_lru_.erase(name_statistics_, position);
+    release_name(static_cast<DNSNameTable::id_type>(value.key >> 16));
+    value = name_statistics();
+    free_statistics_.push_back(position);
+}
+
+void DNSTransactionTracker::acquire_name(DNSNameTable::id_type id) {
+    if (id >= name_references_.size()) {
+        name_references_.resize(id + 1);
+    }
+    name_references_[id]++;
+}
+
+void DNSTransactionTracker::release_name(DNSNameTable::id_type id) {
+    if (--name_references_[id] == 0) {
+        names_.erase(id);
+    }
+}
+
+void DNSTransactionTracker::set_timeout(const timestamp_type& value) {
+    const timestamp_type old_tick = tick_duration_;
+    timeout_ = value;
+    tick_duration_ = timeout_ / TRANSACTION_WHEEL_SIZE;
+    if (tick_duration_ < timestamp_type(1)) {
+        tick_duration_ = timestamp_type(1);
+    }
+    if (!wheel_started_ || old_tick == tick_duration_) {
+        return;
+    }
+    // Place the pending queries in the buckets that match the new tick size
+    vector<wheel_entry> entries;
+    for (size_t i = 0; i < wheel_.size(); ++i) {
+        entries.insert(entries.end(), wheel_[i].begin(), wheel_[i].end());
+        wheel_[i].clear();
+    }
+    current_tick_ = current_tick_ * old_tick.count() / tick_duration_.count();
+    for (size_t i = 0; i < entries.size(); ++i) {
+        schedule(entries[i]);
+    }
+}
+
+void DNSTransactionTracker::schedule(const wheel_entry& entry) {
+    uint64_t tick = entry.deadline.count() > 0 ? 
+                    entry.deadline.count() / tick_duration_.count() : 0;
+    // Packets can arrive slightly out of order
+    if (tick < current_tick_) {
+        tick = current_tick_;
+    }
+    wheel_[tick % TRANSACTION_WHEEL_SIZE].push_back(entry);
+}
+
+void DNSTransactionTracker::advance_wheel(const timestamp_type& now) {
+    const uint64_t now_tick = now.count() > 0 ? now.count() / tick_duration_.count() : 0;
+    if (!wheel_started_) {
+        current_tick_ = now_tick;
+        wheel_started_ = true;
+        return;
+    }
+    if (now_tick > current_tick_ + TRANSACTION_WHEEL_SIZE) {
+        // Every bucket has to be looked at anyway
+        current_tick_ = now_tick - TRANSACTION_WHEEL_SIZE;
+    }
+    while (current_tick_ < now_tick) {
+        expire_bucket(current_tick_ % TRANSACTION_WHEEL_SIZE, now);
+        current_tick_++;
+    }
+}
+
+// Buckets can also contain entries for later laps around the wheel and
+// entries for queries that were already answered
+void DNSTransactionTracker::expire_bucket(size_t index, const timestamp_type& now) {
+    vector<wheel_entry>& bucket = wheel_[index];
+    size_t kept = 0;
+    for (size_t i = 0; i < bucket.size(); ++i) {
+        if (bucket[i].deadline > now) {
+            bucket[kept++] = bucket[i];
+            continue;
+        }
+        const size_t current = find_transaction(bucket[i].key);
+        if (current != transactions_type::npos && 
+            transactions_.value(current).timestamp == bucket[i].timestamp) {
+            find_statistics(transactions_.value(current).statistics_key).unanswered++;
+            unanswered_count_++;
+            erase_transaction(current);
+        }
+    }
+    bucket.resize(kept);
+}
+
+} // Tins
+
+#endif // TINS_IS_CXX11
@@ -81,13 +81,14 @@ void Dot11::write_fixed_parameters(Memory::OutputMemoryStream& /*stream*/) {
 
 void Dot11::parse_tagged_parameters(InputMemoryStream& stream) {
     if (stream) {
+        Internals::option_block block(stream.pointer(), stream.pointer() + stream.size());
         while (stream.size() >= 2) {
             OptionTypes opcode = static_cast<OptionTypes>(stream.read<uint8_t>());
             uint8_t length = stream.read<uint8_t>();
             if (!stream.can_read(length)) {
                 throw malformed_packet();
             }
-            add_tagged_option(opcode, length, stream.pointer());
+            add_option(option(opcode, length, stream.pointer(), length, block));
             stream.skip(length);
         }
     }
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/dot11/dot11_mgmt_scanner.h>
+#ifdef TINS_HAVE_DOT11
+
+#include <cstring>
+#include <tins/exceptions.h>
+
+using std::string;
+using std::memcpy;
+using std::memset;
+
+namespace Tins {
+
+// Frame control, duration, 3 addresses and sequence control
+const uint32_t MGMT_SCANNER_HEADER_SIZE = 24;
+const uint32_t MGMT_SCANNER_HT_CONTROL_SIZE = 4;
+const uint8_t MGMT_SCANNER_TO_DS = 0x01;
+const uint8_t MGMT_SCANNER_FROM_DS = 0x02;
+const uint8_t MGMT_SCANNER_PROTECTED = 0x40;
+const uint8_t MGMT_SCANNER_ORDER = 0x80;
+
+// Returns the size of the fixed parameters that precede the tagged ones,
+// or -1 if this subtype has no tagged parameters
+static int mgmt_fixed_parameters_size(uint8_t subtype) {
+    switch (subtype) {
+        case Dot11::ASSOC_REQ:
+            return 4;
+        case Dot11::ASSOC_RESP:
+        case Dot11::REASSOC_RESP:
+        case Dot11::AUTH:
+            return 6;
+        case Dot11::REASSOC_REQ:
+            return 10;
+        case Dot11::PROBE_REQ:
+            return 0;
+        case Dot11::PROBE_RESP:
+        case Dot11::BEACON:
+            return 12;
+        default:
+            return -1;
+    }
+}
+
+// handler_holder
+
+#if TINS_IS_CXX11
+struct Dot11MgmtScanner::handler_holder {
+    handler_type handler;
+};
+#else // TINS_IS_CXX11
+struct Dot11MgmtScanner::handler_holder {
+
+};
+#endif // TINS_IS_CXX11
+
+// Dot11MgmtScanner
+
+Dot11MgmtScanner::Dot11MgmtScanner() 
+: frame_(0), handler_(0), generation_(1) {
+    memset(generations_, 0, sizeof(generations_));
+    request_all();
+}
+
+Dot11MgmtScanner::Dot11MgmtScanner(const Dot11MgmtScanner& other)
+: frame_(0), handler_(0) {
+    *this = other;
+}
+
+Dot11MgmtScanner& Dot11MgmtScanner::operator=(const Dot11MgmtScanner& other) {
+    if (this != &other) {
+        handler_holder* handler = 0;
+        if (other.handler_) {
+            handler = new handler_holder(*other.handler_);
+        }
+        delete handler_;
+        handler_ = handler;
+        frame_ = other.frame_;
+        memcpy(requested_, other.requested_, sizeof(requested_));
+        memcpy(elements_, other.elements_, sizeof(elements_));
+        memcpy(generations_, other.generations_, sizeof(generations_));
+        generation_ = other.generation_;
+    }
+    return *this;
+}
+
+Dot11MgmtScanner::~Dot11MgmtScanner() {
+    delete handler_;
+}
+
+void Dot11MgmtScanner::request(uint8_t id) {
+    requested_[id / 64] |= uint64_t(1) << (id % 64);
+}
+
+void Dot11MgmtScanner::request_all() {
+    memset(requested_, 0xff, sizeof(requested_));
+}
+
+void Dot11MgmtScanner::clear_requests() {
+    memset(requested_, 0, sizeof(requested_));
+}
+
+#if TINS_IS_CXX11
+void Dot11MgmtScanner::handler(const handler_type& value) {
+    if (!value) {
+        delete handler_;
+        handler_ = 0;
+    }
+    else if (handler_) {
+        handler_->handler = value;
+    }
+    else {
+        handler_ = new handler_holder();
+        handler_->handler = value;
+    }
+}
+#endif // TINS_IS_CXX11
+
+bool Dot11MgmtScanner::scan(const uint8_t* buffer, uint32_t total_sz) {
+    frame_ = 0;
+    // Elements found in previous frames are discarded by moving on to 
+    // the next generation
+    if (++generation_ == 0) {
+        memset(generations_, 0, sizeof(generations_));
+        generation_ = 1;
+    }
+    if (total_sz < MGMT_SCANNER_HEADER_SIZE || 
+        ((buffer[0] >> 2) & 0x03) != Dot11::MANAGEMENT) {
+        return false;
+    }
+    frame_ = buffer;
+    const int fixed_size = mgmt_fixed_parameters_size(subtype());
+    if (fixed_size < 0 || (buffer[1] & MGMT_SCANNER_PROTECTED) != 0) {
+        return true;
+    }
+    uint32_t offset = MGMT_SCANNER_HEADER_SIZE + fixed_size;
+    if ((buffer[1] & MGMT_SCANNER_ORDER) != 0) {
+        offset += MGMT_SCANNER_HT_CONTROL_SIZE;
+    }
+    while (offset + 2 <= total_sz) {
+        const uint8_t id = buffer[offset];
+        const uint8_t length = buffer[offset + 1];
+        offset += 2;
+        if (length > total_sz - offset) {
+            break;
+        }
+        if ((requested_[id / 64] >> (id % 64)) & 1) {
+            element& current = elements_[id];
+            if (generations_[id] != generation_) {
+                current.data = buffer + offset;
+                current.offset = offset;
+                current.id = id;
+                current.length = length;
+                generations_[id] = generation_;
+            }
+            #if TINS_IS_CXX11
+                if (handler_) {
+                    element value;
+                    value.data = buffer + offset;
+                    value.offset = offset;
+                    value.id = id;
+                    value.length = length;
+                    handler_->handler(value);
+                }
+            #endif // TINS_IS_CXX11
+        }
+        offset += length;
+    }
+    return true;
+}
+
+uint8_t Dot11MgmtScanner::subtype() const {
+    return frame_ ? frame_[0] >> 4 : 0;
+}
+
+bool Dot11MgmtScanner::to_ds() const {
+    return frame_ && (frame_[1] & MGMT_SCANNER_TO_DS) != 0;
+}
+
+bool Dot11MgmtScanner::from_ds() const {
+    return frame_ && (frame_[1] & MGMT_SCANNER_FROM_DS) != 0;
+}
+
+Dot11MgmtScanner::address_type Dot11MgmtScanner::addr1() const {
+    return frame_ ? address_type(frame_ + 4) : address_type();
+}
+
+Dot11MgmtScanner::address_type Dot11MgmtScanner::addr2() const {
+    return frame_ ? address_type(frame_ + 4 + address_type::address_size) : address_type();
+}
+
+Dot11MgmtScanner::address_type Dot11MgmtScanner::addr3() const {
+    return frame_ ? address_type(frame_ + 4 + address_type::address_size * 2) : 
+                    address_type();
+}
+
+const Dot11MgmtScanner::element* Dot11MgmtScanner::search_element(uint8_t id) const {
+    return generations_[id] == generation_ ? &elements_[id] : 0;
+}
+
+string Dot11MgmtScanner::ssid() const {
+    const element* ssid_element = search_element(Dot11::SSID);
+    if (!ssid_element) {
+        throw option_not_found();
+    }
+    const char* data = reinterpret_cast<const char*>(ssid_element->data);
+    return string(data, data + ssid_element->length);
+}
+
+uint8_t Dot11MgmtScanner::channel() const {
+    const element* channel_element = search_element(Dot11::DS_SET);
+    if (!channel_element || channel_element->length == 0) {
+        channel_element = search_element(Dot11::HT_OPERATION);
+    }
+    if (!channel_element || channel_element->length == 0) {
+        throw option_not_found();
+    }
+    return channel_element->data[0];
+}
+
+} // Tins
+
+#endif // TINS_HAVE_DOT11
@@ -32,16 +32,135 @@
 #ifdef TINS_HAVE_DOT11
 
 #include <algorithm>
+#include <cstring>
 #include <tins/dot11/dot11_data.h>
+#include <tins/packet.h>
+#include <tins/timestamp.h>
+#include <tins/detail/hash_table_helpers.h>
 
-using std::max_element;
 using std::max;
 using std::min;
-using std::pair;
+using std::make_pair;
+using std::memcmp;
+
+using Tins::Internals::fnv_hash;
 
 namespace Tins {
 
+static const uint64_t handshake_capturer_microseconds_per_second = 1000000;
+
+static uint64_t handshake_capturer_microseconds(const Timestamp& ts) {
+    return static_cast<uint64_t>(ts.seconds()) * handshake_capturer_microseconds_per_second +
+           ts.microseconds();
+}
+
+const uint32_t RSNHandshakeCapturer::DEFAULT_TIMEOUT = 60;
+
+// address_pair_key
+
+RSNHandshakeCapturer::address_pair_key::address_pair_key(const address_type& addr1,
+                                                         const address_type& addr2) {
+    min(addr1, addr2).copy(data);
+    max(addr1, addr2).copy(data + address_type::address_size);
+}
+
+bool RSNHandshakeCapturer::address_pair_key::operator==(const address_pair_key& rhs) const {
+    return memcmp(data, rhs.data, data_size) == 0;
+}
+
+uint64_t RSNHandshakeCapturer::address_pair_key::hash() const {
+    // FNV-1a over both addresses
+    return fnv_hash(data, data_size);
+}
+
+// callback_holder
+
+#if TINS_IS_CXX11
+struct RSNHandshakeCapturer::callback_holder {
+    handshake_callback_type callback;
+};
+#else // TINS_IS_CXX11
+struct RSNHandshakeCapturer::callback_holder {
+
+};
+#endif // TINS_IS_CXX11
+
+// RSNHandshakeCapturer
+
+RSNHandshakeCapturer::RSNHandshakeCapturer()
+: handshake_callback_(0),
+  timeout_(DEFAULT_TIMEOUT * handshake_capturer_microseconds_per_second),
+  last_expiration_(0) {
+
+}
+
+RSNHandshakeCapturer::RSNHandshakeCapturer(const RSNHandshakeCapturer& other)
+: handshakes_(other.handshakes_), completed_handshakes_(other.completed_handshakes_),
+  handshake_callback_(0), timeout_(other.timeout_),
+  last_expiration_(other.last_expiration_) {
+    if (other.handshake_callback_) {
+        handshake_callback_ = new callback_holder(*other.handshake_callback_);
+    }
+}
+
+RSNHandshakeCapturer& RSNHandshakeCapturer::operator=(const RSNHandshakeCapturer& other) {
+    if (this != &other) {
+        callback_holder* callback = 0;
+        if (other.handshake_callback_) {
+            callback = new callback_holder(*other.handshake_callback_);
+        }
+        delete handshake_callback_;
+        handshake_callback_ = callback;
+        handshakes_ = other.handshakes_;
+        completed_handshakes_ = other.completed_handshakes_;
+        timeout_ = other.timeout_;
+        last_expiration_ = other.last_expiration_;
+    }
+    return *this;
+}
+
+RSNHandshakeCapturer::~RSNHandshakeCapturer() {
+    delete handshake_callback_;
+}
+
 bool RSNHandshakeCapturer::process_packet(const PDU& pdu) {
+    return process_packet(pdu, handshake_capturer_microseconds(Timestamp::current_time()));
+}
+
+bool RSNHandshakeCapturer::process_packet(const Packet& packet) {
+    if (!packet.pdu()) {
+        return false;
+    }
+    return process_packet(*packet.pdu(), handshake_capturer_microseconds(packet.timestamp()));
+}
+
+#if TINS_IS_CXX11
+void RSNHandshakeCapturer::handshake_callback(const handshake_callback_type& callback) {
+    if (!callback) {
+        delete handshake_callback_;
+        handshake_callback_ = 0;
+    }
+    else if (handshake_callback_) {
+        handshake_callback_->callback = callback;
+    }
+    else {
+        handshake_callback_ = new callback_holder();
+        handshake_callback_->callback = callback;
+    }
+}
+#endif // TINS_IS_CXX11
+
+void RSNHandshakeCapturer::timeout(uint32_t value) {
+    timeout_ = value * handshake_capturer_microseconds_per_second;
+}
+
+size_t RSNHandshakeCapturer::pending_handshakes() const {
+    return handshakes_.size();
+}
+
+bool RSNHandshakeCapturer::process_packet(const PDU& pdu, timestamp_type ts) {
+    expire_handshakes(ts);
+
     const RSNEAPOL* eapol = pdu.find_pdu<RSNEAPOL>();
     const Dot11Data* dot11 = pdu.find_pdu<Dot11Data>();
     if (!eapol || !dot11) {
@@ -49,57 +168,115 @@ bool RSNHandshakeCapturer::process_packet(const PDU& pdu) {
     }
     
     // Use this to identify each flow, regardless of the direction
-    pair<address_type, address_type> addresses;
-    addresses.first  = min(dot11->src_addr(), dot11->dst_addr());
-    addresses.second = max(dot11->src_addr(), dot11->dst_addr());
+    const address_pair_key key(dot11->src_addr(), dot11->dst_addr());
         
     // 1st packet
     if (eapol->key_t() && eapol->key_ack() && !eapol->key_mic() && !eapol->install()) {
-        handshakes_[addresses].assign(eapol, eapol + 1);
+        size_t index = find_index(key);
+        if (index == handshake_map::npos) {
+            pending_handshake pending;
+            pending.key = key;
+            index = handshakes_.insert(key.hash(), pending);
+        }
+        pending_handshake& pending = handshakes_.value(index);
+        pending.last_seen = ts;
+        pending.frames.assign(1, *eapol);
     }
     // 2nd and 4th packets
     else if (eapol->key_t() && !eapol->key_ack() && eapol->key_mic() && !eapol->install()) {
         // 2nd packet won't have the secure bit set
         if (!eapol->secure()) {
-            do_insert(addresses, eapol, 1);
+            pending_handshake* pending = find_handshake(key, ts, 1);
+            if (pending && pending->frames[0].replay_counter() == eapol->replay_counter()) {
+                pending->frames.push_back(*eapol);
+                pending->last_seen = ts;
+            }
         }
         // Otherwise, this should be the 4th and last packet
-        else if (do_insert(addresses, eapol, 3)) {
-            completed_handshakes_.push_back(
-                handshake_type(
-                    addresses.first,
-                    addresses.second,
-                    handshakes_[addresses]
-                )
-            );
-            handshakes_.erase(addresses);
-            return true;
+        else {
+            pending_handshake* pending = find_handshake(key, ts, 3);
+            if (pending && pending->frames[2].replay_counter() == eapol->replay_counter()) {
+                eapol_list frames;
+                frames.swap(pending->frames);
+                frames.push_back(*eapol);
+                handshakes_.erase(find_index(key));
+                const address_type addr1 = dot11->src_addr(), addr2 = dot11->dst_addr();
+                complete_handshake(handshake_type(min(addr1, addr2), max(addr1, addr2), frames));
+                return true;
+            }
         }
     }
-    // 3nd packet
+    // 3rd packet
     else if (eapol->key_t() && eapol->key_ack() && eapol->key_mic() && eapol->install()) {
-        do_insert(addresses, eapol, 2);
+        pending_handshake* pending = find_handshake(key, ts, 2);
+        if (pending) {
+            pending->frames.push_back(*eapol);
+            pending->last_seen = ts;
+        }
     }
     return false;
 }
 
-bool RSNHandshakeCapturer::do_insert(const handshake_map::key_type& key,
-                                     const RSNEAPOL* eapol,
+size_t RSNHandshakeCapturer::find_index(const address_pair_key& key) const {
+    size_t index = handshakes_.find(key.hash());
+    while (index != handshake_map::npos && !(handshakes_.value(index).key == key)) {
+        index = handshakes_.find_next(index);
+    }
+    return index;
+}
+
+RSNHandshakeCapturer::pending_handshake* 
+RSNHandshakeCapturer::find_handshake(const address_pair_key& key,
+                                     timestamp_type ts,
                                      size_t expected) {
-    handshake_map::iterator iter = handshakes_.find(key);
-    if (iter != handshakes_.end()) {
-        if (iter->second.size() != expected) {
-            // skip repeated
-            if (iter->second.size() != expected + 1) {
-                iter->second.clear();
-            }
+    const size_t index = find_index(key);
+    if (index == handshake_map::npos) {
+        return 0;
+    }
+    pending_handshake& pending = handshakes_.value(index);
+    if (ts > pending.last_seen && ts - pending.last_seen > timeout_) {
+        handshakes_.erase(index);
+        return 0;
+    }
+    if (pending.frames.size() != expected) {
+        // skip repeated
+        if (pending.frames.size() != expected + 1) {
+            handshakes_.erase(index);
         }
-        else {
-            iter->second.push_back(*eapol);
-            return true;
+        return 0;
+    }
+    return &pending;
+}
+
+void RSNHandshakeCapturer::complete_handshake(const handshake_type& handshake) {
+    #if TINS_IS_CXX11
+        if (handshake_callback_) {
+            handshake_callback_->callback(handshake);
+            return;
+        }
+    #endif // TINS_IS_CXX11
+    completed_handshakes_.push_back(handshake);
+}
+
+void RSNHandshakeCapturer::expire_handshakes(timestamp_type now) {
+    // Only go through the whole index once per timeout period
+    if (now < last_expiration_ || now - last_expiration_ < timeout_) {
+        return;
+    }
+    last_expiration_ = now;
+    // Erasing shifts the following handshakes back, so the same slot is
+    // checked again after an erasure
+    size_t index = 0;
+    while (index < handshakes_.slot_count()) {
+        if (handshakes_.used(index)) {
+            const timestamp_type last_seen = handshakes_.value(index).last_seen;
+            if (now > last_seen && now - last_seen > timeout_) {
+                handshakes_.erase(index);
+                continue;
+            }
         }
+        ++index;
     }
-    return false;
 }
 
 } // namespace Tins;
@@ -101,6 +101,7 @@ ICMPv6::ICMPv6(const uint8_t* buffer, uint32_t total_sz)
 }
 
 void ICMPv6::parse_options(InputMemoryStream& stream) {
+    Internals::option_block block(stream.pointer(), stream.pointer() + stream.size());
     while (stream) {
         const uint8_t opt_type = stream.read<uint8_t>();
         const uint32_t opt_size = static_cast<uint32_t>(stream.read<uint8_t>()) * 8;
@@ -116,7 +117,9 @@ void ICMPv6::parse_options(InputMemoryStream& stream) {
             option(
                 opt_type, 
                 payload_size, 
-                stream.pointer()
+                stream.pointer(),
+                payload_size,
+                block
             )
         );
         stream.skip(payload_size);
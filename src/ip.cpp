@@ -57,6 +57,37 @@ namespace Tins {
 
 const uint8_t IP::DEFAULT_TTL = 128;
 
+// Reads the option starting at ptr and returns a pointer right after it
+const uint8_t* read_ip_option(const uint8_t* ptr, const uint8_t* end,
+                              IP::option_identifier& opt_type,
+                              const uint8_t*& data, uint32_t& data_size) {
+    opt_type = IP::option_identifier(*ptr++);
+    data = ptr;
+    data_size = 0;
+    if (opt_type.number > IP::NOOP) {
+        // Multibyte options with length as second byte
+        if (TINS_UNLIKELY(ptr == end)) {
+            throw malformed_packet();
+        }
+        const uint32_t option_size = *ptr++;
+        if (TINS_UNLIKELY(option_size < (sizeof(uint8_t) << 1))) {
+            throw malformed_packet();
+        }
+        // The data size is the option size - the identifier and size fields
+        data_size = option_size - (sizeof(uint8_t) << 1);
+        if (TINS_UNLIKELY(ptr + data_size > end)) {
+            throw malformed_packet();
+        }
+        data = ptr;
+        return ptr + data_size;
+    }
+    // Make sure we found the END option at the end of the options list
+    if (TINS_UNLIKELY(opt_type == IP::END && ptr != end)) {
+        throw malformed_packet();
+    }
+    return ptr;
+}
+
 PDU::metadata IP::extract_metadata(const uint8_t *buffer, uint32_t total_sz) {
     if (TINS_UNLIKELY(total_sz < sizeof(ip_header))) {
         throw malformed_packet();
@@ -67,7 +98,8 @@ PDU::metadata IP::extract_metadata(const uint8_t *buffer, uint32_t total_sz) {
     return metadata(header->ihl * 4, pdu_flag, next_type);
 }
 
-IP::IP(address_type ip_dst, address_type ip_src) {
+IP::IP(address_type ip_dst, address_type ip_src)
+: raw_options_size_(0), options_parsed_(true) {
     init_ip_fields();
     this->dst_addr(ip_dst);
     this->src_addr(ip_src); 
@@ -83,43 +115,24 @@ IP::IP(const uint8_t* buffer, uint32_t total_sz) {
         throw malformed_packet();
     }
     const uint8_t* options_end = buffer + head_len() * sizeof(uint32_t);
-    
-    // While the end of the options is not reached read an option
-    while (stream.pointer() < options_end) {
-        option_identifier opt_type = (option_identifier)stream.read<uint8_t>();
-        if (opt_type.number > NOOP) {
-            // Multibyte options with length as second byte
-            const uint32_t option_size = stream.read<uint8_t>();
-            if (TINS_UNLIKELY(option_size < (sizeof(uint8_t) << 1))) {
-                throw malformed_packet();
-            }
-            // The data size is the option size - the identifier and size fields
-            const uint32_t data_size = option_size - (sizeof(uint8_t) << 1);
-            if (data_size > 0) {
-                if (stream.pointer() + data_size > options_end) {
-                    throw malformed_packet();
-                }
-                options_.push_back(
-                    option(opt_type, stream.pointer(), stream.pointer() + data_size)
-                );
-                stream.skip(data_size);
-            }
-            else {
-                options_.push_back(option(opt_type));
-            }
-        }
-        else if (opt_type == END) {
-            // If the end option found, we're done
-            if (TINS_UNLIKELY(stream.pointer() != options_end)) {
-                // Make sure we found the END option at the end of the options list
-                throw malformed_packet();
-            }
+
+    // Only validate the options here. They're kept in their raw form and 
+    // decoded the first time they're needed
+    const uint8_t* options_start = stream.pointer();
+    const uint8_t* ptr = options_start;
+    while (ptr < options_end) {
+        option_identifier opt_type;
+        const uint8_t* data;
+        uint32_t data_size;
+        ptr = read_ip_option(ptr, options_end, opt_type, data, data_size);
+        if (opt_type == END) {
             break;
         }
-        else {
-            options_.push_back(option(opt_type));
-        }
     }
+    raw_options_size_ = static_cast<uint8_t>(options_end - options_start);
+    memcpy(raw_options_, options_start, raw_options_size_);
+    options_parsed_ = raw_options_size_ == 0;
+    stream.skip(raw_options_size_);
     if (stream) {
         // Don't avoid consuming more than we should if tot_len is 0,
         // since this is the case when using TCP segmentation offload
@@ -134,26 +147,14 @@ IP::IP(const uint8_t* buffer, uint32_t total_sz) {
 
         // Don't try to decode it if it's fragmented
         if (!is_fragmented()) {
+            // User registered protocols share the same dispatch table
             inner_pdu(
                 Internals::pdu_from_flag(
                     static_cast<Constants::IP::e>(header_.protocol),
                     stream.pointer(), 
-                    total_sz,
-                    false
+                    total_sz
                 )
             );
-            if (!inner_pdu()) {
-                inner_pdu(
-                    Internals::allocate<IP>(
-                        header_.protocol,
-                        stream.pointer(), 
-                        total_sz
-                    )
-                );
-                if (!inner_pdu()) {
-                    inner_pdu(new RawPDU(stream.pointer(), total_sz));
-                }
-            }
         }
         else {
             // It's fragmented, just use RawPDU
@@ -291,35 +292,95 @@ void IP::add_route_option(option_identifier id, const generic_route_option_type&
 }
 
 IP::generic_route_option_type IP::search_route_option(option_identifier id) const {
-    const option* opt = search_option(id);
-    if (!opt) {
-        throw option_not_found();
-    }
-    return opt->to<generic_route_option_type>();
+    return find_option(id).to<generic_route_option_type>();
 }
 
 IP::security_type IP::security() const {
-    const option* opt = search_option(130);
-    if (!opt) {
-        throw option_not_found();
-    }
-    return opt->to<security_type>();
+    return find_option(130).to<security_type>();
 }
 
 uint16_t IP::stream_identifier() const {
-    const option* opt = search_option(136);
-    if (!opt) {
-        throw option_not_found();
+    return find_option(136).to<uint16_t>();
+}
+
+// Unlike search_option, this doesn't decode every option if they 
+// haven't been parsed yet, so getters never modify this PDU
+IP::option IP::find_option(option_identifier id) const {
+    if (options_parsed_) {
+        options_type::const_iterator iter = search_option_iterator(id);
+        if (iter == options_.end()) {
+            throw option_not_found();
+        }
+        return *iter;
     }
-    return opt->to<uint16_t>();
+    const uint8_t* ptr = raw_options_;
+    const uint8_t* end = raw_options_ + raw_options_size_;
+    while (ptr < end) {
+        option_identifier opt_type;
+        const uint8_t* data;
+        uint32_t data_size;
+        ptr = read_ip_option(ptr, end, opt_type, data, data_size);
+        if (opt_type == END) {
+            break;
+        }
+        if (opt_type == id) {
+            return option(opt_type, data_size, data_size > 0 ? data : 0);
+        }
+    }
+    throw option_not_found();
 }
 
 void IP::add_option(const option& opt) {
+    parse_options();
     options_.push_back(opt);
 }
 
+void IP::parse_options() const {
+    if (options_parsed_) {
+        return;
+    }
+    options_parsed_ = true;
+    const uint8_t* ptr = raw_options_;
+    const uint8_t* end = raw_options_ + raw_options_size_;
+    Internals::option_block block(ptr, end);
+    while (ptr < end) {
+        option_identifier opt_type;
+        const uint8_t* data;
+        uint32_t data_size;
+        ptr = read_ip_option(ptr, end, opt_type, data, data_size);
+        if (opt_type == END) {
+            break;
+        }
+        else if (data_size > 0) {
+            options_.push_back(option(opt_type, data_size, data, data_size, block));
+        }
+        else {
+            options_.push_back(option(opt_type));
+        }
+    }
+}
+
 uint32_t IP::calculate_options_size() const {
     uint32_t options_size = 0;
+    if (!options_parsed_) {
+        // Same as below, without decoding the options
+        const uint8_t* ptr = raw_options_;
+        const uint8_t* end = raw_options_ + raw_options_size_;
+        while (ptr < end) {
+            option_identifier option_id;
+            const uint8_t* data;
+            uint32_t data_size;
+            ptr = read_ip_option(ptr, end, option_id, data, data_size);
+            if (option_id == END) {
+                break;
+            }
+            options_size += sizeof(uint8_t);
+            if (option_id.op_class != CONTROL || option_id.number > NOOP) {
+                options_size += sizeof(uint8_t) + data_size;
+            }
+        }
+        return options_size;
+    }
     for (options_type::const_iterator iter = options_.begin(); iter != options_.end(); ++iter) {
         options_size += sizeof(uint8_t);
         const option_identifier option_id = iter->option();
@@ -337,6 +398,7 @@ uint32_t IP::pad_options_size(uint32_t size) const {
 }
 
 bool IP::remove_option(option_identifier id) {
+    parse_options();
     options_type::iterator iter = search_option_iterator(id);
     if (iter == options_.end()) {
         return false;
@@ -346,6 +408,7 @@ bool IP::remove_option(option_identifier id) {
 }
 
 const IP::option* IP::search_option(option_identifier id) const {
+    parse_options();
     options_type::const_iterator iter = search_option_iterator(id);
     return (iter != options_.end()) ? &*iter : 0;
 }
@@ -455,6 +518,7 @@ void IP::write_serialization(uint8_t* buffer, uint32_t total_sz) {
     // Restore the fragment offset field in case we flipped it
     header_.frag_off = original_frag_off;
 
+    parse_options();
     for (options_type::const_iterator it = options_.begin(); it != options_.end(); ++it) {
         write_option(*it, stream);
     }
@@ -27,72 +27,164 @@
  *
  */
 
+#include <algorithm>
+#include <limits>
+#include <cstring>
 #include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/rawpdu.h>
+#include <tins/packet.h>
 #include <tins/constants.h>
 #include <tins/ip_reassembler.h>
+#include <tins/exceptions.h>
+#include <tins/memory_helpers.h>
 #include <tins/detail/pdu_helpers.h>
+#include <tins/detail/smart_ptr.h>
 
 using std::make_pair;
+using std::vector;
+using std::numeric_limits;
+
+using Tins::Memory::InputMemoryStream;
+using Tins::Memory::OutputMemoryStream;
 
 namespace Tins {
 namespace Internals {
 
 IPv4Stream::IPv4Stream() 
-: received_size_(), total_size_(), received_end_(false) {
+: holes_(1, hole_type(0, numeric_limits<uint32_t>::max())), total_size_(),
+  received_first_(false), received_end_(false) {
+
+}
 
+IPv4Stream::IPv4Stream(InputMemoryStream& input)
+: total_size_(), received_first_(false), received_end_(false) {
+    received_end_ = input.read<uint8_t>() != 0;
+    total_size_ = input.read_le<uint32_t>();
+    const uint16_t header_size = input.read_le<uint16_t>();
+    if (header_size > 0) {
+        if (!input.can_read(header_size)) {
+            throw malformed_packet();
+        }
+        first_fragment_ = IP(input.pointer(), header_size);
+        input.skip(header_size);
+        first_fragment_.protocol(input.read<uint8_t>());
+        received_first_ = true;
+    }
+    input.read(buffer_, input.read_le<uint32_t>());
+    uint32_t hole_count = input.read_le<uint32_t>();
+    while (hole_count--) {
+        const uint32_t first = input.read_le<uint32_t>();
+        const uint32_t last = input.read_le<uint32_t>();
+        // A hole that can't ever be filled would keep the stream from completing
+        if (first >= last || (received_end_ && last > total_size_)) {
+            throw malformed_packet();
+        }
+        holes_.push_back(hole_type(first, last));
+    }
+    // Once the end is known, the buffer always contains the whole packet
+    if (received_end_ && buffer_.size() < total_size_) {
+        throw malformed_packet();
+    }
 }
 
 void IPv4Stream::add_fragment(IP* ip) {
-    const uint16_t offset = extract_offset(ip);
-    fragments_type::iterator it = fragments_.begin();
-    while (it != fragments_.end() && offset > it->offset()) {
-        ++it;
+    const uint32_t offset = extract_offset(ip);
+    const PDU* inner_pdu = ip->inner_pdu();
+    // Fragments are always parsed as RawPDUs, so their payload can be used directly
+    PDU::serialization_type serialized;
+    const PDU::serialization_type* payload = &serialized;
+    if (inner_pdu->pdu_type() == PDU::RAW) {
+        payload = &static_cast<const RawPDU*>(inner_pdu)->payload();
     }
-    // No duplicates plx
-    if (it != fragments_.end() && it->offset() == offset) {
-        return;
+    else {
+        serialized = ip->inner_pdu()->serialize();
     }
-    fragments_.insert(it, IPv4Fragment(ip->inner_pdu(), offset));
-    received_size_ += ip->inner_pdu()->size();
-    // If the MF flag is off
-    if ((ip->flags() & IP::MORE_FRAGMENTS) == 0) {
-        total_size_ = offset + ip->inner_pdu()->size();
-        received_end_ = true;
+    uint32_t end = offset + static_cast<uint32_t>(payload->size());
+    // If the MF flag is off, this fragment tells us the packet's size. The first 
+    // last fragment seen wins
+    if ((ip->flags() & IP::MORE_FRAGMENTS) == 0 && !received_end_) {
+        set_total_size(end);
     }
-    if (offset == 0) {
+    // Anything after the end of the packet is ignored
+    if (received_end_ && end > total_size_) {
+        end = std::max(offset, total_size_);
+    }
+    const uint32_t required_size = received_end_ ? total_size_ : end;
+    if (buffer_.size() < required_size) {
+        buffer_.resize(required_size);
+    }
+    fill_holes(payload->empty() ? 0 : &(*payload)[0], offset, end);
+    if (offset == 0 && !received_first_) {
         // Release the inner PDU, store this first fragment and restore the inner PDU
         PDU* inner_pdu = ip->release_inner_pdu();
         first_fragment_ = *ip;
         ip->inner_pdu(inner_pdu);
+        received_first_ = true;
     }
 }
 
-bool IPv4Stream::is_complete() const {
-    // If we haven't received the last chunk of we haven't received all the data,
-    // then we're not complete
-    if (!received_end_ || received_size_ != total_size_) {
-        return false;
+void IPv4Stream::fill_holes(const uint8_t* data, uint32_t offset, uint32_t end) {
+    // RFC 815: each hole the fragment touches is filled and replaced by whatever 
+    // is left of it on each side. Data that doesn't fall into a hole was already 
+    // received, so the first copy of every byte is the one kept
+    if (offset >= end) {
+        return;
+    }
+    size_t i = 0;
+    while (i < holes_.size()) {
+        const hole_type hole = holes_[i];
+        if (offset >= hole.second || end <= hole.first) {
+            ++i;
+            continue;
+        }
+        const uint32_t copy_first = std::max(offset, hole.first);
+        const uint32_t copy_last = std::min(end, hole.second);
+        std::memcpy(&buffer_[copy_first], data + (copy_first - offset), copy_last - copy_first);
+        const bool has_left = hole.first < offset;
+        const bool has_right = end < hole.second;
+        if (has_left) {
+            holes_[i++].second = offset;
+            if (has_right) {
+                holes_.push_back(hole_type(end, hole.second));
+            }
+        }
+        else if (has_right) {
+            holes_[i++].first = end;
+        }
+        else {
+            holes_[i] = holes_.back();
+            holes_.pop_back();
+        }
     }
-    // Make sure the first fragment has offset 0
-    return fragments_.begin()->offset() == 0;
 }
 
-PDU* IPv4Stream::allocate_pdu() const {
-    PDU::serialization_type buffer;
-    buffer.reserve(total_size_);
-    // Check if we actually have all the data we need. Otherwise return nullptr;
-    size_t expected = 0;
-    for (fragments_type::const_iterator it = fragments_.begin(); it != fragments_.end(); ++it) {
-        if (expected != it->offset()) {
-            return 0;
+void IPv4Stream::set_total_size(uint32_t total_size) {
+    total_size_ = total_size;
+    received_end_ = true;
+    // Holes can't go past the end of the packet
+    size_t i = 0;
+    while (i < holes_.size()) {
+        if (holes_[i].first >= total_size) {
+            holes_[i] = holes_.back();
+            holes_.pop_back();
+        }
+        else {
+            holes_[i].second = std::min(holes_[i].second, total_size);
+            ++i;
         }
-        expected = it->offset() + it->payload().size();
-        buffer.insert(buffer.end(), it->payload().begin(), it->payload().end());
     }
+}
+
+bool IPv4Stream::is_complete() const {
+    return received_end_ && holes_.empty();
+}
+
+PDU* IPv4Stream::allocate_pdu() const {
     return Internals::pdu_from_flag(
         static_cast<Constants::IP::e>(first_fragment_.protocol()),
-        buffer.empty() ? 0 :& buffer[0],
-        static_cast<uint32_t>(buffer.size())
+        total_size_ == 0 ? 0 : &buffer_[0],
+        total_size_
     );
 }
 
@@ -100,30 +192,362 @@ const IP& IPv4Stream::first_fragment() const {
     return first_fragment_;
 }
 
+size_t IPv4Stream::serialized_size() const {
+    // End flag, total size, first fragment header size, buffer size and hole count
+    size_t output = sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint16_t) + 
+                    sizeof(uint32_t) + sizeof(uint32_t);
+    if (received_first_) {
+        output += first_fragment_.header_size() + sizeof(uint8_t);
+    }
+    return output + buffer_.size() + holes_.size() * sizeof(uint32_t) * 2;
+}
+
+void IPv4Stream::serialize(OutputMemoryStream& output) const {
+    output.write<uint8_t>(received_end_ ? 1 : 0);
+    output.write_le<uint32_t>(total_size_);
+    if (received_first_) {
+        PDU::serialization_type header = IP(first_fragment_).serialize();
+        output.write_le<uint16_t>(header.size());
+        output.write(header.begin(), header.end());
+        // Serializing an IP header without payload clears its protocol field
+        output.write<uint8_t>(first_fragment_.protocol());
+    }
+    else {
+        output.write_le<uint16_t>(0);
+    }
+    output.write_le<uint32_t>(buffer_.size());
+    output.write(buffer_.begin(), buffer_.end());
+    output.write_le<uint32_t>(holes_.size());
+    for (holes_type::const_iterator it = holes_.begin(); it != holes_.end(); ++it) {
+        output.write_le<uint32_t>(it->first);
+        output.write_le<uint32_t>(it->second);
+    }
+}
+
 uint16_t IPv4Stream::extract_offset(const IP* ip) {
     return ip->fragment_offset() * 8;
 }
 
+// IPv6Stream
+
+const uint32_t ipv6_header_size = 40;
+const uint32_t ipv6_max_payload_size = 65535;
+
+uint32_t ext_header_size(const IPv6::ext_header& header) {
+    // Extension headers are always padded to a multiple of 8 bytes
+    const uint32_t size = header.data_size() + sizeof(uint8_t) * 2;
+    return (size + 7) & ~7U;
+}
+
+IPv6Stream::IPv6Stream(const IPv6& ipv6, size_t fragment_index)
+: holes_(1, hole_type(0, numeric_limits<uint32_t>::max())),
+  header_size_(unfragmentable_size(ipv6, fragment_index)), total_size_(),
+  received_end_(false) {
+    buffer_.resize(header_size_);
+}
+
+bool IPv6Stream::is_valid_fragment(const IPv6& ipv6, size_t fragment_index) {
+    const IPv6::fragment_header header = IPv6::fragment_header::from_extension_header(
+        ipv6.headers()[fragment_index]
+    );
+    const uint32_t size = fragmentable_size(ipv6, fragment_index);
+    // Every fragment but the last one has to be a multiple of 8 bytes long
+    if (header.more_fragments && (size == 0 || size % 8 != 0)) {
+        return false;
+    }
+    return header.fragment_offset * 8U + size <= ipv6_max_payload_size;
+}
+
+bool IPv6Stream::add_fragment(const IPv6& ipv6, size_t fragment_index) {
+    const IPv6::fragment_header header = IPv6::fragment_header::from_extension_header(
+        ipv6.headers()[fragment_index]
+    );
+    const uint32_t offset = header.fragment_offset * 8U;
+    const uint32_t size = fragmentable_size(ipv6, fragment_index);
+    const uint32_t end = offset + size;
+    if (received_end_ && end > total_size_) {
+        return false;
+    }
+    // Overlaps invalidate the packet, so a fragment has to fit in a single hole. 
+    // A fragment that doesn't touch any hole was already received and is ignored
+    size_t index = 0;
+    bool touches_hole = false;
+    while (index < holes_.size()) {
+        const hole_type& hole = holes_[index];
+        if (hole.first <= offset && end <= hole.second) {
+            break;
+        }
+        if (offset < hole.second && hole.first < end) {
+            touches_hole = true;
+        }
+        ++index;
+    }
+    if (index == holes_.size()) {
+        return !touches_hole;
+    }
+    if (!header.more_fragments) {
+        // The last fragment can't change the size nor be before some other
+        // fragment, so the hole it falls into has to be the trailing one
+        if ((received_end_ && end != total_size_) ||
+            (!received_end_ && holes_[index].second != numeric_limits<uint32_t>::max())) {
+            return false;
+        }
+        if (!received_end_) {
+            set_total_size(end);
+            // Truncating the trailing hole may have moved or removed it
+            index = 0;
+            while (index < holes_.size() && holes_[index].second != end) {
+                ++index;
+            }
+        }
+    }
+    // The first fragment's unfragmentable part is the one used. We can't use it
+    // if its size is not the same as the one of the fragment that created this stream
+    if (offset == 0) {
+        if (unfragmentable_size(ipv6, fragment_index) != header_size_) {
+            return false;
+        }
+        write_unfragmentable_part(ipv6, fragment_index);
+    }
+    // Once the size is known the buffer already holds the whole packet. Until
+    // then, it only grows up to the end of the furthest fragment seen
+    if (buffer_.size() < header_size_ + end) {
+        buffer_.resize(header_size_ + end);
+    }
+    if (size > 0) {
+        write_fragmentable_part(ipv6, fragment_index, &buffer_[0] + header_size_ + offset, size);
+    }
+    if (index < holes_.size()) {
+        fill_hole(index, offset, end);
+    }
+    return true;
+}
+
+void IPv6Stream::set_total_size(uint32_t total_size) {
+    total_size_ = total_size;
+    received_end_ = true;
+    const size_t required_size = header_size_ + total_size;
+    if (buffer_.capacity() < required_size) {
+        // Allocate exactly what's needed, rather than letting the buffer 
+        // grow geometrically
+        vector<uint8_t> buffer;
+        buffer.reserve(required_size);
+        buffer.assign(buffer_.begin(), buffer_.end());
+        buffer_.swap(buffer);
+    }
+    buffer_.resize(required_size);
+    // Holes can't go past the end of the packet
+    size_t i = 0;
+    while (i < holes_.size()) {
+        if (holes_[i].first >= total_size) {
+            holes_[i] = holes_.back();
+            holes_.pop_back();
+        }
+        else {
+            holes_[i].second = std::min(holes_[i].second, total_size);
+            ++i;
+        }
+    }
+}
+
+void IPv6Stream::fill_hole(size_t index, uint32_t offset, uint32_t end) {
+    // The fragment is replaced by whatever is left of the hole on each side
+    const hole_type hole = holes_[index];
+    const bool has_left = hole.first < offset;
+    const bool has_right = end < hole.second;
+    if (has_left) {
+        holes_[index].second = offset;
+        if (has_right) {
+            holes_.push_back(hole_type(end, hole.second));
+        }
+    }
+    else if (has_right) {
+        holes_[index].first = end;
+    }
+    else {
+        holes_[index] = holes_.back();
+        holes_.pop_back();
+    }
+}
+
+bool IPv6Stream::is_complete() const {
+    return received_end_ && holes_.empty();
+}
+
+bool IPv6Stream::build_packet(IPv6& ipv6) {
+    const uint32_t payload_size = header_size_ - ipv6_header_size + total_size_;
+    if (payload_size > ipv6_max_payload_size) {
+        return false;
+    }
+    // The payload length is the only field we don't know until the end
+    OutputMemoryStream output(&buffer_[sizeof(uint32_t)], sizeof(uint16_t));
+    output.write_be<uint16_t>(payload_size);
+    try {
+        ipv6 = IPv6(&buffer_[0], header_size_ + total_size_);
+    }
+    catch (const malformed_packet&) {
+        return false;
+    }
+    return true;
+}
+
+size_t IPv6Stream::buffer_size() const {
+    return buffer_.capacity();
+}
+
+uint8_t IPv6Stream::fragment_next_header(const IPv6& ipv6, size_t fragment_index) {
+    const IPv6::headers_type& headers = ipv6.headers();
+    if (fragment_index + 1 < headers.size()) {
+        return headers[fragment_index + 1].option();
+    }
+    return ipv6.last_next_header();
+}
+
+uint32_t IPv6Stream::unfragmentable_size(const IPv6& ipv6, size_t fragment_index) {
+    const IPv6::headers_type& headers = ipv6.headers();
+    uint32_t output = ipv6_header_size;
+    for (size_t i = 0; i < fragment_index; ++i) {
+        output += ext_header_size(headers[i]);
+    }
+    return output;
+}
+
+uint32_t IPv6Stream::fragmentable_size(const IPv6& ipv6, size_t fragment_index) {
+    // Any extension header after the fragment one is part of the fragment's payload
+    const IPv6::headers_type& headers = ipv6.headers();
+    uint32_t output = 0;
+    for (size_t i = fragment_index + 1; i < headers.size(); ++i) {
+        output += ext_header_size(headers[i]);
+    }
+    if (ipv6.inner_pdu()) {
+        output += ipv6.inner_pdu()->size();
+    }
+    return output;
+}
+
+void IPv6Stream::write_ext_header(OutputMemoryStream& output, uint8_t next_header,
+                                  const IPv6::ext_header& header) {
+    const uint32_t size = ext_header_size(header);
+    output.write<uint8_t>(next_header);
+    output.write<uint8_t>(size / 8 - 1);
+    output.write(header.data_ptr(), header.data_size());
+    output.fill(size - header.data_size() - sizeof(uint8_t) * 2, 0);
+}
+
+void IPv6Stream::write_unfragmentable_part(const IPv6& ipv6, size_t fragment_index) {
+    const IPv6::headers_type& headers = ipv6.headers();
+    OutputMemoryStream output(&buffer_[0], header_size_);
+    const uint32_t first_word = (6U << 28) | (static_cast<uint32_t>(ipv6.traffic_class()) << 20) |
+                                ipv6.flow_label();
+    output.write_be(first_word);
+    // Payload length, written once the packet is complete
+    output.write_be<uint16_t>(0);
+    // The fragment header is removed so the previous header points to the next one
+    if (fragment_index > 0) {
+        output.write<uint8_t>(headers[0].option());
+    }
+    else {
+        output.write<uint8_t>(fragment_next_header(ipv6, fragment_index));
+    }
+    output.write<uint8_t>(ipv6.hop_limit());
+    output.write(ipv6.src_addr());
+    output.write(ipv6.dst_addr());
+    for (size_t i = 0; i < fragment_index; ++i) {
+        if (i + 1 < fragment_index) {
+            write_ext_header(output, headers[i + 1].option(), headers[i]);
+        }
+        else {
+            write_ext_header(output, fragment_next_header(ipv6, fragment_index), headers[i]);
+        }
+    }
+}
+
+void IPv6Stream::write_fragmentable_part(const IPv6& ipv6, size_t fragment_index,
+                                         uint8_t* buffer, uint32_t size) {
+    const IPv6::headers_type& headers = ipv6.headers();
+    OutputMemoryStream output(buffer, size);
+    for (size_t i = fragment_index + 1; i < headers.size(); ++i) {
+        if (i + 1 < headers.size()) {
+            write_ext_header(output, headers[i + 1].option(), headers[i]);
+        }
+        else {
+            write_ext_header(output, ipv6.last_next_header(), headers[i]);
+        }
+    }
+    const PDU* inner_pdu = ipv6.inner_pdu();
+    if (!inner_pdu) {
+        return;
+    }
+    // Fragment payloads are always parsed as RawPDUs, so this is a single copy
+    if (inner_pdu->pdu_type() == PDU::RAW) {
+        const RawPDU::payload_type& payload = static_cast<const RawPDU*>(inner_pdu)->payload();
+        output.write(payload.begin(), payload.end());
+    }
+    else {
+        Internals::smart_ptr<PDU>::type pdu(inner_pdu->clone());
+        PDU::serialization_type buffer = pdu->serialize();
+        output.write(buffer.begin(), buffer.end());
+    }
+}
+
 } // Internals
 
-IPv4Reassembler::IPv4Reassembler()
-: technique_(NONE) {
+const uint64_t microseconds_per_second = 1000000;
 
+uint64_t timestamp_to_microseconds(const Timestamp& ts) {
+    return static_cast<uint64_t>(ts.seconds()) * microseconds_per_second + ts.microseconds();
 }
 
-IPv4Reassembler::IPv4Reassembler(OverlappingTechnique technique)
-: technique_(technique) {
+const uint32_t IPv4Reassembler::CHECKPOINT_MAGIC = 0x43524954; // "TIRC"
+const uint8_t IPv4Reassembler::CHECKPOINT_VERSION = 3;
+IPv4Reassembler::IPv4Reassembler()
+: timeout_(0), max_streams_(0), max_streams_per_source_(0), technique_(NONE) {
+    std::fill(eviction_counts_, eviction_counts_ + 3, 0);
+}
 
+IPv4Reassembler::IPv4Reassembler(OverlappingTechnique technique)
+: timeout_(0), max_streams_(0), max_streams_per_source_(0), technique_(technique) {
+    std::fill(eviction_counts_, eviction_counts_ + 3, 0);
 }
 
 IPv4Reassembler::PacketStatus IPv4Reassembler::process(PDU& pdu) {
+    // Timestamps are only used for timeouts, so don't read the clock otherwise
+    if (timeout_ == 0) {
+        return process(pdu, 0);
+    }
+    return process(pdu, timestamp_to_microseconds(Timestamp::current_time()));
+}
+
+IPv4Reassembler::PacketStatus IPv4Reassembler::process(Packet& packet) {
+    return process(*packet.pdu(), timestamp_to_microseconds(packet.timestamp()));
+}
+
+IPv4Reassembler::PacketStatus IPv4Reassembler::process(PDU& pdu, timestamp_type ts) {
+    if (timeout_ > 0) {
+        expire_streams(ts);
+    }
     IP* ip = pdu.find_pdu<IP>();
     if (ip && ip->inner_pdu()) {
         // There's fragmentation
         if (ip->is_fragmented()) {
             key_type key = make_key(ip);
-            // Create it or look it up, it's the same
-            Internals::IPv4Stream& stream = streams_[key];
+            streams_type::iterator iter = streams_.find(key);
+            if (iter == streams_.end()) {
+                source_counts_type::const_iterator count_iter = source_counts_.find(ip->src_addr());
+                if (max_streams_per_source_ > 0 && count_iter != source_counts_.end() &&
+                    count_iter->second >= max_streams_per_source_) {
+                    ++eviction_counts_[SOURCE_QUOTA];
+                    return FRAGMENTED;
+                }
+                // Make room for the new packet
+                if (max_streams_ > 0) {
+                    enforce_stream_limit(max_streams_ - 1);
+                }
+                stream_data data(Internals::IPv4Stream(), ip->src_addr(), ts,
+                                 key_list_type::iterator());
+                iter = add_stream(key, data);
+            }
+            Internals::IPv4Stream& stream = iter->second.stream;
             stream.add_fragment(ip);
             if (stream.is_complete()) {
                 PDU* pdu = stream.allocate_pdu();
@@ -131,7 +555,7 @@ IPv4Reassembler::PacketStatus IPv4Reassembler::process(PDU& pdu) {
                 *ip = stream.first_fragment();
 
                 // Erase this stream, since it's already assembled
-                streams_.erase(key);
+                remove_stream(iter);
                 // The packet is corrupt
                 if (!pdu) {
                     return FRAGMENTED;
@@ -165,17 +589,295 @@ IPv4Reassembler::address_pair IPv4Reassembler::make_address_pair(IPv4Address add
     }
 }
 
+void IPv4Reassembler::timeout(uint32_t value) {
+    timeout_ = value * microseconds_per_second;
+}
+
+void IPv4Reassembler::max_streams(size_t value) {
+    max_streams_ = value;
+    if (max_streams_ > 0) {
+        enforce_stream_limit(max_streams_);
+    }
+}
+
+void IPv4Reassembler::max_streams_per_source(size_t value) {
+    max_streams_per_source_ = value;
+}
+
+size_t IPv4Reassembler::stream_count() const {
+    return streams_.size();
+}
+
+uint64_t IPv4Reassembler::eviction_count(EvictionReason reason) const {
+    return eviction_counts_[reason];
+}
+
 void IPv4Reassembler::clear_streams() {
     streams_.clear();
+    streams_by_age_.clear();
+    source_counts_.clear();
 }
 
 void IPv4Reassembler::remove_stream(uint16_t id, IPv4Address addr1, IPv4Address addr2) {
-    streams_.erase(
+    streams_type::iterator iter = streams_.find(
         make_pair(
             id, 
             make_address_pair(addr1, addr2)
         )
     );
+    if (iter != streams_.end()) {
+        remove_stream(iter);
+    }
+}
+
+IPv4Reassembler::streams_type::iterator IPv4Reassembler::add_stream(const key_type& key,
+                                                                    stream_data& data) {
+    // Keep the list sorted by age. New packets will almost always go at the end
+    key_list_type::iterator position = streams_by_age_.end();
+    while (position != streams_by_age_.begin()) {
+        key_list_type::iterator previous = position;
+        --previous;
+        if (streams_.find(*previous)->second.first_seen <= data.first_seen) {
+            break;
+        }
+        position = previous;
+    }
+    data.position = streams_by_age_.insert(position, key);
+    ++source_counts_[data.source];
+    #if TINS_IS_CXX11
+        return streams_.insert(make_pair(key, std::move(data))).first;
+    #else
+        return streams_.insert(make_pair(key, data)).first;
+    #endif // TINS_IS_CXX11
+}
+
+void IPv4Reassembler::remove_stream(streams_type::iterator iter) {
+    source_counts_type::iterator count_iter = source_counts_.find(iter->second.source);
+    if (--count_iter->second == 0) {
+        source_counts_.erase(count_iter);
+    }
+    streams_by_age_.erase(iter->second.position);
+    streams_.erase(iter);
+}
+
+void IPv4Reassembler::expire_streams(timestamp_type now) {
+    // Streams are sorted by age so we only need to look at the oldest ones
+    while (!streams_by_age_.empty()) {
+        streams_type::iterator iter = streams_.find(streams_by_age_.front());
+        if (iter->second.first_seen + timeout_ > now) {
+            break;
+        }
+        remove_stream(iter);
+        ++eviction_counts_[TIMEOUT];
+    }
+}
+
+void IPv4Reassembler::enforce_stream_limit(size_t limit) {
+    while (streams_.size() > limit) {
+        remove_stream(streams_.find(streams_by_age_.front()));
+        ++eviction_counts_[MAX_STREAMS];
+    }
+}
+
+vector<uint8_t> IPv4Reassembler::checkpoint() const {
+    // Magic, version and stream count
+    size_t total_size = sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t);
+    for (streams_type::const_iterator it = streams_.begin(); it != streams_.end(); ++it) {
+        // Identifier, both addresses, the source address and the first seen timestamp
+        total_size += sizeof(uint16_t) + sizeof(uint32_t) * 3 + sizeof(int64_t);
+        total_size += it->second.stream.serialized_size();
+    }
+    vector<uint8_t> output(total_size);
+    OutputMemoryStream stream(output);
+    stream.write_le<uint32_t>(CHECKPOINT_MAGIC);
+    stream.write<uint8_t>(CHECKPOINT_VERSION);
+    stream.write_le<uint32_t>(streams_.size());
+    for (streams_type::const_iterator it = streams_.begin(); it != streams_.end(); ++it) {
+        stream.write_le<uint16_t>(it->first.first);
+        stream.write(it->first.second.first);
+        stream.write(it->first.second.second);
+        stream.write(it->second.source);
+        stream.write_le<uint64_t>(it->second.first_seen);
+        it->second.stream.serialize(stream);
+    }
+    return output;
+}
+
+void IPv4Reassembler::restore(const uint8_t* buffer, size_t total_sz) {
+    // Parse everything before touching our state so a bad checkpoint has no effect
+    vector<std::pair<key_type, stream_data> > streams;
+    try {
+        InputMemoryStream input(buffer, total_sz);
+        if (input.read_le<uint32_t>() != CHECKPOINT_MAGIC ||
+            input.read<uint8_t>() != CHECKPOINT_VERSION) {
+            throw invalid_checkpoint();
+        }
+        uint32_t stream_count = input.read_le<uint32_t>();
+        while (stream_count--) {
+            const uint16_t id = input.read_le<uint16_t>();
+            const IPv4Address addr1 = input.read<IPv4Address>();
+            const IPv4Address addr2 = input.read<IPv4Address>();
+            const IPv4Address source = input.read<IPv4Address>();
+            const timestamp_type first_seen = input.read_le<uint64_t>();
+            key_type key = make_pair(id, make_address_pair(addr1, addr2));
+            stream_data data(Internals::IPv4Stream(input), source, first_seen,
+                             key_list_type::iterator());
+            #if TINS_IS_CXX11
+                streams.push_back(make_pair(key, std::move(data)));
+            #else
+                streams.push_back(make_pair(key, data));
+            #endif // TINS_IS_CXX11
+        }
+        if (input) {
+            throw invalid_checkpoint();
+        }
+    }
+    catch (const malformed_packet&) {
+        throw invalid_checkpoint();
+    }
+    for (size_t i = 0; i < streams.size(); ++i) {
+        streams_type::iterator iter = streams_.find(streams[i].first);
+        if (iter != streams_.end()) {
+            remove_stream(iter);
+        }
+        add_stream(streams[i].first, streams[i].second);
+    }
+}
+
+// IPv6Reassembler
+
+const uint32_t IPv6Reassembler::DEFAULT_TIMEOUT = 60;
+const size_t IPv6Reassembler::DEFAULT_MAX_BUFFERED_BYTES = 4 * 1024 * 1024;
+
+IPv6Reassembler::IPv6Reassembler()
+: timeout_(DEFAULT_TIMEOUT * microseconds_per_second),
+  max_buffered_bytes_(DEFAULT_MAX_BUFFERED_BYTES), buffered_bytes_(0) {
+
+}
+
+IPv6Reassembler::PacketStatus IPv6Reassembler::process(PDU& pdu) {
+    // Timestamps are only used for timeouts, so don't read the clock otherwise
+    if (timeout_ == 0) {
+        return process(pdu, 0);
+    }
+    return process(pdu, timestamp_to_microseconds(Timestamp::current_time()));
+}
+
+IPv6Reassembler::PacketStatus IPv6Reassembler::process(Packet& packet) {
+    return process(*packet.pdu(), timestamp_to_microseconds(packet.timestamp()));
+}
+
+IPv6Reassembler::PacketStatus IPv6Reassembler::process(PDU& pdu, timestamp_type ts) {
+    if (timeout_ > 0) {
+        expire_streams(ts);
+    }
+    IPv6* ipv6 = pdu.find_pdu<IPv6>();
+    if (!ipv6) {
+        return NOT_FRAGMENTED;
+    }
+    const IPv6::headers_type& headers = ipv6->headers();
+    size_t fragment_index = 0;
+    while (fragment_index < headers.size() && headers[fragment_index].option() != IPv6::FRAGMENT) {
+        ++fragment_index;
+    }
+    if (fragment_index == headers.size()) {
+        return NOT_FRAGMENTED;
+    }
+    if (!Internals::IPv6Stream::is_valid_fragment(*ipv6, fragment_index)) {
+        return FRAGMENTED;
+    }
+    const IPv6::fragment_header header = IPv6::fragment_header::from_extension_header(
+        headers[fragment_index]
+    );
+    // Atomic fragments are processed in isolation
+    if (header.fragment_offset == 0 && !header.more_fragments) {
+        Internals::IPv6Stream stream(*ipv6, fragment_index);
+        if (stream.add_fragment(*ipv6, fragment_index) && stream.build_packet(*ipv6)) {
+            return REASSEMBLED;
+        }
+        return FRAGMENTED;
+    }
+    const key_type key = make_pair(
+        header.identification,
+        make_pair(ipv6->src_addr(), ipv6->dst_addr())
+    );
+    streams_type::iterator iter = streams_.find(key);
+    if (iter == streams_.end()) {
+        key_list_type::iterator position = streams_by_age_.insert(streams_by_age_.end(), key);
+        // The stream is empty at this point, so copying it is cheap
+        stream_data data(Internals::IPv6Stream(*ipv6, fragment_index), ts, position);
+        iter = streams_.insert(make_pair(key, data)).first;
+        buffered_bytes_ += iter->second.stream.buffer_size();
+    }
+    Internals::IPv6Stream& stream = iter->second.stream;
+    const size_t previous_size = stream.buffer_size();
+    const bool is_valid = stream.add_fragment(*ipv6, fragment_index);
+    buffered_bytes_ += stream.buffer_size() - previous_size;
+    if (!is_valid) {
+        remove_stream(iter);
+        return FRAGMENTED;
+    }
+    if (stream.is_complete()) {
+        const bool built = stream.build_packet(*ipv6);
+        remove_stream(iter);
+        return built ? REASSEMBLED : FRAGMENTED;
+    }
+    enforce_memory_limit();
+    return FRAGMENTED;
+}
+
+void IPv6Reassembler::timeout(uint32_t value) {
+    timeout_ = value * microseconds_per_second;
+}
+
+void IPv6Reassembler::max_buffered_bytes(size_t value) {
+    max_buffered_bytes_ = value;
+    enforce_memory_limit();
+}
+
+size_t IPv6Reassembler::buffered_bytes() const {
+    return buffered_bytes_;
+}
+
+size_t IPv6Reassembler::stream_count() const {
+    return streams_.size();
+}
+
+void IPv6Reassembler::clear_streams() {
+    streams_.clear();
+    streams_by_age_.clear();
+    buffered_bytes_ = 0;
+}
+
+void IPv6Reassembler::remove_stream(uint32_t id, const IPv6Address& src_addr,
+                                    const IPv6Address& dst_addr) {
+    streams_type::iterator iter = streams_.find(make_pair(id, make_pair(src_addr, dst_addr)));
+    if (iter != streams_.end()) {
+        remove_stream(iter);
+    }
+}
+
+void IPv6Reassembler::remove_stream(streams_type::iterator iter) {
+    buffered_bytes_ -= iter->second.stream.buffer_size();
+    streams_by_age_.erase(iter->second.position);
+    streams_.erase(iter);
+}
+
+void IPv6Reassembler::expire_streams(timestamp_type now) {
+    // Streams are sorted by age so we only need to look at the oldest ones
+    while (!streams_by_age_.empty()) {
+        streams_type::iterator iter = streams_.find(streams_by_age_.front());
+        if (iter->second.first_seen + timeout_ > now) {
+            break;
+        }
+        remove_stream(iter);
+    }
+}
+
+void IPv6Reassembler::enforce_memory_limit() {
+    while (buffered_bytes_ > max_buffered_bytes_ && !streams_by_age_.empty()) {
+        remove_stream(streams_.find(streams_by_age_.front()));
+    }
 }
 
 } // Tins
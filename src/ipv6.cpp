@@ -176,26 +176,14 @@ IPv6::IPv6(const uint8_t* buffer, uint32_t total_sz) {
                 inner_pdu(new Tins::RawPDU(stream.pointer(), actual_payload_length));
             }
             else {
+                // User registered protocols share the same dispatch table
                 inner_pdu(
                     Internals::pdu_from_flag(
                         static_cast<Constants::IP::e>(current_header),
                         stream.pointer(), 
-                        actual_payload_length,
-                        false
+                        actual_payload_length
                     )
                 );
-                if (!inner_pdu()) {
-                    inner_pdu(
-                        Internals::allocate<IPv6>(
-                            current_header,
-                            stream.pointer(), 
-                            actual_payload_length
-                        )
-                    );
-                    if (!inner_pdu()) {
-                        inner_pdu(new Tins::RawPDU(stream.pointer(), actual_payload_length));
-                    }
-                }
             }
             // We got to an actual PDU, we're done
             break;
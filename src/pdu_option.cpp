@@ -28,6 +28,10 @@
  */
 
 #include <algorithm>
+#include <tins/cxxstd.h>
+#if TINS_IS_CXX11
+    #include <atomic>
+#endif // TINS_IS_CXX11
 #include <tins/pdu.h>
 #include <tins/ip_address.h>
 #include <tins/ipv6_address.h>
@@ -280,5 +284,51 @@ pair<uint32_t, uint32_t> convert(const uint8_t* ptr, uint32_t data_size, PDU::en
 }
 
 } // Converters
+
+class option_buffer {
+public:
+    option_buffer(const uint8_t* start, const uint8_t* end)
+    : references(1), data(start, end) {
+
+    }
+
+    #if TINS_IS_CXX11
+    std::atomic<uint32_t> references;
+    #else
+    uint32_t references;
+    #endif // TINS_IS_CXX11
+    vector<uint8_t> data;
+};
+
+void acquire_option_buffer(option_buffer* buffer) {
+    ++buffer->references;
+}
+
+void release_option_buffer(option_buffer* buffer) {
+    if (--buffer->references == 0) {
+        delete buffer;
+    }
+}
+
+option_block::option_block(const uint8_t* start, const uint8_t* end)
+: start_(start), end_(end), buffer_(0) {
+
+}
+
+option_block::~option_block() {
+    if (buffer_) {
+        release_option_buffer(buffer_);
+    }
+}
+
+const uint8_t* option_block::share(const uint8_t* ptr, option_buffer*& buffer) {
+    if (!buffer_) {
+        buffer_ = new option_buffer(start_, end_);
+    }
+    acquire_option_buffer(buffer_);
+    buffer = buffer_;
+    return &buffer_->data[0] + (ptr - start_);
+}
+
 } // Internals
 } // Tins
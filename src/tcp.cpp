@@ -36,6 +36,7 @@
 #include <tins/exceptions.h>
 #include <tins/memory_helpers.h>
 #include <tins/utils/checksum_utils.h>
+#include <tins/detail/pdu_helpers.h>
 
 using std::vector;
 using std::pair;
@@ -47,6 +48,33 @@ namespace Tins {
 
 const uint16_t TCP::DEFAULT_WINDOW = 32678;
 
+// Reads the option starting at ptr and returns a pointer right after it
+const uint8_t* read_tcp_option(const uint8_t* ptr, const uint8_t* end, uint8_t& option_type,
+                               const uint8_t*& data, uint32_t& data_size) {
+    option_type = *ptr++;
+    data = ptr;
+    data_size = 0;
+    if (option_type == TCP::EOL || option_type == TCP::NOP) {
+        return ptr;
+    }
+    if (TINS_UNLIKELY(ptr == end)) {
+        throw malformed_packet();
+    }
+    // We need to subtract the option type and length from the size
+    uint32_t length = *ptr++;
+    if (TINS_UNLIKELY(length < sizeof(uint8_t) << 1)) {
+        throw malformed_packet();
+    }
+    length -= (sizeof(uint8_t) << 1);
+    // Make sure we have enough bytes for the advertised option payload length
+    if (TINS_UNLIKELY(ptr + length > end)) {
+        throw malformed_packet();
+    }
+    data = ptr;
+    data_size = length;
+    return ptr + length;
+}
+
 PDU::metadata TCP::extract_metadata(const uint8_t *buffer, uint32_t total_sz) {
     if (TINS_UNLIKELY(total_sz < sizeof(tcp_header))) {
         throw malformed_packet();
@@ -56,7 +84,7 @@ PDU::metadata TCP::extract_metadata(const uint8_t *buffer, uint32_t total_sz) {
 }
 
 TCP::TCP(uint16_t dport, uint16_t sport) 
-: header_() {
+: header_(), raw_options_size_(0), options_parsed_(true) {
     this->dport(dport);
     this->sport(sport);
     data_offset(sizeof(tcp_header) / sizeof(uint32_t));
@@ -73,52 +101,33 @@ TCP::TCP(const uint8_t* buffer, uint32_t total_sz) {
     }
     const uint8_t* header_end = buffer + (data_offset() * sizeof(uint32_t));
 
-    if (stream.pointer() < header_end) {
-        // Estimate about 4 bytes per option and reserver that so we avoid doing 
-        // multiple reallocations on the vector
-        options_.reserve((header_end - stream.pointer()) / sizeof(uint32_t));
-    }
-
-    while (stream.pointer() < header_end) {
-        const OptionTypes option_type = (OptionTypes)stream.read<uint8_t>();
+    // Only validate the options here. They're kept in their raw form and 
+    // decoded the first time they're needed
+    const uint8_t* options_start = stream.pointer();
+    const uint8_t* ptr = options_start;
+    while (ptr < header_end) {
+        uint8_t option_type;
+        const uint8_t* data;
+        uint32_t data_size;
+        ptr = read_tcp_option(ptr, header_end, option_type, data, data_size);
         if (option_type == EOL) {
-            stream.skip(header_end - stream.pointer());
             break;
         }
-        else if (option_type == NOP) {
-            #if TINS_IS_CXX11
-            add_option(option_type, 0);
-            #else
-            add_option(option(option_type, 0));
-            #endif // TINS_IS_CXX11
-        }
-        else {
-            // Extract the length
-            uint32_t len = stream.read<uint8_t>();
-            const uint8_t* data_start = stream.pointer();
-
-            // We need to subtract the option type and length from the size
-            if (TINS_UNLIKELY(len < sizeof(uint8_t) << 1)) {
-                throw malformed_packet();
-            }
-            len -= (sizeof(uint8_t) << 1);
-            // Make sure we have enough bytes for the advertised option payload length
-            if (TINS_UNLIKELY(data_start + len > header_end)) {
-                throw malformed_packet(); 
-            }
-            // If we're using C++11, use the variadic template overload
-            #if TINS_IS_CXX11
-            add_option(option_type, data_start, data_start + len);
-            #else
-            add_option(option(option_type, data_start, data_start + len));
-            #endif // TINS_IS_CXX11
-            // Skip the option's payload
-            stream.skip(len);
-        }
     }
+    raw_options_size_ = static_cast<uint8_t>(header_end - options_start);
+    memcpy(raw_options_, options_start, raw_options_size_);
+    options_parsed_ = raw_options_size_ == 0;
+    stream.skip(raw_options_size_);
     // If we still have any bytes left
     if (stream) {
-        inner_pdu(new RawPDU(stream.pointer(), stream.size()));
+        inner_pdu(
+            Internals::pdu_from_tcp_ports(
+                sport(),
+                dport(),
+                stream.pointer(),
+                static_cast<uint32_t>(stream.size())
+            )
+        );
     }
 }
 
@@ -176,6 +185,11 @@ void TCP::sack_permitted() {
 }
 
 bool TCP::has_sack_permitted() const {
+    if (!options_parsed_) {
+        const uint8_t* data;
+        uint32_t data_size;
+        return find_raw_option(SACK_OK, data, data_size);
+    }
     return search_option(SACK_OK) != NULL;
 }
 
@@ -191,11 +205,7 @@ void TCP::sack(const sack_type& edges) {
 }
 
 TCP::sack_type TCP::sack() const {
-    const option* opt = search_option(SACK);
-    if (!opt) {
-        throw option_not_found();
-    }
-    return opt->to<sack_type>();
+    return generic_search<sack_type>(SACK);
 }
 
 void TCP::timestamp(uint32_t value, uint32_t reply) {
@@ -205,11 +215,7 @@ void TCP::timestamp(uint32_t value, uint32_t reply) {
 }
 
 pair<uint32_t, uint32_t> TCP::timestamp() const {
-    const option* opt = search_option(TSOPT);
-    if (!opt) {
-        throw option_not_found();
-    }
-    return opt->to<pair<uint32_t, uint32_t> >();
+    return generic_search<pair<uint32_t, uint32_t> >(TSOPT);
 }
 
 void TCP::altchecksum(AltChecksums value) {
@@ -296,6 +302,7 @@ void TCP::flags(small_uint<12> value) {
 }
 
 void TCP::add_option(const option& opt) {
+    parse_options();
     options_.push_back(opt);
 }
 
@@ -311,6 +318,7 @@ void TCP::write_serialization(uint8_t* buffer, uint32_t total_sz) {
     checksum(0);
     header_.doff = (sizeof(tcp_header) + total_options_size) / sizeof(uint32_t);
     stream.write(header_);
+    parse_options();
     for (options_type::const_iterator it = options_.begin(); it != options_.end(); ++it) {
         write_option(*it, stream);
     }
@@ -350,6 +358,7 @@ void TCP::write_serialization(uint8_t* buffer, uint32_t total_sz) {
 }
 
 const TCP::option* TCP::search_option(OptionTypes type) const {
+    parse_options();
     // Search for the iterator. If we found something, return it, otherwise return nullptr.
     options_type::const_iterator iter = search_option_iterator(type);
     return (iter != options_.end()) ? &*iter : 0;
@@ -382,6 +391,25 @@ void TCP::write_option(const option& opt, OutputMemoryStream& stream) {
 
 uint32_t TCP::calculate_options_size() const {
     uint32_t options_size = 0;
+    if (!options_parsed_) {
+        // Same as below, without decoding the options
+        const uint8_t* ptr = raw_options_;
+        const uint8_t* end = raw_options_ + raw_options_size_;
+        while (ptr < end) {
+            uint8_t option_type;
+            const uint8_t* data;
+            uint32_t data_size;
+            ptr = read_tcp_option(ptr, end, option_type, data, data_size);
+            if (option_type == EOL) {
+                break;
+            }
+            options_size += sizeof(uint8_t);
+            if (data_size || option_type == SACK_OK) {
+                options_size += sizeof(uint8_t) + data_size;
+            }
+        }
+        return options_size;
+    }
     for (options_type::const_iterator iter = options_.begin(); iter != options_.end(); ++iter) {
         const option& opt = *iter;
         options_size += sizeof(uint8_t);
@@ -399,7 +427,54 @@ uint32_t TCP::pad_options_size(uint32_t size) const {
     return padding ? (size - padding + 4) : size;
 }
 
+void TCP::parse_options() const {
+    if (options_parsed_) {
+        return;
+    }
+    options_parsed_ = true;
+    const uint8_t* ptr = raw_options_;
+    const uint8_t* end = raw_options_ + raw_options_size_;
+    // Estimate about 4 bytes per option and reserve that so we avoid doing 
+    // multiple reallocations on the vector
+    options_.reserve(raw_options_size_ / sizeof(uint32_t));
+    Internals::option_block block(ptr, end);
+    while (ptr < end) {
+        uint8_t option_type;
+        const uint8_t* data;
+        uint32_t data_size;
+        ptr = read_tcp_option(ptr, end, option_type, data, data_size);
+        if (option_type == EOL) {
+            break;
+        }
+        else if (option_type == NOP) {
+            options_.push_back(option(NOP, 0));
+        }
+        else {
+            options_.push_back(
+                option((OptionTypes)option_type, data_size, data, data_size, block)
+            );
+        }
+    }
+}
+
+bool TCP::find_raw_option(OptionTypes type, const uint8_t*& data, uint32_t& data_size) const {
+    const uint8_t* ptr = raw_options_;
+    const uint8_t* end = raw_options_ + raw_options_size_;
+    while (ptr < end) {
+        uint8_t option_type;
+        ptr = read_tcp_option(ptr, end, option_type, data, data_size);
+        if (option_type == EOL) {
+            break;
+        }
+        if (option_type == type) {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool TCP::remove_option(OptionTypes type) {
+    parse_options();
     options_type::iterator iter = search_option_iterator(type);
     if (iter == options_.end()) {
         return false;
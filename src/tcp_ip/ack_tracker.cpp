@@ -33,6 +33,9 @@
 
 #include <limits>
 #include <tins/tcp.h>
+#include <tins/endianness.h>
+#include <tins/memory_helpers.h>
+#include <tins/tcp_ip/segment_info.h>
 #include <tins/detail/sequence_number_helpers.h>
 
 using std::vector;
@@ -41,6 +44,8 @@ using std::numeric_limits;
 using boost::icl::interval_bounds;
 using boost::icl::contains;
 
+using Tins::Memory::InputMemoryStream;
+using Tins::Memory::OutputMemoryStream;
 using Tins::Internals::seq_compare;
 
 namespace Tins {
@@ -109,6 +114,17 @@ AckTracker::AckTracker(uint32_t initial_ack, bool use_sack)
 
 }
 
+AckTracker::AckTracker(InputMemoryStream& input) {
+    ack_number_ = input.read_le<uint32_t>();
+    use_sack_ = input.read<uint8_t>() != 0;
+    uint32_t interval_count = input.read_le<uint32_t>();
+    while (interval_count--) {
+        const uint32_t first = input.read_le<uint32_t>();
+        const uint32_t last = input.read_le<uint32_t>();
+        acked_intervals_.insert(AckedRange::interval_type::closed(first, last));
+    }
+}
+
 void AckTracker::process_packet(const PDU& packet) {
     const TCP* tcp = packet.find_pdu<TCP>();
     if (!tcp) {
@@ -127,6 +143,21 @@ void AckTracker::process_packet(const PDU& packet) {
     }
 }
 
+void AckTracker::process_segment(const SegmentInfo& segment) {
+    if (seq_compare(segment.ack_seq, ack_number_) > 0) {
+        cleanup_sacked_intervals(ack_number_, segment.ack_seq);
+        ack_number_ = segment.ack_seq;
+    }
+    if (use_sack_ && segment.sack_size > 0) {
+        vector<uint32_t> sack(segment.sack_size / sizeof(uint32_t));
+        for (size_t i = 0; i < sack.size(); ++i) {
+            Memory::read_value(segment.sack + i * sizeof(uint32_t), sack[i]);
+            sack[i] = Endian::be_to_host(sack[i]);
+        }
+        process_sack(sack);
+    }
+}
+
 void AckTracker::process_sack(const vector<uint32_t>& sack) {
     for (size_t i = 1; i < sack.size(); i += 2) {
         // Left edge must be lower than right edge
@@ -188,6 +219,23 @@ bool AckTracker::is_segment_acked(uint32_t sequence_number, uint32_t length) con
     return true;
 }
 
+size_t AckTracker::serialized_size() const {
+    return sizeof(uint32_t) * 2 + sizeof(uint8_t) +
+           acked_intervals_.iterative_size() * sizeof(uint32_t) * 2;
+}
+
+void AckTracker::serialize(OutputMemoryStream& output) const {
+    output.write_le<uint32_t>(ack_number_);
+    output.write<uint8_t>(use_sack_ ? 1 : 0);
+    output.write_le<uint32_t>(acked_intervals_.iterative_size());
+    interval_set_type::const_iterator iter = acked_intervals_.begin();
+    for (; iter != acked_intervals_.end(); ++iter) {
+        // Intervals are always stored as closed ones
+        output.write_le<uint32_t>(interval_start(*iter));
+        output.write_le<uint32_t>(interval_end(*iter));
+    }
+}
+
 } // TCPIP
 } // Tins
 
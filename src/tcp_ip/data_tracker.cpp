@@ -31,8 +31,11 @@
 
 #ifdef TINS_HAVE_TCPIP
 
+#include <tins/memory_helpers.h>
 #include <tins/detail/sequence_number_helpers.h>
 
+using Tins::Memory::InputMemoryStream;
+using Tins::Memory::OutputMemoryStream;
 using Tins::Internals::seq_compare;
 
 namespace Tins {
@@ -48,6 +51,19 @@ DataTracker::DataTracker(uint32_t seq_number)
 
 }
 
+DataTracker::DataTracker(InputMemoryStream& input)
+: total_buffered_bytes_(0) {
+    seq_number_ = input.read_le<uint32_t>();
+    input.read(payload_, input.read_le<uint32_t>());
+    uint32_t chunk_count = input.read_le<uint32_t>();
+    while (chunk_count--) {
+        const uint32_t seq = input.read_le<uint32_t>();
+        payload_type& chunk = buffered_payload_[seq];
+        input.read(chunk, input.read_le<uint32_t>());
+        total_buffered_bytes_ += chunk.size();
+    }
+}
+
 bool DataTracker::process_payload(uint32_t seq, payload_type payload) {
     const uint32_t chunk_end = seq + payload.size();
     // If the end of the chunk ends before current sequence number, ignore it.
@@ -151,6 +167,27 @@ uint32_t DataTracker::total_buffered_bytes() const {
     return total_buffered_bytes_;
 }
 
+size_t DataTracker::serialized_size() const {
+    // Sequence number, payload size and buffered chunk count
+    size_t output = sizeof(uint32_t) * 3 + payload_.size();
+    // Each chunk's sequence number and size
+    output += buffered_payload_.size() * sizeof(uint32_t) * 2;
+    return output + total_buffered_bytes_;
+}
+
+void DataTracker::serialize(OutputMemoryStream& output) const {
+    output.write_le<uint32_t>(seq_number_);
+    output.write_le<uint32_t>(payload_.size());
+    output.write(payload_.begin(), payload_.end());
+    output.write_le<uint32_t>(buffered_payload_.size());
+    buffered_payload_type::const_iterator iter = buffered_payload_.begin();
+    for (; iter != buffered_payload_.end(); ++iter) {
+        output.write_le<uint32_t>(iter->first);
+        output.write_le<uint32_t>(iter->second.size());
+        output.write(iter->second.begin(), iter->second.end());
+    }
+}
+
 void DataTracker::store_payload(uint32_t seq, payload_type payload) {
     buffered_payload_type::iterator iter = buffered_payload_.find(seq);
     // New segment, store it
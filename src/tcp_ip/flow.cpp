@@ -32,12 +32,14 @@
 #ifdef TINS_HAVE_TCPIP
 
 #include <limits>
+#include <cstring>
 #include <tins/ip_address.h>
 #include <tins/ipv6_address.h>
 #include <tins/tcp.h>
 #include <tins/ip.h>
 #include <tins/ipv6.h>
 #include <tins/rawpdu.h>
+#include <tins/tcp_ip/segment_info.h>
 #include <tins/detail/sequence_number_helpers.h>
 #include <tins/exceptions.h>
 #include <tins/memory_helpers.h>
@@ -72,6 +74,33 @@ Flow::Flow(const IPv6Address& dest_address, uint16_t dest_port,
     initialize();
 }
 
+Flow::Flow(InputMemoryStream& input)
+: data_tracker_(input) {
+    input.read(dest_address_.data(), dest_address_.size());
+    dest_port_ = input.read_le<uint16_t>();
+    const uint8_t state = input.read<uint8_t>();
+    if (state > RST_SENT) {
+        throw malformed_packet();
+    }
+    state_ = static_cast<State>(state);
+    mss_ = static_cast<int32_t>(input.read_le<uint32_t>());
+    const uint8_t flags = input.read<uint8_t>();
+    flags_.is_v6 = (flags >> 0) & 1;
+    flags_.ignore_data_packets = (flags >> 1) & 1;
+    flags_.sack_permitted = (flags >> 2) & 1;
+    if ((flags >> 3) & 1) {
+        #ifdef TINS_HAVE_ACK_TRACKER
+        flags_.ack_tracking = 1;
+        ack_tracker_ = AckTracker(input);
+        #else
+        // Skip the ACK number, the SACK flag and the acked intervals
+        input.skip(sizeof(uint32_t) + sizeof(uint8_t));
+        const uint32_t interval_count = input.read_le<uint32_t>();
+        input.skip(static_cast<size_t>(interval_count) * sizeof(uint32_t) * 2);
+        #endif // TINS_HAVE_ACK_TRACKER
+    }
+}
+
 void Flow::initialize() {
     state_ = UNKNOWN;
     mss_ = -1;
@@ -87,7 +116,6 @@ void Flow::out_of_order_callback(const flow_packet_callback_type& callback) {
 
 void Flow::process_packet(PDU& pdu) {
     TCP* tcp = pdu.find_pdu<TCP>();
-    RawPDU* raw = pdu.find_pdu<RawPDU>(); 
     // Update the internal state first
     if (tcp) {
         update_state(*tcp);
@@ -100,22 +128,50 @@ void Flow::process_packet(PDU& pdu) {
     if (flags_.ignore_data_packets) {
         return;
     }
-    if (!tcp || !raw) {
+    if (!tcp || !tcp->inner_pdu()) {
+        return;
+    }
+    PDU* inner = tcp->inner_pdu();
+    if (inner->pdu_type() == PDU::RAW) {
+        process_payload(tcp->seq(), std::move(static_cast<RawPDU*>(inner)->payload()));
+    }
+    else {
+        // Decoded through a port allocator, follow its serialization
+        process_payload(tcp->seq(), inner->serialize());
+    }
+}
+
+void Flow::process_segment(const SegmentInfo& segment) {
+    update_state(segment.flags, segment.seq, segment.ack_seq, segment.mss,
+                 segment.sack_permitted);
+    #ifdef TINS_HAVE_ACK_TRACKER
+    if (flags_.ack_tracking) {
+        ack_tracker_.process_segment(segment);
+    }
+    #endif // TINS_HAVE_ACK_TRACKER
+    if (flags_.ignore_data_packets || segment.payload_size == 0) {
         return;
     }
-    const uint32_t chunk_end = tcp->seq() + raw->payload_size();
+    process_payload(
+        segment.seq,
+        payload_type(segment.payload, segment.payload + segment.payload_size)
+    );
+}
+
+void Flow::process_payload(uint32_t seq, payload_type payload) {
+    const uint32_t chunk_end = seq + payload.size();
     const uint32_t current_seq = data_tracker_.sequence_number();
     // If the end of the chunk ends before the current sequence number or
     // if we're going to buffer this and we have a buffering callback, execute it
     if (seq_compare(chunk_end, current_seq) < 0 ||
-            seq_compare(tcp->seq(), current_seq) > 0){
+            seq_compare(seq, current_seq) > 0){
         if (on_out_of_order_callback_) {
-            on_out_of_order_callback_(*this, tcp->seq(), raw->payload());
+            on_out_of_order_callback_(*this, seq, payload);
         }
     }
 
     // can process either way, since it will abort immediately if not needed
-    if (data_tracker_.process_payload(tcp->seq(), std::move(raw->payload()))) {
+    if (data_tracker_.process_payload(seq, std::move(payload))) {
         if (on_data_callback_) {
             on_data_callback_(*this);
         }
@@ -127,30 +183,44 @@ void Flow::advance_sequence(uint32_t seq) {
 }
 
 void Flow::update_state(const TCP& tcp) {
-    if (tcp.has_flags(TCP::FIN)) {
+    int mss = -1;
+    bool sack_permitted = false;
+    // Options are only relevant on SYNs, avoid looking them up otherwise
+    if (tcp.has_flags(TCP::SYN)) {
+        const TCP::option* mss_option = tcp.search_option(TCP::MSS);
+        if (mss_option) {
+            mss = mss_option->to<uint16_t>();
+        }
+        sack_permitted = tcp.has_sack_permitted();
+    }
+    update_state(tcp.flags(), tcp.seq(), tcp.ack_seq(), mss, sack_permitted);
+}
+
+void Flow::update_state(uint8_t tcp_flags, uint32_t seq, uint32_t ack_seq, int mss,
+                        bool sack_permitted) {
+    if ((tcp_flags & TCP::FIN) != 0) {
         state_ = FIN_SENT;
     }
-    else if (tcp.has_flags(TCP::RST)) {
+    else if ((tcp_flags & TCP::RST) != 0) {
         state_ = RST_SENT;
     }
-    else if (state_ == SYN_SENT && tcp.has_flags(TCP::ACK)) {
+    else if (state_ == SYN_SENT && (tcp_flags & TCP::ACK) != 0) {
         #ifdef TINS_HAVE_ACK_TRACKER
-            ack_tracker_ = AckTracker(tcp.ack_seq());
+            ack_tracker_ = AckTracker(ack_seq);
         #endif // TINS_HAVE_ACK_TRACKER
         state_ = ESTABLISHED;
     }
-    else if (state_ == UNKNOWN && tcp.has_flags(TCP::SYN)) {
+    else if (state_ == UNKNOWN && (tcp_flags & TCP::SYN) != 0) {
         // This is the server's state, sending it's first SYN|ACK
         #ifdef TINS_HAVE_ACK_TRACKER
-            ack_tracker_ = AckTracker(tcp.ack_seq());
+            ack_tracker_ = AckTracker(ack_seq);
         #endif // TINS_HAVE_ACK_TRACKER
         state_ = SYN_SENT;
-        data_tracker_.sequence_number(tcp.seq() + 1);
-        const TCP::option* mss_option = tcp.search_option(TCP::MSS);
-        if (mss_option) {
-            mss_ = mss_option->to<uint16_t>();
+        data_tracker_.sequence_number(seq + 1);
+        if (mss != -1) {
+            mss_ = mss;
         }
-        flags_.sack_permitted = tcp.has_sack_permitted();
+        flags_.sack_permitted = sack_permitted;
     }
 }
 
@@ -179,6 +249,14 @@ bool Flow::packet_belongs(const PDU& packet) const {
     return tcp && tcp->dport() == dport();
 }
 
+bool Flow::segment_belongs(const SegmentInfo& segment) const {
+    if (segment.is_v6 != is_v6() || segment.dport != dport()) {
+        return false;
+    }
+    const size_t address_size = is_v6() ? IPv6Address::address_size : sizeof(uint32_t);
+    return std::memcmp(segment.dst_addr.data(), dest_address_.data(), address_size) == 0;
+}
+
 IPv4Address Flow::dst_addr_v4() const {
     InputMemoryStream stream(dest_address_.data(), dest_address_.size());
     return stream.read<IPv4Address>();
@@ -260,6 +338,35 @@ AckTracker& Flow::ack_tracker() {
 
 #endif // TINS_HAVE_ACK_TRACKER
 
+size_t Flow::serialized_size() const {
+    // Destination address, port, state, MSS and flags
+    size_t output = data_tracker_.serialized_size() + dest_address_.size() + 
+                    sizeof(uint16_t) + sizeof(uint8_t) + sizeof(uint32_t) +
+                    sizeof(uint8_t);
+    #ifdef TINS_HAVE_ACK_TRACKER
+    if (flags_.ack_tracking) {
+        output += ack_tracker_.serialized_size();
+    }
+    #endif // TINS_HAVE_ACK_TRACKER
+    return output;
+}
+
+void Flow::serialize(OutputMemoryStream& output) const {
+    data_tracker_.serialize(output);
+    output.write(dest_address_.data(), dest_address_.size());
+    output.write_le<uint16_t>(dest_port_);
+    output.write<uint8_t>(state_);
+    output.write_le<uint32_t>(static_cast<uint32_t>(mss_));
+    const uint8_t flags = (flags_.is_v6 << 0) | (flags_.ignore_data_packets << 1) |
+                          (flags_.sack_permitted << 2) | (flags_.ack_tracking << 3);
+    output.write<uint8_t>(flags);
+    #ifdef TINS_HAVE_ACK_TRACKER
+    if (flags_.ack_tracking) {
+        ack_tracker_.serialize(output);
+    }
+    #endif // TINS_HAVE_ACK_TRACKER
+}
+
 } // TCPIP
 } // Tins
 
@@ -0,0 +1,334 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/tcp_ip/http_framer.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+#include <limits>
+
+using std::min;
+using std::search;
+using std::numeric_limits;
+
+namespace Tins {
+namespace TCPIP {
+
+const size_t HTTPFramer::DEFAULT_MAX_HEADERS_SIZE = 64 * 1024;
+// Chunk size lines are tiny, unless they contain absurd extensions
+const size_t max_chunk_line_size = 1024;
+
+static bool header_name_equals(const uint8_t* name, size_t size, const char* expected) {
+    const size_t expected_size = std::strlen(expected);
+    if (size != expected_size) {
+        return false;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        if (std::tolower(name[i]) != expected[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool header_value_contains(const uint8_t* value, size_t size, const char* expected) {
+    const size_t expected_size = std::strlen(expected);
+    for (size_t i = 0; i + expected_size <= size; ++i) {
+        size_t j = 0;
+        while (j < expected_size && std::tolower(value[i + j]) == expected[j]) {
+            ++j;
+        }
+        if (j == expected_size) {
+            return true;
+        }
+    }
+    return false;
+}
+
+HTTPFramer::HTTPFramer(MessageType type)
+: max_headers_size_(DEFAULT_MAX_HEADERS_SIZE), remaining_(0), scanned_(0), type_(type),
+  state_(HEADERS) {
+
+}
+
+void HTTPFramer::headers_callback(const data_callback_type& callback) {
+    on_headers_ = callback;
+}
+
+void HTTPFramer::body_callback(const data_callback_type& callback) {
+    on_body_ = callback;
+}
+
+void HTTPFramer::message_end_callback(const message_end_callback_type& callback) {
+    on_message_end_ = callback;
+}
+
+void HTTPFramer::max_headers_size(size_t value) {
+    max_headers_size_ = value;
+}
+
+bool HTTPFramer::has_error() const {
+    return state_ == FRAMING_ERROR;
+}
+
+size_t HTTPFramer::operator()(const uint8_t* data, size_t size) {
+    size_t consumed = 0;
+    while (consumed < size) {
+        const uint8_t* ptr = data + consumed;
+        const size_t available = size - consumed;
+        switch (state_) {
+            case HEADERS:
+                {
+                    // Skip empty lines in between messages
+                    if (scanned_ == 0 && (*ptr == '\r' || *ptr == '\n')) {
+                        consumed++;
+                        break;
+                    }
+                    const size_t end = find_sequence(ptr, available, "\r\n\r\n", 4);
+                    if (end == available) {
+                        if (available > max_headers_size_) {
+                            state_ = FRAMING_ERROR;
+                            break;
+                        }
+                        return consumed;
+                    }
+                    const size_t headers_size = end + 4;
+                    if (on_headers_) {
+                        on_headers_(ptr, headers_size);
+                    }
+                    consumed += headers_size;
+                    process_headers(ptr, headers_size);
+                }
+                break;
+            case BODY:
+            case CHUNK_DATA:
+                {
+                    const size_t chunk_size = static_cast<size_t>(
+                        min<uint64_t>(available, remaining_)
+                    );
+                    notify_body(ptr, chunk_size);
+                    consumed += chunk_size;
+                    remaining_ -= chunk_size;
+                    if (remaining_ == 0) {
+                        if (state_ == BODY) {
+                            finish_message();
+                        }
+                        else {
+                            state_ = CHUNK_DATA_END;
+                        }
+                    }
+                }
+                break;
+            case BODY_UNTIL_CLOSE:
+                notify_body(ptr, available);
+                consumed += available;
+                break;
+            case CHUNK_SIZE:
+                {
+                    const size_t end = find_sequence(ptr, available, "\r\n", 2);
+                    if (end == available) {
+                        if (available > max_chunk_line_size) {
+                            state_ = FRAMING_ERROR;
+                            break;
+                        }
+                        return consumed;
+                    }
+                    uint64_t chunk_size = 0;
+                    size_t digits = 0;
+                    while (digits < end && std::isxdigit(ptr[digits])) {
+                        const uint8_t digit = ptr[digits];
+                        // Reject sizes that would overflow
+                        if (chunk_size >> 60) {
+                            break;
+                        }
+                        chunk_size = chunk_size * 16 + (std::isdigit(digit) ? 
+                                     digit - '0' : std::tolower(digit) - 'a' + 10);
+                        digits++;
+                    }
+                    if (digits == 0 || (digits < end && ptr[digits] != ';' && 
+                        ptr[digits] != ' ' && ptr[digits] != '\t')) {
+                        state_ = FRAMING_ERROR;
+                        break;
+                    }
+                    consumed += end + 2;
+                    remaining_ = chunk_size;
+                    state_ = chunk_size == 0 ? CHUNK_TRAILERS : CHUNK_DATA;
+                }
+                break;
+            case CHUNK_DATA_END:
+                if (available < 2) {
+                    return consumed;
+                }
+                if (ptr[0] != '\r' || ptr[1] != '\n') {
+                    state_ = FRAMING_ERROR;
+                    break;
+                }
+                consumed += 2;
+                state_ = CHUNK_SIZE;
+                break;
+            case CHUNK_TRAILERS:
+                {
+                    const size_t end = find_sequence(ptr, available, "\r\n", 2);
+                    if (end == available) {
+                        if (available > max_headers_size_) {
+                            state_ = FRAMING_ERROR;
+                            break;
+                        }
+                        return consumed;
+                    }
+                    consumed += end + 2;
+                    // An empty line ends the trailers and the message
+                    if (end == 0) {
+                        finish_message();
+                    }
+                }
+                break;
+            case FRAMING_ERROR:
+                // Discard everything
+                consumed = size;
+                break;
+        }
+    }
+    return consumed;
+}
+
+size_t HTTPFramer::find_sequence(const uint8_t* data, size_t size, const char* sequence,
+                                 size_t sequence_size) {
+    // Don't look again at the bytes scanned on previous calls
+    const size_t start = scanned_ >= sequence_size ? scanned_ - (sequence_size - 1) : 0;
+    const uint8_t* end = data + size;
+    const uint8_t* iter = search(data + min(start, size), end, sequence,
+                                 sequence + sequence_size);
+    if (iter == end) {
+        scanned_ = size;
+        return size;
+    }
+    scanned_ = 0;
+    return iter - data;
+}
+
+void HTTPFramer::process_headers(const uint8_t* data, size_t size) {
+    const uint8_t* end = data + size;
+    const uint8_t* line = data;
+    const uint8_t* line_end = search(line, end, "\r\n", "\r\n" + 2);
+    bool has_body = true;
+    if (type_ == RESPONSE) {
+        // The status code goes right after "HTTP/x.y "
+        const uint8_t* status = std::find(line, line_end, ' ');
+        int status_code = 0;
+        while (status != line_end && *status == ' ') {
+            ++status;
+        }
+        for (size_t i = 0; i < 3 && status + i < line_end && std::isdigit(status[i]); ++i) {
+            status_code = status_code * 10 + (status[i] - '0');
+        }
+        // After switching protocols, everything is opaque data
+        if (status_code == 101) {
+            state_ = BODY_UNTIL_CLOSE;
+            return;
+        }
+        has_body = !((status_code >= 100 && status_code < 200) || status_code == 204 ||
+                     status_code == 304);
+    }
+    bool chunked = false;
+    bool has_length = false;
+    uint64_t content_length = 0;
+    while (line_end != end) {
+        line = line_end + 2;
+        line_end = search(line, end, "\r\n", "\r\n" + 2);
+        const uint8_t* colon = std::find(line, line_end, ':');
+        if (colon == line_end) {
+            continue;
+        }
+        const uint8_t* value = colon + 1;
+        while (value != line_end && (*value == ' ' || *value == '\t')) {
+            ++value;
+        }
+        if (header_name_equals(line, colon - line, "content-length")) {
+            has_length = true;
+            content_length = 0;
+            while (value != line_end && std::isdigit(*value)) {
+                const uint64_t digit = *value - '0';
+                // A length that doesn't fit can't be used to frame the body
+                if (content_length > (numeric_limits<uint64_t>::max() - digit) / 10) {
+                    state_ = FRAMING_ERROR;
+                    return;
+                }
+                content_length = content_length * 10 + digit;
+                ++value;
+            }
+        }
+        else if (header_name_equals(line, colon - line, "transfer-encoding")) {
+            chunked = header_value_contains(value, line_end - value, "chunked");
+        }
+    }
+    if (!has_body) {
+        finish_message();
+    }
+    else if (chunked) {
+        state_ = CHUNK_SIZE;
+    }
+    else if (has_length) {
+        remaining_ = content_length;
+        if (remaining_ == 0) {
+            finish_message();
+        }
+        else {
+            state_ = BODY;
+        }
+    }
+    else if (type_ == RESPONSE) {
+        state_ = BODY_UNTIL_CLOSE;
+    }
+    else {
+        finish_message();
+    }
+}
+
+void HTTPFramer::notify_body(const uint8_t* data, size_t size) {
+    if (on_body_ && size > 0) {
+        on_body_(data, size);
+    }
+}
+
+void HTTPFramer::finish_message() {
+    state_ = HEADERS;
+    remaining_ = 0;
+    if (on_message_end_) {
+        on_message_end_();
+    }
+}
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
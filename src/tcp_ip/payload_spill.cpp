@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/tcp_ip/payload_spill.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <algorithm>
+#include <cstring>
+#include <tins/exceptions.h>
+
+using std::min;
+using std::shared_ptr;
+
+namespace Tins {
+namespace TCPIP {
+
+// Seeks using 64 bit offsets, as spilled payloads can grow past 2GB
+static int seek_file(FILE* file, uint64_t offset, int whence) {
+    #ifdef _WIN32
+        return _fseeki64(file, static_cast<__int64>(offset), whence);
+    #else
+        return fseeko(file, static_cast<off_t>(offset), whence);
+    #endif
+}
+
+// PayloadSpill
+
+// The backing file and the amount of bytes written to it. This is shared by
+// every copy of a PayloadSpill so they always agree on its size
+struct PayloadSpill::Storage {
+    Storage(FILE* file)
+    : file(file), size(0) {
+
+    }
+
+    ~Storage() {
+        std::fclose(file);
+    }
+
+    FILE* file;
+    uint64_t size;
+private:
+    Storage(const Storage&);
+    Storage& operator=(const Storage&);
+};
+
+PayloadSpill::PayloadSpill() {
+
+}
+
+void PayloadSpill::append(const uint8_t* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    if (!storage_) {
+        FILE* file = std::tmpfile();
+        if (!file) {
+            throw spill_error();
+        }
+        storage_ = shared_ptr<Storage>(new Storage(file));
+    }
+    // Reads may have moved the file position, so always go back to the end
+    if (seek_file(storage_->file, 0, SEEK_END) != 0 ||
+        std::fwrite(data, 1, size, storage_->file) != size) {
+        throw spill_error();
+    }
+    storage_->size += size;
+}
+
+size_t PayloadSpill::read(uint64_t offset, uint8_t* buffer, size_t size) const {
+    if (offset >= this->size() || size == 0) {
+        return 0;
+    }
+    size = static_cast<size_t>(min<uint64_t>(size, storage_->size - offset));
+    if (seek_file(storage_->file, offset, SEEK_SET) != 0) {
+        throw spill_error();
+    }
+    return std::fread(buffer, 1, size, storage_->file);
+}
+
+uint64_t PayloadSpill::size() const {
+    return storage_ ? storage_->size : 0;
+}
+
+bool PayloadSpill::empty() const {
+    return size() == 0;
+}
+
+void PayloadSpill::clear() {
+    storage_.reset();
+}
+
+// PayloadReader
+
+PayloadReader::PayloadReader(const PayloadSpill& spill, const payload_type& payload)
+: spill_(&spill), payload_(&payload), position_(0) {
+
+}
+
+size_t PayloadReader::read(uint8_t* buffer, size_t size) {
+    size_t total_read = 0;
+    const uint64_t spilled = spill_->size();
+    if (position_ < spilled) {
+        total_read = spill_->read(position_, buffer, size);
+        position_ += total_read;
+        if (total_read == size || position_ < spilled) {
+            return total_read;
+        }
+    }
+    const uint64_t payload_offset = position_ - spilled;
+    if (payload_offset < payload_->size()) {
+        const size_t chunk_size = static_cast<size_t>(
+            min<uint64_t>(size - total_read, payload_->size() - payload_offset)
+        );
+        std::memcpy(buffer + total_read, &(*payload_)[0] + payload_offset, chunk_size);
+        position_ += chunk_size;
+        total_read += chunk_size;
+    }
+    return total_read;
+}
+
+uint64_t PayloadReader::size() const {
+    return spill_->size() + payload_->size();
+}
+
+uint64_t PayloadReader::position() const {
+    return position_;
+}
+
+bool PayloadReader::eof() const {
+    return position_ >= size();
+}
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/tcp_ip/segment_info.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <cstring>
+#include <tins/tcp.h>
+#include <tins/constants.h>
+#include <tins/endianness.h>
+#include <tins/memory_helpers.h>
+
+namespace Tins {
+namespace TCPIP {
+
+template <typename T>
+static T read_be(const uint8_t* buffer) {
+    T value;
+    Memory::read_value(buffer, value);
+    return Endian::be_to_host(value);
+}
+
+SegmentInfo::SegmentInfo()
+: is_v6(false), sport(0), dport(0), seq(0), ack_seq(0), flags(0), mss(-1),
+  sack_permitted(false), sack(0), sack_size(0), payload(0), payload_size(0) {
+    src_addr.fill(0);
+    dst_addr.fill(0);
+}
+
+bool SegmentInfo::scan_ethernet(const uint8_t* buffer, uint32_t total_sz) {
+    const uint32_t ethernet_header_size = 14;
+    const uint32_t vlan_tag_size = 4;
+    if (total_sz < ethernet_header_size) {
+        return false;
+    }
+    dst_hw_addr = hwaddress_type(buffer);
+    src_hw_addr = hwaddress_type(buffer + hwaddress_type::address_size);
+    uint32_t offset = ethernet_header_size;
+    uint16_t ether_type = read_be<uint16_t>(buffer + offset - 2);
+    while (ether_type == Constants::Ethernet::VLAN ||
+           ether_type == Constants::Ethernet::QINQ ||
+           ether_type == Constants::Ethernet::OLD_QINQ) {
+        if (total_sz < offset + vlan_tag_size) {
+            return false;
+        }
+        ether_type = read_be<uint16_t>(buffer + offset + 2);
+        offset += vlan_tag_size;
+    }
+    if (ether_type != Constants::Ethernet::IP && ether_type != Constants::Ethernet::IPV6) {
+        return false;
+    }
+    return scan_ip(buffer + offset, total_sz - offset);
+}
+
+bool SegmentInfo::scan_ip(const uint8_t* buffer, uint32_t total_sz) {
+    const uint32_t ipv4_header_size = 20;
+    const uint32_t ipv6_header_size = 40;
+    if (total_sz < 1) {
+        return false;
+    }
+    const uint8_t version = buffer[0] >> 4;
+    if (version == 4) {
+        if (total_sz < ipv4_header_size) {
+            return false;
+        }
+        const uint32_t header_size = (buffer[0] & 0x0f) * 4;
+        const uint32_t total_length = read_be<uint16_t>(buffer + 2);
+        const uint16_t fragment_field = read_be<uint16_t>(buffer + 6);
+        // Either more fragments are coming or this isn't the first one
+        if ((fragment_field & 0x3fff) != 0) {
+            return false;
+        }
+        if (buffer[9] != Constants::IP::PROTO_TCP || header_size < ipv4_header_size ||
+            header_size > total_sz) {
+            return false;
+        }
+        // Ignore any padding after the datagram, but handle TSO-style 0 lengths
+        if (total_length >= header_size && total_length < total_sz) {
+            total_sz = total_length;
+        }
+        is_v6 = false;
+        src_addr.fill(0);
+        dst_addr.fill(0);
+        std::memcpy(src_addr.data(), buffer + 12, 4);
+        std::memcpy(dst_addr.data(), buffer + 16, 4);
+        return scan_tcp(buffer + header_size, total_sz - header_size);
+    }
+    else if (version == 6) {
+        if (total_sz < ipv6_header_size) {
+            return false;
+        }
+        const uint32_t payload_length = read_be<uint16_t>(buffer + 4);
+        if (payload_length != 0 && payload_length + ipv6_header_size < total_sz) {
+            total_sz = payload_length + ipv6_header_size;
+        }
+        uint8_t next_header = buffer[6];
+        std::memcpy(src_addr.data(), buffer + 8, 16);
+        std::memcpy(dst_addr.data(), buffer + 24, 16);
+        is_v6 = true;
+        uint32_t offset = ipv6_header_size;
+        // Skip any extension headers
+        while (next_header != Constants::IP::PROTO_TCP) {
+            if (total_sz < offset + 8) {
+                return false;
+            }
+            uint32_t extension_size;
+            switch (next_header) {
+                case Constants::IP::PROTO_HOPOPTS:
+                case Constants::IP::PROTO_ROUTING:
+                case Constants::IP::PROTO_DSTOPTS:
+                    extension_size = (buffer[offset + 1] + 1) * 8;
+                    break;
+                case Constants::IP::PROTO_FRAGMENT:
+                    // Only atomic fragments can be handled
+                    if ((read_be<uint16_t>(buffer + offset + 2) & 0xfff9) != 0) {
+                        return false;
+                    }
+                    extension_size = 8;
+                    break;
+                default:
+                    return false;
+            }
+            next_header = buffer[offset];
+            offset += extension_size;
+        }
+        if (offset > total_sz) {
+            return false;
+        }
+        return scan_tcp(buffer + offset, total_sz - offset);
+    }
+    return false;
+}
+
+bool SegmentInfo::scan_tcp(const uint8_t* buffer, uint32_t total_sz) {
+    const uint32_t tcp_header_size = 20;
+    if (total_sz < tcp_header_size) {
+        return false;
+    }
+    const uint32_t header_size = (buffer[12] >> 4) * 4;
+    if (header_size < tcp_header_size || header_size > total_sz) {
+        return false;
+    }
+    sport = read_be<uint16_t>(buffer);
+    dport = read_be<uint16_t>(buffer + 2);
+    seq = read_be<uint32_t>(buffer + 4);
+    ack_seq = read_be<uint32_t>(buffer + 8);
+    flags = buffer[13];
+    mss = -1;
+    sack_permitted = false;
+    sack = 0;
+    sack_size = 0;
+    // Walk the options looking for the ones used to follow streams
+    const uint8_t* options = buffer + tcp_header_size;
+    const uint8_t* options_end = buffer + header_size;
+    while (options < options_end) {
+        const uint8_t kind = *options;
+        if (kind == TCP::EOL) {
+            break;
+        }
+        if (kind == TCP::NOP) {
+            options++;
+            continue;
+        }
+        if (options + 2 > options_end || options[1] < 2 ||
+            options + options[1] > options_end) {
+            break;
+        }
+        const uint8_t length = options[1];
+        if (kind == TCP::MSS && length == 4) {
+            mss = read_be<uint16_t>(options + 2);
+        }
+        else if (kind == TCP::SACK_OK) {
+            sack_permitted = true;
+        }
+        else if (kind == TCP::SACK) {
+            sack = options + 2;
+            sack_size = length - 2;
+        }
+        options += length;
+    }
+    payload = buffer + header_size;
+    payload_size = total_sz - header_size;
+    return true;
+}
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
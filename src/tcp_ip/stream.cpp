@@ -40,12 +40,17 @@
 #include <tins/ethernetII.h>
 #include <tins/rawpdu.h>
 #include <tins/exceptions.h>
+#include <tins/memory_helpers.h>
+#include <tins/tcp_ip/segment_info.h>
 
 using std::make_pair;
 using std::bind;
 using std::pair;
 using std::numeric_limits;
 
+using Tins::Memory::InputMemoryStream;
+using Tins::Memory::OutputMemoryStream;
+
 namespace Tins {
 namespace TCPIP {
 
@@ -53,7 +58,8 @@ Stream::Stream(PDU& packet, const timestamp_type& ts)
 : client_flow_(extract_client_flow(packet)),
   server_flow_(extract_server_flow(packet)), create_time_(ts), 
   last_seen_(ts), auto_cleanup_client_(true), auto_cleanup_server_(true),
-  is_partial_stream_(false), directions_recovery_mode_enabled_(0) {
+  is_partial_stream_(false), client_spill_threshold_(0), server_spill_threshold_(0),
+  directions_recovery_mode_enabled_(0) {
     const EthernetII* eth = packet.find_pdu<EthernetII>();
     if (eth) {
         client_hw_addr_ = eth->src_addr();
@@ -64,6 +70,27 @@ Stream::Stream(PDU& packet, const timestamp_type& ts)
     is_partial_stream_ = !tcp.has_flags(TCP::SYN);
 }
 
+Stream::Stream(const SegmentInfo& segment, const timestamp_type& ts) 
+: client_flow_(extract_client_flow(segment)),
+  server_flow_(extract_server_flow(segment)), client_hw_addr_(segment.src_hw_addr),
+  server_hw_addr_(segment.dst_hw_addr), create_time_(ts), last_seen_(ts),
+  auto_cleanup_client_(true), auto_cleanup_server_(true),
+  is_partial_stream_(!segment.has_flags(TCP::SYN)), client_spill_threshold_(0),
+  server_spill_threshold_(0), directions_recovery_mode_enabled_(0) {
+
+}
+
+Stream::Stream(InputMemoryStream& input)
+: client_flow_(input), server_flow_(input), auto_cleanup_client_(true),
+  auto_cleanup_server_(true), client_spill_threshold_(0), server_spill_threshold_(0),
+  directions_recovery_mode_enabled_(0) {
+    input.read(client_hw_addr_);
+    input.read(server_hw_addr_);
+    create_time_ = timestamp_type(input.read_le<int64_t>());
+    last_seen_ = timestamp_type(input.read_le<int64_t>());
+    is_partial_stream_ = input.read<uint8_t>() != 0;
+}
+
 void Stream::process_packet(PDU& packet, const timestamp_type& ts) {
     last_seen_ = ts;
     if (client_flow_.packet_belongs(packet)) {
@@ -81,6 +108,24 @@ void Stream::process_packet(PDU& packet) {
     return process_packet(packet, timestamp_type(0));
 }
 
+void Stream::process_segment(const SegmentInfo& segment, const timestamp_type& ts) {
+    last_seen_ = ts;
+    if (client_flow_.segment_belongs(segment)) {
+        client_flow_.process_segment(segment);
+    }
+    else if (server_flow_.segment_belongs(segment)) {
+        server_flow_.process_segment(segment);
+    }
+    if (is_finished() && on_stream_closed_) {
+        on_stream_closed_(*this);
+    }
+}
+
+void Stream::process_segment(const SegmentInfo& segment) {
+    return process_segment(segment, timestamp_type(0));
+}
+
+
 Flow& Stream::client_flow() {
     return client_flow_;
 }
@@ -117,6 +162,14 @@ void Stream::server_out_of_order_callback(const stream_packet_callback_type& cal
     on_server_out_of_order_callback_ = callback;
 }
 
+void Stream::client_payload_consumer(const payload_consumer_type& consumer) {
+    client_payload_consumer_ = consumer;
+}
+
+void Stream::server_payload_consumer(const payload_consumer_type& consumer) {
+    server_payload_consumer_ = consumer;
+}
+
 void Stream::ignore_client_data() {
     client_flow().ignore_data_packets();
 }
@@ -230,6 +283,45 @@ Flow Stream::extract_server_flow(const PDU& packet) {
     }
 }
 
+Flow Stream::extract_client_flow(const SegmentInfo& segment) {
+    if (segment.is_v6) {
+        return Flow(IPv6Address(segment.dst_addr.data()), segment.dport, segment.seq);
+    }
+    else {
+        InputMemoryStream stream(segment.dst_addr.data(), segment.dst_addr.size());
+        return Flow(stream.read<IPv4Address>(), segment.dport, segment.seq);
+    }
+}
+
+Flow Stream::extract_server_flow(const SegmentInfo& segment) {
+    if (segment.is_v6) {
+        return Flow(IPv6Address(segment.src_addr.data()), segment.sport, segment.ack_seq);
+    }
+    else {
+        InputMemoryStream stream(segment.src_addr.data(), segment.src_addr.size());
+        return Flow(stream.read<IPv4Address>(), segment.sport, segment.ack_seq);
+    }
+}
+
+size_t Stream::serialized_size() const {
+    return client_flow_.serialized_size() + server_flow_.serialized_size() + 
+           client_hw_addr_.size() + server_hw_addr_.size() + 
+           sizeof(int64_t) * 2 + sizeof(uint8_t);
+}
+
+void Stream::serialize(OutputMemoryStream& output) const {
+    if (!client_spill_.empty() || !server_spill_.empty()) {
+        throw unserializable_stream();
+    }
+    client_flow_.serialize(output);
+    server_flow_.serialize(output);
+    output.write(client_hw_addr_);
+    output.write(server_hw_addr_);
+    output.write_le<int64_t>(create_time_.count());
+    output.write_le<int64_t>(last_seen_.count());
+    output.write<uint8_t>(is_partial_stream_ ? 1 : 0);
+}
+
 void Stream::setup_flows_callbacks() {
     using namespace std::placeholders;
 
@@ -254,6 +346,43 @@ void Stream::auto_cleanup_server_data(bool value) {
     auto_cleanup_server_ = value;
 }
 
+void Stream::spill_payloads(uint32_t threshold) {
+    spill_client_data(threshold);
+    spill_server_data(threshold);
+}
+
+void Stream::spill_client_data(uint32_t threshold) {
+    client_spill_threshold_ = threshold;
+}
+
+void Stream::spill_server_data(uint32_t threshold) {
+    server_spill_threshold_ = threshold;
+}
+
+const PayloadSpill& Stream::client_spilled_payload() const {
+    return client_spill_;
+}
+
+PayloadSpill& Stream::client_spilled_payload() {
+    return client_spill_;
+}
+
+const PayloadSpill& Stream::server_spilled_payload() const {
+    return server_spill_;
+}
+
+PayloadSpill& Stream::server_spilled_payload() {
+    return server_spill_;
+}
+
+PayloadReader Stream::client_payload_reader() const {
+    return PayloadReader(client_spill_, client_payload());
+}
+
+PayloadReader Stream::server_payload_reader() const {
+    return PayloadReader(server_spill_, server_payload());
+}
+
 void Stream::enable_ack_tracking() {
     client_flow().enable_ack_tracking();
     server_flow().enable_ack_tracking();
@@ -283,21 +412,41 @@ bool Stream::is_recovery_mode_enabled() const {
 }
 
 void Stream::on_client_flow_data(const Flow& /*flow*/) {
+    if (client_payload_consumer_) {
+        consume_payload(client_payload(), client_payload_consumer_);
+    }
     if (on_client_data_callback_) {
         on_client_data_callback_(*this);
     }
+    // When there's a consumer, whatever it didn't consume must be kept
+    if (client_payload_consumer_) {
+        return;
+    }
     if (auto_cleanup_client_) {
         client_payload().clear();
     }
+    else {
+        spill_payload(client_payload(), client_spill_, client_spill_threshold_);
+    }
 }
 
 void Stream::on_server_flow_data(const Flow& /*flow*/) {
+    if (server_payload_consumer_) {
+        consume_payload(server_payload(), server_payload_consumer_);
+    }
     if (on_server_data_callback_) {
         on_server_data_callback_(*this);
     }
+    // When there's a consumer, whatever it didn't consume must be kept
+    if (server_payload_consumer_) {
+        return;
+    }
     if (auto_cleanup_server_) {
         server_payload().clear();
     }
+    else {
+        spill_payload(server_payload(), server_spill_, server_spill_threshold_);
+    }
 }
 
 void Stream::on_client_out_of_order(const Flow& /*flow*/, uint32_t seq, const payload_type& payload) {
@@ -351,6 +500,29 @@ bool Stream::recovery_mode_handler(Flow& flow, uint32_t sequence_number,
     return recovery_sequence_number_end > sequence_number;
 }
 
+void Stream::consume_payload(payload_type& payload,
+                             const payload_consumer_type& consumer) {
+    if (payload.empty()) {
+        return;
+    }
+    size_t consumed = consumer(&payload[0], payload.size());
+    if (consumed >= payload.size()) {
+        payload.clear();
+    }
+    else if (consumed > 0) {
+        payload.erase(payload.begin(), payload.begin() + consumed);
+    }
+}
+
+void Stream::spill_payload(payload_type& payload, PayloadSpill& spill,
+                           uint32_t threshold) {
+    if (threshold == 0 || payload.size() < threshold) {
+        return;
+    }
+    spill.append(&payload[0], payload.size());
+    payload.clear();
+}
+
 } // TCPIP
 } // Tins
 
@@ -32,6 +32,7 @@
 #ifdef TINS_HAVE_TCPIP
 
 #include <limits>
+#include <algorithm>
 #include <tins/ip_address.h>
 #include <tins/ipv6_address.h>
 #include <tins/tcp.h>
@@ -40,8 +41,12 @@
 #include <tins/rawpdu.h>
 #include <tins/packet.h>
 #include <tins/exceptions.h>
+#include <tins/memory_helpers.h>
+#include <tins/tcp_ip/segment_info.h>
 
 using std::make_pair;
+using std::max;
+using std::vector;
 using std::bind;
 using std::pair;
 using std::numeric_limits;
@@ -49,6 +54,9 @@ using std::chrono::system_clock;
 using std::chrono::minutes;
 using std::chrono::duration_cast;
 
+using Tins::Memory::InputMemoryStream;
+using Tins::Memory::OutputMemoryStream;
+
 namespace Tins {
 namespace TCPIP {
 
@@ -56,6 +64,8 @@ const size_t StreamFollower::DEFAULT_MAX_BUFFERED_CHUNKS = 512;
 const size_t StreamFollower::DEFAULT_MAX_SACKED_INTERVALS = 1024;
 const uint32_t StreamFollower::DEFAULT_MAX_BUFFERED_BYTES = 3 * 1024 * 1024; // 3MB
 const StreamFollower::timestamp_type StreamFollower::DEFAULT_KEEP_ALIVE = minutes(5);
+const uint32_t StreamFollower::CHECKPOINT_MAGIC = 0x43465354; // "TSFC"
+const uint8_t StreamFollower::CHECKPOINT_VERSION = 1;
 
 StreamFollower::StreamFollower() 
 : max_buffered_chunks_(DEFAULT_MAX_BUFFERED_CHUNKS),
@@ -87,19 +97,7 @@ void StreamFollower::process_packet(PDU& packet, const timestamp_type& ts) {
         // Start on client's SYN, not on server's SYN+ACK
         const bool is_syn = tcp->has_flags(TCP::SYN) && !tcp->has_flags(TCP::ACK);
         if (is_syn || (attach_to_flows_ && tcp->find_pdu<RawPDU>() != 0)) {
-            iter = streams_.insert(make_pair(identifier, Stream(packet, ts))).first;
-            iter->second.setup_flows_callbacks();
-            if (on_new_connection_) {
-                on_new_connection_(iter->second);
-            }
-            else {
-                throw callback_not_set();
-            }
-            if (!is_syn) {
-                // assume the connection is established
-                iter->second.client_flow().state(Flow::ESTABLISHED);
-                iter->second.server_flow().state(Flow::ESTABLISHED);
-            }
+            iter = track_stream(identifier, Stream(packet, ts), !is_syn);
         }
         else {
             // no stream found and no stream was created
@@ -111,8 +109,56 @@ void StreamFollower::process_packet(PDU& packet, const timestamp_type& ts) {
     }
     // We'll process it if we had already seen this stream or if we just attached to
     // it and it contains payload
+    iter->second.process_packet(packet, ts);
+    check_stream_termination(iter, ts);
+}
+
+void StreamFollower::process_segment(const SegmentInfo& segment) {
+    // Use current time
+    const system_clock::duration ts = system_clock::now().time_since_epoch();
+    process_segment(segment, duration_cast<timestamp_type>(ts));
+}
+
+void StreamFollower::process_segment(const SegmentInfo& segment, const timestamp_type& ts) {
+    stream_id identifier(segment.src_addr, segment.sport, segment.dst_addr, segment.dport);
+    streams_type::iterator iter = streams_.find(identifier);
+    if (iter == streams_.end()) {
+        const bool is_syn = segment.has_flags(TCP::SYN) && !segment.has_flags(TCP::ACK);
+        if (is_syn || (attach_to_flows_ && segment.payload_size > 0)) {
+            iter = track_stream(identifier, Stream(segment, ts), !is_syn);
+        }
+        else {
+            if (last_cleanup_ + stream_keep_alive_ <= ts) {
+                cleanup_streams(ts);
+            }
+            return;
+        }
+    }
+    iter->second.process_segment(segment, ts);
+    check_stream_termination(iter, ts);
+}
+
+StreamFollower::streams_type::iterator
+StreamFollower::track_stream(const stream_id& identifier, Stream stream,
+                             bool assume_established) {
+    streams_type::iterator iter = streams_.insert(make_pair(identifier, std::move(stream))).first;
+    iter->second.setup_flows_callbacks();
+    if (on_new_connection_) {
+        on_new_connection_(iter->second);
+    }
+    else {
+        throw callback_not_set();
+    }
+    if (assume_established) {
+        iter->second.client_flow().state(Flow::ESTABLISHED);
+        iter->second.server_flow().state(Flow::ESTABLISHED);
+    }
+    return iter;
+}
+
+void StreamFollower::check_stream_termination(streams_type::iterator iter,
+                                              const timestamp_type& ts) {
     Stream& stream = iter->second;
-    stream.process_packet(packet, ts);
     // Check for different potential termination
     size_t total_chunks = stream.client_flow().buffered_payload().size() +
                           stream.server_flow().buffered_payload().size();
@@ -179,6 +225,59 @@ void StreamFollower::follow_partial_streams(bool value) {
     attach_to_flows_ = value;
 }
 
+vector<uint8_t> StreamFollower::checkpoint() const {
+    // Magic, version, last cleanup timestamp and stream count
+    size_t total_size = sizeof(uint32_t) + sizeof(uint8_t) + sizeof(int64_t) +
+                        sizeof(uint32_t);
+    for (streams_type::const_iterator iter = streams_.begin(); iter != streams_.end(); ++iter) {
+        total_size += iter->second.serialized_size();
+    }
+    vector<uint8_t> output(total_size);
+    OutputMemoryStream stream(output);
+    stream.write_le<uint32_t>(CHECKPOINT_MAGIC);
+    stream.write<uint8_t>(CHECKPOINT_VERSION);
+    stream.write_le<int64_t>(last_cleanup_.count());
+    stream.write_le<uint32_t>(streams_.size());
+    for (streams_type::const_iterator iter = streams_.begin(); iter != streams_.end(); ++iter) {
+        iter->second.serialize(stream);
+    }
+    return output;
+}
+
+void StreamFollower::restore(const uint8_t* buffer, size_t total_sz) {
+    if (!on_new_connection_) {
+        throw callback_not_set();
+    }
+    // Parse everything before touching our state so a bad checkpoint has no effect
+    vector<Stream> streams;
+    timestamp_type last_cleanup;
+    try {
+        InputMemoryStream input(buffer, total_sz);
+        if (input.read_le<uint32_t>() != CHECKPOINT_MAGIC ||
+            input.read<uint8_t>() != CHECKPOINT_VERSION) {
+            throw invalid_checkpoint();
+        }
+        last_cleanup = timestamp_type(input.read_le<int64_t>());
+        uint32_t stream_count = input.read_le<uint32_t>();
+        while (stream_count--) {
+            streams.push_back(Stream(input));
+        }
+        if (input) {
+            throw invalid_checkpoint();
+        }
+    }
+    catch (const malformed_packet&) {
+        throw invalid_checkpoint();
+    }
+    last_cleanup_ = max(last_cleanup_, last_cleanup);
+    for (size_t i = 0; i < streams.size(); ++i) {
+        const stream_id identifier = stream_id::make_identifier(streams[i]);
+        streams_.erase(identifier);
+        // Restored flows already have their own state
+        track_stream(identifier, std::move(streams[i]), false);
+    }
+}
+
 void StreamFollower::cleanup_streams(const timestamp_type& now) {
     streams_type::iterator iter = streams_.begin();
     while (iter != streams_.end()) {
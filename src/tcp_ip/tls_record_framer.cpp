@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/tcp_ip/tls_record_framer.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+namespace Tins {
+namespace TCPIP {
+
+const size_t TLSRecordFramer::RECORD_HEADER_SIZE = 5;
+const size_t TLSRecordFramer::MAX_FRAGMENT_SIZE = 16384 + 2048;
+
+TLSRecordFramer::TLSRecordFramer()
+: has_error_(false) {
+
+}
+
+void TLSRecordFramer::record_callback(const record_callback_type& callback) {
+    on_record_ = callback;
+}
+
+bool TLSRecordFramer::has_error() const {
+    return has_error_;
+}
+
+size_t TLSRecordFramer::operator()(const uint8_t* data, size_t size) {
+    if (has_error_) {
+        return size;
+    }
+    size_t consumed = 0;
+    while (size - consumed >= RECORD_HEADER_SIZE) {
+        const uint8_t* record = data + consumed;
+        const uint8_t content_type = record[0];
+        const uint16_t version = static_cast<uint16_t>((record[1] << 8) | record[2]);
+        const size_t fragment_size = (record[3] << 8) | record[4];
+        // Every SSLv3/TLS version has a major version of 3
+        if (content_type < CHANGE_CIPHER_SPEC || content_type > HEARTBEAT ||
+            record[1] != 3 || fragment_size > MAX_FRAGMENT_SIZE) {
+            has_error_ = true;
+            return size;
+        }
+        if (size - consumed < RECORD_HEADER_SIZE + fragment_size) {
+            break;
+        }
+        if (on_record_) {
+            on_record_(content_type, version, record + RECORD_HEADER_SIZE, fragment_size);
+        }
+        consumed += RECORD_HEADER_SIZE + fragment_size;
+    }
+    return consumed;
+}
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/tcp_ip/udp_flow_tracker.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <tins/ip_address.h>
+#include <tins/ipv6_address.h>
+#include <tins/udp.h>
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/packet.h>
+#include <tins/exceptions.h>
+#include <tins/memory_helpers.h>
+
+using std::pair;
+using std::chrono::system_clock;
+using std::chrono::minutes;
+using std::chrono::duration_cast;
+
+using Tins::Memory::InputMemoryStream;
+
+namespace Tins {
+namespace TCPIP {
+
+// UDPFlowRecord
+
+UDPFlowRecord::UDPFlowRecord()
+: client_port(0), server_port(0), is_v6(false), first_seen(0), last_seen(0),
+  client_packets(0), client_bytes(0), server_packets(0), server_bytes(0),
+  end_reason(FORCED_END) {
+    client_addr.fill(0);
+    server_addr.fill(0);
+}
+
+IPv4Address UDPFlowRecord::client_addr_v4() const {
+    InputMemoryStream stream(client_addr.data(), client_addr.size());
+    return stream.read<IPv4Address>();
+}
+
+IPv6Address UDPFlowRecord::client_addr_v6() const {
+    InputMemoryStream stream(client_addr.data(), client_addr.size());
+    return stream.read<IPv6Address>();
+}
+
+IPv4Address UDPFlowRecord::server_addr_v4() const {
+    InputMemoryStream stream(server_addr.data(), server_addr.size());
+    return stream.read<IPv4Address>();
+}
+
+IPv6Address UDPFlowRecord::server_addr_v6() const {
+    InputMemoryStream stream(server_addr.data(), server_addr.size());
+    return stream.read<IPv6Address>();
+}
+
+// UDPFlowTracker
+
+const UDPFlowTracker::timestamp_type UDPFlowTracker::DEFAULT_IDLE_TIMEOUT = minutes(2);
+
+UDPFlowTracker::UDPFlowTracker()
+: idle_timeout_(DEFAULT_IDLE_TIMEOUT), last_cleanup_(0) {
+
+}
+
+void UDPFlowTracker::process_packet(PDU& packet) {
+    // Use current time
+    const system_clock::duration ts = system_clock::now().time_since_epoch();
+    process_packet(packet, duration_cast<timestamp_type>(ts));
+}
+
+void UDPFlowTracker::process_packet(Packet& packet) {
+    process_packet(*packet.pdu(), packet.timestamp());
+}
+
+void UDPFlowTracker::process_packet(PDU& packet, const timestamp_type& ts) {
+    const UDP* udp = packet.find_pdu<UDP>();
+    if (!udp) {
+        return;
+    }
+    flow_id::address_type src_addr;
+    flow_id::address_type dst_addr;
+    uint32_t size;
+    bool is_v6;
+    if (const IP* ip = packet.find_pdu<IP>()) {
+        src_addr = flow_id::serialize(ip->src_addr());
+        dst_addr = flow_id::serialize(ip->dst_addr());
+        size = ip->size();
+        is_v6 = false;
+    }
+    else if (const IPv6* ip = packet.find_pdu<IPv6>()) {
+        src_addr = flow_id::serialize(ip->src_addr());
+        dst_addr = flow_id::serialize(ip->dst_addr());
+        size = ip->size();
+        is_v6 = true;
+    }
+    else {
+        return;
+    }
+    const flow_id identifier(src_addr, udp->sport(), dst_addr, udp->dport());
+    pair<flow_state&, bool> result = flows_.insert(identifier);
+    flow_state& state = result.first;
+    const bool sent_by_min = identifier.min_address == src_addr &&
+                             identifier.min_address_port == udp->sport();
+    if (result.second) {
+        state.first_seen = ts;
+        state.client_is_min = sent_by_min;
+        state.is_v6 = is_v6;
+    }
+    const size_t direction = sent_by_min ? 0 : 1;
+    state.last_seen = ts;
+    state.packets[direction]++;
+    state.bytes[direction] += size;
+
+    if (last_cleanup_ + idle_timeout_ <= ts) {
+        cleanup_flows(ts);
+    }
+}
+
+void UDPFlowTracker::flow_export_callback(const export_callback_type& callback) {
+    on_flow_export_ = callback;
+}
+
+void UDPFlowTracker::reserve(size_t flow_count) {
+    flows_.reserve(flow_count);
+}
+
+UDPFlowRecord UDPFlowTracker::find_flow(const IPv4Address& client_addr,
+                                        uint16_t client_port,
+                                        const IPv4Address& server_addr,
+                                        uint16_t server_port) const {
+    flow_id identifier(flow_id::serialize(client_addr), client_port,
+                       flow_id::serialize(server_addr), server_port);
+    return find_flow(identifier);
+}
+
+UDPFlowRecord UDPFlowTracker::find_flow(const IPv6Address& client_addr,
+                                        uint16_t client_port,
+                                        const IPv6Address& server_addr,
+                                        uint16_t server_port) const {
+    flow_id identifier(flow_id::serialize(client_addr), client_port,
+                       flow_id::serialize(server_addr), server_port);
+    return find_flow(identifier);
+}
+
+UDPFlowRecord UDPFlowTracker::find_flow(const flow_id& id) const {
+    const flow_state* state = flows_.find(id);
+    if (!state) {
+        throw stream_not_found();
+    }
+    return make_record(id, *state, UDPFlowRecord::FORCED_END);
+}
+
+void UDPFlowTracker::flush() {
+    if (on_flow_export_) {
+        for (table_type::const_iterator iter = flows_.begin(); iter != flows_.end(); ++iter) {
+            on_flow_export_(make_record(iter->first, iter->second, UDPFlowRecord::FORCED_END));
+        }
+    }
+    flows_.clear();
+}
+
+size_t UDPFlowTracker::flow_count() const {
+    return flows_.size();
+}
+
+const UDPFlowTracker::table_type& UDPFlowTracker::flows() const {
+    return flows_;
+}
+
+UDPFlowRecord UDPFlowTracker::make_record(const flow_id& id, const flow_state& state,
+                                          UDPFlowRecord::EndReason reason) {
+    UDPFlowRecord record;
+    const size_t client_direction = state.client_is_min ? 0 : 1;
+    const size_t server_direction = 1 - client_direction;
+    if (state.client_is_min) {
+        record.client_addr = id.min_address;
+        record.client_port = id.min_address_port;
+        record.server_addr = id.max_address;
+        record.server_port = id.max_address_port;
+    }
+    else {
+        record.client_addr = id.max_address;
+        record.client_port = id.max_address_port;
+        record.server_addr = id.min_address;
+        record.server_port = id.min_address_port;
+    }
+    record.is_v6 = state.is_v6;
+    record.first_seen = state.first_seen;
+    record.last_seen = state.last_seen;
+    record.client_packets = state.packets[client_direction];
+    record.client_bytes = state.bytes[client_direction];
+    record.server_packets = state.packets[server_direction];
+    record.server_bytes = state.bytes[server_direction];
+    record.end_reason = reason;
+    return record;
+}
+
+void UDPFlowTracker::cleanup_flows(const timestamp_type& now) {
+    const timestamp_type idle_timeout = idle_timeout_;
+    const export_callback_type& callback = on_flow_export_;
+    flows_.remove_if([&](const flow_id& id, const flow_state& state) {
+        if (state.last_seen + idle_timeout > now) {
+            return false;
+        }
+        if (callback) {
+            callback(make_record(id, state, UDPFlowRecord::IDLE_TIMEOUT));
+        }
+        return true;
+    });
+    last_cleanup_ = now;
+}
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
@@ -164,7 +164,17 @@ bool TCPStream::generic_process(uint32_t& my_seq,
     if (tcp->get_flag(TCP::FIN) || tcp->get_flag(TCP::RST)) {
         fin_sent_ = true;
     }
-    RawPDU* raw = static_cast<RawPDU*>(tcp->release_inner_pdu()); 
+    RawPDU* raw = 0;
+    if (PDU* inner = tcp->release_inner_pdu()) {
+        if (inner->pdu_type() == PDU::RAW) {
+            raw = static_cast<RawPDU*>(inner);
+        }
+        else {
+            // Decoded through a port allocator, follow its serialization
+            raw = new RawPDU(inner->serialize());
+            delete inner;
+        }
+    }
     if (raw) {
         const uint32_t chunk_end = add_sequence_numbers(tcp->seq(), raw->payload_size());
         // If the end of the chunk ends after our current sequence number, process it.
@@ -36,6 +36,7 @@
 #include <tins/exceptions.h>
 #include <tins/memory_helpers.h>
 #include <tins/utils/checksum_utils.h>
+#include <tins/detail/pdu_helpers.h>
 
 using Tins::Memory::InputMemoryStream;
 using Tins::Memory::OutputMemoryStream;
@@ -59,7 +60,14 @@ UDP::UDP(const uint8_t* buffer, uint32_t total_sz)  {
     InputMemoryStream stream(buffer, total_sz);
     stream.read(header_);
     if (stream) {
-        inner_pdu(new RawPDU(stream.pointer(), stream.size()));
+        inner_pdu(
+            Internals::pdu_from_udp_ports(
+                sport(),
+                dport(),
+                stream.pointer(),
+                static_cast<uint32_t>(stream.size())
+            )
+        );
     }
 }
 
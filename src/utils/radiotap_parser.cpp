@@ -33,6 +33,7 @@
 
 #include <iostream>
 #include <tins/exceptions.h>
+#include <tins/cxxstd.h>
 
 using std::vector;
 
@@ -67,6 +68,11 @@ const RadioTapParser::FieldMetadata RadioTapParser::RADIOTAP_METADATA[] = {
 const uint32_t RadioTapParser::MAX_RADIOTAP_FIELD = sizeof(RADIOTAP_METADATA) /
                                                     sizeof(FieldMetadata);
 
+const uint16_t RadioTapParser::FIELD_NOT_PRESENT = 0xffff;
+
+// Number of field layouts cached per thread
+const uint32_t RADIOTAP_LAYOUT_CACHE_SIZE = 16;
+
 #if TINS_IS_LITTLE_ENDIAN
 TINS_BEGIN_PACK
 struct RadioTapFlags {
@@ -139,24 +145,41 @@ void align_buffer(const uint8_t* buffer_start, const uint8_t*& buffer, size_t n)
     }
 }
 
-RadioTapParser::RadioTapParser(const vector<uint8_t>& buffer)
-: current_bit_(MAX_RADIOTAP_FIELD), current_flags_(0), namespace_index_(0),
-  current_namespace_(RADIOTAP_NS) {
+RadioTapParser::RadioTapParser(const vector<uint8_t>& buffer) {
     if (buffer.empty()) {
+        initialize(0, 0);
+    }
+    else {
+        initialize(&buffer[0], buffer.size());
+    }
+}
+
+RadioTapParser::RadioTapParser(const uint8_t* buffer, uint32_t total_sz) {
+    initialize(buffer, total_sz);
+}
+
+void RadioTapParser::initialize(const uint8_t* buffer, uint32_t total_sz) {
+    current_bit_ = MAX_RADIOTAP_FIELD;
+    current_flags_ = 0;
+    namespace_index_ = 0;
+    current_namespace_ = RADIOTAP_NS;
+    layout_.present = 0;
+    layout_.present_count = 0;
+    if (total_sz == 0) {
         start_ = 0;
         end_ = 0;
         current_ptr_ = start_;
-        current_flags_ = 0;
     }
     else {
-        if (TINS_UNLIKELY(buffer.size() < sizeof(RadioTapFlags))) {
+        if (TINS_UNLIKELY(total_sz < sizeof(RadioTapFlags))) {
             throw malformed_packet();
         }
-        start_ = &*buffer.begin();
-        end_ = start_ + buffer.size();
+        start_ = buffer;
+        end_ = start_ + total_sz;
         load_current_flags();
         current_bit_ = 0;
         current_ptr_ = find_options_start();
+        load_layout();
         // Skip all fields and make this point to the first flags one
         advance_to_first_field();
     }
@@ -223,6 +246,32 @@ RadioTap::PresentFlags RadioTapParser::namespace_flags() const {
 }
 
 bool RadioTapParser::skip_to_field(RadioTap::PresentFlags flag) {
+    // Fields in the first namespace can be reached directly using the layout.
+    // Anything else (fields behind the current one, extended namespaces) 
+    // falls back to walking the fields one by one
+    const uint32_t value = flag;
+    if (namespace_index_ == 0 && has_fields() && value != 0 &&
+        (value & (value - 1)) == 0) {
+        uint32_t bit = 0;
+        while ((value >> bit) != 1) {
+            bit++;
+        }
+        if (bit == current_bit_) {
+            return true;
+        }
+        const uint16_t offset = layout_.offsets[bit];
+        if (bit > current_bit_ && offset != FIELD_NOT_PRESENT) {
+            current_ptr_ = start_ + offset;
+            current_bit_ = bit;
+            current_flags_ = layout_.present >> bit;
+            return has_fields();
+        }
+        // Without an extended bitmask there's nowhere else to look
+        if ((layout_.present & (1U << 31)) == 0) {
+            current_bit_ = MAX_RADIOTAP_FIELD;
+            return false;
+        }
+    }
     while (has_fields() && current_field() != flag) {
         advance_field();
     }
@@ -249,6 +298,52 @@ bool RadioTapParser::has_field(RadioTap::PresentFlags flag) const {
     return false;
 }
 
+void RadioTapParser::build_layout(FieldLayout& layout, uint32_t present,
+                                  uint32_t present_count) {
+    layout.present = present;
+    layout.present_count = present_count;
+    for (uint32_t bit = 0; bit < 32; ++bit) {
+        layout.offsets[bit] = FIELD_NOT_PRESENT;
+    }
+    // Alignment is relative to the start of the RadioTap header, which is
+    // one word before the present flags
+    uint32_t offset = present_count * sizeof(uint32_t);
+    for (uint32_t bit = 0; bit < MAX_RADIOTAP_FIELD; ++bit) {
+        if ((present & (1U << bit)) == 0) {
+            continue;
+        }
+        const uint32_t alignment = RADIOTAP_METADATA[bit].alignment;
+        offset += (alignment - ((offset + sizeof(uint32_t)) & (alignment - 1))) &
+                  (alignment - 1);
+        // Only possible with a huge amount of present words, in which case
+        // the extended bit is set and skip_to_field falls back to walking
+        if (offset >= FIELD_NOT_PRESENT) {
+            break;
+        }
+        layout.offsets[bit] = static_cast<uint16_t>(offset);
+        offset += RADIOTAP_METADATA[bit].size;
+    }
+}
+
+void RadioTapParser::load_layout() {
+    const uint32_t present_count = (current_ptr_ - start_) / sizeof(uint32_t);
+    const uint32_t present = current_flags_;
+    #if TINS_IS_CXX11
+        // Captures tend to use a handful of present flags values, so keep
+        // a small direct mapped cache of the layouts seen by this thread
+        static thread_local FieldLayout cache[RADIOTAP_LAYOUT_CACHE_SIZE];
+        const uint32_t index = ((present * 0x9e3779b1U) >> 28 ^ present_count) %
+                               RADIOTAP_LAYOUT_CACHE_SIZE;
+        FieldLayout& entry = cache[index];
+        if (entry.present != present || entry.present_count != present_count) {
+            build_layout(entry, present, present_count);
+        }
+        layout_ = entry;
+    #else
+        build_layout(layout_, present, present_count);
+    #endif // TINS_IS_CXX11
+}
+
 const uint8_t* RadioTapParser::find_options_start() const {
     uint32_t total_sz = end_ - start_;
     if (TINS_UNLIKELY(total_sz < sizeof(RadioTapFlags))) {
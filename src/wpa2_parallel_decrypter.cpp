@@ -0,0 +1,366 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/wpa2_parallel_decrypter.h>
+
+#ifdef TINS_HAVE_WPA2_CALLBACKS
+
+#include <deque>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <tins/packet.h>
+#include <tins/pdu.h>
+#include <tins/snap.h>
+#include <tins/rawpdu.h>
+#include <tins/dot11/dot11_data.h>
+#include <tins/detail/hash_table_helpers.h>
+
+using std::string;
+using std::deque;
+using std::thread;
+using std::mutex;
+using std::unique_lock;
+using std::lock_guard;
+using std::condition_variable;
+using std::unordered_map;
+using std::make_pair;
+
+using Tins::Internals::fnv32_hash;
+
+namespace Tins {
+namespace Crypto {
+
+typedef WPA2ParallelDecrypter::address_type address_type;
+typedef WPA2ParallelDecrypter::addr_pair addr_pair;
+
+addr_pair make_sorted_pair(const address_type& addr1, const address_type& addr2) {
+    return (addr1 < addr2) ? make_pair(addr1, addr2) : make_pair(addr2, addr1);
+}
+
+// These match the lookups done by WPA2Decrypter::decrypt
+addr_pair extract_src_pair(const Dot11Data& dot11) {
+    if (!dot11.from_ds() && dot11.to_ds()) {
+        return make_sorted_pair(dot11.addr1(), dot11.addr2());
+    }
+    else {
+        return make_sorted_pair(dot11.addr2(), dot11.addr3());
+    }
+}
+
+addr_pair extract_dst_pair(const Dot11Data& dot11) {
+    if (dot11.from_ds() && !dot11.to_ds()) {
+        return make_sorted_pair(dot11.addr1(), dot11.addr2());
+    }
+    else {
+        return make_sorted_pair(dot11.addr1(), dot11.addr3());
+    }
+}
+
+struct addr_pair_hash {
+    size_t operator()(const addr_pair& addresses) const {
+        // FNV-1a over both addresses
+        const uint32_t output = fnv32_hash(addresses.first.begin(), 
+                                           addresses.first.size());
+        return fnv32_hash(addresses.second.begin(), addresses.second.size(), output);
+    }
+};
+
+struct WPA2ParallelDecrypter::task {
+    task() : is_packet(false) {
+
+    }
+
+    bool is_packet;
+    Packet packet;
+    addr_pair addresses;
+    WPA2::SessionKeys session_keys;
+};
+
+struct WPA2ParallelDecrypter::worker {
+    typedef unordered_map<addr_pair, WPA2::SessionKeys, addr_pair_hash> keys_map;
+
+    worker() : busy(false), stopping(false) {
+
+    }
+
+    bool decrypt(PDU& pdu) const {
+        Dot11Data* data = pdu.find_pdu<Dot11Data>();
+        RawPDU* raw = pdu.find_pdu<RawPDU>();
+        if (!data || !raw || !data->wep()) {
+            return false;
+        }
+        keys_map::const_iterator iter = keys.find(extract_src_pair(*data));
+        if (iter == keys.end()) {
+            iter = keys.find(extract_dst_pair(*data));
+            if (iter == keys.end()) {
+                return false;
+            }
+        }
+        SNAP* snap = iter->second.decrypt_unicast(*data, *raw);
+        if (!snap) {
+            return false;
+        }
+        data->inner_pdu(snap);
+        data->wep(0);
+        return true;
+    }
+
+    thread worker_thread;
+    mutex tasks_mutex;
+    // Notified when tasks are added or the worker has to stop
+    condition_variable tasks_added;
+    // Notified when the worker takes tasks from the queue or becomes idle
+    condition_variable tasks_taken;
+    deque<task> tasks;
+    keys_map keys;
+    bool busy;
+    bool stopping;
+};
+
+const size_t WPA2ParallelDecrypter::DEFAULT_MAX_QUEUE_SIZE = 1024;
+
+WPA2ParallelDecrypter::WPA2ParallelDecrypter(size_t thread_count, 
+                                             const packet_callback_type& callback)
+: packet_callback_(callback), max_queue_size_(DEFAULT_MAX_QUEUE_SIZE),
+  has_worker_error_(false) {
+    using namespace std::placeholders;
+    if (thread_count == 0) {
+        thread_count = std::max(thread::hardware_concurrency(), 1U);
+    }
+    decrypter_.handshake_captured_callback(
+        std::bind(&WPA2ParallelDecrypter::on_handshake_captured, this, _1, _2, _3)
+    );
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.push_back(Internals::smart_ptr<worker>::type(new worker()));
+    }
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        workers_[i]->worker_thread = thread(&WPA2ParallelDecrypter::run_worker, this,
+                                            std::ref(*workers_[i]));
+    }
+}
+
+WPA2ParallelDecrypter::~WPA2ParallelDecrypter() {
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        {
+            lock_guard<mutex> _(workers_[i]->tasks_mutex);
+            workers_[i]->stopping = true;
+        }
+        workers_[i]->tasks_added.notify_one();
+    }
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        workers_[i]->worker_thread.join();
+    }
+}
+
+void WPA2ParallelDecrypter::add_ap_data(const string& psk, const string& ssid) {
+    decrypter_.add_ap_data(psk, ssid);
+}
+
+void WPA2ParallelDecrypter::add_ap_data(const string& psk, 
+                                        const string& ssid,
+                                        const address_type& addr) {
+    decrypter_.add_ap_data(psk, ssid, addr);
+}
+
+void WPA2ParallelDecrypter::add_ap_data(const WPA2::SupplicantData& data) {
+    decrypter_.add_ap_data(data);
+}
+
+void WPA2ParallelDecrypter::add_decryption_keys(const addr_pair& addresses, 
+                                                const WPA2::SessionKeys& session_keys) {
+    decrypter_.add_decryption_keys(addresses, session_keys);
+    push_keys(make_sorted_pair(addresses.first, addresses.second), session_keys);
+}
+
+void WPA2ParallelDecrypter::process(Packet packet) {
+    rethrow_worker_error();
+    PDU* pdu = packet.pdu();
+    if (!pdu) {
+        return;
+    }
+    const Dot11Data* data = pdu->find_pdu<Dot11Data>();
+    // Beacons and handshakes have to be handled in order, so they're processed
+    // right away. Encrypted data is left for the workers
+    if (!data || !data->wep() || !pdu->find_pdu<RawPDU>()) {
+        decrypter_.decrypt(*pdu);
+    }
+    task item;
+    item.is_packet = true;
+    item.packet = std::move(packet);
+    push_task(find_worker(*item.packet.pdu()), item, true);
+}
+
+void WPA2ParallelDecrypter::flush() {
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        worker& target = *workers_[i];
+        unique_lock<mutex> lock(target.tasks_mutex);
+        while (!target.tasks.empty() || target.busy) {
+            target.tasks_taken.wait(lock);
+        }
+    }
+    rethrow_worker_error();
+}
+
+void WPA2ParallelDecrypter::max_queue_size(size_t value) {
+    max_queue_size_ = value;
+}
+
+size_t WPA2ParallelDecrypter::thread_count() const {
+    return workers_.size();
+}
+
+void WPA2ParallelDecrypter::handshake_captured_callback(const handshake_captured_callback_type& callback) {
+    handshake_captured_callback_ = callback;
+}
+
+void WPA2ParallelDecrypter::ap_found_callback(const ap_found_callback_type& callback) {
+    decrypter_.ap_found_callback(callback);
+}
+
+const WPA2Decrypter::keys_map& WPA2ParallelDecrypter::get_keys() const {
+    return decrypter_.get_keys();
+}
+
+void WPA2ParallelDecrypter::on_handshake_captured(const string& ssid,
+                                                  const address_type& bssid,
+                                                  const address_type& client) {
+    const WPA2Decrypter::keys_map& keys = decrypter_.get_keys();
+    WPA2Decrypter::keys_map::const_iterator iter = keys.find(make_sorted_pair(bssid, client));
+    if (iter != keys.end()) {
+        push_keys(iter->first, iter->second);
+    }
+    if (handshake_captured_callback_) {
+        handshake_captured_callback_(ssid, bssid, client);
+    }
+}
+
+void WPA2ParallelDecrypter::push_keys(const addr_pair& addresses,
+                                      const WPA2::SessionKeys& session_keys) {
+    // Every worker gets a copy, as a pair's keys can be needed by packets 
+    // sent to or from other addresses
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        task item;
+        item.addresses = addresses;
+        item.session_keys = session_keys;
+        push_task(*workers_[i], item, false);
+    }
+}
+
+void WPA2ParallelDecrypter::push_task(worker& target, task& item, bool wait_for_room) {
+    {
+        unique_lock<mutex> lock(target.tasks_mutex);
+        while (wait_for_room && target.tasks.size() >= max_queue_size_) {
+            target.tasks_taken.wait(lock);
+        }
+        target.tasks.push_back(std::move(item));
+    }
+    target.tasks_added.notify_one();
+}
+
+WPA2ParallelDecrypter::worker& WPA2ParallelDecrypter::find_worker(const PDU& pdu) {
+    size_t hash = 0;
+    if (const Dot11Data* data = pdu.find_pdu<Dot11Data>()) {
+        // Both directions of the same link go to the same worker
+        hash = addr_pair_hash()(make_sorted_pair(data->addr1(), data->addr2()));
+    }
+    else if (const Dot11* dot11 = pdu.find_pdu<Dot11>()) {
+        hash = addr_pair_hash()(make_pair(dot11->addr1(), address_type()));
+    }
+    return *workers_[hash % workers_.size()];
+}
+
+void WPA2ParallelDecrypter::run_worker(worker& target) {
+    deque<task> tasks;
+    while (true) {
+        {
+            unique_lock<mutex> lock(target.tasks_mutex);
+            target.busy = false;
+            target.tasks_taken.notify_all();
+            while (target.tasks.empty() && !target.stopping) {
+                target.tasks_added.wait(lock);
+            }
+            if (target.tasks.empty()) {
+                return;
+            }
+            // Take everything at once so the producer doesn't contend on every packet
+            tasks.swap(target.tasks);
+            target.busy = true;
+        }
+        target.tasks_taken.notify_all();
+        for (deque<task>::iterator it = tasks.begin(); it != tasks.end(); ++it) {
+            if (it->is_packet) {
+                // An exception escaping this thread would terminate the process, 
+                // so it's handed to the thread calling process/flush instead
+                try {
+                    const bool decrypted = target.decrypt(*it->packet.pdu());
+                    packet_callback_(it->packet, decrypted);
+                }
+                catch (...) {
+                    store_worker_error(std::current_exception());
+                }
+            }
+            else {
+                target.keys[it->addresses] = it->session_keys;
+            }
+        }
+        tasks.clear();
+    }
+}
+
+void WPA2ParallelDecrypter::store_worker_error(std::exception_ptr error) {
+    lock_guard<mutex> _(error_mutex_);
+    if (!worker_error_) {
+        worker_error_ = error;
+        has_worker_error_ = true;
+    }
+}
+
+void WPA2ParallelDecrypter::rethrow_worker_error() {
+    // Avoid locking on every packet, errors are rare
+    if (!has_worker_error_) {
+        return;
+    }
+    std::exception_ptr error;
+    {
+        lock_guard<mutex> _(error_mutex_);
+        error.swap(worker_error_);
+        has_worker_error_ = false;
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+} // Crypto
+} // Tins
+
+#endif // TINS_HAVE_WPA2_CALLBACKS
@@ -0,0 +1,516 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/wpa2_pmk.h>
+
+#ifdef TINS_HAVE_WPA2_DECRYPTION
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#ifdef _WIN32
+    #include <io.h>
+    #include <fcntl.h>
+    #include <share.h>
+    #include <sys/stat.h>
+    #include <windows.h>
+#else // _WIN32
+    #include <stdlib.h>
+    #include <unistd.h>
+#endif // _WIN32
+#ifdef TINS_HAVE_CXX11
+    #include <thread>
+    #include <atomic>
+#endif // TINS_HAVE_CXX11
+#include <openssl/evp.h>
+#include <tins/cxxstd.h>
+#include <tins/exceptions.h>
+#include <tins/memory_helpers.h>
+
+using std::string;
+using std::vector;
+using std::pair;
+using std::make_pair;
+using std::ifstream;
+using std::istreambuf_iterator;
+using std::runtime_error;
+
+using Tins::Memory::InputMemoryStream;
+using Tins::Memory::OutputMemoryStream;
+
+namespace Tins {
+namespace Crypto {
+namespace WPA2 {
+
+// Multi-buffer PBKDF2-HMAC-SHA1
+//
+// Every lane holds an independent SHA-1 computation. All loops over lanes
+// are simple enough for the compiler to turn them into SIMD instructions.
+// Each PMK is made of two PBKDF2 blocks, so every PMK uses two lanes.
+
+const size_t SHA1_LANES = 8;
+const size_t PMKS_PER_PASS = SHA1_LANES / 2;
+const uint32_t PBKDF2_ITERATIONS = 4096;
+// The size of an HMAC inner/outer message for a 20 byte input, in bits
+const uint32_t HMAC_DIGEST_MESSAGE_BITS = (64 + 20) * 8;
+
+typedef uint32_t sha1_lanes[5][SHA1_LANES];
+typedef uint32_t sha1_block_lanes[16][SHA1_LANES];
+
+const uint32_t sha1_initial_state[5] = {
+    0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+};
+
+static inline uint32_t rotate_left(uint32_t value, uint32_t count) {
+    return (value << count) | (value >> (32 - count));
+}
+
+static inline void sha1_schedule(uint32_t (&w)[16][SHA1_LANES], size_t t) {
+    uint32_t* output = w[t & 15];
+    const uint32_t* w3 = w[(t + 13) & 15];
+    const uint32_t* w8 = w[(t + 8) & 15];
+    const uint32_t* w14 = w[(t + 2) & 15];
+    for (size_t l = 0; l < SHA1_LANES; ++l) {
+        output[l] = rotate_left(w3[l] ^ w8[l] ^ w14[l] ^ output[l], 1);
+    }
+}
+
+static void sha1_compress(sha1_lanes& state, const sha1_block_lanes& block) {
+    uint32_t w[16][SHA1_LANES];
+    uint32_t a[SHA1_LANES], b[SHA1_LANES], c[SHA1_LANES], d[SHA1_LANES], e[SHA1_LANES];
+    std::copy(&block[0][0], &block[0][0] + 16 * SHA1_LANES, &w[0][0]);
+    for (size_t l = 0; l < SHA1_LANES; ++l) {
+        a[l] = state[0][l];
+        b[l] = state[1][l];
+        c[l] = state[2][l];
+        d[l] = state[3][l];
+        e[l] = state[4][l];
+    }
+    for (size_t t = 0; t < 80; ++t) {
+        if (t >= 16) {
+            sha1_schedule(w, t);
+        }
+        const uint32_t* wt = w[t & 15];
+        if (t < 20) {
+            for (size_t l = 0; l < SHA1_LANES; ++l) {
+                const uint32_t f = (b[l] & c[l]) | (~b[l] & d[l]);
+                const uint32_t temp = rotate_left(a[l], 5) + f + e[l] + 0x5a827999 + wt[l];
+                e[l] = d[l]; d[l] = c[l]; c[l] = rotate_left(b[l], 30); b[l] = a[l]; a[l] = temp;
+            }
+        }
+        else if (t < 40) {
+            for (size_t l = 0; l < SHA1_LANES; ++l) {
+                const uint32_t f = b[l] ^ c[l] ^ d[l];
+                const uint32_t temp = rotate_left(a[l], 5) + f + e[l] + 0x6ed9eba1 + wt[l];
+                e[l] = d[l]; d[l] = c[l]; c[l] = rotate_left(b[l], 30); b[l] = a[l]; a[l] = temp;
+            }
+        }
+        else if (t < 60) {
+            for (size_t l = 0; l < SHA1_LANES; ++l) {
+                const uint32_t f = (b[l] & c[l]) | (b[l] & d[l]) | (c[l] & d[l]);
+                const uint32_t temp = rotate_left(a[l], 5) + f + e[l] + 0x8f1bbcdc + wt[l];
+                e[l] = d[l]; d[l] = c[l]; c[l] = rotate_left(b[l], 30); b[l] = a[l]; a[l] = temp;
+            }
+        }
+        else {
+            for (size_t l = 0; l < SHA1_LANES; ++l) {
+                const uint32_t f = b[l] ^ c[l] ^ d[l];
+                const uint32_t temp = rotate_left(a[l], 5) + f + e[l] + 0xca62c1d6 + wt[l];
+                e[l] = d[l]; d[l] = c[l]; c[l] = rotate_left(b[l], 30); b[l] = a[l]; a[l] = temp;
+            }
+        }
+    }
+    for (size_t l = 0; l < SHA1_LANES; ++l) {
+        state[0][l] += a[l];
+        state[1][l] += b[l];
+        state[2][l] += c[l];
+        state[3][l] += d[l];
+        state[4][l] += e[l];
+    }
+}
+
+// Loads a 64 byte block into a lane as big endian words
+static void load_block(sha1_block_lanes& block, size_t lane, const uint8_t* data) {
+    for (size_t i = 0; i < 16; ++i, data += 4) {
+        block[i][lane] = (static_cast<uint32_t>(data[0]) << 24) | 
+                         (static_cast<uint32_t>(data[1]) << 16) |
+                         (static_cast<uint32_t>(data[2]) << 8) | data[3];
+    }
+}
+
+// Fills words 5 to 15 with the padding for a 20 byte message after a key block
+static void pad_digest_block(sha1_block_lanes& block) {
+    for (size_t l = 0; l < SHA1_LANES; ++l) {
+        block[5][l] = 0x80000000;
+        for (size_t i = 6; i < 15; ++i) {
+            block[i][l] = 0;
+        }
+        block[15][l] = HMAC_DIGEST_MESSAGE_BITS;
+    }
+}
+
+// Whether the fast path can be used. Otherwise, OpenSSL's PBKDF2 is used
+static bool can_derive_in_lanes(const pair<string, string>& credentials) {
+    // The PSK has to fit in a block and the salt plus the block index, 
+    // padding and length need to fit in another one
+    return credentials.first.size() <= 64 && credentials.second.size() <= 64 - 4 - 9;
+}
+
+static SessionKeys::pmk_type derive_pmk_openssl(const pair<string, string>& credentials) {
+    SessionKeys::pmk_type pmk(SessionKeys::PMK_SIZE);
+    PKCS5_PBKDF2_HMAC_SHA1(
+        credentials.first.c_str(), 
+        credentials.first.size(), 
+        (const unsigned char*)credentials.second.c_str(), 
+        credentials.second.size(), 
+        PBKDF2_ITERATIONS, 
+        pmk.size(), 
+        &pmk[0]
+    );
+    return pmk;
+}
+
+// Derives up to PMKS_PER_PASS PMKs. Unused lanes repeat the first PMK's work
+static void derive_pmks_in_lanes(const pair<string, string>* const* credentials, size_t count,
+                          SessionKeys::pmk_type* const* output) {
+    sha1_lanes inner_state, outer_state, state, result;
+    sha1_block_lanes inner_block, outer_block;
+    for (size_t l = 0; l < SHA1_LANES; ++l) {
+        for (size_t i = 0; i < 5; ++i) {
+            inner_state[i][l] = outer_state[i][l] = sha1_initial_state[i];
+        }
+    }
+    // Hash the HMAC key pads
+    for (size_t l = 0; l < SHA1_LANES; ++l) {
+        const string& psk = credentials[std::min(l / 2, count - 1)]->first;
+        uint8_t inner_pad[64], outer_pad[64];
+        std::fill(inner_pad, inner_pad + 64, 0x36);
+        std::fill(outer_pad, outer_pad + 64, 0x5c);
+        for (size_t i = 0; i < psk.size(); ++i) {
+            inner_pad[i] ^= static_cast<uint8_t>(psk[i]);
+            outer_pad[i] ^= static_cast<uint8_t>(psk[i]);
+        }
+        load_block(inner_block, l, inner_pad);
+        load_block(outer_block, l, outer_pad);
+    }
+    sha1_compress(inner_state, inner_block);
+    sha1_compress(outer_state, outer_block);
+
+    // U1 = HMAC(psk, ssid || block index)
+    for (size_t l = 0; l < SHA1_LANES; ++l) {
+        const string& ssid = credentials[std::min(l / 2, count - 1)]->second;
+        const uint64_t bits = (64 + ssid.size() + 4) * 8;
+        uint8_t message[64] = { 0 };
+        std::copy(ssid.begin(), ssid.end(), message);
+        message[ssid.size() + 3] = static_cast<uint8_t>(l % 2 + 1);
+        message[ssid.size() + 4] = 0x80;
+        message[62] = static_cast<uint8_t>(bits >> 8);
+        message[63] = static_cast<uint8_t>(bits);
+        load_block(inner_block, l, message);
+    }
+    std::copy(&inner_state[0][0], &inner_state[0][0] + 5 * SHA1_LANES, &state[0][0]);
+    sha1_compress(state, inner_block);
+    pad_digest_block(outer_block);
+    pad_digest_block(inner_block);
+    std::copy(&state[0][0], &state[0][0] + 5 * SHA1_LANES, &outer_block[0][0]);
+    std::copy(&outer_state[0][0], &outer_state[0][0] + 5 * SHA1_LANES, &state[0][0]);
+    sha1_compress(state, outer_block);
+    std::copy(&state[0][0], &state[0][0] + 5 * SHA1_LANES, &result[0][0]);
+
+    // U_n = HMAC(psk, U_n-1) and the result is the XOR of all of them
+    for (uint32_t iteration = 1; iteration < PBKDF2_ITERATIONS; ++iteration) {
+        std::copy(&state[0][0], &state[0][0] + 5 * SHA1_LANES, &inner_block[0][0]);
+        std::copy(&inner_state[0][0], &inner_state[0][0] + 5 * SHA1_LANES, &state[0][0]);
+        sha1_compress(state, inner_block);
+        std::copy(&state[0][0], &state[0][0] + 5 * SHA1_LANES, &outer_block[0][0]);
+        std::copy(&outer_state[0][0], &outer_state[0][0] + 5 * SHA1_LANES, &state[0][0]);
+        sha1_compress(state, outer_block);
+        for (size_t i = 0; i < 5; ++i) {
+            for (size_t l = 0; l < SHA1_LANES; ++l) {
+                result[i][l] ^= state[i][l];
+            }
+        }
+    }
+
+    // The PMK is the first block followed by the first 12 bytes of the second one
+    for (size_t k = 0; k < count; ++k) {
+        SessionKeys::pmk_type& pmk = *output[k];
+        pmk.resize(SessionKeys::PMK_SIZE);
+        for (size_t i = 0; i < SessionKeys::PMK_SIZE; ++i) {
+            const size_t lane = k * 2 + i / 20;
+            const uint32_t word = result[(i % 20) / 4][lane];
+            pmk[i] = static_cast<uint8_t>(word >> (24 - (i % 4) * 8));
+        }
+    }
+}
+
+static void derive_pmk_group(const vector<pair<string, string> >& credentials,
+                      const vector<size_t>& indexes, size_t group,
+                      vector<SessionKeys::pmk_type>& output) {
+    const pair<string, string>* group_credentials[PMKS_PER_PASS];
+    SessionKeys::pmk_type* group_output[PMKS_PER_PASS];
+    const size_t first = group * PMKS_PER_PASS;
+    const size_t count = std::min(PMKS_PER_PASS, indexes.size() - first);
+    for (size_t i = 0; i < count; ++i) {
+        group_credentials[i] = &credentials[indexes[first + i]];
+        group_output[i] = &output[indexes[first + i]];
+    }
+    derive_pmks_in_lanes(group_credentials, count, group_output);
+}
+
+SessionKeys::pmk_type derive_pmk(const string& psk, const string& ssid) {
+    vector<pair<string, string> > credentials(1, make_pair(psk, ssid));
+    return derive_pmks(credentials).front();
+}
+
+vector<SessionKeys::pmk_type> derive_pmks(const vector<pair<string, string> >& credentials,
+                                          size_t thread_count, PMKCache* cache) {
+    vector<SessionKeys::pmk_type> output(credentials.size());
+    // Find out which ones have to be derived using lanes
+    vector<size_t> indexes;
+    for (size_t i = 0; i < credentials.size(); ++i) {
+        const SessionKeys::pmk_type* cached = 0;
+        if (cache) {
+            cached = cache->find(credentials[i].first, credentials[i].second);
+        }
+        if (cached) {
+            output[i] = *cached;
+        }
+        else if (can_derive_in_lanes(credentials[i])) {
+            indexes.push_back(i);
+        }
+        else {
+            output[i] = derive_pmk_openssl(credentials[i]);
+        }
+    }
+    const size_t group_count = (indexes.size() + PMKS_PER_PASS - 1) / PMKS_PER_PASS;
+    #ifdef TINS_HAVE_CXX11
+        if (thread_count == 0) {
+            thread_count = std::max(std::thread::hardware_concurrency(), 1U);
+        }
+        // Threads take groups until there are none left
+        std::atomic<size_t> next_group(0);
+        vector<std::thread> threads;
+        for (size_t i = 1; i < std::min(thread_count, group_count); ++i) {
+            threads.push_back(std::thread([&]() {
+                size_t group;
+                while ((group = next_group++) < group_count) {
+                    derive_pmk_group(credentials, indexes, group, output);
+                }
+            }));
+        }
+        size_t group;
+        while ((group = next_group++) < group_count) {
+            derive_pmk_group(credentials, indexes, group, output);
+        }
+        for (size_t i = 0; i < threads.size(); ++i) {
+            threads[i].join();
+        }
+    #else
+        Internals::unused(thread_count);
+        for (size_t group = 0; group < group_count; ++group) {
+            derive_pmk_group(credentials, indexes, group, output);
+        }
+    #endif // TINS_HAVE_CXX11
+    if (cache) {
+        for (size_t i = 0; i < credentials.size(); ++i) {
+            cache->insert(credentials[i].first, credentials[i].second, output[i]);
+        }
+    }
+    return output;
+}
+
+// PMKCache
+
+// The longest SSID allowed by IEEE 802.11
+const size_t PMK_CACHE_MAX_SSID_SIZE = 32;
+
+// Creates a new file next to file_path that only the current user can access.
+// Its path is stored in temp_path. Returns a null pointer on failure
+static FILE* pmk_cache_create_temp_file(const string& file_path, string& temp_path) {
+    const string pattern = file_path + ".XXXXXX";
+    vector<char> path(pattern.begin(), pattern.end());
+    path.push_back(0);
+    #ifdef _WIN32
+        int fd = -1;
+        if (_mktemp_s(&path[0], path.size()) != 0 ||
+            _sopen_s(&fd, &path[0], _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY,
+                     _SH_DENYRW, _S_IREAD | _S_IWRITE) != 0) {
+            return 0;
+        }
+        FILE* file = _fdopen(fd, "wb");
+        if (!file) {
+            _close(fd);
+        }
+    #else // _WIN32
+        // mkstemp creates the file with 0600 permissions
+        const int fd = mkstemp(&path[0]);
+        if (fd == -1) {
+            return 0;
+        }
+        FILE* file = fdopen(fd, "wb");
+        if (!file) {
+            close(fd);
+        }
+    #endif // _WIN32
+    temp_path = &path[0];
+    if (!file) {
+        std::remove(temp_path.c_str());
+    }
+    return file;
+}
+
+// Replaces file_path with the file at temp_path. rename can't do this on
+// Windows if file_path already exists
+static bool pmk_cache_replace_file(const string& temp_path, const string& file_path) {
+    #ifdef _WIN32
+        return MoveFileExA(temp_path.c_str(), file_path.c_str(),
+                           MOVEFILE_REPLACE_EXISTING) != 0;
+    #else // _WIN32
+        return std::rename(temp_path.c_str(), file_path.c_str()) == 0;
+    #endif // _WIN32
+}
+
+const uint32_t PMKCache::FILE_MAGIC = 0x4b4d5054; // "TPMK"
+const uint8_t PMKCache::FILE_VERSION = 1;
+
+PMKCache::PMKCache() {
+
+}
+
+PMKCache::PMKCache(const string& file_path)
+: file_path_(file_path) {
+    load();
+}
+
+const PMKCache::pmk_type* PMKCache::find(const string& psk, const string& ssid) const {
+    pmks_type::const_iterator iter = pmks_.find(make_key(psk, ssid));
+    return (iter != pmks_.end()) ? &iter->second : 0;
+}
+
+void PMKCache::insert(const string& psk, const string& ssid, const pmk_type& pmk) {
+    if (ssid.size() > PMK_CACHE_MAX_SSID_SIZE) {
+        throw invalid_ssid();
+    }
+    pmks_[make_key(psk, ssid)] = pmk;
+}
+
+size_t PMKCache::size() const {
+    return pmks_.size();
+}
+
+void PMKCache::save() const {
+    if (file_path_.empty()) {
+        return;
+    }
+    // Magic, version and count
+    size_t total_size = sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t);
+    for (pmks_type::const_iterator it = pmks_.begin(); it != pmks_.end(); ++it) {
+        total_size += sizeof(uint8_t) + it->first.first.size() + it->first.second.size() +
+                      it->second.size();
+    }
+    vector<uint8_t> buffer(total_size);
+    OutputMemoryStream stream(&buffer[0], buffer.size());
+    stream.write_le(FILE_MAGIC);
+    stream.write(FILE_VERSION);
+    stream.write_le<uint32_t>(pmks_.size());
+    for (pmks_type::const_iterator it = pmks_.begin(); it != pmks_.end(); ++it) {
+        stream.write<uint8_t>(it->first.first.size());
+        stream.write(it->first.first.begin(), it->first.first.end());
+        stream.write(it->first.second.begin(), it->first.second.end());
+        stream.write(it->second.begin(), it->second.end());
+    }
+
+    // Write a temporary file and then replace the actual one
+    string temp_path;
+    FILE* output = pmk_cache_create_temp_file(file_path_, temp_path);
+    if (!output) {
+        throw runtime_error("Failed to write PMK cache");
+    }
+    const bool written = std::fwrite(&buffer[0], 1, buffer.size(), output) == buffer.size();
+    if (std::fclose(output) != 0 || !written ||
+        !pmk_cache_replace_file(temp_path, file_path_)) {
+        std::remove(temp_path.c_str());
+        throw runtime_error("Failed to write PMK cache");
+    }
+}
+
+PMKCache::key_type PMKCache::make_key(const string& psk, const string& ssid) {
+    hash_type hash(32);
+    EVP_Digest(psk.data(), psk.size(), &hash[0], 0, EVP_sha256(), 0);
+    return make_pair(ssid, hash);
+}
+
+void PMKCache::load() {
+    ifstream input(file_path_.c_str(), std::ios::binary);
+    if (!input) {
+        return;
+    }
+    const vector<uint8_t> buffer((istreambuf_iterator<char>(input)), istreambuf_iterator<char>());
+    if (buffer.empty()) {
+        return;
+    }
+    // Parse everything first so an invalid file leaves the cache empty
+    pmks_type pmks;
+    try {
+        InputMemoryStream stream(&buffer[0], buffer.size());
+        if (stream.read_le<uint32_t>() != FILE_MAGIC || stream.read<uint8_t>() != FILE_VERSION) {
+            return;
+        }
+        uint32_t count = stream.read_le<uint32_t>();
+        while (count--) {
+            const uint8_t ssid_size = stream.read<uint8_t>();
+            if (ssid_size > PMK_CACHE_MAX_SSID_SIZE || !stream.can_read(ssid_size)) {
+                return;
+            }
+            const string ssid(stream.pointer(), stream.pointer() + ssid_size);
+            stream.skip(ssid_size);
+            hash_type hash;
+            stream.read(hash, 32);
+            pmk_type pmk;
+            stream.read(pmk, SessionKeys::PMK_SIZE);
+            pmks[make_pair(ssid, hash)] = pmk;
+        }
+        if (stream) {
+            return;
+        }
+    }
+    catch (const malformed_packet&) {
+        return;
+    }
+    pmks_.swap(pmks);
+}
+
+} // WPA2
+} // Crypto
+} // Tins
+
+#endif // TINS_HAVE_WPA2_DECRYPTION
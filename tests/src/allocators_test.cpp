@@ -9,6 +9,10 @@
 #include <tins/dot1q.h>
 #include <tins/ip.h>
 #include <tins/ipv6.h>
+#include <tins/udp.h>
+#include <tins/tcp.h>
+#include <tins/dns.h>
+#include <tins/rawpdu.h>
 
 
 using namespace Tins;
@@ -120,3 +124,73 @@ TEST_F(AllocatorsTest, IPv6) {
         EXPECT_EQ(pkt.serialize(), ipv6_data);
     }
 }
+
+TEST_F(AllocatorsTest, ReplaceBuiltInProtocol) {
+    std::vector<uint8_t> ipv4_data(
+        ipv4_data_buffer,
+        ipv4_data_buffer + sizeof(ipv4_data_buffer)
+    );
+    // Use the MPLS ethertype, which is otherwise decoded by the library
+    ipv4_data[12] = 0x88;
+    ipv4_data[13] = 0x47;
+    {
+        EthernetII pkt(&ipv4_data[0], (uint32_t)ipv4_data.size());
+        EXPECT_TRUE(pkt.find_pdu<DummyPDU<4> >() == NULL);
+    }
+    Allocators::register_allocator<EthernetII, DummyPDU<4> >(0x8847);
+    {
+        EthernetII pkt(&ipv4_data[0], (uint32_t)ipv4_data.size());
+        EXPECT_TRUE(pkt.find_pdu<DummyPDU<4> >() != NULL);
+        EXPECT_EQ(pkt.serialize(), ipv4_data);
+    }
+}
+
+TEST_F(AllocatorsTest, Ports) {
+    Allocators::register_allocator<UDP, DummyPDU<5> >(9999);
+    Allocators::register_allocator<TCP, DummyPDU<6> >(9999);
+    {
+        EthernetII eth = EthernetII() / IP() / UDP(9999, 40000) / RawPDU("hello");
+        PDU::serialization_type buffer = eth.serialize();
+        EthernetII pkt(&buffer[0], (uint32_t)buffer.size());
+        EXPECT_TRUE(pkt.find_pdu<DummyPDU<5> >() != NULL);
+        EXPECT_EQ(pkt.serialize(), buffer);
+    }
+    {
+        EthernetII eth = EthernetII() / IP() / TCP(40000, 9999) / RawPDU("hello");
+        PDU::serialization_type buffer = eth.serialize();
+        EthernetII pkt(&buffer[0], (uint32_t)buffer.size());
+        EXPECT_TRUE(pkt.find_pdu<DummyPDU<6> >() != NULL);
+        EXPECT_EQ(pkt.serialize(), buffer);
+    }
+}
+
+TEST_F(AllocatorsTest, ApplicationLayerProtocols) {
+    DNS dns;
+    dns.id(0x1234);
+    dns.add_query(DNS::query("www.example.com", DNS::A, DNS::INTERNET));
+    EthernetII eth = EthernetII() / IP() / UDP(53, 1025) / dns;
+    PDU::serialization_type buffer = eth.serialize();
+    {
+        EthernetII pkt(&buffer[0], (uint32_t)buffer.size());
+        EXPECT_TRUE(pkt.find_pdu<RawPDU>() != NULL);
+    }
+
+    Allocators::register_application_allocators();
+    {
+        EthernetII pkt(&buffer[0], (uint32_t)buffer.size());
+        const DNS* parsed = pkt.find_pdu<DNS>();
+        ASSERT_TRUE(parsed != NULL);
+        EXPECT_EQ(0x1234, parsed->id());
+        ASSERT_EQ(1U, parsed->queries().size());
+        EXPECT_EQ("www.example.com", parsed->queries().front().dname());
+        EXPECT_EQ(pkt.serialize(), buffer);
+    }
+    {
+        // Anything that's not valid DNS is kept as a RawPDU
+        EthernetII other = EthernetII() / IP() / UDP(1025, 53) / RawPDU("A");
+        PDU::serialization_type other_buffer = other.serialize();
+        EthernetII pkt(&other_buffer[0], (uint32_t)other_buffer.size());
+        EXPECT_TRUE(pkt.find_pdu<DNS>() == NULL);
+        EXPECT_TRUE(pkt.find_pdu<RawPDU>() != NULL);
+    }
+}
@@ -0,0 +1,285 @@
+#include <tins/cxxstd.h>
+#include <gtest/gtest.h>
+
+#if TINS_IS_CXX11
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <tins/dhcp_lease_tracker.h>
+#include <tins/dhcp.h>
+#include <tins/dhcpv6.h>
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/udp.h>
+#include <tins/rawpdu.h>
+#include <tins/packet.h>
+#include <tins/memory_helpers.h>
+
+using namespace Tins;
+
+using std::string;
+using std::vector;
+using std::chrono::microseconds;
+using std::chrono::seconds;
+
+class DHCPLeaseTrackerTest : public testing::Test {
+public:
+    typedef DHCPLeaseTracker::hwaddress_type hwaddress_type;
+
+    static const hwaddress_type client, server_hw;
+
+    static Packet make_dhcp(const microseconds& ts, uint8_t type, 
+                            const hwaddress_type& client_hw,
+                            const IPv4Address& address = IPv4Address(),
+                            const IPv4Address& server = "10.0.0.1",
+                            uint32_t lease_time = 3600);
+    static Packet make_dhcpv6(const microseconds& ts, DHCPv6::MessageType type, 
+                              const IPv6Address& address = IPv6Address(), 
+                              uint32_t valid_lifetime = 3600);
+    static DHCPv6::duid_type server_duid();
+};
+
+const DHCPLeaseTrackerTest::hwaddress_type DHCPLeaseTrackerTest::client = "00:01:02:03:04:05";
+const DHCPLeaseTrackerTest::hwaddress_type DHCPLeaseTrackerTest::server_hw = "00:0a:0b:0c:0d:0e";
+
+Packet DHCPLeaseTrackerTest::make_dhcp(const microseconds& ts, uint8_t type, 
+                                       const hwaddress_type& client_hw,
+                                       const IPv4Address& address,
+                                       const IPv4Address& server,
+                                       uint32_t lease_time) {
+    DHCP dhcp;
+    const bool from_client = type == DHCP::RELEASE || type == DHCP::DECLINE;
+    dhcp.opcode(from_client ? DHCP::BOOTREQUEST : DHCP::BOOTREPLY);
+    dhcp.type(static_cast<DHCP::Flags>(type));
+    dhcp.chaddr(client_hw);
+    dhcp.yiaddr(address);
+    dhcp.server_identifier(server);
+    if (type == DHCP::ACK) {
+        dhcp.lease_time(lease_time);
+    }
+    dhcp.end();
+    EthernetII pkt = EthernetII(client_hw, server_hw) / IP("255.255.255.255", server) / 
+                     UDP(68, 67) / dhcp;
+    return Packet(pkt, ts);
+}
+
+DHCPv6::duid_type DHCPLeaseTrackerTest::server_duid() {
+    vector<uint8_t> lladdress(server_hw.begin(), server_hw.end());
+    return DHCPv6::duid_ll(1, lladdress);
+}
+
+Packet DHCPLeaseTrackerTest::make_dhcpv6(const microseconds& ts, DHCPv6::MessageType type, 
+                                         const IPv6Address& address, 
+                                         uint32_t valid_lifetime) {
+    DHCPv6 dhcp;
+    dhcp.msg_type(type);
+    vector<uint8_t> lladdress(client.begin(), client.end());
+    dhcp.client_id(DHCPv6::duid_ll(1, lladdress));
+    dhcp.server_id(server_duid());
+    if (type == DHCPv6::REPLY) {
+        vector<uint8_t> options(4 + 24);
+        Memory::OutputMemoryStream stream(options);
+        stream.write_be<uint16_t>(DHCPv6::IA_ADDR);
+        stream.write_be<uint16_t>(24);
+        stream.write(address);
+        stream.write_be<uint32_t>(valid_lifetime / 2);
+        stream.write_be<uint32_t>(valid_lifetime);
+        dhcp.ia_na(DHCPv6::ia_na_type(1, 0, 0, options));
+    }
+    EthernetII pkt = EthernetII(client, server_hw) / IPv6("fe80::1", "fe80::2") / 
+                     UDP(546, 547) / dhcp;
+    return Packet(pkt, ts);
+}
+
+TEST_F(DHCPLeaseTrackerTest, AckAddsLease) {
+    DHCPLeaseTracker tracker;
+    EXPECT_FALSE(tracker.process_packet(make_dhcp(seconds(1), DHCP::OFFER, client, 
+                                                  "10.0.0.20")));
+    EXPECT_EQ(0U, tracker.lease_count());
+    EXPECT_TRUE(tracker.process_packet(make_dhcp(seconds(2), DHCP::ACK, client, 
+                                                 "10.0.0.20")));
+    ASSERT_EQ(1U, tracker.lease_count());
+    const DHCPLeaseTracker::lease* lease = tracker.find_lease(client);
+    ASSERT_TRUE(lease != 0);
+    EXPECT_EQ(client, lease->client);
+    EXPECT_EQ(IPv4Address("10.0.0.20"), lease->address);
+    EXPECT_FALSE(lease->ipv6);
+    EXPECT_EQ(seconds(3602), lease->expiry);
+    EXPECT_TRUE(tracker.find_ipv6_lease(client) == 0);
+
+    ASSERT_EQ(1U, tracker.servers().size());
+    const DHCPLeaseTracker::server& server = tracker.servers()[lease->server_index];
+    const uint8_t identifier[] = { 10, 0, 0, 1 };
+    EXPECT_EQ(vector<uint8_t>(identifier, identifier + 4), server.identifier);
+    EXPECT_EQ(server_hw, server.hw_address);
+    EXPECT_EQ(2U, server.packets);
+    EXPECT_FALSE(server.ipv6);
+    EXPECT_FALSE(server.trusted);
+}
+
+TEST_F(DHCPLeaseTrackerTest, LeaseExpires) {
+    DHCPLeaseTracker tracker;
+    tracker.process_packet(make_dhcp(seconds(0), DHCP::ACK, client, "10.0.0.20", 
+                                     "10.0.0.1", 100));
+    // Renewing it moves its expiry forward
+    tracker.process_packet(make_dhcp(seconds(80), DHCP::ACK, client, "10.0.0.20", 
+                                     "10.0.0.1", 100));
+    tracker.expire(seconds(150));
+    EXPECT_EQ(1U, tracker.lease_count());
+    const hwaddress_type other = "00:01:02:03:04:06";
+    tracker.process_packet(make_dhcp(seconds(180), DHCP::OFFER, other, "10.0.0.21"));
+    EXPECT_EQ(0U, tracker.lease_count());
+    EXPECT_TRUE(tracker.find_lease(client) == 0);
+}
+
+TEST_F(DHCPLeaseTrackerTest, InfiniteLease) {
+    DHCPLeaseTracker tracker;
+    tracker.process_packet(make_dhcp(seconds(0), DHCP::ACK, client, "10.0.0.20", 
+                                     "10.0.0.1", 0xffffffff));
+    tracker.expire(seconds(1000000));
+    ASSERT_EQ(1U, tracker.lease_count());
+    EXPECT_EQ(DHCPLeaseTracker::timestamp_type::max(), tracker.find_lease(client)->expiry);
+}
+
+TEST_F(DHCPLeaseTrackerTest, LeaseRemoval) {
+    const uint8_t types[] = { DHCP::RELEASE, DHCP::DECLINE, DHCP::NAK };
+    for (size_t i = 0; i < sizeof(types); ++i) {
+        DHCPLeaseTracker tracker;
+        tracker.process_packet(make_dhcp(seconds(0), DHCP::ACK, client, "10.0.0.20"));
+        EXPECT_TRUE(tracker.process_packet(make_dhcp(seconds(1), types[i], client)));
+        EXPECT_EQ(0U, tracker.lease_count());
+        EXPECT_FALSE(tracker.process_packet(make_dhcp(seconds(2), types[i], client)));
+    }
+}
+
+TEST_F(DHCPLeaseTrackerTest, InformAckIgnored) {
+    DHCPLeaseTracker tracker;
+    EXPECT_FALSE(tracker.process_packet(make_dhcp(seconds(0), DHCP::ACK, client)));
+    EXPECT_EQ(0U, tracker.lease_count());
+}
+
+TEST_F(DHCPLeaseTrackerTest, UnexpectedServers) {
+    DHCPLeaseTracker tracker;
+    vector<DHCPLeaseTracker::server> reported;
+    tracker.trust_server(IPv4Address("10.0.0.1"));
+    tracker.trust_server(server_duid());
+    tracker.unexpected_server_handler([&](const DHCPLeaseTracker::server& value) {
+        reported.push_back(value);
+    });
+    tracker.process_packet(make_dhcp(seconds(0), DHCP::OFFER, client, "10.0.0.20"));
+    tracker.process_packet(make_dhcpv6(seconds(0), DHCPv6::ADVERTISE));
+    EXPECT_EQ(0U, reported.size());
+    for (int i = 0; i < 2; ++i) {
+        tracker.process_packet(make_dhcp(seconds(1), DHCP::OFFER, client, "10.0.0.20",
+                                         "10.0.0.66"));
+    }
+    ASSERT_EQ(1U, reported.size());
+    const uint8_t identifier[] = { 10, 0, 0, 66 };
+    EXPECT_EQ(vector<uint8_t>(identifier, identifier + 4), reported[0].identifier);
+    EXPECT_EQ(server_hw, reported[0].hw_address);
+    EXPECT_FALSE(reported[0].trusted);
+
+    const DHCPLeaseTracker::servers_type& servers = tracker.servers();
+    ASSERT_EQ(3U, servers.size());
+    EXPECT_TRUE(servers[0].trusted);
+    EXPECT_TRUE(servers[1].trusted);
+    EXPECT_TRUE(servers[1].ipv6);
+    EXPECT_EQ(1U, servers[1].packets);
+    EXPECT_FALSE(servers[2].trusted);
+    EXPECT_EQ(2U, servers[2].packets);
+
+    // Trusting a server that was already seen
+    tracker.trust_server(IPv4Address("10.0.0.66"));
+    EXPECT_EQ(3U, servers.size());
+    EXPECT_TRUE(servers[2].trusted);
+}
+
+TEST_F(DHCPLeaseTrackerTest, DHCPv6Leases) {
+    DHCPLeaseTracker tracker;
+    EXPECT_TRUE(tracker.process_packet(make_dhcpv6(seconds(0), DHCPv6::REPLY, 
+                                                   "2001:db8::20")));
+    const DHCPLeaseTracker::lease* lease = tracker.find_ipv6_lease(client);
+    ASSERT_TRUE(lease != 0);
+    EXPECT_TRUE(lease->ipv6);
+    EXPECT_EQ(IPv6Address("2001:db8::20"), lease->ipv6_address);
+    EXPECT_EQ(seconds(3600), lease->expiry);
+    EXPECT_TRUE(tracker.find_lease(client) == 0);
+    EXPECT_TRUE(tracker.servers()[lease->server_index].ipv6);
+
+    // DHCP and DHCPv6 leases are kept separately
+    tracker.process_packet(make_dhcp(seconds(1), DHCP::ACK, client, "10.0.0.20"));
+    EXPECT_EQ(2U, tracker.lease_count());
+    EXPECT_TRUE(tracker.process_packet(make_dhcpv6(seconds(2), DHCPv6::RELEASE)));
+    EXPECT_TRUE(tracker.find_ipv6_lease(client) == 0);
+    EXPECT_TRUE(tracker.find_lease(client) != 0);
+
+    tracker.process_packet(make_dhcpv6(seconds(3), DHCPv6::REPLY, "2001:db8::20"));
+    EXPECT_TRUE(tracker.process_packet(make_dhcpv6(seconds(4), DHCPv6::REPLY, 
+                                                   "2001:db8::20", 0)));
+    EXPECT_TRUE(tracker.find_ipv6_lease(client) == 0);
+}
+
+TEST_F(DHCPLeaseTrackerTest, RawPayloads) {
+    DHCPLeaseTracker tracker;
+    const Packet packet = make_dhcp(seconds(0), DHCP::ACK, client, "10.0.0.20");
+    DHCP dhcp = packet.pdu()->rfind_pdu<DHCP>();
+    PDU::serialization_type buffer = dhcp.serialize();
+    EthernetII pkt = EthernetII(client, server_hw) / IP("10.0.0.20", "10.0.0.1") / 
+                     UDP(68, 67) / RawPDU(buffer.begin(), buffer.end());
+    EXPECT_TRUE(tracker.process_packet(Packet(pkt, seconds(0))));
+    const DHCPLeaseTracker::lease* lease = tracker.find_lease(client);
+    ASSERT_TRUE(lease != 0);
+    EXPECT_EQ(IPv4Address("10.0.0.20"), lease->address);
+
+    // Garbage on DHCP ports is ignored
+    const uint8_t garbage[] = { 1, 2, 3 };
+    pkt.rfind_pdu<UDP>().inner_pdu(RawPDU(garbage, sizeof(garbage)));
+    EXPECT_FALSE(tracker.process_packet(Packet(pkt, seconds(0))));
+}
+
+TEST_F(DHCPLeaseTrackerTest, ManyClients) {
+    DHCPLeaseTracker tracker;
+    const uint32_t client_count = 100000;
+    tracker.reserve(client_count);
+    DHCP dhcp;
+    dhcp.opcode(DHCP::BOOTREPLY);
+    dhcp.type(DHCP::ACK);
+    dhcp.server_identifier("10.0.0.1");
+    dhcp.lease_time(100);
+    EthernetII pkt = EthernetII(client, server_hw) / IP("255.255.255.255", "10.0.0.1") / 
+                     UDP(68, 67) / dhcp;
+    DHCP& inner = pkt.rfind_pdu<DHCP>();
+    for (uint32_t i = 0; i < client_count; ++i) {
+        const uint8_t address[] = { 0, 1, uint8_t(i >> 16), uint8_t(i >> 8), uint8_t(i), 0 };
+        inner.chaddr(hwaddress_type(address));
+        inner.yiaddr(IPv4Address(Endian::host_to_be(0x0a000000 + i)));
+        // Half of the leases expire earlier
+        ASSERT_TRUE(tracker.process_packet(Packet(pkt, seconds(i % 2))));
+    }
+    EXPECT_EQ(client_count, tracker.lease_count());
+    size_t count = 0;
+    for (DHCPLeaseTracker::const_iterator it = tracker.begin(); it != tracker.end(); ++it) {
+        EXPECT_EQ(0x0a000000U + ((it->client[2] << 16) | (it->client[3] << 8) | it->client[4]),
+                  Endian::be_to_host(static_cast<uint32_t>(it->address)));
+        ++count;
+    }
+    EXPECT_EQ(client_count, count);
+    EXPECT_EQ(client_count, tracker.snapshot().size());
+
+    tracker.expire(seconds(100));
+    EXPECT_EQ(client_count / 2, tracker.lease_count());
+    EXPECT_EQ(client_count / 2, tracker.snapshot().size());
+    tracker.expire(seconds(101));
+    EXPECT_EQ(0U, tracker.lease_count());
+    EXPECT_TRUE(tracker.begin() == tracker.end());
+}
+
+#else
+
+TEST(Foo, Dummy) {
+
+}
+
+#endif // TINS_IS_CXX11
@@ -5,6 +5,7 @@
 #include <list>
 #include <string>
 #include <tins/dhcp.h>
+#include <tins/exceptions.h>
 #include <tins/utils.h>
 #include <tins/ethernetII.h>
 #include <tins/hw_address.h>
@@ -223,6 +224,25 @@ TEST_F(DHCPTest, DNSOption) {
     EXPECT_EQ(dns, dns2);
 }
 
+TEST_F(DHCPTest, AddressRange) {
+    DHCP dhcp;
+    std::vector<IPv4Address> routers;
+    routers.push_back("192.168.0.253");
+    routers.push_back("10.123.45.67");
+    routers.push_back("10.0.0.1");
+    dhcp.routers(routers);
+
+    DHCP::address_range range = dhcp.addresses(DHCP::ROUTERS);
+    EXPECT_EQ(3U, range.size());
+    EXPECT_FALSE(range.empty());
+    std::vector<IPv4Address> routers2(range.begin(), range.end());
+    EXPECT_EQ(routers, routers2);
+
+    EXPECT_THROW(dhcp.addresses(DHCP::DOMAIN_NAME_SERVERS), option_not_found);
+    dhcp.hostname("foo");
+    EXPECT_THROW(dhcp.addresses(DHCP::HOST_NAME), malformed_option);
+}
+
 TEST_F(DHCPTest, DomainNameOption) {
     DHCP dhcp;
     string domain = "libtins.test.domain";
@@ -317,3 +337,25 @@ TEST_F(DHCPTest, RemoveOption) {
     PDU::serialization_type new_buffer = dhcp.serialize();
     EXPECT_EQ(old_buffer, new_buffer);
 }
+
+TEST_F(DHCPTest, SearchOptionAfterRemoval) {
+    DHCP dhcp;
+    dhcp.domain_name("first.example.com");
+    dhcp.hostname("foo");
+    dhcp.domain_name("second.example.com");
+    dhcp.lease_time(3600);
+    EXPECT_EQ("first.example.com", dhcp.domain_name());
+
+    EXPECT_TRUE(dhcp.remove_option(DHCP::DOMAIN_NAME));
+    EXPECT_EQ("second.example.com", dhcp.domain_name());
+    EXPECT_EQ("foo", dhcp.hostname());
+    EXPECT_EQ(3600U, dhcp.lease_time());
+    EXPECT_TRUE(dhcp.remove_option(DHCP::DOMAIN_NAME));
+    EXPECT_FALSE(dhcp.remove_option(DHCP::DOMAIN_NAME));
+    EXPECT_TRUE(dhcp.search_option(DHCP::DOMAIN_NAME) == 0);
+    EXPECT_EQ(3600U, dhcp.lease_time());
+
+    DHCP copy(dhcp);
+    EXPECT_EQ("foo", copy.hostname());
+    EXPECT_EQ(3600U, copy.lease_time());
+}
@@ -348,3 +348,18 @@ TEST_F(DHCPv6Test, RemoveOption) {
     PDU::serialization_type new_buffer = dhcp.serialize();
     EXPECT_EQ(old_buffer, new_buffer);
 }
+
+TEST_F(DHCPv6Test, SearchOptionAfterRemoval) {
+    DHCPv6 dhcp;
+    dhcp.preference(12);
+    dhcp.add_option(DHCPv6::option(static_cast<DHCPv6::OptionTypes>(300)));
+    dhcp.elapsed_time(0x1234);
+
+    EXPECT_TRUE(dhcp.search_option(static_cast<DHCPv6::OptionTypes>(300)) != 0);
+    EXPECT_TRUE(dhcp.remove_option(DHCPv6::PREFERENCE));
+    EXPECT_TRUE(dhcp.search_option(DHCPv6::PREFERENCE) == 0);
+    EXPECT_EQ(0x1234, dhcp.elapsed_time());
+    EXPECT_TRUE(dhcp.remove_option(static_cast<DHCPv6::OptionTypes>(300)));
+    EXPECT_TRUE(dhcp.search_option(static_cast<DHCPv6::OptionTypes>(300)) == 0);
+    EXPECT_EQ(0x1234, dhcp.elapsed_time());
+}
@@ -0,0 +1,196 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <tins/dns.h>
+#include <tins/dns_builder.h>
+#include <tins/exceptions.h>
+
+using namespace Tins;
+
+using std::string;
+
+class DNSBuilderTest : public testing::Test {
+public:
+    static void test_equals(const DNS::resources_type& lhs, 
+                            const DNS::resources_type& rhs);
+};
+
+void DNSBuilderTest::test_equals(const DNS::resources_type& lhs, 
+                                 const DNS::resources_type& rhs) {
+    ASSERT_EQ(lhs.size(), rhs.size());
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        EXPECT_EQ(lhs[i].dname(), rhs[i].dname());
+        EXPECT_EQ(lhs[i].data(), rhs[i].data());
+        EXPECT_EQ(lhs[i].query_type(), rhs[i].query_type());
+        EXPECT_EQ(lhs[i].query_class(), rhs[i].query_class());
+        EXPECT_EQ(lhs[i].ttl(), rhs[i].ttl());
+        EXPECT_EQ(lhs[i].preference(), rhs[i].preference());
+    }
+}
+
+TEST_F(DNSBuilderTest, Header) {
+    DNSBuilder builder;
+    builder.id(0x1234)
+           .type(DNS::RESPONSE)
+           .authoritative_answer(1)
+           .recursion_desired(1)
+           .recursion_available(1)
+           .rcode(3);
+    DNS dns = builder.build();
+    EXPECT_EQ(0x1234, dns.id());
+    EXPECT_EQ(DNS::RESPONSE, dns.type());
+    EXPECT_EQ(1, dns.authoritative_answer());
+    EXPECT_EQ(1, dns.recursion_desired());
+    EXPECT_EQ(1, dns.recursion_available());
+    EXPECT_EQ(3, dns.rcode());
+    EXPECT_EQ(0, dns.opcode());
+    EXPECT_EQ(0, dns.truncated());
+}
+
+TEST_F(DNSBuilderTest, AllSections) {
+    DNS expected;
+    DNSBuilder builder;
+    const DNS::query query("www.example.com", DNS::A, DNS::INTERNET);
+    const DNS::resource answers[] = {
+        DNS::resource("www.example.com", "192.168.0.1", DNS::A, DNS::INTERNET, 60),
+        DNS::resource("www.example.com", "f9a8:239::1:1", DNS::AAAA, DNS::INTERNET, 61),
+        DNS::resource("WWW.example.com", "mail.example.com", DNS::MX, DNS::INTERNET, 62, 10),
+        DNS::resource("alias.example.com", "www.example.com", DNS::CNAME, DNS::INTERNET, 63)
+    };
+    const DNS::resource authority("example.com", "ns1.example.com", DNS::NS,
+                                  DNS::INTERNET, 64);
+    const DNS::resource additional("ns1.example.com", "10.0.0.1", DNS::A,
+                                   DNS::INTERNET, 65);
+    expected.add_query(query);
+    builder.add_query(query);
+    for (size_t i = 0; i < sizeof(answers) / sizeof(answers[0]); ++i) {
+        expected.add_answer(answers[i]);
+        builder.add_answer(answers[i]);
+    }
+    expected.add_authority(authority);
+    builder.add_authority(authority);
+    expected.add_additional(additional);
+    builder.add_additional(additional);
+
+    DNS dns = builder.build();
+    EXPECT_EQ(1, dns.questions_count());
+    EXPECT_EQ(4, dns.answers_count());
+    EXPECT_EQ(1, dns.authority_count());
+    EXPECT_EQ(1, dns.additional_count());
+    ASSERT_EQ(1U, dns.queries().size());
+    EXPECT_EQ(query.dname(), dns.queries().front().dname());
+    // The decompressed names are the ones in the buffer, so compare 
+    // case-insensitive names through the original ones
+    DNS::resources_type built_answers = dns.answers();
+    ASSERT_EQ(4U, built_answers.size());
+    EXPECT_EQ("www.example.com", built_answers[2].dname());
+    built_answers[2].dname("WWW.example.com");
+    test_equals(expected.answers(), built_answers);
+    test_equals(expected.authority(), dns.authority());
+    test_equals(expected.additional(), dns.additional());
+
+    // Every name but the first one is compressed
+    EXPECT_LT(builder.buffer().size(), expected.size());
+}
+
+TEST_F(DNSBuilderTest, NameCompression) {
+    DNSBuilder builder;
+    builder.add_query(DNS::query("www.example.com", DNS::A, DNS::INTERNET));
+    const size_t size = builder.buffer().size();
+    builder.add_query(DNS::query("www.example.com.", DNS::A, DNS::INTERNET));
+    // Just a pointer plus type and class
+    EXPECT_EQ(size + 6, builder.buffer().size());
+    builder.add_query(DNS::query("ftp.example.com", DNS::A, DNS::INTERNET));
+    // A label, a pointer plus type and class
+    EXPECT_EQ(size + 6 + 4 + 2 + 4, builder.buffer().size());
+    builder.add_query(DNS::query("example.org", DNS::A, DNS::INTERNET));
+    EXPECT_EQ(size + 16 + 13 + 4, builder.buffer().size());
+
+    DNS dns = builder.build();
+    DNS::queries_type queries = dns.queries();
+    ASSERT_EQ(4U, queries.size());
+    EXPECT_EQ("www.example.com", queries[0].dname());
+    EXPECT_EQ("www.example.com", queries[1].dname());
+    EXPECT_EQ("ftp.example.com", queries[2].dname());
+    EXPECT_EQ("example.org", queries[3].dname());
+}
+
+TEST_F(DNSBuilderTest, ResponseFromQuery) {
+    DNS query;
+    query.id(0x4321);
+    query.recursion_desired(1);
+    query.add_query(DNS::query("www.example.com", DNS::A, DNS::INTERNET));
+    query.add_query(DNS::query("example.com", DNS::MX, DNS::INTERNET));
+    const PDU::serialization_type query_buffer = query.serialize();
+
+    DNSBuilder builder(DNS(&query_buffer[0], query_buffer.size()));
+    const size_t size = builder.buffer().size();
+    builder.recursion_available(1);
+    builder.add_answer(
+        DNS::resource("www.example.com", "127.0.0.1", DNS::A, DNS::INTERNET, 777)
+    );
+    // The name is a pointer to the question
+    EXPECT_EQ(size + 2 + 10 + 4, builder.buffer().size());
+
+    DNS dns = builder.build();
+    EXPECT_EQ(0x4321, dns.id());
+    EXPECT_EQ(DNS::RESPONSE, dns.type());
+    EXPECT_EQ(1, dns.recursion_desired());
+    EXPECT_EQ(1, dns.recursion_available());
+    EXPECT_EQ(2, dns.questions_count());
+    EXPECT_EQ(1, dns.answers_count());
+    EXPECT_EQ(0, dns.authority_count());
+    EXPECT_EQ(0, dns.additional_count());
+    DNS::queries_type queries = dns.queries();
+    ASSERT_EQ(2U, queries.size());
+    EXPECT_EQ("example.com", queries[1].dname());
+    EXPECT_EQ(DNS::MX, queries[1].query_type());
+    DNS::resources_type answers = dns.answers();
+    ASSERT_EQ(1U, answers.size());
+    EXPECT_EQ("www.example.com", answers[0].dname());
+    EXPECT_EQ("127.0.0.1", answers[0].data());
+}
+
+TEST_F(DNSBuilderTest, ResponseDropsRecords) {
+    DNS query;
+    query.add_query(DNS::query("www.example.com", DNS::A, DNS::INTERNET));
+    query.add_additional(
+        DNS::resource("www.example.com", "127.0.0.1", DNS::A, DNS::INTERNET, 1)
+    );
+
+    DNSBuilder builder(query);
+    DNS dns = builder.build();
+    EXPECT_EQ(1, dns.questions_count());
+    EXPECT_EQ(0, dns.additional_count());
+    // Header, name, type and class
+    EXPECT_EQ(12U + 17 + 4, builder.buffer().size());
+}
+
+TEST_F(DNSBuilderTest, SectionOrder) {
+    DNSBuilder builder;
+    const DNS::resource resource("www.example.com", "127.0.0.1", DNS::A, 
+                                 DNS::INTERNET, 1);
+    builder.add_authority(resource);
+    EXPECT_THROW(builder.add_answer(resource), invalid_section_order);
+    EXPECT_THROW(
+        builder.add_query(DNS::query("www.example.com", DNS::A, DNS::INTERNET)),
+        invalid_section_order
+    );
+    builder.add_additional(resource);
+    EXPECT_THROW(builder.add_authority(resource), invalid_section_order);
+
+    builder.clear();
+    builder.add_answer(resource);
+    EXPECT_EQ(1, builder.build().answers_count());
+}
+
+TEST_F(DNSBuilderTest, InvalidNames) {
+    DNSBuilder builder;
+    EXPECT_THROW(
+        builder.add_query(DNS::query("www..example.com", DNS::A, DNS::INTERNET)),
+        invalid_domain_name
+    );
+    EXPECT_THROW(
+        builder.add_query(DNS::query(string(64, 'a') + ".com", DNS::A, DNS::INTERNET)),
+        invalid_domain_name
+    );
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <stdexcept>
+#include <tins/dns.h>
+#include <tins/dns_name_table.h>
+
+using namespace Tins;
+
+using std::string;
+
+class DNSNameTableTest : public testing::Test {
+public:
+    static const uint8_t dns_response1[];
+};
+
+// google.com MX response, every name is compressed
+const uint8_t DNSNameTableTest::dns_response1[] = {
+    174, 73, 129, 128, 0, 1, 0, 5, 0, 0, 0, 0, 6, 103, 111, 111, 103, 108, 
+    101, 3, 99, 111, 109, 0, 0, 15, 0, 1, 192, 12, 0, 15, 0, 1, 0, 0, 2, 88, 
+    0, 17, 0, 50, 4, 97, 108, 116, 52, 5, 97, 115, 112, 109, 120, 1, 108, 
+    192, 12, 192, 12, 0, 15, 0, 1, 0, 0, 2, 88, 0, 9, 0, 40, 4, 97, 108, 
+    116, 51, 192, 47, 192, 12, 0, 15, 0, 1, 0, 0, 2, 88, 0, 9, 0, 20, 4, 
+    97, 108, 116, 49, 192, 47, 192, 12, 0, 15, 0, 1, 0, 0, 2, 88, 0, 4, 
+    0, 10, 192, 47, 192, 12, 0, 15, 0, 1, 0, 0, 2, 88, 0, 9, 0, 30, 4, 97, 
+    108, 116, 50, 192, 47
+};
+
+TEST_F(DNSNameTableTest, InternStrings) {
+    DNSNameTable table;
+    const DNSNameTable::id_type id = table.intern("www.example.com");
+    EXPECT_EQ(id, table.intern("WWW.Example.COM."));
+    EXPECT_NE(id, table.intern("example.com"));
+    EXPECT_NE(id, table.intern("www.example.co"));
+    EXPECT_EQ(3U, table.size());
+    EXPECT_EQ("www.example.com", table.name(id));
+
+    table.clear();
+    EXPECT_EQ(0U, table.size());
+}
+
+TEST_F(DNSNameTableTest, InternRecords) {
+    DNS dns(dns_response1, sizeof(dns_response1));
+    DNSNameTable table;
+    const DNSNameTable::id_type google_id = table.intern("google.com");
+    DNS::record_range records = dns.answer_records();
+    DNS::resources_type resources = dns.answers();
+    DNS::resources_type::const_iterator resource_it = resources.begin();
+    for (DNS::record_iterator it = records.begin(); it != records.end(); ++it) {
+        EXPECT_EQ(google_id, table.intern(*it));
+        const DNSNameTable::id_type target_id = table.intern_target(*it);
+        EXPECT_EQ(resource_it->data(), table.name(target_id));
+        EXPECT_EQ(target_id, table.intern(resource_it->data()));
+        ++resource_it;
+    }
+    // google.com plus 5 different MX targets
+    EXPECT_EQ(6U, table.size());
+
+    // Interning the same packet again doesn't add anything
+    for (DNS::record_iterator it = records.begin(); it != records.end(); ++it) {
+        table.intern(*it);
+        table.intern_target(*it);
+    }
+    EXPECT_EQ(6U, table.size());
+}
+
+TEST_F(DNSNameTableTest, Erase) {
+    DNSNameTable table;
+    const DNSNameTable::id_type first = table.intern("www.example.com");
+    const DNSNameTable::id_type second = table.intern("example.com");
+    table.erase(first);
+    EXPECT_EQ(1U, table.size());
+    EXPECT_THROW(table.name(first), std::out_of_range);
+    EXPECT_EQ(second, table.intern("EXAMPLE.com"));
+    // Erased identifiers are reused
+    EXPECT_EQ(first, table.intern("other.com"));
+    EXPECT_EQ("other.com", table.name(first));
+    EXPECT_NE(first, table.intern("www.example.com"));
+    EXPECT_EQ(3U, table.size());
+}
+
+TEST_F(DNSNameTableTest, MaxSize) {
+    DNSNameTable table;
+    EXPECT_EQ(0U, table.max_size());
+    const DNSNameTable::id_type a = table.intern("a.com");
+    const DNSNameTable::id_type b = table.intern("b.com");
+    const DNSNameTable::id_type c = table.intern("c.com");
+    // a.com is now the most recently interned one
+    EXPECT_EQ(a, table.intern("a.com"));
+    table.max_size(2);
+    EXPECT_EQ(2U, table.size());
+    EXPECT_THROW(table.name(b), std::out_of_range);
+    EXPECT_EQ("c.com", table.name(c));
+
+    const DNSNameTable::id_type d = table.intern("d.com");
+    EXPECT_EQ(2U, table.size());
+    // c.com was evicted and its identifier reused
+    EXPECT_EQ(c, d);
+    EXPECT_EQ("a.com", table.name(a));
+    EXPECT_EQ("d.com", table.name(d));
+
+    DNS dns(dns_response1, sizeof(dns_response1));
+    DNS::record_range records = dns.answer_records();
+    for (DNS::record_iterator it = records.begin(); it != records.end(); ++it) {
+        table.intern_target(*it);
+    }
+    EXPECT_EQ(2U, table.size());
+}
@@ -2,6 +2,8 @@
 #include <iostream>
 #include <tins/dns.h>
 #include <tins/ipv6_address.h>
+#include <tins/ip_address.h>
+#include <tins/exceptions.h>
 
 using namespace Tins;
 
@@ -396,6 +398,74 @@ TEST_F(DNSTest, AnswersV6) {
     }
 }
 
+TEST_F(DNSTest, RecordViews) {
+    DNS dns(dns_response1, sizeof(dns_response1));
+    DNS::resources_type resources = dns.answers();
+    DNS::record_range records = dns.answer_records();
+    DNS::resources_type::const_iterator resource_it = resources.begin();
+    size_t count = 0;
+    for(DNS::record_iterator it = records.begin(); it != records.end(); ++it) {
+        ASSERT_TRUE(resource_it != resources.end());
+        EXPECT_EQ(resource_it->dname(), it->dname());
+        EXPECT_TRUE(it->dname_equals("google.com"));
+        EXPECT_TRUE(it->dname_equals("GOOGLE.com."));
+        EXPECT_FALSE(it->dname_equals("google.co"));
+        EXPECT_FALSE(it->dname_equals("www.google.com"));
+        EXPECT_EQ(resource_it->query_type(), it->query_type());
+        EXPECT_EQ(resource_it->query_class(), it->query_class());
+        EXPECT_EQ(resource_it->ttl(), it->ttl());
+        EXPECT_EQ(resource_it->preference(), it->preference());
+        EXPECT_EQ(resource_it->data(), it->target_dname());
+        EXPECT_TRUE(it->target_dname_equals(resource_it->data()));
+        ++resource_it;
+        ++count;
+    }
+    EXPECT_EQ(resources.size(), count);
+    EXPECT_TRUE(dns.authority_records().empty());
+    EXPECT_TRUE(dns.additional_records().empty());
+}
+
+TEST_F(DNSTest, RecordViewsAddresses) {
+    DNS dns;
+    dns.add_query(DNS::query("www.example.com", DNS::A, DNS::INTERNET));
+    dns.add_answer(
+        DNS::resource("www.example.com", "192.168.0.1", DNS::A, DNS::INTERNET, 0x762)
+    );
+    dns.add_answer(
+        DNS::resource("www.example.com", "f9a8:239::1:1", DNS::AAAA, DNS::INTERNET, 0x762)
+    );
+    dns.add_authority(
+        DNS::resource("example.com", "ns.example.com", DNS::NS, DNS::INTERNET, 0x762)
+    );
+    dns.add_additional(
+        DNS::resource("ns.example.com", "10.0.0.1", DNS::A, DNS::INTERNET, 0x762)
+    );
+
+    DNS::record_range answers = dns.answer_records();
+    DNS::record_iterator it = answers.begin();
+    ASSERT_TRUE(it != answers.end());
+    EXPECT_EQ(DNS::A, it->query_type());
+    EXPECT_EQ(IPv4Address("192.168.0.1"), it->address());
+    EXPECT_THROW(it->address_v6(), malformed_packet);
+    ++it;
+    ASSERT_TRUE(it != answers.end());
+    EXPECT_EQ(DNS::AAAA, it->query_type());
+    EXPECT_EQ(IPv6Address("f9a8:239::1:1"), it->address_v6());
+    EXPECT_THROW(it->address(), malformed_packet);
+    ++it;
+    EXPECT_TRUE(it == answers.end());
+
+    DNS::record_range authority = dns.authority_records();
+    ASSERT_FALSE(authority.empty());
+    EXPECT_TRUE(authority.begin()->dname_equals("example.com"));
+    EXPECT_EQ("ns.example.com", authority.begin()->target_dname());
+
+    DNS::record_range additional = dns.additional_records();
+    ASSERT_FALSE(additional.empty());
+    EXPECT_EQ("ns.example.com", additional.begin()->dname());
+    EXPECT_EQ(IPv4Address("10.0.0.1"), additional.begin()->address());
+}
+
 TEST_F(DNSTest, ItAintGonnaCorrupt) {
     DNS dns(dns_response1, sizeof(dns_response1));
     EXPECT_EQ(dns.questions_count(), 1);
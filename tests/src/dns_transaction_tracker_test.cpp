@@ -0,0 +1,303 @@
+#include <tins/cxxstd.h>
+#include <gtest/gtest.h>
+
+#if TINS_IS_CXX11
+
+#include <chrono>
+#include <string>
+#include <tins/dns_transaction_tracker.h>
+#include <tins/dns.h>
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/udp.h>
+#include <tins/rawpdu.h>
+#include <tins/packet.h>
+
+using namespace Tins;
+
+using std::string;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+
+class DNSTransactionTrackerTest : public testing::Test {
+public:
+    static DNS make_dns(uint16_t id, const string& name, DNS::QueryType type, 
+                        DNS::QRType qr);
+    static Packet make_query(const microseconds& ts, uint16_t id, 
+                             const string& name, DNS::QueryType type = DNS::A,
+                             uint16_t client_port = 1234);
+    static Packet make_response(const microseconds& ts, uint16_t id, 
+                                const string& name, DNS::QueryType type = DNS::A,
+                                uint16_t client_port = 1234);
+};
+
+DNS DNSTransactionTrackerTest::make_dns(uint16_t id, const string& name, 
+                                        DNS::QueryType type, DNS::QRType qr) {
+    DNS dns;
+    dns.id(id);
+    dns.type(qr);
+    dns.add_query(DNS::query(name, type, DNS::INTERNET));
+    return dns;
+}
+
+Packet DNSTransactionTrackerTest::make_query(const microseconds& ts, uint16_t id, 
+                                             const string& name, DNS::QueryType type,
+                                             uint16_t client_port) {
+    IP pkt = IP("8.8.8.8", "192.168.0.2") / UDP(53, client_port) / 
+             make_dns(id, name, type, DNS::QUERY);
+    return Packet(pkt, ts);
+}
+
+Packet DNSTransactionTrackerTest::make_response(const microseconds& ts, uint16_t id, 
+                                                const string& name, DNS::QueryType type,
+                                                uint16_t client_port) {
+    IP pkt = IP("192.168.0.2", "8.8.8.8") / UDP(client_port, 53) / 
+             make_dns(id, name, type, DNS::RESPONSE);
+    return Packet(pkt, ts);
+}
+
+TEST_F(DNSTransactionTrackerTest, HistogramEmpty) {
+    LatencyHistogram histogram;
+    EXPECT_EQ(0U, histogram.count());
+    EXPECT_EQ(0, histogram.minimum().count());
+    EXPECT_EQ(0, histogram.maximum().count());
+    EXPECT_EQ(0, histogram.mean().count());
+    EXPECT_EQ(0, histogram.percentile(50).count());
+}
+
+TEST_F(DNSTransactionTrackerTest, HistogramPercentiles) {
+    LatencyHistogram histogram;
+    for (int i = 1; i <= 1000; ++i) {
+        histogram.add(microseconds(i));
+    }
+    EXPECT_EQ(1000U, histogram.count());
+    EXPECT_EQ(1, histogram.minimum().count());
+    EXPECT_EQ(1000, histogram.maximum().count());
+    EXPECT_EQ(500, histogram.mean().count());
+    EXPECT_EQ(1, histogram.percentile(0).count());
+    EXPECT_EQ(10, histogram.percentile(1).count());
+    EXPECT_EQ(1000, histogram.percentile(100).count());
+    const int percentiles[] = { 50, 90, 99 };
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(int); ++i) {
+        const double expected = percentiles[i] * 10;
+        const double actual = static_cast<double>(histogram.percentile(percentiles[i]).count());
+        EXPECT_GE(actual, expected);
+        EXPECT_LE(actual, expected * 1.0625);
+    }
+}
+
+TEST_F(DNSTransactionTrackerTest, HistogramLargeValues) {
+    LatencyHistogram histogram;
+    histogram.add(microseconds(-5));
+    histogram.add(seconds(3600 * 24));
+    EXPECT_EQ(0, histogram.minimum().count());
+    EXPECT_EQ(0, histogram.percentile(50).count());
+    EXPECT_EQ(seconds(3600 * 24), histogram.percentile(100));
+}
+
+TEST_F(DNSTransactionTrackerTest, HistogramMerge) {
+    LatencyHistogram lhs, rhs;
+    lhs.add(microseconds(10));
+    rhs.add(microseconds(5));
+    rhs.add(microseconds(30));
+    lhs.merge(rhs);
+    lhs.merge(LatencyHistogram());
+    EXPECT_EQ(3U, lhs.count());
+    EXPECT_EQ(5, lhs.minimum().count());
+    EXPECT_EQ(30, lhs.maximum().count());
+    EXPECT_EQ(15, lhs.mean().count());
+    lhs.clear();
+    EXPECT_EQ(0U, lhs.count());
+}
+
+TEST_F(DNSTransactionTrackerTest, MatchResponses) {
+    DNSTransactionTracker tracker;
+    EXPECT_FALSE(tracker.process_packet(make_query(seconds(10), 1, "www.example.com")));
+    EXPECT_FALSE(tracker.process_packet(make_query(seconds(10), 2, "example.com", DNS::MX)));
+    EXPECT_EQ(2U, tracker.pending_transactions());
+    // Different id
+    EXPECT_FALSE(tracker.process_packet(make_response(seconds(11), 3, "www.example.com")));
+    // Different client port
+    EXPECT_FALSE(
+        tracker.process_packet(make_response(seconds(11), 1, "www.example.com", DNS::A, 9))
+    );
+    EXPECT_TRUE(tracker.process_packet(make_response(seconds(10) + milliseconds(20), 1, 
+                                                     "www.example.com")));
+    EXPECT_TRUE(tracker.process_packet(make_response(seconds(10) + milliseconds(30), 2, 
+                                                     "example.com", DNS::MX)));
+    EXPECT_EQ(0U, tracker.pending_transactions());
+    EXPECT_EQ(2U, tracker.answered_count());
+    EXPECT_EQ(0U, tracker.unanswered_count());
+    EXPECT_EQ(milliseconds(20), tracker.latency().minimum());
+    EXPECT_EQ(milliseconds(30), tracker.latency().maximum());
+
+    DNSTransactionTracker::statistics_type stats = tracker.statistics();
+    ASSERT_EQ(2U, stats.size());
+    for (size_t i = 0; i < stats.size(); ++i) {
+        EXPECT_EQ(1U, stats[i].latency.count());
+        EXPECT_EQ(0U, stats[i].unanswered);
+        if (stats[i].type == DNS::A) {
+            EXPECT_EQ("www.example.com", stats[i].name);
+            EXPECT_EQ(milliseconds(20), stats[i].latency.maximum());
+        }
+        else {
+            EXPECT_EQ(DNS::MX, stats[i].type);
+            EXPECT_EQ("example.com", stats[i].name);
+            EXPECT_EQ(milliseconds(30), stats[i].latency.maximum());
+        }
+    }
+}
+
+TEST_F(DNSTransactionTrackerTest, RawPayloads) {
+    DNSTransactionTracker tracker;
+    DNS query = make_dns(1, "www.example.com", DNS::A, DNS::QUERY);
+    DNS response = make_dns(1, "www.example.com", DNS::A, DNS::RESPONSE);
+    PDU::serialization_type query_buffer = query.serialize();
+    PDU::serialization_type response_buffer = response.serialize();
+    IPv6 query_pkt = IPv6("::1", "fe80::1") / UDP(53, 1000) / 
+                     RawPDU(query_buffer.begin(), query_buffer.end());
+    IPv6 response_pkt = IPv6("fe80::1", "::1") / UDP(1000, 53) / 
+                        RawPDU(response_buffer.begin(), response_buffer.end());
+    EXPECT_FALSE(tracker.process_packet(Packet(query_pkt, seconds(1))));
+    EXPECT_TRUE(tracker.process_packet(Packet(response_pkt, seconds(2))));
+    EXPECT_EQ(seconds(1), tracker.latency().maximum());
+}
+
+TEST_F(DNSTransactionTrackerTest, Retransmissions) {
+    DNSTransactionTracker tracker;
+    tracker.process_packet(make_query(seconds(1), 1, "www.example.com"));
+    tracker.process_packet(make_query(seconds(2), 1, "www.example.com"));
+    EXPECT_EQ(1U, tracker.pending_transactions());
+    EXPECT_TRUE(tracker.process_packet(make_response(seconds(3), 1, "www.example.com")));
+    EXPECT_FALSE(tracker.process_packet(make_response(seconds(3), 1, "www.example.com")));
+    EXPECT_EQ(seconds(2), tracker.latency().maximum());
+}
+
+TEST_F(DNSTransactionTrackerTest, Timeouts) {
+    DNSTransactionTracker tracker;
+    tracker.timeout(seconds(2));
+    tracker.process_packet(make_query(seconds(100), 1, "www.example.com"));
+    tracker.process_packet(make_query(seconds(101), 2, "www.example.com"));
+    tracker.process_packet(make_query(seconds(101), 3, "www.example.com", DNS::AAAA));
+    EXPECT_TRUE(tracker.process_packet(make_response(seconds(101), 2, "www.example.com")));
+    EXPECT_EQ(0U, tracker.unanswered_count());
+    tracker.process_packet(make_query(seconds(102) + milliseconds(100), 4, "other.com"));
+    EXPECT_EQ(1U, tracker.unanswered_count());
+    EXPECT_EQ(2U, tracker.pending_transactions());
+    // A late response doesn't match anything
+    EXPECT_FALSE(tracker.process_packet(make_response(seconds(102), 1, "www.example.com")));
+    // Jumping far ahead expires everything
+    tracker.process_packet(make_query(seconds(1000), 5, "other.com"));
+    EXPECT_EQ(3U, tracker.unanswered_count());
+    EXPECT_EQ(1U, tracker.pending_transactions());
+
+    DNSTransactionTracker::statistics_type stats = tracker.statistics();
+    uint64_t total = 0;
+    for (size_t i = 0; i < stats.size(); ++i) {
+        total += stats[i].unanswered;
+        if (stats[i].name == "www.example.com" && stats[i].type == DNS::A) {
+            EXPECT_EQ(1U, stats[i].unanswered);
+            EXPECT_EQ(1U, stats[i].latency.count());
+        }
+    }
+    EXPECT_EQ(3U, total);
+
+    tracker.clear_statistics();
+    EXPECT_EQ(0U, tracker.unanswered_count());
+    EXPECT_TRUE(tracker.statistics().empty());
+}
+
+TEST_F(DNSTransactionTrackerTest, ManyTransactions) {
+    DNSTransactionTracker tracker;
+    for (uint16_t i = 0; i < 5000; ++i) {
+        tracker.process_packet(make_query(seconds(1), i, "www.example.com"));
+    }
+    EXPECT_EQ(5000U, tracker.pending_transactions());
+    // Answer every other one, in reverse order
+    for (uint16_t i = 5000; i > 0; i -= 2) {
+        EXPECT_TRUE(tracker.process_packet(make_response(seconds(2), i - 1, 
+                                                         "www.example.com")));
+    }
+    EXPECT_EQ(2500U, tracker.pending_transactions());
+    for (uint16_t i = 0; i < 5000; i += 2) {
+        EXPECT_TRUE(tracker.process_packet(make_response(seconds(3), i, 
+                                                         "www.example.com")));
+    }
+    EXPECT_EQ(0U, tracker.pending_transactions());
+    EXPECT_EQ(5000U, tracker.answered_count());
+}
+
+TEST_F(DNSTransactionTrackerTest, Shards) {
+    const size_t shard_count = 8;
+    DNSTransactionTracker trackers[shard_count];
+    for (uint16_t i = 0; i < 100; ++i) {
+        Packet query = make_query(seconds(1), i, "www.example.com");
+        Packet response = make_response(seconds(2), i, "www.example.com");
+        const size_t index = DNSTransactionTracker::shard(query, shard_count);
+        ASSERT_LT(index, shard_count);
+        EXPECT_EQ(index, DNSTransactionTracker::shard(response, shard_count));
+        trackers[index].process_packet(query);
+        EXPECT_TRUE(trackers[index].process_packet(response));
+    }
+    DNSTransactionTracker total;
+    for (size_t i = 0; i < shard_count; ++i) {
+        total.merge(trackers[i]);
+    }
+    EXPECT_EQ(100U, total.answered_count());
+    DNSTransactionTracker::statistics_type stats = total.statistics();
+    ASSERT_EQ(1U, stats.size());
+    EXPECT_EQ("www.example.com", stats[0].name);
+    EXPECT_EQ(100U, stats[0].latency.count());
+}
+
+TEST_F(DNSTransactionTrackerTest, StatisticsEviction) {
+    DNSTransactionTracker tracker;
+    EXPECT_EQ(DNSTransactionTracker::DEFAULT_MAX_STATISTICS, tracker.max_statistics());
+    tracker.max_statistics(2);
+    tracker.process_packet(make_query(seconds(1), 1, "a.com"));
+    tracker.process_packet(make_query(seconds(1), 2, "b.com"));
+    tracker.process_packet(make_query(seconds(1), 3, "c.com"));
+    tracker.process_packet(make_query(seconds(1), 4, "d.com"));
+    EXPECT_TRUE(tracker.process_packet(make_response(seconds(2), 1, "a.com")));
+    EXPECT_TRUE(tracker.process_packet(make_response(seconds(2), 2, "b.com")));
+    // Evicts a.com, the least recently updated
+    EXPECT_TRUE(tracker.process_packet(make_response(seconds(3), 3, "c.com")));
+    // Evicts b.com. Pending queries keep their names even if they 
+    // have no statistics yet
+    EXPECT_TRUE(tracker.process_packet(make_response(seconds(4), 4, "d.com")));
+    EXPECT_EQ(4U, tracker.answered_count());
+
+    DNSTransactionTracker::statistics_type stats = tracker.statistics();
+    ASSERT_EQ(2U, stats.size());
+    for (size_t i = 0; i < stats.size(); ++i) {
+        EXPECT_TRUE(stats[i].name == "c.com" || stats[i].name == "d.com");
+        EXPECT_EQ(1U, stats[i].latency.count());
+    }
+
+    tracker.max_statistics(1);
+    stats = tracker.statistics();
+    ASSERT_EQ(1U, stats.size());
+    EXPECT_EQ("d.com", stats[0].name);
+}
+
+TEST_F(DNSTransactionTrackerTest, StatisticsEvictionReusesNames) {
+    DNSTransactionTracker tracker;
+    tracker.max_statistics(1);
+    for (uint16_t i = 0; i < 100; ++i) {
+        const string name = "host" + std::to_string(i) + ".com";
+        tracker.process_packet(make_query(seconds(1), i, name));
+        EXPECT_TRUE(tracker.process_packet(make_response(seconds(2), i, name)));
+        DNSTransactionTracker::statistics_type stats = tracker.statistics();
+        ASSERT_EQ(1U, stats.size());
+        EXPECT_EQ(name, stats[0].name);
+    }
+}
+
+#else
+
+TEST(Foo, Dummy) {
+
+}
+
+#endif // TINS_IS_CXX11
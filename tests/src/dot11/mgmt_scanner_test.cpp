@@ -0,0 +1,195 @@
+#include <tins/dot11/dot11_mgmt_scanner.h>
+
+#ifdef TINS_HAVE_DOT11
+
+#include <vector>
+#include <string>
+#include <gtest/gtest.h>
+#include <tins/dot11/dot11_beacon.h>
+#include <tins/dot11/dot11_probe.h>
+#include <tins/dot11/dot11_auth.h>
+#include <tins/dot11/dot11_data.h>
+#include <tins/exceptions.h>
+
+using namespace std;
+using namespace Tins;
+
+typedef Dot11::address_type address_type;
+
+class Dot11MgmtScannerTest : public testing::Test {
+public:
+    static const address_type bssid, station;
+
+    static PDU::serialization_type make_beacon();
+};
+
+const address_type Dot11MgmtScannerTest::bssid("72:91:34:fa:de:ad"),
+                   Dot11MgmtScannerTest::station("00:01:02:03:04:05");
+
+PDU::serialization_type Dot11MgmtScannerTest::make_beacon() {
+    Dot11Beacon beacon(Dot11::BROADCAST, bssid);
+    beacon.addr3(bssid);
+    beacon.ssid("libtins");
+    Dot11Beacon::rates_type rates;
+    rates.push_back(1.0f);
+    rates.push_back(5.5f);
+    beacon.supported_rates(rates);
+    beacon.ds_parameter_set(6);
+    const uint8_t vendor1[] = { 0x00, 0x50, 0xf2, 0x02 };
+    const uint8_t vendor2[] = { 0x00, 0x10, 0x18, 0x02, 0x00 };
+    beacon.add_option(Dot11::option(Dot11::VENDOR_SPECIFIC, vendor1, vendor1 + 4));
+    beacon.add_option(Dot11::option(Dot11::VENDOR_SPECIFIC, vendor2, vendor2 + 5));
+    return beacon.serialize();
+}
+
+TEST_F(Dot11MgmtScannerTest, Beacon) {
+    const PDU::serialization_type buffer = make_beacon();
+    Dot11MgmtScanner scanner;
+    ASSERT_TRUE(scanner.scan(&buffer[0], (uint32_t)buffer.size()));
+    const Dot11Beacon beacon(&buffer[0], (uint32_t)buffer.size());
+    EXPECT_EQ(Dot11::BEACON, scanner.subtype());
+    EXPECT_FALSE(scanner.to_ds());
+    EXPECT_FALSE(scanner.from_ds());
+    EXPECT_EQ(beacon.addr1(), scanner.addr1());
+    EXPECT_EQ(beacon.addr2(), scanner.addr2());
+    EXPECT_EQ(bssid, scanner.addr3());
+    EXPECT_EQ(beacon.ssid(), scanner.ssid());
+    EXPECT_EQ(6, scanner.channel());
+
+    const Dot11MgmtScanner::element* rates = scanner.search_element(Dot11::SUPPORTED_RATES);
+    ASSERT_TRUE(rates != 0);
+    const Dot11::option* option = beacon.search_option(Dot11::SUPPORTED_RATES);
+    ASSERT_TRUE(option != 0);
+    ASSERT_EQ(option->data_size(), rates->length);
+    EXPECT_TRUE(equal(rates->data, rates->data + rates->length, option->data_ptr()));
+    EXPECT_EQ(&buffer[0] + rates->offset, rates->data);
+
+    // Only the first occurrence can be searched
+    const Dot11MgmtScanner::element* vendor = scanner.search_element(Dot11::VENDOR_SPECIFIC);
+    ASSERT_TRUE(vendor != 0);
+    EXPECT_EQ(4U, vendor->length);
+    EXPECT_TRUE(scanner.search_element(Dot11::RSN) == 0);
+}
+
+TEST_F(Dot11MgmtScannerTest, RequestedElements) {
+    const PDU::serialization_type buffer = make_beacon();
+    Dot11MgmtScanner scanner;
+    scanner.clear_requests();
+    scanner.request(Dot11::SSID);
+    scanner.request(Dot11::VENDOR_SPECIFIC);
+    ASSERT_TRUE(scanner.scan(&buffer[0], (uint32_t)buffer.size()));
+    EXPECT_EQ("libtins", scanner.ssid());
+    EXPECT_TRUE(scanner.search_element(Dot11::DS_SET) == 0);
+    EXPECT_THROW(scanner.channel(), option_not_found);
+    const Dot11MgmtScanner::element* vendor = scanner.search_element(Dot11::VENDOR_SPECIFIC);
+    ASSERT_TRUE(vendor != 0);
+    EXPECT_EQ(4, vendor->length);
+}
+
+#if TINS_IS_CXX11
+
+TEST_F(Dot11MgmtScannerTest, Handler) {
+    const PDU::serialization_type buffer = make_beacon();
+    Dot11MgmtScanner scanner;
+    scanner.clear_requests();
+    scanner.request(Dot11::SSID);
+    scanner.request(Dot11::VENDOR_SPECIFIC);
+    vector<uint8_t> lengths;
+    scanner.handler([&](const Dot11MgmtScanner::element& value) {
+        if (value.id == Dot11::VENDOR_SPECIFIC) {
+            lengths.push_back(value.length);
+        }
+    });
+    ASSERT_TRUE(scanner.scan(&buffer[0], (uint32_t)buffer.size()));
+    ASSERT_EQ(2U, lengths.size());
+    EXPECT_EQ(4, lengths[0]);
+    EXPECT_EQ(5, lengths[1]);
+}
+
+TEST_F(Dot11MgmtScannerTest, CopyKeepsHandler) {
+    const PDU::serialization_type buffer = make_beacon();
+    size_t count = 0;
+    Dot11MgmtScanner scanner;
+    scanner.clear_requests();
+    scanner.request(Dot11::SSID);
+    scanner.handler([&](const Dot11MgmtScanner::element&) {
+        ++count;
+    });
+    Dot11MgmtScanner copy(scanner);
+    scanner = Dot11MgmtScanner();
+    ASSERT_TRUE(copy.scan(&buffer[0], (uint32_t)buffer.size()));
+    ASSERT_TRUE(scanner.scan(&buffer[0], (uint32_t)buffer.size()));
+    EXPECT_EQ(1U, count);
+    EXPECT_EQ("libtins", copy.ssid());
+}
+
+#endif // TINS_IS_CXX11
+
+TEST_F(Dot11MgmtScannerTest, HTOperationChannel) {
+    Dot11ProbeResponse probe(station, bssid);
+    probe.ssid("five");
+    const uint8_t ht_operation[22] = { 36 };
+    probe.add_option(Dot11::option(Dot11::HT_OPERATION, ht_operation, 
+                                   ht_operation + sizeof(ht_operation)));
+    const PDU::serialization_type buffer = probe.serialize();
+    Dot11MgmtScanner scanner;
+    ASSERT_TRUE(scanner.scan(&buffer[0], (uint32_t)buffer.size()));
+    EXPECT_EQ(Dot11::PROBE_RESP, scanner.subtype());
+    EXPECT_EQ("five", scanner.ssid());
+    EXPECT_EQ(36, scanner.channel());
+}
+
+TEST_F(Dot11MgmtScannerTest, ElementsFromPreviousFrameDiscarded) {
+    const PDU::serialization_type beacon = make_beacon();
+    Dot11ProbeRequest probe(bssid, station);
+    const PDU::serialization_type buffer = probe.serialize();
+    Dot11MgmtScanner scanner;
+    ASSERT_TRUE(scanner.scan(&beacon[0], (uint32_t)beacon.size()));
+    ASSERT_TRUE(scanner.scan(&buffer[0], (uint32_t)buffer.size()));
+    EXPECT_EQ(Dot11::PROBE_REQ, scanner.subtype());
+    EXPECT_EQ(station, scanner.addr2());
+    EXPECT_TRUE(scanner.search_element(Dot11::SSID) == 0);
+    EXPECT_THROW(scanner.ssid(), option_not_found);
+}
+
+TEST_F(Dot11MgmtScannerTest, TruncatedElement) {
+    PDU::serialization_type buffer = make_beacon();
+    // Add a bogus FCS
+    const uint8_t fcs[] = { 0, 80, 1, 2 };
+    buffer.insert(buffer.end(), fcs, fcs + sizeof(fcs));
+    Dot11MgmtScanner scanner;
+    ASSERT_TRUE(scanner.scan(&buffer[0], (uint32_t)buffer.size()));
+    EXPECT_EQ("libtins", scanner.ssid());
+    EXPECT_EQ(6, scanner.channel());
+}
+
+TEST_F(Dot11MgmtScannerTest, NonManagementFrames) {
+    Dot11MgmtScanner scanner;
+    Dot11Data data(bssid, station);
+    PDU::serialization_type buffer = data.serialize();
+    EXPECT_FALSE(scanner.scan(&buffer[0], (uint32_t)buffer.size()));
+    const PDU::serialization_type beacon = make_beacon();
+    EXPECT_FALSE(scanner.scan(&beacon[0], 20));
+    EXPECT_TRUE(scanner.search_element(Dot11::SSID) == 0);
+}
+
+TEST_F(Dot11MgmtScannerTest, FramesWithoutElements) {
+    Dot11Deauthentication deauth(station, bssid);
+    deauth.ssid("ignored");
+    PDU::serialization_type buffer = deauth.serialize();
+    Dot11MgmtScanner scanner;
+    ASSERT_TRUE(scanner.scan(&buffer[0], (uint32_t)buffer.size()));
+    EXPECT_EQ(Dot11::DEAUTH, scanner.subtype());
+    EXPECT_EQ(bssid, scanner.addr2());
+    EXPECT_TRUE(scanner.search_element(Dot11::SSID) == 0);
+
+    // Protected frames are skipped as well
+    Dot11Beacon beacon(Dot11::BROADCAST, bssid);
+    beacon.ssid("hidden");
+    beacon.wep(1);
+    buffer = beacon.serialize();
+    ASSERT_TRUE(scanner.scan(&buffer[0], (uint32_t)buffer.size()));
+    EXPECT_TRUE(scanner.search_element(Dot11::SSID) == 0);
+}
+
+#endif // TINS_HAVE_DOT11
@@ -1,12 +1,18 @@
 #include <gtest/gtest.h>
 #include <cstring>
+#include <algorithm>
 #include <string>
 #include <utility>
+#include <tins/cxxstd.h>
 #include <tins/ip_reassembler.h>
 #include <tins/ethernetII.h>
 #include <tins/udp.h>
 #include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/packet.h>
+#include <tins/constants.h>
 #include <tins/rawpdu.h>
+#include <tins/exceptions.h>
 
 using std::vector;
 using std::pair;
@@ -20,8 +26,20 @@ public:
     static const size_t packet_sizes[], orderings[][11];
     
     void test_packets(const vector<pair<const uint8_t*, size_t> >& vt);
+    static IP make_fragment(const IPv4Address& src_addr, uint16_t id, uint16_t offset,
+                            bool more_fragments);
 };
 
+IP IPv4ReassemblerTest::make_fragment(const IPv4Address& src_addr, uint16_t id,
+                                      uint16_t offset, bool more_fragments) {
+    IP packet = IP("4.3.2.1", src_addr) / RawPDU(RawPDU::payload_type(8, 'A'));
+    packet.protocol(253);
+    packet.id(id);
+    packet.fragment_offset(offset);
+    packet.flags(more_fragments ? IP::MORE_FRAGMENTS : static_cast<IP::Flags>(0));
+    return packet;
+}
+
 const uint8_t IPv4ReassemblerTest::packets[][1514] = {
     {130,111,185,223,39,177,226,183,186,36,71,231,8,0,69,0,5,220,53,162,32,0,64,17,169,88,192,168,0,100,176,5,5,5,177,46,34,184,58,160,124,236,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65},
     {130,111,185,223,39,177,226,183,186,36,71,231,8,0,69,0,5,220,53,162,32,185,64,17,168,159,192,168,0,100,176,5,5,5,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65},
@@ -115,3 +133,479 @@ TEST_F(IPv4ReassemblerTest, PacketHasMFAndDF) {
     EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(packet1));
     EXPECT_EQ(IPv4Reassembler::REASSEMBLED, reassembler.process(packet2));
 }
+
+TEST_F(IPv4ReassemblerTest, OverlappingFragments) {
+    const RawPDU::payload_type first_payload(16, 'A');
+    const RawPDU::payload_type second_payload(16, 'B');
+    const RawPDU::payload_type third_payload(8, 'C');
+    IP first = IP("1.2.3.4", "4.3.2.1") / RawPDU(first_payload);
+    first.protocol(253);
+    first.id(1234);
+    first.flags(IP::MORE_FRAGMENTS);
+    // This one overlaps with both the first and the last fragments
+    IP second = first;
+    second.inner_pdu(RawPDU(second_payload));
+    second.fragment_offset(1);
+    second.flags(static_cast<IP::Flags>(0));
+    IP third = first;
+    third.inner_pdu(RawPDU(third_payload));
+    third.fragment_offset(2);
+
+    IPv4Reassembler reassembler;
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(first));
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(third));
+    EXPECT_EQ(IPv4Reassembler::REASSEMBLED, reassembler.process(second));
+    // The data that was received first is kept
+    RawPDU::payload_type expected(24, 'A');
+    std::fill(expected.begin() + 16, expected.end(), 'C');
+    EXPECT_EQ(expected, second.rfind_pdu<RawPDU>().payload());
+    EXPECT_EQ(0, second.fragment_offset());
+}
+
+TEST_F(IPv4ReassemblerTest, CheckpointAndRestore) {
+    IPv4Reassembler reassembler;
+    const size_t* ordering = orderings[3];
+    // Make sure the first fragment is part of the checkpoint
+    for (size_t i = 0; i < 7; ++i) {
+        EthernetII eth(packets[ordering[i]], (uint32_t)packet_sizes[ordering[i]]);
+        if (eth.rfind_pdu<IP>().fragment_offset() == 0) {
+            eth.rfind_pdu<IP>().ttl(32);
+        }
+        EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(eth));
+    }
+    vector<uint8_t> checkpoint = reassembler.checkpoint();
+
+    IPv4Reassembler restored;
+    restored.restore(&checkpoint[0], checkpoint.size());
+    EXPECT_EQ(checkpoint, restored.checkpoint());
+    for (size_t i = 7; i < 11; ++i) {
+        EthernetII eth(packets[ordering[i]], (uint32_t)packet_sizes[ordering[i]]);
+        IPv4Reassembler::PacketStatus status = restored.process(eth);
+        if (i == 10) {
+            ASSERT_EQ(IPv4Reassembler::REASSEMBLED, status);
+            EXPECT_EQ(32, eth.rfind_pdu<IP>().ttl());
+            ASSERT_TRUE(eth.find_pdu<UDP>() != NULL);
+            EXPECT_EQ(15000ULL, eth.rfind_pdu<RawPDU>().payload().size());
+        }
+        else {
+            EXPECT_EQ(IPv4Reassembler::FRAGMENTED, status);
+        }
+    }
+}
+
+TEST_F(IPv4ReassemblerTest, RestoreInvalidCheckpoint) {
+    IPv4Reassembler reassembler;
+    EthernetII eth(packets[0], (uint32_t)packet_sizes[0]);
+    reassembler.process(eth);
+    vector<uint8_t> checkpoint = reassembler.checkpoint();
+
+    IPv4Reassembler restored;
+    EXPECT_THROW(restored.restore(&checkpoint[0], checkpoint.size() - 1), invalid_checkpoint);
+    checkpoint[0] ^= 0xff;
+    EXPECT_THROW(restored.restore(&checkpoint[0], checkpoint.size()), invalid_checkpoint);
+    EXPECT_EQ(IPv4Reassembler().checkpoint(), restored.checkpoint());
+}
+
+TEST_F(IPv4ReassemblerTest, RestoreInvalidHoles) {
+    // The stream's holes are the last thing in the checkpoint
+    IPv4Reassembler reassembler;
+    IP first = make_fragment("1.2.3.4", 1, 0, true);
+    reassembler.process(first);
+    vector<uint8_t> checkpoint = reassembler.checkpoint();
+    const size_t hole_end = checkpoint.size() - sizeof(uint32_t);
+    // [8, 8) is empty
+    std::fill(checkpoint.begin() + hole_end, checkpoint.end(), 0);
+    checkpoint[hole_end] = 8;
+    IPv4Reassembler restored;
+    EXPECT_THROW(restored.restore(&checkpoint[0], checkpoint.size()), invalid_checkpoint);
+
+    // Once the size is known, holes can't go past it
+    IPv4Reassembler other_reassembler;
+    IP last = make_fragment("1.2.3.4", 1, 1, false);
+    other_reassembler.process(last);
+    checkpoint = other_reassembler.checkpoint();
+    checkpoint[checkpoint.size() - sizeof(uint32_t)] = 17;
+    EXPECT_THROW(restored.restore(&checkpoint[0], checkpoint.size()), invalid_checkpoint);
+    checkpoint[checkpoint.size() - sizeof(uint32_t)] = 8;
+    restored.restore(&checkpoint[0], checkpoint.size());
+    EXPECT_EQ(1U, restored.stream_count());
+}
+
+#if TINS_IS_CXX11
+
+TEST_F(IPv4ReassemblerTest, Timeout) {
+    using std::chrono::seconds;
+    IPv4Reassembler reassembler;
+    reassembler.timeout(seconds(30));
+    Packet packet1(make_fragment("1.2.3.4", 1, 0, true), seconds(100));
+    Packet packet2(make_fragment("1.2.3.4", 1, 1, false), seconds(130));
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(packet1));
+    EXPECT_EQ(1U, reassembler.stream_count());
+    // The packet expires before the last fragment is processed
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(packet2));
+    EXPECT_EQ(1U, reassembler.stream_count());
+    EXPECT_EQ(1U, reassembler.eviction_count(IPv4Reassembler::TIMEOUT));
+
+    Packet packet3(make_fragment("1.2.3.4", 1, 0, true), seconds(159));
+    EXPECT_EQ(IPv4Reassembler::REASSEMBLED, reassembler.process(packet3));
+    EXPECT_EQ(16U, packet3.pdu()->rfind_pdu<RawPDU>().payload().size());
+    EXPECT_EQ(0U, reassembler.stream_count());
+}
+
+#endif // TINS_IS_CXX11
+
+TEST_F(IPv4ReassemblerTest, MaxStreams) {
+    IPv4Reassembler reassembler;
+    reassembler.max_streams(2);
+    IP first = make_fragment("1.2.3.4", 1, 0, true);
+    IP second = make_fragment("1.2.3.5", 2, 0, true);
+    IP third = make_fragment("1.2.3.6", 3, 0, true);
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(first));
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(second));
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(third));
+    // The oldest packet is evicted to make room for the new one
+    EXPECT_EQ(2U, reassembler.stream_count());
+    EXPECT_EQ(1U, reassembler.eviction_count(IPv4Reassembler::MAX_STREAMS));
+    IP last = make_fragment("1.2.3.5", 2, 1, false);
+    EXPECT_EQ(IPv4Reassembler::REASSEMBLED, reassembler.process(last));
+
+    // 0 removes the limit
+    reassembler.max_streams(0);
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(first));
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(second));
+    EXPECT_EQ(3U, reassembler.stream_count());
+    EXPECT_EQ(1U, reassembler.eviction_count(IPv4Reassembler::MAX_STREAMS));
+    // Lowering the limit evicts the oldest packets right away
+    reassembler.max_streams(1);
+    EXPECT_EQ(1U, reassembler.stream_count());
+    EXPECT_EQ(3U, reassembler.eviction_count(IPv4Reassembler::MAX_STREAMS));
+}
+
+TEST_F(IPv4ReassemblerTest, UnboundedByDefault) {
+    IPv4Reassembler reassembler;
+    timeval first_seen = { 100, 0 };
+    for (uint16_t id = 0; id < 2000; ++id) {
+        Packet packet(make_fragment("1.2.3.4", id, 0, true), first_seen);
+        EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(packet));
+    }
+    // Much later on, as if replayed from a capture
+    timeval last_seen = { 100000, 0 };
+    Packet packet(make_fragment("1.2.3.4", 0, 1, false), last_seen);
+    EXPECT_EQ(IPv4Reassembler::REASSEMBLED, reassembler.process(packet));
+    EXPECT_EQ(1999U, reassembler.stream_count());
+    EXPECT_EQ(0U, reassembler.eviction_count(IPv4Reassembler::TIMEOUT));
+    EXPECT_EQ(0U, reassembler.eviction_count(IPv4Reassembler::MAX_STREAMS));
+    EXPECT_EQ(0U, reassembler.eviction_count(IPv4Reassembler::SOURCE_QUOTA));
+}
+
+TEST_F(IPv4ReassemblerTest, MaxStreamsPerSource) {
+    IPv4Reassembler reassembler;
+    reassembler.max_streams_per_source(2);
+    for (uint16_t id = 0; id < 4; ++id) {
+        IP fragment = make_fragment("1.2.3.4", id, 0, true);
+        EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(fragment));
+    }
+    EXPECT_EQ(2U, reassembler.stream_count());
+    EXPECT_EQ(2U, reassembler.eviction_count(IPv4Reassembler::SOURCE_QUOTA));
+    // Other sources are unaffected
+    IP other = make_fragment("1.2.3.5", 0, 0, true);
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(other));
+    EXPECT_EQ(3U, reassembler.stream_count());
+    // Fragments for packets already being reassembled are still accepted
+    IP last = make_fragment("1.2.3.4", 1, 1, false);
+    EXPECT_EQ(IPv4Reassembler::REASSEMBLED, reassembler.process(last));
+    IP fragment = make_fragment("1.2.3.4", 2, 0, true);
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(fragment));
+    EXPECT_EQ(3U, reassembler.stream_count());
+    EXPECT_EQ(2U, reassembler.eviction_count(IPv4Reassembler::SOURCE_QUOTA));
+}
+
+class IPv6ReassemblerTest : public testing::Test {
+public:
+    typedef vector<IPv6> fragments_type;
+
+    static const uint32_t fragment_id;
+
+    static IPv6 make_packet(size_t payload_size);
+    static IPv6 make_fragment(const PDU::serialization_type& payload, size_t offset,
+                              size_t size, bool more_fragments, uint32_t id,
+                              bool add_hop_by_hop = false);
+    static fragments_type make_fragments(IPv6 packet, size_t fragment_size,
+                                         uint32_t id = fragment_id,
+                                         bool add_hop_by_hop = false);
+    static void check_reassembled(const IPv6& packet, size_t payload_size);
+};
+
+const uint32_t IPv6ReassemblerTest::fragment_id = 0x12345678;
+
+IPv6 IPv6ReassemblerTest::make_packet(size_t payload_size) {
+    RawPDU::payload_type payload(payload_size);
+    for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<uint8_t>(i);
+    }
+    return IPv6("::2", "::1") / UDP(53, 1024) / RawPDU(payload);
+}
+
+IPv6 IPv6ReassemblerTest::make_fragment(const PDU::serialization_type& payload,
+                                        size_t offset, size_t size, bool more_fragments,
+                                        uint32_t id, bool add_hop_by_hop) {
+    IPv6 fragment("::2", "::1");
+    fragment.next_header(Constants::IP::PROTO_UDP);
+    if (add_hop_by_hop) {
+        // A single PadN option
+        const uint8_t options[] = { 1, 4, 0, 0, 0, 0 };
+        fragment.add_header(IPv6::ext_header(IPv6::HOP_BY_HOP, options,
+                                             options + sizeof(options)));
+    }
+    const uint16_t offset_field = static_cast<uint16_t>((offset / 8) << 3) |
+                                  (more_fragments ? 1 : 0);
+    const uint8_t header_data[] = {
+        static_cast<uint8_t>(offset_field >> 8), static_cast<uint8_t>(offset_field),
+        static_cast<uint8_t>(id >> 24), static_cast<uint8_t>(id >> 16),
+        static_cast<uint8_t>(id >> 8), static_cast<uint8_t>(id)
+    };
+    fragment.add_header(IPv6::ext_header(IPv6::FRAGMENT, header_data,
+                                         header_data + sizeof(header_data)));
+    fragment /= RawPDU(&payload[offset], static_cast<uint32_t>(size));
+    // Parse it back so it looks like a captured packet
+    PDU::serialization_type buffer = fragment.serialize();
+    return IPv6(&buffer[0], static_cast<uint32_t>(buffer.size()));
+}
+
+IPv6ReassemblerTest::fragments_type IPv6ReassemblerTest::make_fragments(IPv6 packet,
+                                                                       size_t fragment_size,
+                                                                       uint32_t id,
+                                                                       bool add_hop_by_hop) {
+    const PDU::serialization_type payload = packet.inner_pdu()->serialize();
+    fragments_type fragments;
+    for (size_t offset = 0; offset < payload.size(); offset += fragment_size) {
+        const size_t size = std::min(fragment_size, payload.size() - offset);
+        const bool more_fragments = offset + size < payload.size();
+        fragments.push_back(make_fragment(payload, offset, size, more_fragments, id,
+                                          add_hop_by_hop));
+    }
+    return fragments;
+}
+
+void IPv6ReassemblerTest::check_reassembled(const IPv6& packet, size_t payload_size) {
+    EXPECT_TRUE(packet.search_header(IPv6::FRAGMENT) == NULL);
+    EXPECT_EQ(IPv6Address("::2"), packet.dst_addr());
+    EXPECT_EQ(IPv6Address("::1"), packet.src_addr());
+    const UDP* udp = packet.find_pdu<UDP>();
+    ASSERT_TRUE(udp != NULL);
+    EXPECT_EQ(53, udp->dport());
+    EXPECT_EQ(1024, udp->sport());
+    const RawPDU* raw = packet.find_pdu<RawPDU>();
+    ASSERT_TRUE(raw != NULL);
+    EXPECT_EQ(make_packet(payload_size).rfind_pdu<RawPDU>().payload(), raw->payload());
+}
+
+TEST_F(IPv6ReassemblerTest, Reassemble) {
+    const size_t orderings[][5] = {
+        { 0, 1, 2, 3, 4 },
+        { 4, 3, 2, 1, 0 },
+        { 2, 4, 0, 3, 1 }
+    };
+    for (size_t i = 0; i < 3; ++i) {
+        fragments_type fragments = make_fragments(make_packet(4000), 1000, fragment_id,
+                                                  i == 2);
+        ASSERT_EQ(5U, fragments.size());
+        IPv6Reassembler reassembler;
+        for (size_t j = 0; j < fragments.size(); ++j) {
+            IPv6& fragment = fragments[orderings[i][j]];
+            IPv6Reassembler::PacketStatus status = reassembler.process(fragment);
+            if (j + 1 < fragments.size()) {
+                EXPECT_EQ(IPv6Reassembler::FRAGMENTED, status);
+                EXPECT_EQ(1U, reassembler.stream_count());
+            }
+            else {
+                ASSERT_EQ(IPv6Reassembler::REASSEMBLED, status);
+                check_reassembled(fragment, 4000);
+                if (i == 2) {
+                    EXPECT_TRUE(fragment.search_header(IPv6::HOP_BY_HOP) != NULL);
+                }
+            }
+        }
+        EXPECT_EQ(0U, reassembler.stream_count());
+        EXPECT_EQ(0U, reassembler.buffered_bytes());
+    }
+}
+
+TEST_F(IPv6ReassemblerTest, NotFragmented) {
+    IPv6 packet = make_packet(100);
+    IPv6Reassembler reassembler;
+    EXPECT_EQ(IPv6Reassembler::NOT_FRAGMENTED, reassembler.process(packet));
+}
+
+TEST_F(IPv6ReassemblerTest, DuplicatesAreIgnored) {
+    fragments_type fragments = make_fragments(make_packet(2000), 1000);
+    ASSERT_EQ(3U, fragments.size());
+    IPv6Reassembler reassembler;
+    IPv6 duplicate = fragments[1];
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(fragments[1]));
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(fragments[0]));
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(duplicate));
+    EXPECT_EQ(IPv6Reassembler::REASSEMBLED, reassembler.process(fragments[2]));
+    check_reassembled(fragments[2], 2000);
+}
+
+TEST_F(IPv6ReassemblerTest, OverlapDiscardsPacket) {
+    IPv6 packet = make_packet(2000);
+    fragments_type fragments = make_fragments(packet, 1000);
+    const PDU::serialization_type payload = packet.inner_pdu()->serialize();
+    IPv6 overlapping = make_fragment(payload, 504, 504, true, fragment_id);
+    IPv6Reassembler reassembler;
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(fragments[0]));
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(overlapping));
+    EXPECT_EQ(0U, reassembler.stream_count());
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(fragments[1]));
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(fragments[2]));
+}
+
+TEST_F(IPv6ReassemblerTest, LastFragmentBeforeOtherFragments) {
+    IPv6 packet = make_packet(2000);
+    fragments_type fragments = make_fragments(packet, 1000);
+    const PDU::serialization_type payload = packet.inner_pdu()->serialize();
+    IPv6 last = make_fragment(payload, 8, 8, false, fragment_id);
+    IPv6Reassembler reassembler;
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(fragments[1]));
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(last));
+    EXPECT_EQ(0U, reassembler.stream_count());
+}
+
+TEST_F(IPv6ReassemblerTest, InOrderFragmentsShareOneBuffer) {
+    fragments_type fragments = make_fragments(make_packet(3992), 1000);
+    ASSERT_EQ(4U, fragments.size());
+    IPv6Reassembler reassembler;
+    size_t previous_size = 0;
+    for (size_t i = 0; i < 3; ++i) {
+        EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(fragments[i]));
+        // The buffer grows up to the end of the last fragment, but it's
+        // never more than twice as large
+        EXPECT_LT(previous_size, reassembler.buffered_bytes());
+        EXPECT_GE(2 * (40U + (i + 1) * 1000U), reassembler.buffered_bytes());
+        previous_size = reassembler.buffered_bytes();
+    }
+    EXPECT_EQ(IPv6Reassembler::REASSEMBLED, reassembler.process(fragments[3]));
+    check_reassembled(fragments[3], 3992);
+}
+
+TEST_F(IPv6ReassemblerTest, InvalidFragmentSize) {
+    IPv6 packet = make_packet(2000);
+    const PDU::serialization_type payload = packet.inner_pdu()->serialize();
+    IPv6 fragment = make_fragment(payload, 0, 1001, true, fragment_id);
+    IPv6Reassembler reassembler;
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(fragment));
+    EXPECT_EQ(0U, reassembler.stream_count());
+}
+
+TEST_F(IPv6ReassemblerTest, AtomicFragment) {
+    fragments_type fragments = make_fragments(make_packet(2000), 1000);
+    fragments_type atomic = make_fragments(make_packet(200), 1000);
+    ASSERT_EQ(1U, atomic.size());
+    IPv6Reassembler reassembler;
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(fragments[0]));
+    // Atomic fragments don't interfere with packets using the same identifier
+    EXPECT_EQ(IPv6Reassembler::REASSEMBLED, reassembler.process(atomic[0]));
+    check_reassembled(atomic[0], 200);
+    EXPECT_EQ(1U, reassembler.stream_count());
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(fragments[1]));
+    EXPECT_EQ(IPv6Reassembler::REASSEMBLED, reassembler.process(fragments[2]));
+    check_reassembled(fragments[2], 2000);
+}
+
+#if TINS_IS_CXX11
+
+TEST_F(IPv6ReassemblerTest, Timeout) {
+    using std::chrono::seconds;
+    fragments_type fragments = make_fragments(make_packet(2000), 1000);
+    IPv6Reassembler reassembler;
+    reassembler.timeout(seconds(30));
+    Packet packet1(fragments[0], seconds(100));
+    Packet packet2(fragments[1], seconds(129));
+    Packet packet3(fragments[2], seconds(130));
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(packet1));
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(packet2));
+    EXPECT_EQ(1U, reassembler.stream_count());
+    // The packet expires before the last fragment is processed
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(packet3));
+    EXPECT_EQ(1U, reassembler.stream_count());
+    EXPECT_GT(3000U, reassembler.buffered_bytes());
+}
+
+#endif // TINS_IS_CXX11
+
+TEST_F(IPv6ReassemblerTest, TimeoutInSeconds) {
+    fragments_type fragments = make_fragments(make_packet(2000), 1000);
+    IPv6Reassembler reassembler;
+    reassembler.timeout(30);
+    timeval first_seen = { 100, 0 };
+    timeval last_seen = { 130, 0 };
+    Packet packet1(fragments[0], first_seen);
+    Packet packet2(fragments[1], last_seen);
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(packet1));
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(packet2));
+    // Only the second fragment is left
+    EXPECT_EQ(1U, reassembler.stream_count());
+    EXPECT_GT(3000U, reassembler.buffered_bytes());
+}
+
+TEST_F(IPv6ReassemblerTest, TimeoutDisabled) {
+    fragments_type fragments = make_fragments(make_packet(2000), 1000);
+    IPv6Reassembler reassembler;
+    reassembler.timeout(0);
+    timeval first_seen = { 100, 0 };
+    timeval last_seen = { 100000, 0 };
+    Packet packet1(fragments[0], first_seen);
+    Packet packet2(fragments[1], first_seen);
+    Packet packet3(fragments[2], last_seen);
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(packet1));
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(packet2));
+    EXPECT_EQ(IPv6Reassembler::REASSEMBLED, reassembler.process(packet3));
+    check_reassembled(*packet3.pdu()->find_pdu<IPv6>(), 2000);
+}
+
+TEST_F(IPv6ReassemblerTest, BufferAllocatedOnceSizeIsKnown) {
+    fragments_type fragments = make_fragments(make_packet(2000), 1000);
+    IPv6Reassembler reassembler;
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(fragments[0]));
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(fragments[2]));
+    // The IPv6 header, the UDP header and the payload
+    EXPECT_EQ(40U + 8U + 2000U, reassembler.buffered_bytes());
+    EXPECT_EQ(IPv6Reassembler::REASSEMBLED, reassembler.process(fragments[1]));
+    check_reassembled(fragments[1], 2000);
+    EXPECT_EQ(0U, reassembler.buffered_bytes());
+}
+
+TEST_F(IPv6ReassemblerTest, MaxBufferedBytes) {
+    // Including the UDP header, these are 3 fragments of 1000 bytes
+    fragments_type first = make_fragments(make_packet(2992), 1000, 1);
+    fragments_type second = make_fragments(make_packet(2992), 1000, 2);
+    IPv6Reassembler reassembler;
+    reassembler.max_buffered_bytes(5000);
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(first[2]));
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(second[2]));
+    // Both need more than 3000 bytes so the oldest one is evicted
+    EXPECT_EQ(1U, reassembler.stream_count());
+    EXPECT_GE(5000U, reassembler.buffered_bytes());
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(second[0]));
+    EXPECT_EQ(IPv6Reassembler::REASSEMBLED, reassembler.process(second[1]));
+    check_reassembled(second[1], 2992);
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(first[0]));
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(first[1]));
+}
+
+TEST_F(IPv6ReassemblerTest, Proxy) {
+    fragments_type fragments = make_fragments(make_packet(2000), 1000);
+    size_t forwarded = 0;
+    IPv6ReassemblerProxy<std::function<bool(PDU&)> > proxy = 
+        make_ipv6_reassembler_proxy(std::function<bool(PDU&)>([&](PDU& pdu) {
+            forwarded++;
+            EXPECT_TRUE(pdu.find_pdu<UDP>() != NULL);
+            return true;
+        }));
+    for (size_t i = 0; i < fragments.size(); ++i) {
+        EXPECT_TRUE(proxy(fragments[i]));
+    }
+    EXPECT_EQ(1U, forwarded);
+}
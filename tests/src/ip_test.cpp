@@ -883,3 +883,31 @@ TEST_F(IPTest, ParseSerializeOptions) {
     const vector<uint8_t> buffer(options_packet, options_packet + sizeof(options_packet));
     EXPECT_EQ(buffer, serialized);
 }
+
+TEST_F(IPTest, OptionsBeforeParsing) {
+    const size_t ip_offset = 14;
+    const IP ip(options_packet + ip_offset, sizeof(options_packet) - ip_offset);
+    EXPECT_EQ(32U, ip.header_size());
+    EXPECT_EQ(0x0010, ip.security().security);
+    EXPECT_THROW(ip.lsrr(), option_not_found);
+    EXPECT_THROW(ip.stream_identifier(), option_not_found);
+    EXPECT_EQ(1U, ip.options().size());
+    EXPECT_EQ(32U, ip.header_size());
+}
+
+TEST_F(IPTest, ModifyOptionsBeforeParsing) {
+    const size_t ip_offset = 14;
+    const IP ip1(options_packet + ip_offset, sizeof(options_packet) - ip_offset);
+    IP ip2(ip1);
+    ip2.stream_identifier(0x91fa);
+    EXPECT_EQ(1U, ip1.options().size());
+    EXPECT_EQ(2U, ip2.options().size());
+    EXPECT_THROW(ip1.stream_identifier(), option_not_found);
+
+    PDU::serialization_type buffer = ip2.serialize();
+    IP ip3(&buffer[0], (uint32_t)buffer.size());
+    EXPECT_EQ(0x91fa, ip3.stream_identifier());
+    EXPECT_EQ(0x0010, ip3.security().security);
+    EXPECT_TRUE(ip3.remove_option(130));
+    EXPECT_THROW(ip3.security(), option_not_found);
+}
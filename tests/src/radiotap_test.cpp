@@ -672,6 +672,103 @@ TEST_F(RadioTapTest, RadioTapParsingMultipleNamespaces) {
     EXPECT_FALSE(parser.has_fields());
 }
 
+TEST_F(RadioTapTest, RadioTapParsingSkipToFieldMatchesWalk) {
+    const uint8_t* packets[] = {
+        expected_packet, expected_packet1, expected_packet2, expected_packet3,
+        expected_packet4, expected_packet5, expected_packet6, expected_packet7
+    };
+    for (size_t i = 0; i < sizeof(packets) / sizeof(packets[0]); ++i) {
+        const uint8_t* packet = packets[i];
+        const uint32_t length = packet[2] | (packet[3] << 8);
+        vector<uint8_t> buffer(packet + 4, packet + length);
+        for (uint32_t bit = 0; bit < 32; ++bit) {
+            const RadioTap::PresentFlags flag = static_cast<RadioTap::PresentFlags>(1U << bit);
+            RadioTapParser walker(buffer);
+            while (walker.has_fields() && walker.current_field() != flag) {
+                walker.advance_field();
+            }
+            RadioTapParser parser(buffer);
+            EXPECT_EQ(walker.has_fields(), parser.skip_to_field(flag));
+            if (walker.has_fields()) {
+                EXPECT_EQ(walker.current_option_ptr(), parser.current_option_ptr());
+                EXPECT_EQ(walker.current_namespace_index(),
+                          parser.current_namespace_index());
+            }
+        }
+    }
+}
+
+TEST_F(RadioTapTest, RadioTapParsingSkipToFieldSequentially) {
+    vector<uint8_t> buffer(expected_packet + 4, expected_packet + 32);
+    RadioTapParser parser(&buffer[0], buffer.size());
+    EXPECT_TRUE(parser.skip_to_field(RadioTap::RATE));
+    EXPECT_EQ(12, parser.current_option().to<uint8_t>());
+    EXPECT_TRUE(parser.skip_to_field(RadioTap::ANTENNA));
+    EXPECT_EQ(2, parser.current_option().to<uint8_t>());
+    EXPECT_TRUE(parser.advance_field());
+    EXPECT_EQ(RadioTap::XCHANNEL, parser.current_field());
+    // Fields behind the current one can't be found
+    EXPECT_FALSE(parser.skip_to_field(RadioTap::TSFT));
+    EXPECT_FALSE(parser.has_fields());
+}
+
+TEST_F(RadioTapTest, RadioTapParsingSkipToFieldTruncated) {
+    // Cut the buffer right before the XCHANNEL field
+    vector<uint8_t> buffer(expected_packet + 4, expected_packet + 24);
+    RadioTapParser parser(buffer);
+    EXPECT_TRUE(parser.skip_to_field(RadioTap::ANTENNA));
+    EXPECT_FALSE(parser.skip_to_field(RadioTap::XCHANNEL));
+    EXPECT_FALSE(parser.has_fields());
+    EXPECT_THROW(parser.current_option(), malformed_packet);
+}
+
+TEST_F(RadioTapTest, RadioTapParsingSkipToFieldPartiallyTruncated) {
+    // Cut the buffer in the middle of the XCHANNEL field
+    vector<uint8_t> buffer(expected_packet + 4, expected_packet + 28);
+    RadioTapParser parser(&buffer[0], buffer.size());
+    EXPECT_TRUE(parser.skip_to_field(RadioTap::XCHANNEL));
+    EXPECT_THROW(parser.current_option(), malformed_packet);
+}
+
+TEST_F(RadioTapTest, RadioTapParsingSkipToFieldBehindCurrent) {
+    vector<uint8_t> buffer(expected_packet + 4, expected_packet + 32);
+    RadioTapParser parser(&buffer[0], buffer.size());
+    EXPECT_TRUE(parser.skip_to_field(RadioTap::DBM_NOISE));
+    EXPECT_EQ(-96, parser.current_option().to<int8_t>());
+    // Skipping to the current field doesn't move the parser
+    EXPECT_TRUE(parser.skip_to_field(RadioTap::DBM_NOISE));
+    EXPECT_EQ(-96, parser.current_option().to<int8_t>());
+    EXPECT_FALSE(parser.skip_to_field(RadioTap::RATE));
+    EXPECT_FALSE(parser.has_fields());
+}
+
+TEST_F(RadioTapTest, RadioTapParsingSkipToAbsentField) {
+    // No extended bitmask, so the layout is enough to tell
+    vector<uint8_t> buffer(expected_packet + 4, expected_packet + 32);
+    RadioTapParser parser(&buffer[0], buffer.size());
+    EXPECT_FALSE(parser.skip_to_field(RadioTap::CHANNEL));
+    EXPECT_FALSE(parser.has_fields());
+
+    // With an extended bitmask, the other namespaces are looked at too
+    const uint32_t length = expected_packet4[2] | (expected_packet4[3] << 8);
+    vector<uint8_t> extended(expected_packet4 + 4, expected_packet4 + length);
+    RadioTapParser extended_parser(&extended[0], extended.size());
+    EXPECT_FALSE(extended_parser.skip_to_field(RadioTap::RATE));
+    EXPECT_FALSE(extended_parser.has_fields());
+}
+
+TEST_F(RadioTapTest, RadioTapParsingSkipToFieldInSecondNamespace) {
+    const uint32_t length = expected_packet4[2] | (expected_packet4[3] << 8);
+    vector<uint8_t> buffer(expected_packet4 + 4, expected_packet4 + length);
+    RadioTapParser parser(&buffer[0], buffer.size());
+    // ANTENNA is only present in the second namespace
+    EXPECT_TRUE(parser.skip_to_field(RadioTap::ANTENNA));
+    EXPECT_EQ(1U, parser.current_namespace_index());
+    EXPECT_EQ(RadioTap::ANTENNA, parser.current_field());
+    EXPECT_EQ(0, parser.current_option().to<uint8_t>());
+    EXPECT_FALSE(parser.advance_field());
+}
+
 TEST_F(RadioTapTest, RadioTapParsingUsingEmptyBuffer) {
     vector<uint8_t> buffer;
     RadioTapParser parser(buffer);
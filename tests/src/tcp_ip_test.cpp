@@ -9,14 +9,24 @@
 #include <limits>
 #include <cassert>
 #include <tins/tcp_ip/stream_follower.h>
+#include <tins/tcp_ip/flow_table.h>
+#include <tins/tcp_ip/udp_flow_tracker.h>
+#include <tins/tcp_ip/segment_info.h>
+#include <tins/tcp_ip/http_framer.h>
+#include <tins/tcp_ip/tls_record_framer.h>
+#include <tins/ipv6.h>
 #include <tins/tcp.h>
+#include <tins/udp.h>
 #include <tins/ip.h>
 #include <tins/ip_address.h>
 #include <tins/ipv6_address.h>
 #include <tins/exceptions.h>
 #include <tins/ethernetII.h>
 #include <tins/rawpdu.h>
+#include <tins/dns.h>
+#include <tins/pdu_allocator.h>
 #include <tins/packet.h>
+#include <tins/memory_helpers.h>
 #include <tins/config.h>
 #ifdef TINS_HAVE_ACK_TRACKER
     #include <tins/tcp_ip/ack_tracker.h>
@@ -300,6 +310,28 @@ TEST_F(FlowTest, IgnoreDataPackets) {
     EXPECT_TRUE(flow_payload_chunks.empty());
 }
 
+TEST_F(FlowTest, FollowPayloadDecodedByPortAllocator) {
+    using std::placeholders::_1;
+
+    Allocators::register_allocator<TCP, DNS>(5353);
+    DNS dns;
+    dns.id(0x1234);
+    dns.add_query(DNS::query("www.example.com", DNS::A, DNS::INTERNET));
+    const PDU::serialization_type dns_buffer = dns.serialize();
+    TCP tcp(5353, 40000);
+    tcp.seq(1000);
+    EthernetII eth = EthernetII() / IP("1.2.3.4", "4.3.2.1") / tcp / dns;
+    const PDU::serialization_type buffer = eth.serialize();
+    EthernetII packet(&buffer[0], static_cast<uint32_t>(buffer.size()));
+    ASSERT_TRUE(packet.find_pdu<DNS>() != 0);
+
+    Flow flow(IPv4Address("1.2.3.4"), 5353, 1000);
+    flow.data_callback(bind(&FlowTest::cumulative_flow_data_handler, this, _1));
+    flow.process_packet(packet);
+    ASSERT_EQ(1U, flow_payload_chunks.size());
+    EXPECT_EQ(dns_buffer, flow_payload_chunks[0]);
+}
+
 TEST_F(FlowTest, OutOfOrderCallback) {
     using namespace std::placeholders;
 
@@ -514,6 +546,379 @@ TEST_F(FlowTest, StreamFollower_FollowStream) {
     EXPECT_EQ(payload, merge_chunks(stream_client_payload_chunks));
 }
 
+TEST_F(FlowTest, StreamFollower_SpillPayloads) {
+    vector<EthernetII> packets = three_way_handshake(29, 60, "1.2.3.4", 22, "4.3.2.1", 25);
+    ordering_info_type chunks = split_payload(payload, 5);
+    vector<EthernetII> chunk_packets = chunks_to_packets(30 /*initial_seq*/, chunks, payload);
+    set_endpoints(chunk_packets, "1.2.3.4", 22, "4.3.2.1", 25);
+    packets.insert(packets.end(), chunk_packets.begin(), chunk_packets.end());
+    StreamFollower follower;
+    size_t max_resident_size = 0;
+    follower.new_stream_callback([&](Stream& stream) {
+        stream.auto_cleanup_payloads(false);
+        stream.spill_payloads(100);
+        stream.client_data_callback([&](Stream& stream) {
+            max_resident_size = max(max_resident_size, stream.client_payload().size());
+        });
+    });
+    for (size_t i = 0; i < packets.size(); ++i) {
+        follower.process_packet(packets[i]);
+    }
+    Stream& stream = follower.find_stream(IPv4Address("1.2.3.4"), 22,
+                                          IPv4Address("4.3.2.1"), 25);
+    EXPECT_GE(100U, max_resident_size);
+    EXPECT_GT(100U, stream.client_payload().size());
+    EXPECT_EQ(payload.size(), stream.client_spilled_payload().size() +
+                              stream.client_payload().size());
+
+    // Read it back using small buffers so reads span the spill/memory boundary
+    PayloadReader reader = stream.client_payload_reader();
+    EXPECT_EQ(payload.size(), reader.size());
+    string output;
+    uint8_t buffer[7];
+    while (size_t size = reader.read(buffer, sizeof(buffer))) {
+        output.append(buffer, buffer + size);
+    }
+    EXPECT_TRUE(reader.eof());
+    EXPECT_EQ(payload, output);
+
+    stream.client_spilled_payload().clear();
+    EXPECT_TRUE(stream.client_spilled_payload().empty());
+}
+
+TEST_F(FlowTest, StreamFollower_CheckpointSpilledStream) {
+    vector<EthernetII> packets = three_way_handshake(29, 60, "1.2.3.4", 22, "4.3.2.1", 25);
+    ordering_info_type chunks = split_payload(payload, 5);
+    vector<EthernetII> chunk_packets = chunks_to_packets(30 /*initial_seq*/, chunks, payload);
+    set_endpoints(chunk_packets, "1.2.3.4", 22, "4.3.2.1", 25);
+    packets.insert(packets.end(), chunk_packets.begin(), chunk_packets.end());
+    StreamFollower follower;
+    follower.new_stream_callback([&](Stream& stream) {
+        stream.auto_cleanup_payloads(false);
+        stream.spill_payloads(100);
+    });
+    for (size_t i = 0; i < packets.size(); ++i) {
+        follower.process_packet(packets[i]);
+    }
+    Stream& stream = follower.find_stream(IPv4Address("1.2.3.4"), 22,
+                                          IPv4Address("4.3.2.1"), 25);
+    ASSERT_FALSE(stream.client_spilled_payload().empty());
+    EXPECT_THROW(follower.checkpoint(), unserializable_stream);
+
+    // Once the spilled data is discarded, the stream can be checkpointed again
+    stream.client_spilled_payload().clear();
+    EXPECT_FALSE(follower.checkpoint().empty());
+}
+
+TEST_F(FlowTest, PayloadSpillCopiesShareSize) {
+    const uint8_t data[] = { 1, 2, 3, 4 };
+    PayloadSpill spill;
+    spill.append(data, 2);
+    PayloadSpill copy = spill;
+    copy.append(data + 2, 2);
+    EXPECT_EQ(4U, spill.size());
+    EXPECT_EQ(4U, copy.size());
+    uint8_t buffer[4];
+    EXPECT_EQ(4U, spill.read(0, buffer, sizeof(buffer)));
+    EXPECT_EQ(0, memcmp(data, buffer, sizeof(data)));
+}
+
+TEST_F(FlowTest, StreamFollower_FollowStreamUsingSegments) {
+    using std::placeholders::_1;
+
+    vector<EthernetII> packets = three_way_handshake(29, 60, "1.2.3.4", 22, "4.3.2.1", 25);
+    packets[0].src_addr("00:01:02:03:04:05");
+    packets[0].dst_addr("05:04:03:02:01:00");
+    packets[1].rfind_pdu<TCP>().mss(1460);
+    packets[1].rfind_pdu<TCP>().sack_permitted();
+    ordering_info_type chunks = split_payload(payload, 5);
+    swap(chunks[1], chunks[2]);
+    vector<EthernetII> chunk_packets = chunks_to_packets(30 /*initial_seq*/, chunks, payload);
+    set_endpoints(chunk_packets, "1.2.3.4", 22, "4.3.2.1", 25);
+    packets.insert(packets.end(), chunk_packets.begin(), chunk_packets.end());
+    StreamFollower follower;
+    follower.new_stream_callback(bind(&FlowTest::on_new_stream, this, _1));
+    for (size_t i = 0; i < packets.size(); ++i) {
+        PDU::serialization_type buffer = packets[i].serialize();
+        SegmentInfo segment;
+        ASSERT_TRUE(segment.scan_ethernet(&buffer[0], buffer.size()));
+        follower.process_segment(segment, Stream::timestamp_type(i));
+    }
+    EXPECT_EQ(payload, merge_chunks(stream_client_payload_chunks));
+
+    Stream& stream = follower.find_stream(IPv4Address("1.2.3.4"), 22,
+                                          IPv4Address("4.3.2.1"), 25);
+    EXPECT_FALSE(stream.is_partial_stream());
+    EXPECT_EQ(Flow::ESTABLISHED, stream.client_flow().state());
+    EXPECT_EQ(1460, stream.server_flow().mss());
+    EXPECT_TRUE(stream.server_flow().sack_permitted());
+    EXPECT_EQ(HWAddress<6>("00:01:02:03:04:05"), stream.client_hw_addr());
+    EXPECT_EQ(HWAddress<6>("05:04:03:02:01:00"), stream.server_hw_addr());
+    EXPECT_EQ(IPv4Address("1.2.3.4"), stream.client_addr_v4());
+    EXPECT_EQ(IPv4Address("4.3.2.1"), stream.server_addr_v4());
+    EXPECT_EQ(Stream::timestamp_type(packets.size() - 1), stream.last_seen());
+}
+
+TEST_F(FlowTest, StreamFollower_PayloadConsumer) {
+    const string http_payload = 
+        "GET /index.html HTTP/1.1\r\nHost: example.com\r\n"
+        "Content-Length: 11\r\n\r\nhello world"
+        "POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "5\r\nabcde\r\n3\r\nfgh\r\n0\r\n\r\n";
+    vector<EthernetII> packets = three_way_handshake(29, 60, "1.2.3.4", 22, "4.3.2.1", 25);
+    ordering_info_type chunks = split_payload(http_payload, 3);
+    vector<EthernetII> chunk_packets = chunks_to_packets(30 /*initial_seq*/, chunks,
+                                                         http_payload);
+    set_endpoints(chunk_packets, "1.2.3.4", 22, "4.3.2.1", 25);
+    packets.insert(packets.end(), chunk_packets.begin(), chunk_packets.end());
+
+    vector<string> headers;
+    string body;
+    size_t messages = 0;
+    size_t max_resident_size = 0;
+    HTTPFramer framer(HTTPFramer::REQUEST);
+    framer.headers_callback([&](const uint8_t* data, size_t size) {
+        headers.push_back(string(data, data + size));
+    });
+    framer.body_callback([&](const uint8_t* data, size_t size) {
+        body.append(data, data + size);
+    });
+    framer.message_end_callback([&]() {
+        messages++;
+    });
+    StreamFollower follower;
+    follower.new_stream_callback([&](Stream& stream) {
+        stream.client_payload_consumer(framer);
+        stream.client_data_callback([&](Stream& stream) {
+            max_resident_size = max(max_resident_size, stream.client_payload().size());
+        });
+    });
+    for (size_t i = 0; i < packets.size(); ++i) {
+        follower.process_packet(packets[i]);
+    }
+    ASSERT_EQ(2U, headers.size());
+    EXPECT_EQ("GET /index.html HTTP/1.1\r\nHost: example.com\r\n"
+              "Content-Length: 11\r\n\r\n", headers[0]);
+    EXPECT_EQ("POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n", headers[1]);
+    EXPECT_EQ("hello worldabcdefgh", body);
+    EXPECT_EQ(2U, messages);
+    // Only partial header blocks should ever be kept around
+    EXPECT_GT(80U, max_resident_size);
+
+    Stream& stream = follower.find_stream(IPv4Address("1.2.3.4"), 22,
+                                          IPv4Address("4.3.2.1"), 25);
+    EXPECT_TRUE(stream.client_payload().empty());
+}
+
+class FramerTest : public testing::Test {
+public:
+    template <typename Framer>
+    static string feed(Framer& framer, const string& data, size_t chunk_size);
+};
+
+// Feeds data using chunks of the given size, the same way a Stream would
+template <typename Framer>
+string FramerTest::feed(Framer& framer, const string& data, size_t chunk_size) {
+    string pending;
+    for (size_t i = 0; i < data.size(); i += chunk_size) {
+        pending += data.substr(i, chunk_size);
+        const uint8_t* ptr = reinterpret_cast<const uint8_t*>(pending.data());
+        size_t consumed = framer(ptr, pending.size());
+        pending.erase(0, consumed);
+    }
+    return pending;
+}
+
+TEST_F(FramerTest, HTTPResponses) {
+    const string data = 
+        "HTTP/1.1 100 Continue\r\n\r\n"
+        "HTTP/1.1 200 OK\r\ncontent-length: 4\r\n\r\nabcd"
+        "HTTP/1.1 304 Not Modified\r\nContent-Length: 100\r\n\r\n"
+        "HTTP/1.1 200 OK\r\nTransfer-Encoding: gzip, chunked\r\n\r\n"
+        "a;ext=1\r\n0123456789\r\n0\r\nTrailer: value\r\n\r\n"
+        "HTTP/1.0 200 OK\r\n\r\nuntil close";
+    for (size_t chunk_size = 1; chunk_size < 20; ++chunk_size) {
+        vector<string> bodies(1);
+        size_t messages = 0;
+        HTTPFramer framer(HTTPFramer::RESPONSE);
+        framer.body_callback([&](const uint8_t* data, size_t size) {
+            bodies.back().append(data, data + size);
+        });
+        framer.message_end_callback([&]() {
+            messages++;
+            bodies.push_back(string());
+        });
+        EXPECT_EQ("", feed(framer, data, chunk_size));
+        EXPECT_FALSE(framer.has_error());
+        EXPECT_EQ(4U, messages);
+        ASSERT_EQ(5U, bodies.size());
+        EXPECT_EQ("", bodies[0]);
+        EXPECT_EQ("abcd", bodies[1]);
+        EXPECT_EQ("", bodies[2]);
+        EXPECT_EQ("0123456789", bodies[3]);
+        EXPECT_EQ("until close", bodies[4]);
+    }
+}
+
+TEST_F(FramerTest, HTTPInvalidData) {
+    HTTPFramer framer(HTTPFramer::REQUEST);
+    feed(framer, "GET / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nxyz\r\n", 4);
+    EXPECT_TRUE(framer.has_error());
+
+    HTTPFramer small_framer(HTTPFramer::REQUEST);
+    small_framer.max_headers_size(16);
+    feed(small_framer, "GET / HTTP/1.1\r\nHost: example.com\r\n\r\n", 4);
+    EXPECT_TRUE(small_framer.has_error());
+
+    // 2^64 + 5 would wrap around to 5
+    vector<string> bodies;
+    HTTPFramer overflow_framer(HTTPFramer::REQUEST);
+    overflow_framer.body_callback([&](const uint8_t* data, size_t size) {
+        bodies.push_back(string(data, data + size));
+    });
+    feed(overflow_framer, "POST / HTTP/1.1\r\nContent-Length: 18446744073709551621\r\n"
+                          "\r\nhello", 4);
+    EXPECT_TRUE(overflow_framer.has_error());
+    EXPECT_TRUE(bodies.empty());
+
+    HTTPFramer max_framer(HTTPFramer::REQUEST);
+    feed(max_framer, "POST / HTTP/1.1\r\nContent-Length: 18446744073709551615\r\n"
+                     "\r\nhello", 4);
+    EXPECT_FALSE(max_framer.has_error());
+}
+
+TEST_F(FramerTest, TLSRecords) {
+    const uint8_t raw_data[] = {
+        22, 3, 1, 0, 4, 1, 2, 3, 4,
+        20, 3, 3, 0, 1, 1,
+        23, 3, 3, 0, 0,
+        23, 3, 3, 0, 3, 9, 8
+    };
+    const string data(raw_data, raw_data + sizeof(raw_data));
+    for (size_t chunk_size = 1; chunk_size < 10; ++chunk_size) {
+        vector<pair<uint8_t, string> > records;
+        TLSRecordFramer framer;
+        framer.record_callback([&](uint8_t type, uint16_t version,
+                                   const uint8_t* data, size_t size) {
+            EXPECT_EQ(3, version >> 8);
+            records.push_back(make_pair(type, string(data, data + size)));
+        });
+        // The last record is incomplete, so its header and payload are pending
+        EXPECT_EQ(7U, feed(framer, data, chunk_size).size());
+        EXPECT_FALSE(framer.has_error());
+        ASSERT_EQ(3U, records.size());
+        EXPECT_EQ(TLSRecordFramer::HANDSHAKE, records[0].first);
+        EXPECT_EQ("\x01\x02\x03\x04", records[0].second);
+        EXPECT_EQ(TLSRecordFramer::CHANGE_CIPHER_SPEC, records[1].first);
+        EXPECT_EQ(TLSRecordFramer::APPLICATION_DATA, records[2].first);
+        EXPECT_EQ("", records[2].second);
+    }
+
+    TLSRecordFramer framer;
+    feed(framer, "GET / HTTP/1.1\r\n\r\n", 5);
+    EXPECT_TRUE(framer.has_error());
+}
+
+TEST_F(FlowTest, StreamFollower_CheckpointAndRestore) {
+    using std::placeholders::_1;
+
+    vector<EthernetII> packets = three_way_handshake(29, 60, "1.2.3.4", 22, "4.3.2.1", 25);
+    ordering_info_type chunks = split_payload(payload, 5);
+    swap(chunks[1], chunks[2]);
+    vector<EthernetII> chunk_packets = chunks_to_packets(30 /*initial_seq*/, chunks, payload);
+    set_endpoints(chunk_packets, "1.2.3.4", 22, "4.3.2.1", 25);
+    packets.insert(packets.end(), chunk_packets.begin(), chunk_packets.end());
+    StreamFollower follower;
+    follower.new_stream_callback([&](Stream& stream) {
+        on_new_stream(stream);
+        stream.enable_ack_tracking();
+    });
+    // Handshake, first chunk and the out of order third one
+    const size_t checkpoint_index = 5;
+    for (size_t i = 0; i < checkpoint_index; ++i) {
+        Packet packet(packets[i], Stream::timestamp_type(i));
+        follower.process_packet(packet);
+    }
+    vector<uint8_t> checkpoint = follower.checkpoint();
+
+    StreamFollower restored;
+    EXPECT_THROW(restored.restore(&checkpoint[0], checkpoint.size()), callback_not_set);
+    size_t restored_streams = 0;
+    restored.new_stream_callback([&](Stream& stream) {
+        on_new_stream(stream);
+        restored_streams++;
+    });
+    restored.restore(&checkpoint[0], checkpoint.size());
+    EXPECT_EQ(1U, restored_streams);
+    EXPECT_EQ(checkpoint, restored.checkpoint());
+
+    Stream& stream = restored.find_stream(IPv4Address("1.2.3.4"), 22,
+                                          IPv4Address("4.3.2.1"), 25);
+    EXPECT_FALSE(stream.is_partial_stream());
+    EXPECT_EQ(Flow::ESTABLISHED, stream.client_flow().state());
+    EXPECT_EQ(1U, stream.client_flow().buffered_payload().size());
+    EXPECT_TRUE(stream.client_flow().ack_tracking_enabled());
+    EXPECT_EQ(Stream::timestamp_type(checkpoint_index - 1), stream.last_seen());
+
+    for (size_t i = checkpoint_index; i < packets.size(); ++i) {
+        Packet packet(packets[i], Stream::timestamp_type(i));
+        restored.process_packet(packet);
+    }
+    EXPECT_EQ(payload, merge_chunks(stream_client_payload_chunks));
+
+    checkpoint.pop_back();
+    EXPECT_THROW(restored.restore(&checkpoint[0], checkpoint.size()), invalid_checkpoint);
+}
+
+TEST_F(FlowTest, RestoreFlowWithInvalidState) {
+    Flow flow(IPv4Address("1.2.3.4"), 22, 1000);
+    vector<uint8_t> buffer(flow.serialized_size());
+    Memory::OutputMemoryStream output(&buffer[0], buffer.size());
+    flow.serialize(output);
+    // The state is followed by the MSS and the flags
+    buffer[buffer.size() - 6] = Flow::RST_SENT + 1;
+    Memory::InputMemoryStream input(&buffer[0], buffer.size());
+    EXPECT_THROW(Flow restored(input), malformed_packet);
+}
+
+TEST_F(FlowTest, SegmentInfo_ScanIPv6) {
+    IPv6 packet = IPv6("::1", "::2") / TCP(80, 1234) / RawPDU("hello");
+    packet.rfind_pdu<TCP>().seq(1000);
+    packet.rfind_pdu<TCP>().ack_seq(2000);
+    packet.rfind_pdu<TCP>().flags(TCP::PSH | TCP::ACK);
+    packet.rfind_pdu<TCP>().sack({ 10, 20 });
+    PDU::serialization_type buffer = packet.serialize();
+    SegmentInfo segment;
+    ASSERT_TRUE(segment.scan_ip(&buffer[0], buffer.size()));
+    EXPECT_TRUE(segment.is_v6);
+    EXPECT_TRUE(StreamIdentifier::serialize(IPv6Address("::2")) == segment.src_addr);
+    EXPECT_TRUE(StreamIdentifier::serialize(IPv6Address("::1")) == segment.dst_addr);
+    EXPECT_EQ(1234, segment.sport);
+    EXPECT_EQ(80, segment.dport);
+    EXPECT_EQ(1000U, segment.seq);
+    EXPECT_EQ(2000U, segment.ack_seq);
+    EXPECT_TRUE(segment.has_flags(TCP::PSH | TCP::ACK));
+    EXPECT_FALSE(segment.has_flags(TCP::SYN));
+    EXPECT_EQ(8U, segment.sack_size);
+    EXPECT_EQ(-1, segment.mss);
+    EXPECT_EQ("hello", string(segment.payload, segment.payload + segment.payload_size));
+}
+
+TEST_F(FlowTest, SegmentInfo_RejectsNonTCP) {
+    SegmentInfo segment;
+    PDU::serialization_type buffer = (IP("1.2.3.4", "4.3.2.1") / UDP(1, 2)).serialize();
+    EXPECT_FALSE(segment.scan_ip(&buffer[0], buffer.size()));
+
+    IP fragment = IP("1.2.3.4", "4.3.2.1") / TCP(1, 2);
+    fragment.flags(IP::MORE_FRAGMENTS);
+    buffer = fragment.serialize();
+    EXPECT_FALSE(segment.scan_ip(&buffer[0], buffer.size()));
+
+    buffer = (IP("1.2.3.4", "4.3.2.1") / TCP(1, 2)).serialize();
+    EXPECT_FALSE(segment.scan_ip(&buffer[0], 30));
+    EXPECT_TRUE(segment.scan_ip(&buffer[0], buffer.size()));
+}
+
 TEST_F(FlowTest, StreamFollower_AttachToStreams) {
     using std::placeholders::_1;
 
@@ -835,6 +1240,141 @@ TEST_F(FlowTest, AckNumbersAreCorrect) {
 
 #endif // TINS_HAVE_ACK_TRACKER
 
+// Flow table tests
+
+StreamIdentifier make_flow_id(uint32_t index) {
+    return StreamIdentifier(StreamIdentifier::serialize(IPv4Address(index)), 1000,
+                            StreamIdentifier::serialize(IPv4Address("10.0.0.1")), 53);
+}
+
+TEST(FlowTableTest, InsertFindErase) {
+    FlowTable<uint32_t> table;
+    const uint32_t flow_count = 5000;
+    for (uint32_t i = 0; i < flow_count; ++i) {
+        EXPECT_TRUE(table.insert(make_flow_id(i)).second);
+        table[make_flow_id(i)] = i;
+    }
+    EXPECT_EQ(flow_count, table.size());
+    EXPECT_FALSE(table.insert(make_flow_id(0)).second);
+    for (uint32_t i = 0; i < flow_count; i += 2) {
+        EXPECT_TRUE(table.erase(make_flow_id(i)));
+    }
+    EXPECT_FALSE(table.erase(make_flow_id(0)));
+    EXPECT_EQ(flow_count / 2, table.size());
+    for (uint32_t i = 0; i < flow_count; ++i) {
+        const uint32_t* value = table.find(make_flow_id(i));
+        if (i % 2 == 0) {
+            EXPECT_TRUE(value == 0);
+        }
+        else {
+            ASSERT_TRUE(value != 0);
+            EXPECT_EQ(i, *value);
+        }
+    }
+    size_t iterated = 0;
+    for (FlowTable<uint32_t>::const_iterator iter = table.begin(); iter != table.end(); ++iter) {
+        EXPECT_EQ(1U, iter->second % 2);
+        iterated++;
+    }
+    EXPECT_EQ(table.size(), iterated);
+}
+
+TEST(FlowTableTest, RemoveIf) {
+    FlowTable<uint32_t> table;
+    for (uint32_t i = 0; i < 3000; ++i) {
+        table[make_flow_id(i)] = i;
+    }
+    size_t removed = table.remove_if([](const StreamIdentifier&, uint32_t value) {
+        return value % 3 != 0;
+    });
+    EXPECT_EQ(2000U, removed);
+    EXPECT_EQ(1000U, table.size());
+    for (uint32_t i = 0; i < 3000; ++i) {
+        EXPECT_EQ(i % 3 == 0, table.find(make_flow_id(i)) != 0);
+    }
+}
+
+TEST(FlowTableTest, BothDirectionsMatch) {
+    FlowTable<int> table;
+    IP forward = IP("4.3.2.1", "1.2.3.4") / UDP(53, 1000);
+    IP backward = IP("1.2.3.4", "4.3.2.1") / UDP(1000, 53);
+    table[StreamIdentifier::make_identifier(forward)] = 42;
+    const int* value = table.find(StreamIdentifier::make_identifier(backward));
+    ASSERT_TRUE(value != 0);
+    EXPECT_EQ(42, *value);
+}
+
+// UDP flow tracker tests
+
+TEST(UDPFlowTrackerTest, CountersAndDirections) {
+    UDPFlowTracker tracker;
+    EthernetII query = EthernetII() / IP("8.8.8.8", "192.168.0.2") / UDP(53, 5353) /
+                       RawPDU("query");
+    EthernetII response = EthernetII() / IP("192.168.0.2", "8.8.8.8") / UDP(5353, 53) /
+                          RawPDU("a longer response");
+    microseconds ts(1000000);
+    Packet packet1(query, ts);
+    Packet packet2(response, ts + milliseconds(10));
+    Packet packet3(response, ts + milliseconds(20));
+    tracker.process_packet(packet1);
+    tracker.process_packet(packet2);
+    tracker.process_packet(packet3);
+    EXPECT_EQ(1U, tracker.flow_count());
+
+    UDPFlowRecord record = tracker.find_flow(IPv4Address("8.8.8.8"), 53,
+                                             IPv4Address("192.168.0.2"), 5353);
+    EXPECT_EQ(IPv4Address("192.168.0.2"), record.client_addr_v4());
+    EXPECT_EQ(5353, record.client_port);
+    EXPECT_EQ(IPv4Address("8.8.8.8"), record.server_addr_v4());
+    EXPECT_EQ(53, record.server_port);
+    EXPECT_FALSE(record.is_v6);
+    EXPECT_EQ(1U, record.client_packets);
+    EXPECT_EQ(query.rfind_pdu<IP>().size(), record.client_bytes);
+    EXPECT_EQ(2U, record.server_packets);
+    EXPECT_EQ(2 * response.rfind_pdu<IP>().size(), record.server_bytes);
+    EXPECT_EQ(ts, record.first_seen);
+    EXPECT_EQ(ts + milliseconds(20), record.last_seen);
+
+    EXPECT_THROW(
+        tracker.find_flow(IPv4Address("8.8.4.4"), 53, IPv4Address("192.168.0.2"), 5353),
+        stream_not_found
+    );
+}
+
+TEST(UDPFlowTrackerTest, IdleTimeoutExportsFlows) {
+    UDPFlowTracker tracker;
+    vector<UDPFlowRecord> records;
+    tracker.idle_timeout(seconds(30));
+    tracker.flow_export_callback([&](const UDPFlowRecord& record) {
+        records.push_back(record);
+    });
+    microseconds ts(1000000);
+    Packet packet1(IP("1.1.1.1", "2.2.2.2") / UDP(1, 2), ts);
+    Packet packet2(IP("3.3.3.3", "2.2.2.2") / UDP(1, 2), ts + seconds(20));
+    Packet packet3(IP("3.3.3.3", "2.2.2.2") / UDP(1, 2), ts + seconds(40));
+    tracker.process_packet(packet1);
+    tracker.process_packet(packet2);
+    EXPECT_TRUE(records.empty());
+    tracker.process_packet(packet3);
+    ASSERT_EQ(1U, records.size());
+    EXPECT_EQ(IPv4Address("2.2.2.2"), records[0].client_addr_v4());
+    EXPECT_EQ(UDPFlowRecord::IDLE_TIMEOUT, records[0].end_reason);
+    EXPECT_EQ(1U, tracker.flow_count());
+
+    tracker.flush();
+    ASSERT_EQ(2U, records.size());
+    EXPECT_EQ(UDPFlowRecord::FORCED_END, records[1].end_reason);
+    EXPECT_EQ(2U, records[1].client_packets);
+    EXPECT_EQ(0U, tracker.flow_count());
+}
+
+TEST(UDPFlowTrackerTest, IgnoresNonUDPPackets) {
+    UDPFlowTracker tracker;
+    IP packet = IP("1.1.1.1", "2.2.2.2") / TCP(1, 2);
+    tracker.process_packet(packet);
+    EXPECT_EQ(0U, tracker.flow_count());
+}
+
 #else
 
 TEST(Foo, Dummy) {
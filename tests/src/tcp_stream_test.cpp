@@ -5,6 +5,8 @@
 #include <tins/tcp_stream.h>
 #include <tins/tcp.h>
 #include <tins/ethernetII.h>
+#include <tins/dns.h>
+#include <tins/pdu_allocator.h>
 
 using namespace Tins;
 
@@ -19,13 +21,16 @@ public:
     
     static void end_handle(TCPStream& session);
     static void overlapped_end_handle(TCPStream& session);
+    static void decoded_end_handle(TCPStream& session);
     
     static size_t index;
     static bool processed_stream;
+    static std::string stream_payload;
 };
 
 size_t TCPStreamTest::index;
 bool TCPStreamTest::processed_stream;
+std::string TCPStreamTest::stream_payload;
 
 EthernetII TCPStreamTest::packets[] = {
     EthernetII((const uint8_t*)"\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x08\x00\x45\x00\x00\x3c\xfd\x03\x40\x00\x40\x06\x3f\xb6\x7f\x00\x00\x01\x7f\x00\x00\x01\xa3\x78\x0b\xb8\xb1\xe6\x0f\x76\x00\x00\x00\x00\xa0\x02\x80\x18\xfe\x30\x00\x00\x02\x04\x40\x0c\x04\x02\x08\x0a\x2d\x1a\xf2\x75\x00\x00\x00\x00\x01\x03\x03\x04", 74),
@@ -179,3 +184,49 @@ TEST_F(TCPStreamTest, FollowOverlappedStreams5) {
     follower.follow_streams(overlapped_packets5, overlapped_packets5 + 8, data_handle, &TCPStreamTest::overlapped_end_handle);
     EXPECT_TRUE(processed_stream);
 }
+
+void TCPStreamTest::decoded_end_handle(TCPStream& session) {
+    processed_stream = true;
+    stream_payload.assign(session.client_payload().begin(), session.client_payload().end());
+}
+
+TEST_F(TCPStreamTest, FollowPayloadDecodedByPortAllocator) {
+    Allocators::register_allocator<TCP, DNS>(5353);
+    DNS dns;
+    dns.id(0x1234);
+    dns.add_query(DNS::query("www.example.com", DNS::A, DNS::INTERNET));
+    const PDU::serialization_type dns_buffer = dns.serialize();
+
+    TCP syn(5353, 40000);
+    syn.flags(TCP::SYN);
+    syn.seq(100);
+    TCP syn_ack(40000, 5353);
+    syn_ack.flags(TCP::SYN | TCP::ACK);
+    syn_ack.seq(500);
+    syn_ack.ack_seq(101);
+    TCP data(5353, 40000);
+    data.flags(TCP::ACK);
+    data.seq(101);
+    TCP fin(5353, 40000);
+    fin.flags(TCP::FIN | TCP::ACK);
+    fin.seq(101 + static_cast<uint32_t>(dns_buffer.size()));
+    EthernetII packets[] = {
+        EthernetII() / IP("1.2.3.4", "4.3.2.1") / syn,
+        EthernetII() / IP("4.3.2.1", "1.2.3.4") / syn_ack,
+        EthernetII() / IP("1.2.3.4", "4.3.2.1") / data / dns,
+        EthernetII() / IP("1.2.3.4", "4.3.2.1") / fin
+    };
+    std::vector<EthernetII> parsed;
+    for (size_t i = 0; i < 4; ++i) {
+        const PDU::serialization_type buffer = packets[i].serialize();
+        parsed.push_back(EthernetII(&buffer[0], static_cast<uint32_t>(buffer.size())));
+    }
+    ASSERT_TRUE(parsed[2].find_pdu<DNS>() != 0);
+
+    TCPStreamFollower follower;
+    processed_stream = false;
+    follower.follow_streams(parsed.begin(), parsed.end(), data_handle,
+                            &TCPStreamTest::decoded_end_handle);
+    EXPECT_TRUE(processed_stream);
+    EXPECT_EQ(std::string(dns_buffer.begin(), dns_buffer.end()), stream_payload);
+}
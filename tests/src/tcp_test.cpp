@@ -277,6 +277,52 @@ TEST_F(TCPTest, SpoofedOptions) {
     EXPECT_EQ(pdu.serialize().size(), pdu.size());
 }
 
+TEST_F(TCPTest, OptionsSharingBlock) {
+    uint8_t data[32];
+    for (size_t i = 0; i < sizeof(data); ++i) {
+        data[i] = static_cast<uint8_t>(i);
+    }
+    Internals::option_block block(data, data + sizeof(data));
+    TCP::option first(TCP::SACK, 16, data, 16, block);
+    TCP::option second(TCP::SACK, 12, data + 16, 12, block);
+    TCP::option small(TCP::MSS, 2, data + 28, 2, block);
+    // Both large options point into the same copy of the data
+    EXPECT_NE(data, first.data_ptr());
+    EXPECT_EQ(first.data_ptr() + 16, second.data_ptr());
+    EXPECT_TRUE(std::equal(data, data + 16, first.data_ptr()));
+    EXPECT_TRUE(std::equal(data + 16, data + 28, second.data_ptr()));
+    EXPECT_TRUE(std::equal(data + 28, data + 30, small.data_ptr()));
+    EXPECT_EQ(12U, second.data_size());
+    EXPECT_EQ(12U, second.length_field());
+
+    // Copies share the data as well
+    TCP::option copy(first);
+    EXPECT_EQ(first.data_ptr(), copy.data_ptr());
+    copy = TCP::option(TCP::SACK, data, data + 20);
+    EXPECT_NE(first.data_ptr(), copy.data_ptr());
+    EXPECT_TRUE(std::equal(data, data + 20, copy.data_ptr()));
+    copy = second;
+    EXPECT_EQ(second.data_ptr(), copy.data_ptr());
+    copy = small;
+    EXPECT_TRUE(std::equal(data + 28, data + 30, copy.data_ptr()));
+}
+
+TEST_F(TCPTest, OptionOutlivesPDU) {
+    TCP::option sack;
+    {
+        TCP tcp(expected_packet, sizeof(expected_packet));
+        const TCP::option* option = tcp.search_option(TCP::SACK);
+        ASSERT_TRUE(option != 0);
+        sack = *option;
+    }
+    TCP tcp;
+    tcp.add_option(sack);
+    TCP::sack_type edges = tcp.sack();
+    ASSERT_EQ(2U, edges.size());
+    EXPECT_EQ(0x00010203U, edges[0]);
+    EXPECT_EQ(0x04050607U, edges[1]);
+}
+
 TEST_F(TCPTest, MalformedOptionAfterEOL) {
     TCP tcp(malformed_option_after_eol_packet, sizeof(malformed_option_after_eol_packet));
     EXPECT_EQ(0U, tcp.options().size());
@@ -300,3 +346,48 @@ TEST_F(TCPTest, RemoveOption) {
     PDU::serialization_type new_buffer = tcp.serialize();
     EXPECT_EQ(old_buffer, new_buffer);
 }
+
+TEST_F(TCPTest, OptionsBeforeParsing) {
+    const TCP tcp(expected_packet, sizeof(expected_packet));
+    // None of these need the options to be decoded
+    EXPECT_EQ(sizeof(expected_packet), tcp.size());
+    EXPECT_EQ(0x98fa, tcp.mss());
+    EXPECT_EQ(0x7a, tcp.winscale());
+    EXPECT_TRUE(tcp.has_sack_permitted());
+    EXPECT_EQ(std::make_pair(0x4fd23acbU, 0x89fe1234U), tcp.timestamp());
+    EXPECT_EQ(2U, tcp.sack().size());
+    EXPECT_THROW(tcp.altchecksum(), option_not_found);
+
+    EXPECT_EQ(5U, tcp.options().size());
+    EXPECT_EQ(0x98fa, tcp.mss());
+    EXPECT_EQ(sizeof(expected_packet), tcp.size());
+}
+
+TEST_F(TCPTest, ModifyOptionsBeforeParsing) {
+    TCP tcp1(expected_packet, sizeof(expected_packet));
+    TCP tcp2(tcp1);
+    EXPECT_TRUE(tcp2.remove_option(TCP::MSS));
+    tcp2.altchecksum(TCP::CHK_16FLETCHER);
+
+    EXPECT_EQ(0x98fa, tcp1.mss());
+    EXPECT_THROW(tcp1.altchecksum(), option_not_found);
+    EXPECT_THROW(tcp2.mss(), option_not_found);
+    EXPECT_EQ(TCP::CHK_16FLETCHER, tcp2.altchecksum());
+    EXPECT_EQ(5U, tcp2.options().size());
+
+    PDU::serialization_type buffer = tcp2.serialize();
+    TCP tcp3(&buffer[0], (uint32_t)buffer.size());
+    EXPECT_EQ(TCP::CHK_16FLETCHER, tcp3.altchecksum());
+    EXPECT_EQ(tcp1.timestamp(), tcp3.timestamp());
+    EXPECT_THROW(tcp3.mss(), option_not_found);
+}
+
+TEST_F(TCPTest, TruncatedOption) {
+    uint8_t packet[24];
+    std::copy(expected_packet, expected_packet + 20, packet);
+    packet[12] = 0x60;
+    // MSS option claiming 10 bytes
+    const uint8_t option[] = { 2, 10, 152, 250 };
+    std::copy(option, option + sizeof(option), packet + 20);
+    EXPECT_THROW(TCP(packet, sizeof(packet)), malformed_packet);
+}
@@ -5,12 +5,26 @@
 #include <gtest/gtest.h>
 #include <cstring>
 #include <string>
+#include <mutex>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
 #include <stdint.h>
+#ifndef _WIN32
+    #include <sys/stat.h>
+#endif // _WIN32
+#include <openssl/evp.h>
 #include <tins/crypto.h>
+#include <tins/wpa2_parallel_decrypter.h>
+#include <tins/wpa2_pmk.h>
+#include <tins/packet.h>
 #include <tins/radiotap.h>
 #include <tins/dot11/dot11_data.h>
+#include <tins/snap.h>
+#include <tins/ip.h>
 #include <tins/udp.h>
 #include <tins/tcp.h>
+#include <tins/rawpdu.h>
 #include <tins/arp.h>
 
 using namespace Tins;
@@ -53,6 +67,9 @@ public:
     void check_tkip_packet5(const PDU& pdu);
     void check_tkip_packet6(const PDU& pdu);
 
+    static Dot11Data gcmp_encrypt(const Dot11Data& dot11, const PDU::serialization_type& plaintext,
+                                  const uint8_t* key, size_t key_size);
+
     void handshake_captured(const string& ssid, const address_type& bssid, const address_type& client_hw) {
         handshakes_.push_back(handshake(ssid, bssid, client_hw));
     }
@@ -145,6 +162,176 @@ void WPA2DecryptTest::check_tkip_packet6(const PDU& pdu) {
     EXPECT_EQ(tcp->window(), 1204);
 }
 
+Dot11Data WPA2DecryptTest::gcmp_encrypt(const Dot11Data& dot11,
+                                        const PDU::serialization_type& plaintext,
+                                        const uint8_t* key, size_t key_size) {
+    const PDU::serialization_type header = Dot11Data(dot11).serialize();
+    // Mask the frame control and sequence control fields
+    uint8_t aad[22];
+    aad[0] = header[0] & 0x8f;
+    aad[1] = (header[1] & 0xc7) | 0x40;
+    std::copy(header.begin() + 4, header.begin() + 22, aad + 2);
+    aad[20] = header[22] & 0x0f;
+    aad[21] = 0;
+    // PN 0x060504030201 using the extended IV
+    const uint8_t gcmp_header[8] = { 1, 2, 0, 0x20, 3, 4, 5, 6 };
+    uint8_t nonce[12] = { 0, 0, 0, 0, 0, 0, 6, 5, 4, 3, 2, 1 };
+    dot11.addr2().copy(nonce);
+
+    PDU::serialization_type payload(gcmp_header, gcmp_header + 8);
+    payload.resize(8 + plaintext.size() + 16);
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    int length;
+    EVP_EncryptInit_ex(ctx, key_size == 16 ? EVP_aes_128_gcm() : EVP_aes_256_gcm(), 0, 0, 0);
+    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, sizeof(nonce), 0);
+    EVP_EncryptInit_ex(ctx, 0, 0, key, nonce);
+    EVP_EncryptUpdate(ctx, 0, &length, aad, sizeof(aad));
+    EVP_EncryptUpdate(ctx, &payload[8], &length, &plaintext[0], (int)plaintext.size());
+    EVP_EncryptFinal_ex(ctx, &payload[8] + length, &length);
+    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, 16, &payload[8] + plaintext.size());
+    EVP_CIPHER_CTX_free(ctx);
+
+    Dot11Data output = dot11;
+    output.inner_pdu(RawPDU(payload));
+    return output;
+}
+
+TEST_F(WPA2DecryptTest, DecryptGCMP) {
+    using Crypto::WPA2::SessionKeys;
+    const SessionKeys::CipherType ciphers[] = { SessionKeys::GCMP_128, SessionKeys::GCMP_256 };
+    for (size_t i = 0; i < 2; ++i) {
+        SessionKeys::ptk_type ptk(SessionKeys::PTK_SIZE);
+        for (size_t j = 0; j < ptk.size(); ++j) {
+            ptk[j] = static_cast<uint8_t>(j * 7);
+        }
+        SessionKeys keys(ptk, ciphers[i]);
+        EXPECT_EQ(ciphers[i], keys.cipher());
+        EXPECT_FALSE(keys.uses_ccmp());
+
+        Dot11Data dot11("00:01:02:03:04:05", "06:07:08:09:0a:0b");
+        dot11.addr3("06:07:08:09:0a:0b");
+        dot11.from_ds(1);
+        dot11.wep(1);
+        dot11.frag_num(3);
+        dot11.seq_num(1234);
+        const PDU::serialization_type plaintext = (
+            SNAP() / IP("1.2.3.4", "4.3.2.1") / UDP(53, 1234) / RawPDU("hello")
+        ).serialize();
+        Dot11Data encrypted = gcmp_encrypt(dot11, plaintext, &ptk[32], i == 0 ? 16 : 32);
+
+        SNAP* snap = keys.decrypt_unicast(encrypted, encrypted.rfind_pdu<RawPDU>());
+        ASSERT_TRUE(snap != 0);
+        EXPECT_EQ(plaintext, snap->serialize());
+        delete snap;
+
+        // A modified frame fails authentication
+        encrypted = gcmp_encrypt(dot11, plaintext, &ptk[32], i == 0 ? 16 : 32);
+        encrypted.rfind_pdu<RawPDU>().payload()[10] ^= 1;
+        EXPECT_TRUE(keys.decrypt_unicast(encrypted, encrypted.rfind_pdu<RawPDU>()) == 0);
+
+        // The same keys and their copies keep decrypting after a failure
+        const SessionKeys copy = keys;
+        for (size_t j = 0; j < 2; ++j) {
+            const SessionKeys& current = (j == 0) ? keys : copy;
+            encrypted = gcmp_encrypt(dot11, plaintext, &ptk[32], i == 0 ? 16 : 32);
+            snap = current.decrypt_unicast(encrypted, encrypted.rfind_pdu<RawPDU>());
+            ASSERT_TRUE(snap != 0);
+            EXPECT_EQ(plaintext, snap->serialize());
+            delete snap;
+        }
+    }
+}
+
+TEST_F(WPA2DecryptTest, DerivePMKs) {
+    using Crypto::WPA2::SessionKeys;
+    // IEEE 802.11i test vector
+    const uint8_t expected[] = {
+        0xf4, 0x2c, 0x6f, 0xc5, 0x2d, 0xf0, 0xeb, 0xef, 0x9e, 0xbb, 0x4b, 0x90, 
+        0xb3, 0x8a, 0x5f, 0x90, 0x2e, 0x83, 0xfe, 0x1b, 0x13, 0x5a, 0x70, 0xe2, 
+        0x3a, 0xed, 0x76, 0x2e, 0x97, 0x10, 0xa1, 0x2e
+    };
+    EXPECT_EQ(SessionKeys::pmk_type(expected, expected + sizeof(expected)),
+              Crypto::WPA2::derive_pmk("password", "IEEE"));
+
+    vector<std::pair<string, string> > credentials;
+    for (size_t i = 0; i < 9; ++i) {
+        credentials.push_back(std::make_pair(string(8 + i * 7, 'a' + i), string(i * 4, 'z' - i)));
+    }
+    // These can't be derived using the fast path
+    credentials.push_back(std::make_pair(string(70, 'p'), "ssid"));
+    credentials.push_back(std::make_pair("password", string(60, 's')));
+    const vector<SessionKeys::pmk_type> pmks = Crypto::WPA2::derive_pmks(credentials, 3);
+    ASSERT_EQ(credentials.size(), pmks.size());
+    for (size_t i = 0; i < credentials.size(); ++i) {
+        SessionKeys::pmk_type pmk(SessionKeys::PMK_SIZE);
+        PKCS5_PBKDF2_HMAC_SHA1(credentials[i].first.c_str(), credentials[i].first.size(),
+                               (const uint8_t*)credentials[i].second.c_str(),
+                               credentials[i].second.size(), 4096, pmk.size(), &pmk[0]);
+        EXPECT_EQ(pmk, pmks[i]);
+    }
+}
+
+TEST_F(WPA2DecryptTest, PMKCache) {
+    using Crypto::WPA2::PMKCache;
+    const string path = "wpa2_decrypt_test_pmk_cache";
+    vector<std::pair<string, string> > credentials;
+    credentials.push_back(std::make_pair("Induction", "Coherer"));
+    credentials.push_back(std::make_pair("libtinstest", "NODO"));
+    {
+        PMKCache cache(path);
+        EXPECT_EQ(0U, cache.size());
+        Crypto::WPA2::derive_pmks(credentials, 1, &cache);
+        EXPECT_EQ(2U, cache.size());
+        cache.save();
+    }
+    #ifndef _WIN32
+        // The cache holds secrets, so only its owner can access it
+        struct stat file_stat;
+        ASSERT_EQ(0, stat(path.c_str(), &file_stat));
+        EXPECT_EQ(0600U, static_cast<unsigned>(file_stat.st_mode & 0777));
+    #endif // _WIN32
+    PMKCache cache(path);
+    ASSERT_EQ(2U, cache.size());
+    ASSERT_TRUE(cache.find("Induction", "Coherer") != 0);
+    EXPECT_EQ(Crypto::WPA2::derive_pmk("Induction", "Coherer"), 
+              *cache.find("Induction", "Coherer"));
+    EXPECT_TRUE(cache.find("Induction", "NODO") == 0);
+
+    // Cached PMKs are used as they are
+    Crypto::WPA2::SessionKeys::pmk_type fake_pmk(32, 7);
+    cache.insert("Induction", "Coherer", fake_pmk);
+    EXPECT_EQ(fake_pmk, Crypto::WPA2::derive_pmks(credentials, 1, &cache)[0]);
+
+    // SSIDs longer than 32 bytes are rejected
+    EXPECT_THROW(cache.insert("Induction", string(33, 'a'), fake_pmk),
+                 Crypto::WPA2::invalid_ssid);
+    EXPECT_EQ(2U, cache.size());
+
+    // Invalid files are ignored
+    {
+        std::ofstream output(path.c_str(), std::ios::binary | std::ios::trunc);
+        output << "garbage";
+    }
+    EXPECT_EQ(0U, PMKCache(path).size());
+    std::remove(path.c_str());
+}
+
+TEST_F(WPA2DecryptTest, DecryptCCMPUsingSupplicantData) {
+    Crypto::WPA2Decrypter decrypter;
+    vector<std::pair<string, string> > credentials(1, std::make_pair("Induction", "Coherer"));
+    decrypter.add_ap_data(
+        Crypto::WPA2::SupplicantData(Crypto::WPA2::derive_pmks(credentials)[0], "Coherer")
+    );
+    for(size_t i = 0; i < 7; ++i) {
+        RadioTap radio(ccmp_packets[i], ccmp_packets_size[i]);
+        if(i > 4) {
+            ASSERT_TRUE(decrypter.decrypt(radio));
+        }
+        else 
+            ASSERT_FALSE(decrypter.decrypt(radio));
+    }
+}
+
 TEST_F(WPA2DecryptTest, DecryptCCMPUsingBeacon) {
     Crypto::WPA2Decrypter decrypter;
     decrypter.add_ap_data("Induction", "Coherer");
@@ -259,6 +446,26 @@ TEST_F(WPA2DecryptTest, DecryptTKIPWithoutUsingBeacon) {
     }
 }
 
+TEST_F(WPA2DecryptTest, DecryptTKIPRepeatedly) {
+    Crypto::WPA2Decrypter decrypter;
+    decrypter.add_ap_data("libtinstest", "NODO", "00:1b:11:d2:1b:eb");
+    for(size_t i = 1; i < 5; ++i) {
+        RadioTap radio(tkip_packets[i], tkip_packets_size[i]);
+        ASSERT_FALSE(decrypter.decrypt(radio));
+    }
+    // Alternate directions so cached phase 1 keys get reused
+    for(size_t n = 0; n < 3; ++n) {
+        for(size_t i = 5; i < 7; ++i) {
+            RadioTap radio(tkip_packets[i], tkip_packets_size[i]);
+            ASSERT_TRUE(decrypter.decrypt(radio));
+            if(i == 5)
+                check_tkip_packet5(radio);
+            else
+                check_tkip_packet6(radio);
+        }
+    }
+}
+
 TEST_F(WPA2DecryptTest, DecryptTKIPUsingKey) {
     Crypto::WPA2Decrypter::addr_pair addresses;
     Crypto::WPA2::SessionKeys session_keys;
@@ -350,8 +557,88 @@ TEST_F(WPA2DecryptTest, DecryptCCMPAndTKIPWithoutUsingBeacon) {
     }
 }
 
+TEST_F(WPA2DecryptTest, HandshakeCapturerKeepsOriginalFrames) {
+    RSNHandshakeCapturer capturer;
+    capturer.timeout(10);
+    for(size_t i = 1; i < 5; ++i) {
+        RadioTap radio(ccmp_packets[i], ccmp_packets_size[i]);
+        Packet packet(radio, Timestamp(timeval()));
+        EXPECT_EQ(i == 4, capturer.process_packet(packet));
+    }
+    ASSERT_EQ(1U, capturer.handshakes().size());
+    const RSNHandshake::container_type& frames = capturer.handshakes()[0].handshake();
+    ASSERT_EQ(4U, frames.size());
+    for(size_t i = 0; i < frames.size(); ++i) {
+        RadioTap radio(ccmp_packets[i + 1], ccmp_packets_size[i + 1]);
+        RSNEAPOL frame = frames[i];
+        EXPECT_EQ(radio.rfind_pdu<RSNEAPOL>().serialize(), frame.serialize());
+    }
+}
+
 #ifdef TINS_HAVE_WPA2_CALLBACKS
 
+TEST_F(WPA2DecryptTest, HandshakeCapturerCallback) {
+    vector<RSNHandshake> handshakes;
+    RSNHandshakeCapturer capturer;
+    capturer.handshake_callback([&](const RSNHandshake& handshake) {
+        handshakes.push_back(handshake);
+    });
+    for(size_t i = 1; i < 5; ++i) {
+        RadioTap radio(ccmp_packets[i], ccmp_packets_size[i]);
+        EXPECT_EQ(i == 4, capturer.process_packet(radio));
+        EXPECT_EQ(i == 4 ? 0U : 1U, capturer.pending_handshakes());
+    }
+    EXPECT_TRUE(capturer.handshakes().empty());
+    ASSERT_EQ(1U, handshakes.size());
+    ASSERT_EQ(4U, handshakes[0].handshake().size());
+
+    // The captured handshake must yield valid keys
+    Crypto::WPA2::SupplicantData supplicant_data("Induction", "Coherer");
+    Crypto::WPA2::SessionKeys session_keys(handshakes[0], supplicant_data.pmk());
+    EXPECT_TRUE(session_keys.uses_ccmp());
+}
+
+TEST_F(WPA2DecryptTest, HandshakeCapturerCopyKeepsCallback) {
+    size_t count = 0;
+    RSNHandshakeCapturer capturer;
+    capturer.handshake_callback([&](const RSNHandshake&) {
+        ++count;
+    });
+    RSNHandshakeCapturer copy(capturer);
+    capturer = RSNHandshakeCapturer();
+    for(size_t i = 1; i < 5; ++i) {
+        RadioTap radio(ccmp_packets[i], ccmp_packets_size[i]);
+        copy.process_packet(radio);
+        capturer.process_packet(radio);
+    }
+    EXPECT_EQ(1U, count);
+    EXPECT_TRUE(copy.handshakes().empty());
+    EXPECT_EQ(1U, capturer.handshakes().size());
+}
+
+TEST_F(WPA2DecryptTest, HandshakeCapturerTimeout) {
+    using std::chrono::seconds;
+
+    RSNHandshakeCapturer capturer;
+    capturer.timeout(seconds(10));
+    const int64_t times[] = { 0, 1, 20, 21 };
+    for(size_t i = 1; i < 5; ++i) {
+        RadioTap radio(ccmp_packets[i], ccmp_packets_size[i]);
+        Packet packet(radio, Timestamp(seconds(times[i - 1])));
+        EXPECT_FALSE(capturer.process_packet(packet));
+    }
+    EXPECT_EQ(0U, capturer.pending_handshakes());
+    EXPECT_TRUE(capturer.handshakes().empty());
+
+    // A handshake that makes progress within the timeout is completed
+    for(size_t i = 1; i < 5; ++i) {
+        RadioTap radio(ccmp_packets[i], ccmp_packets_size[i]);
+        Packet packet(radio, Timestamp(seconds(100 + i * 8)));
+        EXPECT_EQ(i == 4, capturer.process_packet(packet));
+    }
+    EXPECT_EQ(1U, capturer.handshakes().size());
+}
+
 TEST_F(WPA2DecryptTest, HandshakeCapturedCallback) {
     using namespace std::placeholders;
 
@@ -407,6 +694,78 @@ TEST_F(WPA2DecryptTest, AccessPointFoundCallback) {
     EXPECT_EQ(address_type("00:1b:11:d2:1b:eb"), data.bssid);
 }
 
+TEST_F(WPA2DecryptTest, ParallelDecryptCCMPAndTKIP) {
+    std::mutex packets_mutex;
+    vector<Packet> decrypted_packets;
+    size_t packet_count = 0;
+    Crypto::WPA2ParallelDecrypter decrypter(4, [&](Packet& packet, bool decrypted) {
+        std::lock_guard<std::mutex> _(packets_mutex);
+        ++packet_count;
+        if (decrypted) {
+            decrypted_packets.push_back(packet);
+        }
+    });
+    EXPECT_EQ(4U, decrypter.thread_count());
+    decrypter.add_ap_data("libtinstest", "NODO");
+    decrypter.add_ap_data("Induction", "Coherer");
+    for (size_t i = 0; i < 7; ++i) {
+        decrypter.process(Packet(RadioTap(ccmp_packets[i], ccmp_packets_size[i]), Timestamp()));
+        decrypter.process(Packet(RadioTap(tkip_packets[i], tkip_packets_size[i]), Timestamp()));
+    }
+    decrypter.flush();
+    EXPECT_EQ(2U, decrypter.get_keys().size());
+    EXPECT_EQ(14U, packet_count);
+    ASSERT_EQ(4U, decrypted_packets.size());
+
+    // Packets exchanged between the same addresses are kept in order
+    vector<const PDU*> ccmp_decrypted, tkip_decrypted;
+    for (size_t i = 0; i < decrypted_packets.size(); ++i) {
+        const PDU* pdu = decrypted_packets[i].pdu();
+        if (pdu->find_pdu<UDP>()) {
+            ccmp_decrypted.push_back(pdu);
+        }
+        else {
+            tkip_decrypted.push_back(pdu);
+        }
+    }
+    ASSERT_EQ(2U, ccmp_decrypted.size());
+    ASSERT_EQ(2U, tkip_decrypted.size());
+    check_ccmp_packet5(*ccmp_decrypted[0]);
+    check_ccmp_packet6(*ccmp_decrypted[1]);
+    check_tkip_packet5(*tkip_decrypted[0]);
+    check_tkip_packet6(*tkip_decrypted[1]);
+}
+
+TEST_F(WPA2DecryptTest, ParallelDecryptWorkerException) {
+    std::atomic<bool> thrown(false);
+    Crypto::WPA2ParallelDecrypter decrypter(2, [&](Packet&, bool decrypted) {
+        if (decrypted && !thrown.exchange(true)) {
+            throw malformed_packet();
+        }
+    });
+    decrypter.add_ap_data("libtinstest", "NODO");
+    decrypter.add_ap_data("Induction", "Coherer");
+    // The exception is rethrown by either process or flush
+    size_t caught = 0;
+    for (size_t i = 0; i < 7; ++i) {
+        try {
+            decrypter.process(Packet(RadioTap(ccmp_packets[i], ccmp_packets_size[i]), Timestamp()));
+        }
+        catch (const malformed_packet&) {
+            ++caught;
+        }
+    }
+    try {
+        decrypter.flush();
+    }
+    catch (const malformed_packet&) {
+        ++caught;
+    }
+    EXPECT_TRUE(thrown);
+    EXPECT_EQ(1U, caught);
+    EXPECT_NO_THROW(decrypter.flush());
+}
+
 #endif // TINS_HAVE_WPA2_CALLBACKS
 
 #endif // defined(TINS_HAVE_DOT11) && defined(TINS_HAVE_WPA2_DECRYPTION)